@@ -0,0 +1,137 @@
+package com.blackjack.net;
+
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OperationsPerInvocation;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.Warmup;
+import org.openjdk.jmh.infra.Blackhole;
+
+import java.nio.charset.StandardCharsets;
+import java.util.List;
+
+/**
+ * DecodeBenchmark
+ *
+ * Purpose:
+ *   Messages per second through {@link ClientProtocol#onLine} for typical server traffic,
+ *   next to the old {@code trim()} + {@code split("\\s+")} approach as a baseline.
+ *
+ * Run (from clientBlackJack/client):
+ *   {@code mvn -Pjmh compile exec:exec}
+ * The profile passes {@code -prof gc}, so the report also shows
+ * {@code gc.alloc.rate.norm} (bytes allocated per message).
+ *
+ * Table of contents:
+ *   - gameplay(): per-turn messages while in a game
+ *   - round(): lobby snapshot, join, one full game
+ *   - splitBaseline(): old per-line String work
+ */
+@State(Scope.Thread)
+@BenchmarkMode(Mode.Throughput)
+@Warmup(iterations = 3, time = 1)
+@Measurement(iterations = 5, time = 1)
+@Fork(1)
+public class DecodeBenchmark {
+    private static final String[] GAMEPLAY = {
+            "C45D AS TD",
+            "C45T alice 30",
+            "C45C 7H",
+            "C45PI",
+            "C45PO",
+            "C45T bob 30",
+            "C45C 9S",
+            "C45B bob 26",
+            "C45TO",
+    };
+    private static final String[] ROUND = {
+            "C45L 10 00001020001000000000",
+            "C45OK",
+            "C45D AS TD",
+            "C45T alice 30",
+            "C45C 7H",
+            "C45T bob 30",
+            "C45C 9S",
+            "C45B bob 26",
+            "C45R alice 18 bob 26 alice",
+    };
+
+    private byte[][] gameplay;
+    private byte[][] round;
+    private ClientProtocol protocol;
+    private SinkListener sink;
+
+    /** Listener that feeds every event into the blackhole. */
+    private static final class SinkListener implements ProtocolListener {
+        Blackhole bh;
+        @Override public void onLobbySnapshot(List<LobbyRow> rows) { bh.consume(rows); }
+        @Override public void onDeal(String c1, String c2) { bh.consume(c1); bh.consume(c2); }
+        @Override public void onTurn(String player, int seconds) { bh.consume(player); bh.consume(seconds); }
+        @Override public void onCard(String card) { bh.consume(card); }
+        @Override public void onBust(String player, int value) { bh.consume(player); bh.consume(value); }
+        @Override public void onResult(String summary) { bh.consume(summary); }
+    }
+
+    @Setup
+    public void setup() throws Exception {
+        gameplay = toBytes(GAMEPLAY);
+        round = toBytes(ROUND);
+        sink = new SinkListener();
+        protocol = new ClientProtocol();
+        long now = System.currentTimeMillis();
+        protocol.onNameSent(now);
+        feed("C45OK");
+        feed("C45L 1 00");
+        protocol.onJoinSent();
+        feed("C45OK");
+        feed("C45D 2C 3D");
+    }
+
+    /** Drive the protocol into a game before measuring (no blackhole yet, so no sink). */
+    private void feed(String line) throws Exception {
+        byte[] b = line.getBytes(StandardCharsets.US_ASCII);
+        protocol.onLine(b, 0, b.length, System.currentTimeMillis(), new ProtocolListener() { });
+    }
+
+    private static byte[][] toBytes(String[] lines) {
+        byte[][] out = new byte[lines.length][];
+        for (int i = 0; i < lines.length; i++) out[i] = lines[i].getBytes(StandardCharsets.US_ASCII);
+        return out;
+    }
+
+    @Benchmark
+    @OperationsPerInvocation(9)
+    public void gameplay(Blackhole bh) throws Exception {
+        sink.bh = bh;
+        long now = System.currentTimeMillis();
+        for (byte[] b : gameplay) bh.consume(protocol.onLine(b, 0, b.length, now, sink));
+    }
+
+    @Benchmark
+    @OperationsPerInvocation(9)
+    public void round(Blackhole bh) throws Exception {
+        sink.bh = bh;
+        long now = System.currentTimeMillis();
+        // After the previous round's result the client is back at the lobby list.
+        protocol.onBackSent();
+        for (int i = 0; i < round.length; i++) {
+            if (i == 1) protocol.onJoinSent();
+            byte[] b = round[i];
+            bh.consume(protocol.onLine(b, 0, b.length, now, sink));
+        }
+    }
+
+    @Benchmark
+    @OperationsPerInvocation(9)
+    public void splitBaseline(Blackhole bh) {
+        for (byte[] b : gameplay) {
+            String t = new String(b, StandardCharsets.UTF_8).trim();
+            bh.consume(t.split("\\s+"));
+        }
+    }
+}
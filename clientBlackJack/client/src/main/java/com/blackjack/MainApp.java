@@ -1,12 +1,12 @@
 package com.blackjack;
 
+import com.blackjack.net.LobbyRow;
 import com.blackjack.net.NetClient;
 import com.blackjack.net.ProtocolListener;
 import com.blackjack.ui.GameView;
+import com.blackjack.ui.UiDispatcher;
 
 import javafx.application.Application;
-import javafx.application.Platform;
-import javafx.beans.property.*;
 import javafx.collections.FXCollections;
 import javafx.collections.ObservableList;
 import javafx.geometry.Insets;
@@ -21,6 +21,8 @@ import java.net.SocketException;
 import java.util.ArrayList;
 import java.util.List;
 import java.util.Objects;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
 
 /**
  * MainApp
@@ -33,6 +35,12 @@ import java.util.Objects;
  *   - Wire UI actions to {@link com.blackjack.net.NetClient} commands.
  *   - React to protocol events via {@link com.blackjack.net.ProtocolListener}.
  *
+ * Threading:
+ *   - All sends (connect, name, join, back, hit, stand) run on one "net-sender" thread,
+ *     in the order they were issued.
+ *   - All UI updates go through {@link UiDispatcher}, which batches protocol events
+ *     that arrive before the next FX pulse into one update.
+ *
  * Table of contents:
  *   - Scene builders: buildConnectScene(), buildNameScene(), buildLobbyChoiceScene(), buildLobbyWaitingScene()
  *   - Protocol listener wiring: buildListener()
@@ -47,6 +55,14 @@ public class MainApp extends Application {
     private String lastHost;
     private int lastPort;
 
+    /* --- Threads --- */
+    private final ExecutorService sender = Executors.newSingleThreadExecutor(r -> {
+        Thread t = new Thread(r, "net-sender");
+        t.setDaemon(true);
+        return t;
+    });
+    private final UiDispatcher ui = new UiDispatcher();
+
     /* --- UI state --- */
     private Stage primaryStage;
     private GameView gameView; // created when entering a lobby
@@ -59,43 +75,12 @@ public class MainApp extends Application {
     @Override
     public void start(Stage stage) {
         this.primaryStage = stage;
+        ui.setAfterBatch(() -> { if (gameView != null) gameView.flush(); });
         stage.setTitle("Blackjack Client — connection");
         stage.setScene(buildConnectScene(null));
         stage.show();
     }
 
-    /* --- Lobby row model (used by NetClient) --- */
-    public static class LobbyRow {
-        private final IntegerProperty id = new SimpleIntegerProperty();
-        private final IntegerProperty players = new SimpleIntegerProperty();
-        private final IntegerProperty capacity = new SimpleIntegerProperty();
-        private final StringProperty status = new SimpleStringProperty();
-
-        /**
-         * Create a lobby row model.
-         *
-         * @param id       Lobby id (1-based).
-         * @param players  Current player count.
-         * @param capacity Lobby capacity.
-         * @param status   Lobby status string from the server.
-         */
-        public LobbyRow(int id, int players, int capacity, String status) {
-            this.id.set(id);
-            this.players.set(players);
-            this.capacity.set(capacity);
-            this.status.set(status);
-        }
-
-        /** @return Lobby id (1-based). */
-        public int getId() { return id.get(); }
-        /** @return Current player count. */
-        public int getPlayers() { return players.get(); }
-        /** @return Lobby capacity. */
-        public int getCapacity() { return capacity.get(); }
-        /** @return Lobby status string from the server. */
-        public String getStatus() { return status.get(); }
-    }
-
     // =================================================================
     //                                SCENES
     // =================================================================
@@ -141,12 +126,12 @@ public class MainApp extends Application {
             connectBtn.setDisable(true);
             status.setText("Connection...");
 
-            new Thread(() -> {
+            sender.execute(() -> {
                 try {
                     closeClient();
                     client = NetClient.connect(ip, port, 10000);
                     client.startReader(buildListener());
-                    Platform.runLater(() -> {
+                    ui.post(() -> {
                         primaryStage.setTitle("Blackjack Client — enter name");
                         primaryStage.setScene(buildNameScene());
                     });
@@ -154,9 +139,9 @@ public class MainApp extends Application {
                     String reason = normalizeNetError(ex2);
                     goToConnectScene("Connection ERROR: " + reason);
                 } finally {
-                    Platform.runLater(() -> connectBtn.setDisable(false));
+                    ui.post(() -> connectBtn.setDisable(false));
                 }
-            }, "connect-thread").start();
+            });
         });
 
         reconnectBtn.setOnAction(e -> {
@@ -185,13 +170,13 @@ public class MainApp extends Application {
             connectBtn.setDisable(true);
             status.setText("Reconnecting...");
 
-            new Thread(() -> {
+            sender.execute(() -> {
                 try {
                     closeClient();
                     client = NetClient.connect(ip, port, 5000);
                     client.startReader(buildListener());
                     client.sendReconnect(name, lastLobbySelected);
-                    Platform.runLater(() -> {
+                    ui.post(() -> {
                         primaryStage.setTitle("Blackjack Client — reconnecting");
                         primaryStage.setScene(buildLobbyWaitingScene("Reconnecting to the server..."));
                     });
@@ -199,12 +184,12 @@ public class MainApp extends Application {
                     String reason = normalizeNetError(ex2);
                     goToConnectScene("Connection ERROR: " + reason);
                 } finally {
-                    Platform.runLater(() -> {
+                    ui.post(() -> {
                         reconnectBtn.setDisable(false);
                         connectBtn.setDisable(false);
                     });
                 }
-            }, "reconnect-thread").start();
+            });
         });
 
         GridPane root = new GridPane();
@@ -255,7 +240,7 @@ public class MainApp extends Application {
             sendBtn.setDisable(true);
             status.setText("Sending name...");
 
-            new Thread(() -> {
+            sender.execute(() -> {
                 try {
                     if (client == null) throw new SocketException("Connection broke");
                     // Reader thread is started on connect; here we only send the name handshake.
@@ -265,9 +250,9 @@ public class MainApp extends Application {
                     System.out.println("build Name");
                     goToConnectScene("Connection lost: " + reason);
                 } finally {
-                    Platform.runLater(() -> sendBtn.setDisable(false));
+                    ui.post(() -> sendBtn.setDisable(false));
                 }
-            }, "send-name-thread").start();
+            });
         });
 
         GridPane root = new GridPane();
@@ -360,21 +345,21 @@ public class MainApp extends Application {
 
             lastLobbySelected = num;
 
-            new Thread(() -> {
+            sender.execute(() -> {
                 try {
                     if (client == null) throw new SocketException("Connection broke");
                     // Protocol: "C45J <lobby>\n" (name is implicit after the handshake)
                     client.sendJoin(Objects.requireNonNullElse(name, ""), num);
-                    Platform.runLater(() -> status.setText("Send: " + num));
+                    ui.post(() -> status.setText("Send: " + num));
                     // Join confirmation is delivered via onLobbyJoinOk() from the protocol listener.
                 } catch (Exception ex2) {
                     String reason = normalizeNetError(ex2);
                     System.out.println("build Lobby Choice");
                     goToConnectScene("Connection lost: " + reason);
                 } finally {
-                    Platform.runLater(() -> joinBtn.setDisable(false));
+                    ui.post(() -> joinBtn.setDisable(false));
                 }
-            }, "send-lobby-thread").start();
+            });
         });
 
         Button backBtn = new Button("Disconnect");
@@ -409,7 +394,7 @@ public class MainApp extends Application {
         return new ProtocolListener() {
             @Override
             public void onOk() {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     primaryStage.setTitle("Blackjack Client — Lobyy (waiting for data)");
                     primaryStage.setScene(buildLobbyWaitingScene());
                 });
@@ -417,7 +402,7 @@ public class MainApp extends Application {
 
             @Override
             public void onLobbySnapshot(List<LobbyRow> rows) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     ObservableList<LobbyRow> data = FXCollections.observableArrayList(new ArrayList<>(rows));
                     primaryStage.setTitle("Blackjack Client — Chose Lobby");
                     primaryStage.setScene(buildLobbyChoiceScene(data));
@@ -426,10 +411,10 @@ public class MainApp extends Application {
 
             @Override
             public void onLobbyJoinOk() {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     int ln = lastLobbySelected > 0 ? lastLobbySelected : 0;
                     gameView = new GameView(ln);
-                    gameView.bindClient(client);
+                    gameView.bindClient(client, sender);
                     gameView.setMyName(name);
                     gameView.setOnBackToLobby(() -> MainApp.this.requestBackToLobby());
                     primaryStage.setTitle("Blackjack Client — Game");
@@ -441,12 +426,12 @@ public class MainApp extends Application {
             public void onServerError(String msg) {
                 String reason = (msg == null || msg.isBlank()) ? "Server ERROR" : msg;
                 System.out.println(msg);
-                Platform.runLater(() -> goToConnectScene("Connection lost: " + reason));
+                ui.post(() -> goToConnectScene("Connection lost: " + reason));
             }
 
             @Override
             public void onReconnectAttempt(int attempt, int maxAttempts) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     if (gameView != null) {
                         gameView.showReconnectStatus(
                                 "No connection. Reconnecting " + attempt + "/" + maxAttempts + "..."
@@ -457,7 +442,7 @@ public class MainApp extends Application {
 
             @Override
             public void onReconnectSucceeded() {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     if (gameView != null) {
                         gameView.hideReconnectStatus();
                     }
@@ -466,47 +451,48 @@ public class MainApp extends Application {
 
             // --- game phase ---
             @Override public void onDeal(String c1, String c2) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     createGameView();
                     gameView.onDeal(c1, c2);
                 });
             }
             @Override public void onTurn(String player, int seconds) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     createGameView();
                     gameView.onTurn(player, seconds);
                 });
             }
             @Override public void onCard(String card) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     createGameView();
                     gameView.onCard(card);
                 });
             }
             @Override public void onBust(String player, int value) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     createGameView();
                     gameView.onBust(player, value);
                 });
             }
             @Override public void onOpponentDisconnected(String player, int seconds) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     if (gameView != null) {
                         gameView.onOpponentDisconnected(player, seconds);
                     }
                 });
             }
             @Override public void onOpponentReconnected(String player) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     if (gameView != null) {
                         gameView.onOpponentReconnected(player);
                     }
                 });
             }
             @Override public void onResult(String summary) {
-                Platform.runLater(() -> {
+                ui.post(() -> {
                     createGameView();
                     gameView.onResult(summary);
+                    System.out.println("[UI] game " + ui.takeStats());
                 });
             }
         };
@@ -523,7 +509,7 @@ public class MainApp extends Application {
         if (gameView != null) return;
         int ln = lastLobbySelected > 0 ? lastLobbySelected : 0;
         gameView = new GameView(ln);
-        gameView.bindClient(client);
+        gameView.bindClient(client, sender);
         gameView.setMyName(name);
         gameView.setOnBackToLobby(() -> MainApp.this.requestBackToLobby());
         primaryStage.setTitle("Blackjack Client — Game");
@@ -534,11 +520,11 @@ public class MainApp extends Application {
      * Send a "back to lobby" request and switch the UI into the waiting state.
      */
     private void requestBackToLobby() {
-        Platform.runLater(() -> {
+        ui.post(() -> {
             primaryStage.setTitle("Blackjack Client — Lobby");
             primaryStage.setScene(buildLobbyWaitingScene());
         });
-        new Thread(() -> {
+        sender.execute(() -> {
             try {
                 if (client == null) throw new SocketException("Connection broke");
                 client.sendBackToLobby(Objects.requireNonNullElse(name, ""));
@@ -546,7 +532,7 @@ public class MainApp extends Application {
                 String reason = normalizeNetError(ex);
                 goToConnectScene("Connection lost: " + reason);
             }
-        }, "send-back-thread").start();
+        });
     }
 
     /**
@@ -556,7 +542,7 @@ public class MainApp extends Application {
      */
     private void goToConnectScene(String message) {
         closeClient();
-        Platform.runLater(() -> {
+        ui.post(() -> {
             primaryStage.setTitle("Blackjack Client — connecting");
             primaryStage.setScene(buildConnectScene(message));
         });
@@ -605,6 +591,7 @@ public class MainApp extends Application {
     @Override
     public void stop() {
         closeClient();
+        sender.shutdownNow();
     }
 
     /**
@@ -0,0 +1,197 @@
+package com.blackjack.bot;
+
+import com.blackjack.net.LobbyRow;
+import com.blackjack.net.ProtocolListener;
+import com.blackjack.net.SessionMultiplexer;
+import com.blackjack.net.SessionMultiplexer.Session;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.atomic.AtomicLong;
+
+/**
+ * BotFarm
+ *
+ * Purpose:
+ *   Headless load generator built on the real client protocol stack: thousands of
+ *   simulated players on one {@link SessionMultiplexer} thread, no JavaFX.
+ *
+ * Responsibilities:
+ *   - Open N bot sessions seated by the combined handshake ({@code C45JN}), then join
+ *     lobbies pairwise from the lobby list; play (hit below 17), go back, repeat.
+ *   - Re-open sessions that the server closed (lobby race, timeouts) after a short delay.
+ *   - Print a progress line every few seconds and a final RESULT line.
+ *
+ * Usage (after {@code mvn package}):
+ *   {@code java -cp target/classes com.blackjack.bot.BotFarm [host] [port] [sessions] [seconds] [thinkMs]}
+ *
+ * Bots beyond 2 x lobby count wait at the lobby list and poll it, like idle players.
+ *
+ * Table of contents:
+ *   - Entry point: main()
+ *   - Bot: lobby choice, turn decision, hand value
+ */
+public final class BotFarm {
+    private static final long REPORT_INTERVAL_MS = 5000;
+    private static final long LOBBY_RETRY_MS = 1000;
+    private static final long REOPEN_DELAY_MS = 1000;
+    private static final int STAND_ON = 17;
+
+    private final SessionMultiplexer mux;
+    private final long thinkMs;
+    private final AtomicLong games = new AtomicLong();
+    private final AtomicLong errors = new AtomicLong();
+    private final AtomicLong reopened = new AtomicLong();
+
+    private BotFarm(SessionMultiplexer mux, long thinkMs) {
+        this.mux = mux;
+        this.thinkMs = thinkMs;
+    }
+
+    /* --- Entry point --- */
+    /**
+     * Run the bot farm.
+     *
+     * @param args [host] [port] [sessions] [seconds] [thinkMs]
+     */
+    public static void main(String[] args) throws Exception {
+        String host = args.length > 0 ? args[0] : "127.0.0.1";
+        int port = args.length > 1 ? Integer.parseInt(args[1]) : 10000;
+        int sessions = args.length > 2 ? Integer.parseInt(args[2]) : 1000;
+        int seconds = args.length > 3 ? Integer.parseInt(args[3]) : 60;
+        long thinkMs = args.length > 4 ? Long.parseLong(args[4]) : 0L;
+
+        try (SessionMultiplexer mux = new SessionMultiplexer(host, port)) {
+            BotFarm farm = new BotFarm(mux, thinkMs);
+            Thread loop = new Thread(mux::run, "bot-mux");
+            loop.start();
+
+            for (int i = 0; i < sessions; i++) farm.openBot(i, 0);
+
+            long start = System.currentTimeMillis();
+            long end = start + seconds * 1000L;
+            while (System.currentTimeMillis() < end) {
+                Thread.sleep(Math.min(REPORT_INTERVAL_MS, Math.max(1L, end - System.currentTimeMillis())));
+                System.out.printf("[BOT] t=%ds sessions=%d games=%d errors=%d reopened=%d%n",
+                        (System.currentTimeMillis() - start) / 1000, mux.sessionCount(),
+                        farm.games.get(), farm.errors.get(), farm.reopened.get());
+            }
+
+            mux.stop();
+            loop.join();
+            double elapsed = Math.max(1L, System.currentTimeMillis() - start) / 1000.0;
+            System.out.printf("RESULT sessions=%d games=%d games_per_sec=%.1f errors=%d reopened=%d%n",
+                    sessions, farm.games.get(), farm.games.get() / elapsed, farm.errors.get(), farm.reopened.get());
+        }
+    }
+
+    /**
+     * Open (or re-open) bot number {@code index}.
+     *
+     * @param index      Bot index (decides its lobby).
+     * @param generation Re-open counter, keeps names unique while the server releases the old one.
+     */
+    private void openBot(int index, int generation) {
+        String name = "bot" + index + "g" + generation;
+        // Combined handshake into any lobby: seated in one round trip when a seat is free,
+        // otherwise the server sends the lobby list and the bot picks from it.
+        mux.openAndJoin(name, 0, s -> new Bot(s, index, generation));
+    }
+
+    /* --- Bot --- */
+    /**
+     * One simulated player. All callbacks run on the multiplexer thread.
+     */
+    private final class Bot implements ProtocolListener {
+        private final Session session;
+        private final int index;
+        private final int generation;
+        private final List<String> hand = new ArrayList<>();
+
+        Bot(Session session, int index, int generation) {
+            this.session = session;
+            this.index = index;
+            this.generation = generation;
+        }
+
+        @Override
+        public void onLobbySnapshot(List<LobbyRow> rows) {
+            if (rows.isEmpty()) {
+                retryLobbyList();
+                return;
+            }
+            // Pairs of bots share a lobby so that games start without extra coordination.
+            LobbyRow r = rows.get((index / 2) % rows.size());
+            if (r.getPlayers() < r.getCapacity() && "0".equals(r.getStatus())) {
+                session.sendJoin(r.getId());
+            } else {
+                retryLobbyList();
+            }
+        }
+
+        @Override
+        public void onDeal(String c1, String c2) {
+            hand.clear();
+            hand.add(c1);
+            hand.add(c2);
+        }
+
+        @Override
+        public void onCard(String card) {
+            hand.add(card);
+        }
+
+        @Override
+        public void onTurn(String player, int seconds) {
+            if (!session.name().equals(player)) return;
+            boolean hit = handValue(hand) < STAND_ON;
+            Runnable act = () -> {
+                if (!session.isOpen()) return;
+                if (hit) session.sendHit();
+                else session.sendStand();
+            };
+            if (thinkMs > 0) mux.schedule(thinkMs, act);
+            else act.run();
+        }
+
+        @Override
+        public void onResult(String summary) {
+            games.incrementAndGet();
+            session.sendBackToLobby();
+        }
+
+        @Override
+        public void onServerError(String msg) {
+            errors.incrementAndGet();
+            reopened.incrementAndGet();
+            mux.schedule(REOPEN_DELAY_MS, () -> openBot(index, generation + 1));
+        }
+
+        /** Ask for a fresh lobby list a bit later. */
+        private void retryLobbyList() {
+            mux.schedule(LOBBY_RETRY_MS, () -> {
+                if (session.isOpen()) session.sendBackToLobby();
+            });
+        }
+    }
+
+    /**
+     * Blackjack value of a hand of card strings ("AS", "TD", "7H").
+     * Aces count as 11 until the sum would exceed 21.
+     *
+     * @param hand Cards.
+     * @return Hand value.
+     */
+    static int handValue(List<String> hand) {
+        int sum = 0;
+        int aces = 0;
+        for (String c : hand) {
+            char r = c.isEmpty() ? '0' : c.charAt(0);
+            if (r == 'A') { sum += 11; aces++; }
+            else if (r == 'T' || r == 'J' || r == 'Q' || r == 'K' || r == '1') sum += 10;
+            else if (r >= '2' && r <= '9') sum += r - '0';
+        }
+        while (sum > 21 && aces > 0) { sum -= 10; aces--; }
+        return sum;
+    }
+}
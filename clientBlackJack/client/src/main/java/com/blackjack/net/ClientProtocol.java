@@ -0,0 +1,575 @@
+package com.blackjack.net;
+
+import java.io.EOFException;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+
+/**
+ * ClientProtocol
+ *
+ * Purpose:
+ *   Transport-independent client side of the Blackjack protocol: the per-session
+ *   state machine, server message parsing and heartbeat/timeout bookkeeping.
+ *
+ * Responsibilities:
+ *   - Validate server lines against the client state ({@link State}) and dispatch
+ *     them to a {@link ProtocolListener}. Lines arrive as byte ranges and are decoded
+ *     in place by {@link MessageDecoder} (no per-line String/split allocations).
+ *   - Track handshake, lobby snapshot and keep-alive deadlines; {@link #onTick(long)}
+ *     tells the transport when to ping or when the connection is considered dead.
+ *   - Keep-alive: the client is the only side that originates PINGs. The interval and the
+ *     liveness timeout are adopted from the handshake ({@code C45OK <ping_ms> <timeout_ms>});
+ *     a PING is sent only when nothing was sent for one interval, and any received line
+ *     counts as liveness.
+ *   - Record state transitions caused by client commands (name, join, back, reconnect).
+ *   - Cache the last versioned lobby snapshot so a refresh can be conditional
+ *     ({@code C45B <version>}); a {@code C45LU} answer re-delivers the cached rows.
+ *
+ * The class does no I/O. {@link NetClient} drives it from a blocking reader thread,
+ * {@link SessionMultiplexer} drives many instances from one NIO selector thread.
+ * An instance must only be fed lines from one thread at a time.
+ *
+ * Table of contents:
+ *   - Types and timeouts: State, Outcome, TickAction
+ *   - Transport hooks: onConnected(), resetHeartbeat(), onTick()
+ *   - Command hooks: onNameSent(), onNameJoinSent(), onJoinSent(), onBackSent(), backCommand(), onReconnectSent(), onReconnectStarted(), onDataSent()
+ *   - Server message dispatch: onLine()
+ *   - Parsing and state checks
+ */
+public final class ClientProtocol {
+    // Used until the server advertises its keep-alive parameters (and with older servers).
+    // The interval must stay below the silence timeout to avoid a false "server not responding"
+    // while the connection is simply idle.
+    static final int DEFAULT_HEARTBEAT_INTERVAL_MS = 3000;
+    static final int DEFAULT_SILENCE_TIMEOUT_MS = 10000;
+    static final int MIN_HEARTBEAT_INTERVAL_MS = 500;
+    static final int MAX_SILENCE_TIMEOUT_MS = 600000;
+    static final int HANDSHAKE_TIMEOUT_MS = 10000;
+    static final int LOBBY_SNAPSHOT_TIMEOUT_MS = 16000;
+
+    private static final String[] STATUS_TEXT = {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
+
+    /* --- Types --- */
+    /** Client session state. */
+    public enum State {
+        WAIT_OK,
+        WAIT_LOBBIES,
+        LOBBY_CHOICE,
+        LOBBY_WAIT_OR_GAME,
+        IN_GAME,
+        AFTER_GAME
+    }
+
+    /** What the transport must do after a server line was handled. */
+    public enum Outcome {
+        /** Nothing; keep reading. */
+        CONTINUE,
+        /** Answer a server PING with {@code C45PO}. */
+        SEND_PONG,
+        /** The listener was notified of a terminal condition; close the connection. */
+        CLOSE
+    }
+
+    /** What the transport must do on a periodic tick (no data received for a while). */
+    public enum TickAction {
+        NONE,
+        /** Send {@code C45PI} (the transport reports it through {@link #onDataSent(long)}). */
+        SEND_PING,
+        /** Connection considered dead after the handshake; reconnect (or give up). */
+        RECONNECT,
+        /** Handshake acknowledged, but the lobby list never came. */
+        FAIL_NO_LOBBIES,
+        /** No name sent yet and the server stays silent. */
+        FAIL_SILENT
+    }
+
+    private volatile State state = State.WAIT_OK;
+    private volatile boolean expectLobbySnapshot = false;
+    private volatile long lastServerMessageMs = System.currentTimeMillis();
+    private volatile long lastSentMs = 0L;
+    private volatile int heartbeatIntervalMs = DEFAULT_HEARTBEAT_INTERVAL_MS;
+    private volatile int silenceTimeoutMs = DEFAULT_SILENCE_TIMEOUT_MS;
+    private volatile long handshakeSentMs = 0L;
+    private volatile boolean handshakeDone = false;
+    private volatile long lobbySnapshotExpectedMs = 0L;
+
+    // Reused for every line; see MessageDecoder.
+    private final MessageDecoder decoder = new MessageDecoder();
+    private final ServerMessage msg = new ServerMessage();
+
+    // Legacy multi-line lobby snapshot (C45LOBBIES <n> followed by n C45LOBBY lines).
+    private int legacyLobbyLinesLeft = 0;
+    private List<LobbyRow> legacyLobbyRows = null;
+
+    // Last versioned snapshot (C45L ... <version>); 0 = none. Reader thread writes, senders read the version.
+    private List<LobbyRow> cachedLobbyRows = null;
+    private volatile int cachedLobbyVersion = 0;
+
+    /** @return Current session state. */
+    public State state() { return state; }
+
+    /** @return true once the server acknowledged the handshake or reconnect. */
+    public boolean isHandshakeDone() { return handshakeDone; }
+
+    /* --- Transport hooks --- */
+    /**
+     * Reset per-connection state after a (re)connect.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    public void onConnected(long nowMs) {
+        lastServerMessageMs = nowMs;
+        lastSentMs = nowMs;
+        lobbySnapshotExpectedMs = 0L;
+        legacyLobbyLinesLeft = 0;
+        legacyLobbyRows = null;
+        // A new connection may be a restarted server whose versions start over.
+        cachedLobbyRows = null;
+        cachedLobbyVersion = 0;
+    }
+
+    /**
+     * Restart heartbeat timing (used when a reader starts on an existing connection).
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    public void resetHeartbeat(long nowMs) {
+        lastServerMessageMs = nowMs;
+    }
+
+    /**
+     * Check deadlines while no data arrives. Call roughly once per second.
+     *
+     * @param nowMs Current time in milliseconds.
+     * @return Action the transport must take.
+     */
+    public TickAction onTick(long nowMs) {
+        if (state == State.WAIT_LOBBIES &&
+                lobbySnapshotExpectedMs > 0 &&
+                nowMs - lobbySnapshotExpectedMs > LOBBY_SNAPSHOT_TIMEOUT_MS) {
+            return TickAction.FAIL_NO_LOBBIES;
+        }
+        if (!handshakeDone && handshakeSentMs > 0 &&
+                nowMs - handshakeSentMs > HANDSHAKE_TIMEOUT_MS) {
+            return TickAction.RECONNECT;
+        }
+
+        if (handshakeDone) {
+            // Any server line counts as liveness; we ping at least once per interval,
+            // so a live server answers well within the timeout.
+            if (nowMs - lastServerMessageMs > silenceTimeoutMs) {
+                return TickAction.RECONNECT;
+            }
+        } else if (handshakeSentMs == 0) {
+            // Connected, but the user didn't send a name yet. Keep the connection alive and
+            // detect a dead server quickly by using PING/PONG even before the handshake.
+            if (nowMs - lastServerMessageMs > silenceTimeoutMs) {
+                return TickAction.FAIL_SILENT;
+            }
+        } else {
+            return TickAction.NONE;
+        }
+
+        return pingDue(nowMs) ? TickAction.SEND_PING : TickAction.NONE;
+    }
+
+    /**
+     * Whether a keep-alive PING is due. We ping only after being silent for a whole
+     * interval: any command we send already proves liveness to the server.
+     * Transports that only tick while the socket is idle also call this after each
+     * received line, so a busy inbound stream cannot starve our pings.
+     *
+     * @param nowMs Current time in milliseconds.
+     * @return true if the transport must send {@code C45PI} now.
+     */
+    public boolean pingDue(long nowMs) {
+        if (nowMs - lastSentMs >= heartbeatIntervalMs) {
+            lastSentMs = nowMs;
+            return true;
+        }
+        return false;
+    }
+
+    /* --- Command hooks --- */
+    /**
+     * The name handshake ({@code C45<name>}) is being sent.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    public void onNameSent(long nowMs) {
+        handshakeDone = false;
+        handshakeSentMs = nowMs;
+        state = State.WAIT_OK;
+        expectLobbySnapshot = true;
+        lobbySnapshotExpectedMs = 0L;
+    }
+
+    /**
+     * The combined handshake ({@code C45JN <name> <lobby>}) is being sent. The server
+     * answers {@code C45JOK}, or (no free seat) a plain {@code C45OK} and the lobby list.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    public void onNameJoinSent(long nowMs) {
+        onNameSent(nowMs);
+    }
+
+    /** A lobby join ({@code C45J}) is being sent. */
+    public void onJoinSent() {
+        state = State.LOBBY_CHOICE;
+    }
+
+    /** A back-to-lobby request ({@code C45B}) is being sent. */
+    public void onBackSent() {
+        expectLobbySnapshot = true;
+    }
+
+    /**
+     * @return The back-to-lobby request: {@code C45B <version>} when a versioned snapshot is
+     *         cached (the server may answer {@code C45LU}), otherwise plain {@code C45B}.
+     */
+    public String backCommand() {
+        int v = cachedLobbyVersion;
+        return v > 0 ? "C45B " + v + "\n" : "C45B\n";
+    }
+
+    /**
+     * A reconnect request ({@code C45REC}) is being sent.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    public void onReconnectSent(long nowMs) {
+        handshakeDone = false;
+        handshakeSentMs = nowMs;
+        state = State.WAIT_OK;
+        expectLobbySnapshot = true;
+        lobbySnapshotExpectedMs = 0L;
+    }
+
+    /**
+     * An automatic reconnect starts. After it we can either land back in the
+     * running game OR be redirected to the lobby list.
+     */
+    public void onReconnectStarted() {
+        state = State.WAIT_OK;
+        expectLobbySnapshot = true;
+        handshakeDone = false;
+        lobbySnapshotExpectedMs = 0L;
+    }
+
+    /**
+     * Any line (command or PING) was sent to the server.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    public void onDataSent(long nowMs) {
+        lastSentMs = nowMs;
+    }
+
+    /**
+     * Adopt keep-alive parameters advertised by the server in {@code C45OK}/{@code C45REC_OK}.
+     * Missing (0) or inconsistent values keep the current settings.
+     *
+     * @param intervalMs Ping interval in milliseconds.
+     * @param timeoutMs  Liveness timeout in milliseconds.
+     */
+    private void adoptKeepalive(int intervalMs, int timeoutMs) {
+        if (intervalMs <= 0 || timeoutMs <= intervalMs) return;
+        heartbeatIntervalMs = Math.max(MIN_HEARTBEAT_INTERVAL_MS, intervalMs);
+        silenceTimeoutMs = Math.min(MAX_SILENCE_TIMEOUT_MS, Math.max(timeoutMs, heartbeatIntervalMs + 1000));
+    }
+
+    /* --- Server message dispatch --- */
+    /**
+     * Handle one server line given as a byte range (without the trailing newline).
+     *
+     * The line is decoded in place into a reused {@link ServerMessage}; per-turn
+     * messages (ping, deal, card, turn, bust) do not allocate.
+     *
+     * @param buf   Buffer holding the line.
+     * @param off   Line start.
+     * @param len   Line length.
+     * @param nowMs Current time in milliseconds.
+     * @param l     Listener that receives parsed protocol events.
+     * @return Action the transport must take.
+     * @throws ProtocolException Malformed or out-of-state message (fatal for the session).
+     * @throws EOFException      Truncated message (treat as a transport failure).
+     */
+    public Outcome onLine(byte[] buf, int off, int len, long nowMs, ProtocolListener l) throws ProtocolException, EOFException {
+        lastServerMessageMs = nowMs;
+
+        if (legacyLobbyLinesLeft > 0) {
+            String t = new String(buf, off, len, StandardCharsets.UTF_8).trim();
+            if (t.isEmpty()) return Outcome.CONTINUE;
+            legacyLobbyRows.add(parseLobbyLine(t));
+            if (--legacyLobbyLinesLeft == 0) {
+                List<LobbyRow> rows = legacyLobbyRows;
+                legacyLobbyRows = null;
+                lobbySnapshotDone(rows, l);
+            }
+            return Outcome.CONTINUE;
+        }
+
+        ServerMessage m = msg;
+        ServerMessage.Op op = decoder.decode(buf, off, len, m);
+        if (op == null) return Outcome.CONTINUE;
+
+        switch (op) {
+            case PONG:
+                // Liveness already recorded above.
+                return Outcome.CONTINUE;
+            case PING:
+                return Outcome.SEND_PONG;
+            case DOWN: {
+                String reason = m.spanText();
+                l.onServerError(reason.isEmpty() ? "Server shut down" : "Server shut down: " + reason);
+                return Outcome.CLOSE;
+            }
+            case BUSY:
+                // Refused by server admission control (connection/memory limit).
+                l.onServerError("Server is busy. Please try again later.");
+                return Outcome.CLOSE;
+            case REC_OK:
+                // We are back on the server. It can either resume the game (hand snapshot)
+                // or (if the game already ended) send a normal lobby snapshot.
+                state = State.LOBBY_WAIT_OR_GAME;
+                expectLobbySnapshot = true;
+                handshakeDone = true;
+                adoptKeepalive(m.n1, m.n2);
+                l.onReconnectSucceeded();
+                return Outcome.CONTINUE;
+            case OPP_DOWN:
+                ensureStateIn(m, State.LOBBY_WAIT_OR_GAME, State.IN_GAME, State.AFTER_GAME);
+                l.onOpponentDisconnected(m.name, m.n1);
+                return Outcome.CONTINUE;
+            case OPP_BACK:
+                ensureStateIn(m, State.LOBBY_WAIT_OR_GAME, State.IN_GAME);
+                l.onOpponentReconnected(m.name);
+                return Outcome.CONTINUE;
+            case OK:
+                if (state == State.WAIT_OK) {
+                    adoptKeepalive(m.n1, m.n2);
+                    state = State.WAIT_LOBBIES;
+                    expectLobbySnapshot = true;
+                    lobbySnapshotExpectedMs = nowMs;
+                    l.onOk();
+                    handshakeDone = true;
+                } else if (state == State.LOBBY_CHOICE) {
+                    state = State.LOBBY_WAIT_OR_GAME;
+                    l.onLobbyJoinOk();
+                } else {
+                    throw new ProtocolException("Unexpected C45OK in state " + state + ": " + m.text());
+                }
+                return Outcome.CONTINUE;
+            case JOIN_OK:
+                if (state != State.WAIT_OK) {
+                    throw new ProtocolException("Unexpected C45JOK in state " + state + ": " + m.text());
+                }
+                adoptKeepalive(m.n1, m.n2);
+                state = State.LOBBY_WAIT_OR_GAME;
+                expectLobbySnapshot = false;
+                lobbySnapshotExpectedMs = 0L;
+                handshakeDone = true;
+                l.onJoinOk(m.n3);
+                return Outcome.CONTINUE;
+            case WRONG:
+                l.onServerError(m.nameTaken ? "Name has been taken" : "WRONG");
+                return Outcome.CLOSE;
+            case LOBBIES: {
+                // Compact single-line snapshot: C45L <n> <pairs> [version], validated by the decoder.
+                ensureLobbySnapshotExpected(m);
+                int n = m.n1;
+                List<LobbyRow> rows = new ArrayList<>(n);
+                for (int i = 0; i < n; i++) {
+                    int players = m.buf[m.spanOff + i * 2] - '0';
+                    int status = m.buf[m.spanOff + i * 2 + 1] - '0';
+                    rows.add(new LobbyRow(i + 1, players, 2, STATUS_TEXT[status]));
+                }
+                List<LobbyRow> snapshot = Collections.unmodifiableList(rows);
+                cachedLobbyRows = m.n2 > 0 ? snapshot : null;
+                cachedLobbyVersion = m.n2 > 0 ? m.n2 : 0;
+                lobbySnapshotDone(snapshot, l);
+                return Outcome.CONTINUE;
+            }
+            case LOBBIES_UNCHANGED:
+                // Answer to a conditional C45B: the cached snapshot is still current.
+                ensureLobbySnapshotExpected(m);
+                if (cachedLobbyRows == null || m.n1 != cachedLobbyVersion) {
+                    throw new ProtocolException("Unexpected lobby version: " + m.text());
+                }
+                lobbySnapshotDone(cachedLobbyRows, l);
+                return Outcome.CONTINUE;
+            case LOBBIES_LEGACY:
+                // Legacy multi-line snapshot: header, then n C45LOBBY lines.
+                ensureLobbySnapshotExpected(m);
+                legacyLobbyRows = new ArrayList<>(m.n1);
+                cachedLobbyRows = null;
+                cachedLobbyVersion = 0;
+                legacyLobbyLinesLeft = m.n1;
+                return Outcome.CONTINUE;
+            case DEAL:
+                ensureStateIn(m, State.LOBBY_WAIT_OR_GAME, State.IN_GAME);
+                l.onDeal(m.card1, m.card2);
+                state = State.IN_GAME;
+                return Outcome.CONTINUE;
+            case TURN:
+                ensureStateIn(m, State.IN_GAME);
+                l.onTurn(m.name, m.n1);
+                return Outcome.CONTINUE;
+            case CARD:
+                ensureStateIn(m, State.IN_GAME);
+                if (m.card1 != null) l.onCard(m.card1);
+                return Outcome.CONTINUE;
+            case BUST:
+                ensureStateIn(m, State.IN_GAME);
+                l.onBust(m.name, m.n1);
+                return Outcome.CONTINUE;
+            case TIMEOUT:
+                ensureStateIn(m, State.IN_GAME);
+                return Outcome.CONTINUE;
+            case RESULT: {
+                ensureStateIn(m, State.LOBBY_WAIT_OR_GAME, State.IN_GAME);
+                String header = m.winner.equalsIgnoreCase("PUSH")
+                        ? "Draw. Nobody won."
+                        : "Winner: " + m.winner;
+                String result =
+                        header + "\n" +
+                                m.name + ": " + m.n1 + "\n" +
+                                m.name2 + ": " + m.n2;
+
+                l.onResult(result);
+                state = State.AFTER_GAME;
+                return Outcome.CONTINUE;
+            }
+            default:
+                throw new ProtocolException("Unknown server message: " + m.text());
+        }
+    }
+
+    /**
+     * Deliver a complete lobby snapshot and move to lobby selection.
+     *
+     * @param rows Parsed lobby rows.
+     * @param l    Listener.
+     */
+    private void lobbySnapshotDone(List<LobbyRow> rows, ProtocolListener l) {
+        l.onLobbySnapshot(rows);
+        state = State.LOBBY_CHOICE;
+        expectLobbySnapshot = false;
+        lobbySnapshotExpectedMs = 0L;
+    }
+
+    /* --- Parsing and state checks --- */
+    /**
+     * Parse a single lobby line from the server snapshot.
+     *
+     * Expected format:
+     *   {@code C45LOBBY <id> players=<n>/<cap> status=<0|1>}
+     *
+     * @param line Raw line (without trailing newline).
+     * @return Parsed {@link LobbyRow}.
+     */
+    private static LobbyRow parseLobbyLine(String line) throws ProtocolException {
+        String[] parts = line.split("\\s+");
+        if (parts.length != 4 || !parts[0].equalsIgnoreCase("C45LOBBY")) {
+            throw new ProtocolException("Bad lobby line: " + line);
+        }
+        int id = parsePositiveInt(parts[1], "lobby id");
+
+        String[] pp = parts[2].split("=");
+        if (pp.length != 2 || !pp[0].equalsIgnoreCase("players")) {
+            throw new ProtocolException("Bad lobby players: " + line);
+        }
+        String[] ps = pp[1].split("/");
+        if (ps.length != 2) throw new ProtocolException("Bad lobby players: " + line);
+        int players = parseNonNegativeInt(ps[0], "players");
+        int cap = parsePositiveInt(ps[1], "capacity");
+        if (players > cap) throw new ProtocolException("Bad lobby players: " + line);
+
+        String[] ss = parts[3].split("=");
+        if (ss.length != 2 || !ss[0].equalsIgnoreCase("status")) {
+            throw new ProtocolException("Bad lobby status: " + line);
+        }
+        String status = ss[1];
+        return new LobbyRow(id, players, cap, status);
+    }
+
+    /**
+     * Ensure a lobby snapshot is expected right now.
+     *
+     * @param m Decoded message (used for error context).
+     */
+    private void ensureLobbySnapshotExpected(ServerMessage m) throws ProtocolException {
+        if (!expectLobbySnapshot && state != State.WAIT_LOBBIES) {
+            throw new ProtocolException("Unexpected lobby snapshot: " + m.text());
+        }
+    }
+
+    /**
+     * Ensure the current client state is one of the allowed values.
+     * Fixed-arity overloads instead of varargs keep the per-message path allocation-free.
+     *
+     * @param m Decoded message (used for error context).
+     * @param a Allowed state.
+     */
+    private void ensureStateIn(ServerMessage m, State a) throws ProtocolException {
+        ensureStateIn(m, a, a, a);
+    }
+
+    /**
+     * @param m Decoded message (used for error context).
+     * @param a Allowed state.
+     * @param b Allowed state.
+     */
+    private void ensureStateIn(ServerMessage m, State a, State b) throws ProtocolException {
+        ensureStateIn(m, a, b, b);
+    }
+
+    /**
+     * @param m Decoded message (used for error context).
+     * @param a Allowed state.
+     * @param b Allowed state.
+     * @param c Allowed state.
+     */
+    private void ensureStateIn(ServerMessage m, State a, State b, State c) throws ProtocolException {
+        State s = state;
+        if (s == a || s == b || s == c) return;
+        throw new ProtocolException("Bad client state for message: " + m.text());
+    }
+
+    /**
+     * Parse a strictly positive integer (v > 0).
+     *
+     * @param s   Input string.
+     * @param ctx Context string used for error message.
+     * @return Parsed integer value.
+     */
+    private static int parsePositiveInt(String s, String ctx) throws ProtocolException {
+        try {
+            int v = Integer.parseInt(s);
+            if (v <= 0) throw new NumberFormatException();
+            return v;
+        } catch (NumberFormatException ex) {
+            throw new ProtocolException("Bad " + ctx + ": " + s);
+        }
+    }
+
+    /**
+     * Parse a non-negative integer (v >= 0).
+     *
+     * @param s   Input string.
+     * @param ctx Context string used for error message.
+     * @return Parsed integer value.
+     */
+    private static int parseNonNegativeInt(String s, String ctx) throws ProtocolException {
+        try {
+            int v = Integer.parseInt(s);
+            if (v < 0) throw new NumberFormatException();
+            return v;
+        } catch (NumberFormatException ex) {
+            throw new ProtocolException("Bad " + ctx + ": " + s);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+package com.blackjack.net;
+
+import java.io.IOException;
+import java.io.InputStream;
+
+/**
+ * LineReader
+ *
+ * Purpose:
+ *   Blocking newline splitter over a socket stream that hands out lines as byte ranges
+ *   of a reused buffer, replacing {@code BufferedReader.readLine()} (one String per line).
+ *
+ * A read timeout ({@link java.net.SocketTimeoutException}) propagates to the caller;
+ * a partially received line is kept and completed by the next call.
+ *
+ * Table of contents:
+ *   - readLine(), line()
+ */
+final class LineReader {
+    private final InputStream in;
+    private final byte[] chunk = new byte[8192];
+    private int pos = 0;
+    private int lim = 0;
+    private final byte[] line;
+    private int lineLen = 0;
+
+    /**
+     * @param in      Source stream.
+     * @param maxLine Longest accepted line in bytes.
+     */
+    LineReader(InputStream in, int maxLine) {
+        this.in = in;
+        this.line = new byte[maxLine];
+    }
+
+    /**
+     * Read the next line (without the newline) into {@link #line()}.
+     *
+     * @return Line length, or -1 at end of stream.
+     * @throws ProtocolException Line longer than the buffer.
+     * @throws IOException       Read failure or timeout.
+     */
+    int readLine() throws IOException, ProtocolException {
+        while (true) {
+            while (pos < lim) {
+                byte b = chunk[pos++];
+                if (b == '\n') {
+                    int n = lineLen;
+                    lineLen = 0;
+                    return n;
+                }
+                if (lineLen == line.length) {
+                    lineLen = 0;
+                    throw new ProtocolException("Server line too long");
+                }
+                line[lineLen++] = b;
+            }
+            int n = in.read(chunk, 0, chunk.length);
+            if (n < 0) return -1;
+            pos = 0;
+            lim = n;
+        }
+    }
+
+    /** @return Buffer holding the last line returned by {@link #readLine()}. */
+    byte[] line() { return line; }
+}
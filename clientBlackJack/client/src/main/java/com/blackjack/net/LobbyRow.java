@@ -0,0 +1,41 @@
+package com.blackjack.net;
+
+/**
+ * LobbyRow
+ *
+ * Purpose:
+ *   Immutable lobby list entry parsed from a server lobby snapshot.
+ *
+ * Kept free of JavaFX types so the protocol stack can run headless
+ * (see {@link SessionMultiplexer}).
+ */
+public final class LobbyRow {
+    private final int id;
+    private final int players;
+    private final int capacity;
+    private final String status;
+
+    /**
+     * Create a lobby row model.
+     *
+     * @param id       Lobby id (1-based).
+     * @param players  Current player count.
+     * @param capacity Lobby capacity.
+     * @param status   Lobby status string from the server.
+     */
+    public LobbyRow(int id, int players, int capacity, String status) {
+        this.id = id;
+        this.players = players;
+        this.capacity = capacity;
+        this.status = status;
+    }
+
+    /** @return Lobby id (1-based). */
+    public int getId() { return id; }
+    /** @return Current player count. */
+    public int getPlayers() { return players; }
+    /** @return Lobby capacity. */
+    public int getCapacity() { return capacity; }
+    /** @return Lobby status string from the server. */
+    public String getStatus() { return status; }
+}
@@ -0,0 +1,420 @@
+package com.blackjack.net;
+
+import java.io.EOFException;
+import java.nio.charset.StandardCharsets;
+
+/**
+ * MessageDecoder
+ *
+ * Purpose:
+ *   Allocation-free parser for server lines. One pass splits the line into token
+ *   offsets, then a switch on the bytes after {@code C45} selects the opcode and the
+ *   typed fields are parsed in place into a reusable {@link ServerMessage}.
+ *
+ * Responsibilities:
+ *   - Trim and tokenize a line given as a byte range (no String, no split()).
+ *   - Recognize short and long opcode spellings (e.g. {@code C45T} / {@code C45TURN}).
+ *   - Parse integers directly from bytes; validate field counts and ranges.
+ *   - Return card and player-name Strings from caches, so steady-state play does not
+ *     allocate: cards come from a shared table, names from a small per-session cache.
+ *
+ * Only error paths, lobby snapshots and the once-per-round result summary allocate.
+ * Instances are not thread-safe; each {@link ClientProtocol} owns one.
+ *
+ * Table of contents:
+ *   - decode()
+ *   - Opcode lookup
+ *   - Field helpers: token comparison, integers (signed for scores), cards, names
+ */
+final class MessageDecoder {
+    private static final int MAX_TOKENS = 8;
+    private static final int NAME_CACHE_SIZE = 8;
+    private static final int MAX_LOBBIES = 100;
+    private static final int MAX_TURN_SECONDS = 300;
+
+    // Card strings indexed by their two ASCII bytes; filled lazily. Strings are immutable,
+    // so the benign race between sessions on different threads is harmless.
+    private static final String[] CARD_CACHE = new String[128 * 128];
+
+    private final int[] tokOff = new int[MAX_TOKENS];
+    private final int[] tokLen = new int[MAX_TOKENS];
+    private int tokens;
+
+    private final byte[][] nameKeys = new byte[NAME_CACHE_SIZE][];
+    private final String[] nameValues = new String[NAME_CACHE_SIZE];
+    private int nameNext = 0;
+
+    /* --- decode() --- */
+    /**
+     * Decode one server line into {@code m}.
+     *
+     * @param b   Buffer holding the line.
+     * @param off Line start.
+     * @param len Line length (without the newline; a trailing CR is trimmed).
+     * @param m   Event to fill.
+     * @return Opcode, or {@code null} for a blank line.
+     * @throws ProtocolException Unknown or malformed message.
+     * @throws EOFException      Truncated RESULT (connection dropped mid-line).
+     */
+    ServerMessage.Op decode(byte[] b, int off, int len, ServerMessage m) throws ProtocolException, EOFException {
+        int s = off;
+        int e = off + len;
+        while (s < e && b[s] <= ' ') s++;
+        while (e > s && b[e - 1] <= ' ') e--;
+
+        m.buf = b;
+        m.start = s;
+        m.end = e;
+        m.op = null;
+        m.name = m.name2 = m.winner = m.card1 = m.card2 = null;
+        m.n1 = m.n2 = m.n3 = 0;
+        m.nameTaken = false;
+        m.spanOff = m.spanLen = 0;
+        if (s == e) return null;
+
+        tokenize(b, s, e);
+        ServerMessage.Op op = opcode(b, m);
+        m.op = op;
+
+        switch (op) {
+            case OK:
+            case REC_OK:
+                // Handshake acks may advertise keep-alive: <ping_interval_ms> <timeout_ms>
+                // (0 = not advertised; ClientProtocol keeps its defaults).
+                if (tokens >= 3) {
+                    m.n1 = nonNegativeAt(b, 1, "ping interval");
+                    m.n2 = nonNegativeAt(b, 2, "liveness timeout");
+                }
+                break;
+            case JOIN_OK:
+                // C45JOK <lobby> <ping_interval_ms> <timeout_ms>
+                if (tokens < 4) throw bad("Bad C45JOK: ", m);
+                m.n3 = positiveAt(b, 1, "lobby");
+                m.n1 = positiveAt(b, 2, "ping interval");
+                m.n2 = positiveAt(b, 3, "liveness timeout");
+                break;
+            case OPP_DOWN:
+                m.name = tokens >= 2 ? nameAt(b, 1) : "Enemy";
+                m.n1 = tokens >= 3 ? positiveAt(b, 2, "reconnect seconds") : 30;
+                break;
+            case OPP_BACK:
+                m.name = tokens >= 2 ? nameAt(b, 1) : "Enemy";
+                break;
+            case WRONG:
+                m.nameTaken = tokens >= 2 && tokenIs(b, 1, 0, "NAME_TAKEN");
+                break;
+            case DOWN:
+                if (tokens >= 2) {
+                    m.spanOff = tokOff[1];
+                    m.spanLen = e - tokOff[1];
+                }
+                break;
+            case LOBBIES: {
+                // C45L <n> <pairs> [version], pairs = 2*n digits: players(0..2) + status(0/1).
+                if (tokens < 3) throw bad("Bad C45L snapshot: ", m);
+                int n = positiveAt(b, 1, "lobby count");
+                if (n > MAX_LOBBIES) throw new ProtocolException("Too many lobbies: " + n);
+                if (tokLen[2] != 2 * n) throw bad("Bad C45L snapshot length: ", m);
+                for (int i = tokOff[2], end = i + tokLen[2]; i < end; i++) {
+                    if (b[i] < '0' || b[i] > '9') throw bad("Bad C45L snapshot digits: ", m);
+                }
+                m.n1 = n;
+                m.n2 = tokens >= 4 ? positiveAt(b, 3, "lobby version") : 0;
+                m.spanOff = tokOff[2];
+                m.spanLen = tokLen[2];
+                break;
+            }
+            case LOBBIES_UNCHANGED:
+                if (tokens < 2) throw bad("Bad C45LU: ", m);
+                m.n1 = positiveAt(b, 1, "lobby version");
+                break;
+            case LOBBIES_LEGACY: {
+                if (tokens < 2) throw bad("Bad C45LOBBIES header: ", m);
+                int n = positiveAt(b, 1, "lobby count");
+                if (n > MAX_LOBBIES) throw new ProtocolException("Too many lobbies: " + n);
+                m.n1 = n;
+                break;
+            }
+            case DEAL:
+                if (tokens < 3) throw bad("Bad DEAL: ", m);
+                m.card1 = cardAt(b, 1);
+                m.card2 = cardAt(b, 2);
+                break;
+            case TURN: {
+                if (tokens < 3) throw bad("Bad TURN: ", m);
+                m.name = nameAt(b, 1);
+                int sec = positiveAt(b, 2, "turn seconds");
+                if (sec > MAX_TURN_SECONDS) throw new ProtocolException("Bad turn seconds: " + sec);
+                m.n1 = sec;
+                break;
+            }
+            case CARD:
+                if (tokens >= 2) m.card1 = cardAt(b, 1);
+                break;
+            case BUST:
+                if (tokens < 3) throw bad("Bad BUST: ", m);
+                m.name = nameAt(b, 1);
+                m.n1 = nonNegativeAt(b, 2, "bust value");
+                break;
+            case RESULT: {
+                // C45R p1 s1 p2 s2 winner | C45RESULT p1 s1 p2 s2 <x> winner
+                boolean longForm = tokLen[0] > 4;
+                int need = longForm ? 7 : 6;
+                if (tokens < need) {
+                    // If the TCP connection drops mid-line, the reader can return a partial line at EOF.
+                    // Treat this as a transport failure and let the reconnect logic handle it.
+                    throw new EOFException("Incomplete RESULT: " + m.text());
+                }
+                m.name = nameAt(b, 1);
+                // Scores are -1 for a busted hand.
+                m.n1 = signedAt(b, 2, "score");
+                m.name2 = nameAt(b, 3);
+                m.n2 = signedAt(b, 4, "score");
+                m.winner = nameAt(b, need - 1);
+                break;
+            }
+            default:
+                break;
+        }
+        return op;
+    }
+
+    /**
+     * Record token offsets of the trimmed line {@code [s, e)}.
+     *
+     * @param b Buffer.
+     * @param s Start (first non-blank byte).
+     * @param e End (after the last non-blank byte).
+     */
+    private void tokenize(byte[] b, int s, int e) {
+        int n = 0;
+        int i = s;
+        while (i < e) {
+            while (i < e && b[i] <= ' ') i++;
+            if (i >= e) break;
+            int t = i;
+            while (i < e && b[i] > ' ') i++;
+            if (n < MAX_TOKENS) {
+                tokOff[n] = t;
+                tokLen[n] = i - t;
+            }
+            n++;
+        }
+        tokens = Math.min(n, MAX_TOKENS);
+    }
+
+    /* --- Opcode lookup --- */
+    /**
+     * Select the opcode from token 0.
+     *
+     * @param b Buffer.
+     * @param m Event (for error context).
+     * @return Opcode.
+     */
+    private ServerMessage.Op opcode(byte[] b, ServerMessage m) throws ProtocolException {
+        if (tokenIs(b, 0, 0, "WRONG")) return ServerMessage.Op.WRONG;
+        if (tokLen[0] < 4 || b[tokOff[0]] != 'C' || b[tokOff[0] + 1] != '4' || b[tokOff[0] + 2] != '5') {
+            throw bad("Bad server message (no C45 prefix): ", m);
+        }
+
+        switch (b[tokOff[0] + 3]) {
+            case 'P':
+                if (tokenIs(b, 0, 3, "PI") || tokenIs(b, 0, 3, "PING")) return ServerMessage.Op.PING;
+                if (tokenIs(b, 0, 3, "PO") || tokenIs(b, 0, 3, "PONG")) return ServerMessage.Op.PONG;
+                break;
+            case 'O':
+                if (tokenIs(b, 0, 3, "OK")) return ServerMessage.Op.OK;
+                if (tokenIs(b, 0, 3, "OD") || tokenIs(b, 0, 3, "OPPDOWN")) return ServerMessage.Op.OPP_DOWN;
+                if (tokenIs(b, 0, 3, "OB") || tokenIs(b, 0, 3, "OPPBACK")) return ServerMessage.Op.OPP_BACK;
+                break;
+            case 'D':
+                if (tokenIs(b, 0, 3, "D") || tokenIs(b, 0, 3, "DEAL")) return ServerMessage.Op.DEAL;
+                if (tokenIs(b, 0, 3, "DOWN")) return ServerMessage.Op.DOWN;
+                break;
+            case 'S':
+                if (tokenIs(b, 0, 3, "SERVER_DOWN")) return ServerMessage.Op.DOWN;
+                break;
+            case 'B':
+                if (tokenIs(b, 0, 3, "B") || tokenIs(b, 0, 3, "BUST")) return ServerMessage.Op.BUST;
+                if (tokenIs(b, 0, 3, "BUSY")) return ServerMessage.Op.BUSY;
+                break;
+            case 'R':
+                if (tokenIs(b, 0, 3, "R") || tokenIs(b, 0, 3, "RESULT")) return ServerMessage.Op.RESULT;
+                if (tokenIs(b, 0, 3, "REC_OK") || tokenIs(b, 0, 3, "RECONNECT_OK")) return ServerMessage.Op.REC_OK;
+                break;
+            case 'W':
+                if (tokenIs(b, 0, 3, "WRONG")) return ServerMessage.Op.WRONG;
+                break;
+            case 'J':
+                if (tokenIs(b, 0, 3, "JOK")) return ServerMessage.Op.JOIN_OK;
+                break;
+            case 'L':
+                if (tokenIs(b, 0, 3, "L")) return ServerMessage.Op.LOBBIES;
+                if (tokenIs(b, 0, 3, "LU")) return ServerMessage.Op.LOBBIES_UNCHANGED;
+                if (tokenIs(b, 0, 3, "LOBBIES")) return ServerMessage.Op.LOBBIES_LEGACY;
+                break;
+            case 'T':
+                if (tokenIs(b, 0, 3, "T") || tokenIs(b, 0, 3, "TURN")) return ServerMessage.Op.TURN;
+                if (tokenIs(b, 0, 3, "TO") || tokenIs(b, 0, 3, "TIMEOUT")) return ServerMessage.Op.TIMEOUT;
+                break;
+            case 'C':
+                if (tokenIs(b, 0, 3, "C") || tokenIs(b, 0, 3, "CARD")) return ServerMessage.Op.CARD;
+                break;
+            default:
+                break;
+        }
+        throw bad("Unknown server message: ", m);
+    }
+
+    /* --- Field helpers --- */
+    /**
+     * Compare token {@code t} (starting {@code skip} bytes in) with an ASCII literal.
+     *
+     * @param b    Buffer.
+     * @param t    Token index.
+     * @param skip Bytes to skip at the token start (3 for the {@code C45} prefix).
+     * @param lit  Literal to compare with.
+     * @return true on an exact match.
+     */
+    private boolean tokenIs(byte[] b, int t, int skip, String lit) {
+        int len = tokLen[t] - skip;
+        if (len != lit.length()) return false;
+        int o = tokOff[t] + skip;
+        for (int i = 0; i < len; i++) {
+            if (b[o + i] != lit.charAt(i)) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Parse token {@code t} as a non-negative decimal integer.
+     *
+     * @param b   Buffer.
+     * @param t   Token index.
+     * @param ctx Context for the error message.
+     * @return Parsed value.
+     */
+    private int nonNegativeAt(byte[] b, int t, String ctx) throws ProtocolException {
+        int o = tokOff[t];
+        int len = tokLen[t];
+        if (len > 9) throw badToken(ctx, b, t);
+        int v = 0;
+        for (int i = 0; i < len; i++) {
+            int d = b[o + i] - '0';
+            if (d < 0 || d > 9) throw badToken(ctx, b, t);
+            v = v * 10 + d;
+        }
+        return v;
+    }
+
+    /**
+     * Parse token {@code t} as a decimal integer with an optional leading {@code -}.
+     *
+     * @param b   Buffer.
+     * @param t   Token index.
+     * @param ctx Context for the error message.
+     * @return Parsed value.
+     */
+    private int signedAt(byte[] b, int t, String ctx) throws ProtocolException {
+        int o = tokOff[t];
+        int len = tokLen[t];
+        boolean neg = len > 1 && b[o] == '-';
+        if (neg) {
+            o++;
+            len--;
+        }
+        if (len > 9) throw badToken(ctx, b, t);
+        int v = 0;
+        for (int i = 0; i < len; i++) {
+            int d = b[o + i] - '0';
+            if (d < 0 || d > 9) throw badToken(ctx, b, t);
+            v = v * 10 + d;
+        }
+        return neg ? -v : v;
+    }
+
+    /**
+     * Parse token {@code t} as a strictly positive decimal integer.
+     *
+     * @param b   Buffer.
+     * @param t   Token index.
+     * @param ctx Context for the error message.
+     * @return Parsed value.
+     */
+    private int positiveAt(byte[] b, int t, String ctx) throws ProtocolException {
+        int v = nonNegativeAt(b, t, ctx);
+        if (v <= 0) throw badToken(ctx, b, t);
+        return v;
+    }
+
+    /**
+     * Card string for token {@code t} ("AS", "TD", ...), shared across sessions.
+     *
+     * @param b Buffer.
+     * @param t Token index.
+     * @return Card string.
+     */
+    private String cardAt(byte[] b, int t) {
+        int o = tokOff[t];
+        if (tokLen[t] == 2 && b[o] > 0 && b[o + 1] > 0) {
+            int k = (b[o] << 7) | b[o + 1];
+            String c = CARD_CACHE[k];
+            if (c == null) {
+                c = new String(b, o, 2, StandardCharsets.US_ASCII);
+                CARD_CACHE[k] = c;
+            }
+            return c;
+        }
+        return new String(b, o, tokLen[t], StandardCharsets.UTF_8);
+    }
+
+    /**
+     * Player name for token {@code t}. A session only ever sees a handful of names,
+     * so a small round-robin cache turns repeated names into cache hits.
+     *
+     * @param b Buffer.
+     * @param t Token index.
+     * @return Name string.
+     */
+    private String nameAt(byte[] b, int t) {
+        int o = tokOff[t];
+        int len = tokLen[t];
+        for (int i = 0; i < NAME_CACHE_SIZE; i++) {
+            byte[] k = nameKeys[i];
+            if (k == null || k.length != len) continue;
+            int j = 0;
+            while (j < len && k[j] == b[o + j]) j++;
+            if (j == len) return nameValues[i];
+        }
+        byte[] key = new byte[len];
+        System.arraycopy(b, o, key, 0, len);
+        String v = new String(key, StandardCharsets.UTF_8);
+        nameKeys[nameNext] = key;
+        nameValues[nameNext] = v;
+        nameNext = (nameNext + 1) % NAME_CACHE_SIZE;
+        return v;
+    }
+
+    /**
+     * Build a "Bad ..." exception for a token (error path only).
+     *
+     * @param ctx Context.
+     * @param b   Buffer.
+     * @param t   Token index.
+     * @return Exception to throw.
+     */
+    private ProtocolException badToken(String ctx, byte[] b, int t) {
+        return new ProtocolException("Bad " + ctx + ": " + new String(b, tokOff[t], tokLen[t], StandardCharsets.UTF_8));
+    }
+
+    /**
+     * Build an exception quoting the whole line (error path only).
+     *
+     * @param prefix Message prefix.
+     * @param m      Event holding the line.
+     * @return Exception to throw.
+     */
+    private static ProtocolException bad(String prefix, ServerMessage m) {
+        return new ProtocolException(prefix + m.text());
+    }
+}
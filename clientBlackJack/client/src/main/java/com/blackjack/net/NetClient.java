@@ -1,6 +1,5 @@
 package com.blackjack.net;
 
-import com.blackjack.MainApp.LobbyRow;
 import java.io.*;
 import java.net.*;
 import java.nio.charset.StandardCharsets;
@@ -14,13 +13,17 @@ import java.util.*;
  *
  * Responsibilities:
  *   - Maintain a socket connection and a background reader thread.
- *   - Parse server messages and dispatch them to a {@link ProtocolListener}.
+ *   - Feed server lines to the shared protocol state machine ({@link ClientProtocol}),
+ *     which dispatches them to a {@link ProtocolListener}.
  *   - Send client commands (name, lobby join, game actions).
  *   - Perform keep-alive (PING/PONG) and best-effort reconnect.
  *
  * Threading:
  *   - {@link #startReader(ProtocolListener)} spawns a daemon thread that performs blocking reads.
  *   - {@link #sendRaw(String)} is synchronized to serialize socket writes.
+ *
+ * For many sessions per JVM (bot farms) use {@link SessionMultiplexer}, which runs the
+ * same {@link ClientProtocol} on one NIO selector thread.
  */
 public class NetClient {
     private final String host;
@@ -31,48 +34,22 @@ public class NetClient {
     private static final boolean DEBUG_IO = false;
 
     // Client-side timeouts are what make the UI react quickly when the server process/machine disappears.
-    // Keep HEARTBEAT_INTERVAL_MS <= SERVER_SILENCE_TIMEOUT_MS to avoid false "server not responding"
-    // while the connection is simply idle.
+    // The read timeout is the heartbeat tick (see ClientProtocol.onTick()).
     private static final int SOCKET_READ_TIMEOUT_MS = 1000;
-    private static final int HEARTBEAT_INTERVAL_MS = 3000;
-    private static final int SERVER_SILENCE_TIMEOUT_MS = 10000;
-    private static final int PONG_RESPONSE_TIMEOUT_MS = 10000;
-    private static final int HANDSHAKE_TIMEOUT_MS = 10000;
-    private static final int LOBBY_SNAPSHOT_TIMEOUT_MS = 16000;
     private static final int RECONNECT_WINDOW_MS = 40000;
     private static final int RECONNECT_MAX_ATTEMPTS = 20;
     private static final int RECONNECT_CONNECT_TIMEOUT_MS = 1000;
+    private static final int MAX_LINE_BYTES = 4096;
 
     private Socket socket;
     private OutputStream os;
-    private BufferedReader br;
+    private LineReader lr;
     private Thread reader;
     private volatile boolean closing = false;
     private volatile String lastName = null;
     private volatile int lastLobby = -1;
-    private volatile State state = State.WAIT_OK;
-    private volatile boolean expectLobbySnapshot = false;
-    private volatile long lastServerMessageMs = System.currentTimeMillis();
-    private volatile long lastPingMs = 0L;
-    private volatile long lastPingSentMs = 0L;
-    private volatile boolean awaitingPong = false;
-    private volatile long handshakeSentMs = 0L;
-    private volatile boolean handshakeDone = false;
     private volatile String lastConnectFailureHint = null;
-    private volatile long lobbySnapshotExpectedMs = 0L;
-
-    private enum State {
-        WAIT_OK,
-        WAIT_LOBBIES,
-        LOBBY_CHOICE,
-        LOBBY_WAIT_OR_GAME,
-        IN_GAME,
-        AFTER_GAME
-    }
-
-    private static final class ProtocolException extends Exception {
-        ProtocolException(String message) { super(message); }
-    }
+    private final ClientProtocol protocol = new ClientProtocol();
 
     /**
      * Convert a connect/reconnect failure into a user-facing hint.
@@ -180,279 +157,41 @@ public class NetClient {
     public synchronized void startReader(ProtocolListener l) {
         if (reader != null && reader.isAlive()) return;
         reader = new Thread(() -> {
-            lastServerMessageMs = System.currentTimeMillis();
-            lastPingMs = 0L;
+            protocol.resetHeartbeat(System.currentTimeMillis());
             while (!closing) {
                 try {
-                    String line = br.readLine();
-                    if (line == null){
+                    int n = lr.readLine();
+                    if (n < 0){
                         throw new EOFException("server closed");
                         }
-                    String t = line.trim();
-                    lastServerMessageMs = System.currentTimeMillis();
-                    if (DEBUG_IO) System.out.println(t);
-                    if (t.isEmpty()) continue;
+                    if (DEBUG_IO) System.out.println(new String(lr.line(), 0, n, StandardCharsets.UTF_8).trim());
 
-                    if (t.startsWith("C45PO") || t.startsWith("C45PONG")) {
-                        awaitingPong = false;
-                        continue;
-                    }
-                    if (t.startsWith("C45PI") || t.startsWith("C45PING")) {
+                    long now = System.currentTimeMillis();
+                    ClientProtocol.Outcome out = protocol.onLine(lr.line(), 0, n, now, l);
+                    if (out == ClientProtocol.Outcome.SEND_PONG) {
                         try { sendPong(); } catch (IOException ignored) {}
-                        continue;
-                    }
-                    if (t.startsWith("C45DOWN") || t.startsWith("C45SERVER_DOWN")) {
-                        String reason = t.startsWith("C45DOWN")
-                                ? t.substring("C45DOWN".length()).trim()
-                                : t.substring("C45SERVER_DOWN".length()).trim();
-                        String msg = reason.isEmpty()
-                                ? "Server shut down"
-                                : "Server shut down: " + reason;
-                        l.onServerError(msg);
-                        closeQuietly();
-                        return;
-                    }
-                    if (t.startsWith("C45REC_OK") || t.startsWith("C45RECONNECT_OK")) {
-                        // We are back on the server. It can either resume the game (hand snapshot)
-                        // or (if the game already ended) send a normal lobby snapshot.
-                        state = State.LOBBY_WAIT_OR_GAME;
-                        expectLobbySnapshot = true;
-                        handshakeDone = true;
-                        l.onReconnectSucceeded();
-                        continue;
-                    }
-                    if (t.startsWith("C45OD") || t.startsWith("C45OPPDOWN")) {
-                        ensureStateIn(t, State.LOBBY_WAIT_OR_GAME, State.IN_GAME, State.AFTER_GAME);
-                        String[] p = t.split("\\s+");
-                        String who = (p.length >= 2) ? p[1] : "Enemy";
-                        int sec = 30;
-                        if (p.length >= 3) sec = parsePositiveInt(p[2], "reconnect seconds");
-                        l.onOpponentDisconnected(who, sec);
-                        continue;
-                    }
-                    if (t.startsWith("C45OB") || t.startsWith("C45OPPBACK")) {
-                        ensureStateIn(t, State.LOBBY_WAIT_OR_GAME, State.IN_GAME);
-                        String[] p = t.split("\\s+");
-                        String who = (p.length >= 2) ? p[1] : "Enemy";
-                        l.onOpponentReconnected(who);
-                        continue;
-                    }
-
-                    if (!t.startsWith("C45")) {
-                        throw new ProtocolException("Bad server message (no C45 prefix): " + t);
-                    }
-
-                    if (t.startsWith("C45OK")) {
-                        if (state == State.WAIT_OK) {
-                            ensureState(t, State.WAIT_OK);
-                            state = State.WAIT_LOBBIES;
-                            expectLobbySnapshot = true;
-                            lobbySnapshotExpectedMs = System.currentTimeMillis();
-                            l.onOk();
-                            handshakeDone = true;
-                        } else if (state == State.LOBBY_CHOICE) {
-                            ensureState(t, State.LOBBY_CHOICE);
-                            state = State.LOBBY_WAIT_OR_GAME;
-                            l.onLobbyJoinOk();
-                        } else {
-                            throw new ProtocolException("Unexpected C45OK in state " + state + ": " + t);
-                        }
-                        continue;
-                    }
-                    if(t.startsWith("C45WRONG NAME_TAKEN")){
-                        l.onServerError("Name has been taken");
+                    } else if (out == ClientProtocol.Outcome.CLOSE) {
                         closeQuietly();
                         return;
+                    } else if (protocol.pingDue(now)) {
+                        try { sendPing(); } catch (IOException ignored) {}
                     }
-                    if (t.startsWith("C45WRONG") || t.startsWith("WRONG")) {
-                        l.onServerError("WRONG");
-                        closeQuietly();
-                        return;
-                    }
-
-                    // Lobby snapshot (compact single-line format)
-                    //   C45L <n> <pairs>
-                    // where <pairs> is 2*n digits: players(0..2) + status(0/1).
-                    if (t.startsWith("C45L ")) {
-                        if (!expectLobbySnapshot && state != State.WAIT_LOBBIES) {
-                            throw new ProtocolException("Unexpected lobby snapshot: " + t);
-                        }
-                        String[] p = t.split("\\s+");
-                        if (p.length < 3) throw new ProtocolException("Bad C45L snapshot: " + t);
-                        int n = parsePositiveInt(p[1], "lobby count");
-                        if (n > 100) throw new ProtocolException("Too many lobbies: " + n);
-                        String pairs = p[2];
-                        if (pairs.length() != 2 * n) {
-                            throw new ProtocolException("Bad C45L snapshot length: " + t);
-                        }
-
-                        List<LobbyRow> rows = new ArrayList<>();
-                        for (int i = 0; i < n; i++) {
-                            char pc = pairs.charAt(i * 2);
-                            char sc = pairs.charAt(i * 2 + 1);
-                            if (!Character.isDigit(pc) || !Character.isDigit(sc)) {
-                                throw new ProtocolException("Bad C45L snapshot digits: " + t);
-                            }
-                            int players = pc - '0';
-                            int status = sc - '0';
-                            rows.add(new LobbyRow(i + 1, players, 2, String.valueOf(status)));
-                        }
-
-                        l.onLobbySnapshot(rows);
-                        state = State.LOBBY_CHOICE;
-                        expectLobbySnapshot = false;
-                        lobbySnapshotExpectedMs = 0L;
-                        continue;
-                    }
-
-                    // Legacy lobby snapshot (multi-line format)
-                    if (t.startsWith("C45LOBBIES")) {
-                        if (!expectLobbySnapshot && state != State.WAIT_LOBBIES) {
-                            throw new ProtocolException("Unexpected lobby snapshot: " + t);
-                        }
-                        String[] p = t.split("\\s+");
-                        if (p.length < 2) throw new ProtocolException("Bad C45LOBBIES header: " + t);
-                        int n = parsePositiveInt(p[1], "lobby count");
-                        if (n > 100) throw new ProtocolException("Too many lobbies: " + n);
-                        List<LobbyRow> rows = new ArrayList<>();
-                        for (int i = 0; i < n; i++) {
-                            String ln = br.readLine();
-                            if (ln == null) throw new EOFException("server closed during snapshot");
-                            rows.add(parseLobbyLine(ln.trim()));
-                        }
-                        l.onLobbySnapshot(rows);
-                        state = State.LOBBY_CHOICE;
-                        expectLobbySnapshot = false;
-                        lobbySnapshotExpectedMs = 0L;
-                        continue;
-                    }
-
-                    // gameplay
-                    if (t.startsWith("C45D ") || t.startsWith("C45DEAL")) {
-                        String[] p = t.split("\\s+");
-                        if (p.length < 3) throw new ProtocolException("Bad DEAL: " + t);
-                        ensureStateIn(t, State.LOBBY_WAIT_OR_GAME, State.IN_GAME);
-                        l.onDeal(p[1], p[2]);
-                        state = State.IN_GAME;
-                        continue;
-                    }
-                    if (t.startsWith("C45T ") || t.startsWith("C45TURN")) {
-                        String[] p = t.split("\\s+");
-                        if (p.length < 3) throw new ProtocolException("Bad TURN: " + t);
-                        ensureStateIn(t, State.IN_GAME);
-                        String who = (p.length >= 2) ? p[1] : "?";
-                        int sec = parsePositiveInt(p[2], "turn seconds");
-                        if (sec > 300) throw new ProtocolException("Bad turn seconds: " + sec);
-                        l.onTurn(who, sec); continue;
-                    }
-                    if (t.startsWith("C45C ") || t.startsWith("C45CARD")) {
-                        String[] p = t.split("\\s+");
-                        ensureStateIn(t, State.IN_GAME);
-                        if (p.length >= 2) l.onCard(p[1]); continue;
-                    }
-                    if (t.startsWith("C45B ") || t.startsWith("C45BUST")) {
-                        String[] p = t.split("\\s+");
-                        if (p.length < 3) throw new ProtocolException("Bad BUST: " + t);
-                        ensureStateIn(t, State.IN_GAME);
-                        if (p.length >= 3) l.onBust(p[1], Integer.parseInt(p[2])); continue;
-                    }
-                    if (t.startsWith("C45TO") || t.startsWith("C45TIMEOUT")) {
-                        ensureStateIn(t, State.IN_GAME);
-                        continue;
-                    }
-                    if (t.startsWith("C45R ") || t.startsWith("C45RESULT")) {
-                        ensureStateIn(t, State.LOBBY_WAIT_OR_GAME, State.IN_GAME);
-                        String[] parts = t.split("\\s+");
-                        final String p1;
-                        final String score1;
-                        final String p2;
-                        final String score2;
-                        final String winner;
-                        if (t.startsWith("C45RESULT")) {
-                            if (parts.length < 7) {
-                                // If the TCP connection drops mid-line, BufferedReader can return a partial line at EOF.
-                                // Treat this as a transport failure and let the reconnect logic handle it.
-                                throw new EOFException("Incomplete RESULT: " + t);
-                            }
-                            p1 = parts[1];
-                            score1 = parts[2];
-                            p2 = parts[3];
-                            score2 = parts[4];
-                            winner = parts[6];
-                        } else {
-                            if (parts.length < 6) {
-                                // If the TCP connection drops mid-line, BufferedReader can return a partial line at EOF.
-                                // Treat this as a transport failure and let the reconnect logic handle it.
-                                throw new EOFException("Incomplete RESULT: " + t);
-                            }
-                            p1 = parts[1];
-                            score1 = parts[2];
-                            p2 = parts[3];
-                            score2 = parts[4];
-                            winner = parts[5];
-                        }
-
-                        String header = winner.equalsIgnoreCase("PUSH")
-                                ? "Draw. Nobody won."
-                                : "Winner: " + winner;
-                        String result =
-                                header + "\n" +
-                                        p1 + ": " + score1 + "\n" +
-                                        p2 + ": " + score2;
-
-                        l.onResult(result);
-                        state = State.AFTER_GAME;
-                        continue;
-                    }
-
-                    throw new ProtocolException("Unknown server message: " + t);
                 } catch (SocketTimeoutException ste) {
                     if (closing) return;
-                    long now = System.currentTimeMillis();
-                    if (state == State.WAIT_LOBBIES &&
-                            lobbySnapshotExpectedMs > 0 &&
-                            now - lobbySnapshotExpectedMs > LOBBY_SNAPSHOT_TIMEOUT_MS) {
-                        l.onServerError("Server did not send lobby list.");
-                        closeQuietly();
-                        return;
-                    }
-                    if (!handshakeDone && handshakeSentMs > 0 &&
-                            now - handshakeSentMs > HANDSHAKE_TIMEOUT_MS) {
-                        if (tryReconnect(l, RECONNECT_WINDOW_MS, RECONNECT_MAX_ATTEMPTS)) continue;
-                        l.onServerError(autoReconnectFailedMessage());
-                        closeQuietly();
-                        return;
-                    }
-
-                    if (handshakeDone) {
-                        if (now - lastPingMs >= HEARTBEAT_INTERVAL_MS && !awaitingPong) {
+                    switch (protocol.onTick(System.currentTimeMillis())) {
+                        case SEND_PING:
                             try { sendPing(); } catch (IOException ignored) {}
-                            lastPingMs = now;
-                        }
-
-                        // Primary signal: we sent PING but didn't receive PONG in time.
-                        if (awaitingPong && (now - lastPingSentMs > PONG_RESPONSE_TIMEOUT_MS)) {
+                            break;
+                        case RECONNECT:
                             if (tryReconnect(l, RECONNECT_WINDOW_MS, RECONNECT_MAX_ATTEMPTS)) continue;
                             l.onServerError(autoReconnectFailedMessage());
                             closeQuietly();
                             return;
-                        }
-
-                        // Fallback: no server messages at all for too long.
-                        if (now - lastServerMessageMs > SERVER_SILENCE_TIMEOUT_MS) {
-                            if (tryReconnect(l, RECONNECT_WINDOW_MS, RECONNECT_MAX_ATTEMPTS)) continue;
-                            l.onServerError(autoReconnectFailedMessage());
+                        case FAIL_NO_LOBBIES:
+                            l.onServerError("Server did not send lobby list.");
                             closeQuietly();
                             return;
-                        }
-                    } else if (handshakeSentMs == 0) {
-                        // Connected, but the user didn't send a name yet. Keep the connection alive and
-                        // detect a dead server quickly by using PING/PONG even before the handshake.
-                        if (now - lastPingMs >= HEARTBEAT_INTERVAL_MS && !awaitingPong) {
-                            try { sendPing(); } catch (IOException ignored) {}
-                            lastPingMs = now;
-                        }
-                        if (now - lastServerMessageMs > SERVER_SILENCE_TIMEOUT_MS) {
+                        case FAIL_SILENT: {
                             // No name yet -> cannot use protocol reconnect, but we can still provide a hint
                             // about local network state by probing a fresh TCP connect attempt.
                             String hint = probeConnectHint();
@@ -460,8 +199,9 @@ public class NetClient {
                             closeQuietly();
                             return;
                         }
+                        default:
+                            break;
                     }
-                    continue;
                 } catch (ProtocolException | NumberFormatException ex) {
                     if (closing) return;
                     l.onServerError(ex.getMessage());
@@ -497,7 +237,9 @@ public class NetClient {
      */
     public synchronized void sendRaw(String s) throws IOException {
         if (DEBUG_IO) System.out.println(s);
-        os.write(s.getBytes(StandardCharsets.UTF_8)); os.flush(); }
+        os.write(s.getBytes(StandardCharsets.UTF_8)); os.flush();
+        protocol.onDataSent(System.currentTimeMillis());
+    }
 
     /**
      * Send the initial handshake containing the player name.
@@ -506,14 +248,25 @@ public class NetClient {
      */
     public void sendName(String name) throws IOException {
         lastName = name;
-        handshakeDone = false;
-        handshakeSentMs = System.currentTimeMillis();
-        state = State.WAIT_OK;
-        expectLobbySnapshot = true;
-        lobbySnapshotExpectedMs = 0L;
+        protocol.onNameSent(System.currentTimeMillis());
         sendRaw("C45" + name + "\n");
     }
 
+    /**
+     * Send the combined handshake: name and lobby join in one round trip.
+     *
+     * Format: {@code C45JN <name> <lobby>\n}; the server answers {@code C45JOK} when seated.
+     *
+     * @param name  Player name (must not contain whitespace).
+     * @param lobby 1-based lobby number, or 0 for any lobby.
+     */
+    public void sendNameAndJoin(String name, int lobby) throws IOException {
+        lastName = name;
+        lastLobby = lobby;
+        protocol.onNameJoinSent(System.currentTimeMillis());
+        sendRaw("C45JN " + name + " " + lobby + "\n");
+    }
+
     /**
      * Send a lobby join request.
      *
@@ -525,7 +278,7 @@ public class NetClient {
     public void sendJoin(String name, int lobby) throws IOException {
         lastName = name;
         lastLobby = lobby;
-        state = State.LOBBY_CHOICE;
+        protocol.onJoinSent();
         sendRaw("C45J " + lobby + "\n");
     }
 
@@ -536,12 +289,7 @@ public class NetClient {
     /** Send {@code C45PO} (PONG). */
     public void sendPong() throws IOException { sendRaw("C45PO\n"); }
     /** Send {@code C45PI} (PING). */
-    public void sendPing() throws IOException {
-        long now = System.currentTimeMillis();
-        sendRaw("C45PI\n");
-        awaitingPong = true;
-        lastPingSentMs = now;
-    }
+    public void sendPing() throws IOException { sendRaw("C45PI\n"); }
 
     /**
      * Request going back to lobby list.
@@ -549,8 +297,8 @@ public class NetClient {
      * @param name Player name.
      */
     public void sendBackToLobby(String name) throws IOException {
-        expectLobbySnapshot = true;
-        sendRaw("C45B\n");
+        protocol.onBackSent();
+        sendRaw(protocol.backCommand());
     }
 
     /**
@@ -563,11 +311,7 @@ public class NetClient {
         if (name == null) name = "";
         lastName = name;
         lastLobby = lobby;
-        handshakeDone = false;
-        handshakeSentMs = System.currentTimeMillis();
-        state = State.WAIT_OK;
-        expectLobbySnapshot = true;
-        lobbySnapshotExpectedMs = 0L;
+        protocol.onReconnectSent(System.currentTimeMillis());
         sendRaw("C45REC " + name + " " + lobby + "\n");
     }
 
@@ -575,7 +319,7 @@ public class NetClient {
      * Close the socket and stop the reader thread (best effort).
      */
     public void closeQuietly() {
-        // Close socket first to unblock reader thread; closing BufferedReader can block on its internal lock.
+        // Close socket first to unblock reader thread; a blocked read only returns once the socket is closed.
         closing = true;
         try { socket.close(); } catch (Exception ignored) {}
         try { if (reader != null) reader.interrupt(); } catch (Exception ignored) {}
@@ -593,12 +337,8 @@ public class NetClient {
         s.setTcpNoDelay(true);
         this.socket = s;
         this.os = s.getOutputStream();
-        this.br = new BufferedReader(new InputStreamReader(s.getInputStream(), StandardCharsets.UTF_8));
-        lastServerMessageMs = System.currentTimeMillis();
-        lastPingMs = 0L;
-        lastPingSentMs = 0L;
-        awaitingPong = false;
-        lobbySnapshotExpectedMs = 0L;
+        this.lr = new LineReader(s.getInputStream(), MAX_LINE_BYTES);
+        protocol.onConnected(System.currentTimeMillis());
     }
 
     /**
@@ -612,11 +352,7 @@ public class NetClient {
         int lobby = lastLobby;
         if (n == null || n.isBlank()) return false;
 
-        // After reconnect we can either land back in the running game OR be redirected to lobby list.
-        state = State.WAIT_OK;
-        expectLobbySnapshot = true;
-        handshakeDone = false;
-        lobbySnapshotExpectedMs = 0L;
+        protocol.onReconnectStarted();
 
         long deadline = System.currentTimeMillis() + Math.max(0L, windowMs);
         long perAttemptMs = Math.max(1L, windowMs / Math.max(1, maxAttempts));
@@ -634,7 +370,7 @@ public class NetClient {
                 if (remaining < to) to = (int)Math.max(1L, remaining);
                 s.connect(new InetSocketAddress(host, port), to);
                 replaceConnection(s);
-                handshakeSentMs = System.currentTimeMillis();
+                protocol.onReconnectSent(System.currentTimeMillis());
                 if (lobby > 0) {
                     sendRaw("C45REC " + n + " " + lobby + "\n");
                 } else {
@@ -679,93 +415,4 @@ public class NetClient {
             return hintFromConnectFailure(ex);
         }
     }
-
-    /**
-     * Parse a single lobby line from the server snapshot.
-     *
-     * Expected format:
-     *   {@code C45LOBBY <id> players=<n>/<cap> status=<0|1>}
-     *
-     * @param line Raw line (without trailing newline).
-     * @return Parsed {@link LobbyRow}.
-     */
-    private LobbyRow parseLobbyLine(String line) throws ProtocolException {
-        String[] parts = line.split("\\s+");
-        if (parts.length != 4 || !parts[0].equalsIgnoreCase("C45LOBBY")) {
-            throw new ProtocolException("Bad lobby line: " + line);
-        }
-        int id = parsePositiveInt(parts[1], "lobby id");
-
-        String[] pp = parts[2].split("=");
-        if (pp.length != 2 || !pp[0].equalsIgnoreCase("players")) {
-            throw new ProtocolException("Bad lobby players: " + line);
-        }
-        String[] ps = pp[1].split("/");
-        if (ps.length != 2) throw new ProtocolException("Bad lobby players: " + line);
-        int players = parseNonNegativeInt(ps[0], "players");
-        int cap = parsePositiveInt(ps[1], "capacity");
-        if (players > cap) throw new ProtocolException("Bad lobby players: " + line);
-
-        String[] ss = parts[3].split("=");
-        if (ss.length != 2 || !ss[0].equalsIgnoreCase("status")) {
-            throw new ProtocolException("Bad lobby status: " + line);
-        }
-        String status = ss[1];
-        return new LobbyRow(id, players, cap, status);
-    }
-
-    /**
-     * Ensure the current client state matches the expected value.
-     *
-     * @param msg      Original message (used for error context).
-     * @param expected Expected state.
-     */
-    private void ensureState(String msg, State expected) throws ProtocolException {
-        if (state != expected) throw new ProtocolException("Bad client state for message: " + msg);
-    }
-
-    /**
-     * Ensure the current client state is one of the allowed values.
-     *
-     * @param msg     Original message (used for error context).
-     * @param allowed Allowed states.
-     */
-    private void ensureStateIn(String msg, State... allowed) throws ProtocolException {
-        for (State s : allowed) if (state == s) return;
-        throw new ProtocolException("Bad client state for message: " + msg);
-    }
-
-    /**
-     * Parse a strictly positive integer (v > 0).
-     *
-     * @param s   Input string.
-     * @param ctx Context string used for error message.
-     * @return Parsed integer value.
-     */
-    private static int parsePositiveInt(String s, String ctx) throws ProtocolException {
-        try {
-            int v = Integer.parseInt(s);
-            if (v <= 0) throw new NumberFormatException();
-            return v;
-        } catch (NumberFormatException ex) {
-            throw new ProtocolException("Bad " + ctx + ": " + s);
-        }
-    }
-
-    /**
-     * Parse a non-negative integer (v >= 0).
-     *
-     * @param s   Input string.
-     * @param ctx Context string used for error message.
-     * @return Parsed integer value.
-     */
-    private static int parseNonNegativeInt(String s, String ctx) throws ProtocolException {
-        try {
-            int v = Integer.parseInt(s);
-            if (v < 0) throw new NumberFormatException();
-            return v;
-        } catch (NumberFormatException ex) {
-            throw new ProtocolException("Bad " + ctx + ": " + s);
-        }
-    }
 }
@@ -0,0 +1,8 @@
+package com.blackjack.net;
+
+/**
+ * Malformed or out-of-state server message; the connection cannot continue.
+ */
+public final class ProtocolException extends Exception {
+    ProtocolException(String message) { super(message); }
+}
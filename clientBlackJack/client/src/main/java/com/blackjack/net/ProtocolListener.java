@@ -1,6 +1,5 @@
 package com.blackjack.net;
 
-import com.blackjack.MainApp.LobbyRow;
 import java.util.List;
 
 /**
@@ -32,6 +31,17 @@ public interface ProtocolListener {
      */
     default void onLobbyJoinOk(){ }
 
+    /**
+     * Called when a combined handshake ({@code C45JN}) was accepted with {@code C45JOK}:
+     * the name is registered and the player is seated. Defaults to the two-step callbacks.
+     *
+     * @param lobby 1-based lobby the server seated the player in.
+     */
+    default void onJoinOk(int lobby){
+        onOk();
+        onLobbyJoinOk();
+    }
+
     /**
      * Called on a protocol error or when the client considers the server unreachable.
      *
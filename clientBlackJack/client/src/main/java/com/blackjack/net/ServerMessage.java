@@ -0,0 +1,87 @@
+package com.blackjack.net;
+
+import java.nio.charset.StandardCharsets;
+
+/**
+ * ServerMessage
+ *
+ * Purpose:
+ *   Reusable, mutable event filled in place by {@link MessageDecoder}: the opcode of one
+ *   server line plus its typed fields. One instance lives per {@link ClientProtocol};
+ *   its contents are only valid until the next line is decoded.
+ *
+ * Field usage per opcode:
+ *   - OK, REC_OK: n1 (ping interval ms), n2 (liveness timeout ms); 0 when not advertised
+ *   - JOIN_OK:  n1 (ping interval ms), n2 (liveness timeout ms), n3 (lobby number)
+ *   - DEAL:     card1, card2
+ *   - CARD:     card1
+ *   - TURN:     name, n1 (seconds)
+ *   - BUST:     name, n1 (hand value)
+ *   - RESULT:   name, n1, name2, n2 (scores, -1 = bust), winner
+ *   - OPP_DOWN: name, n1 (reconnect seconds)
+ *   - OPP_BACK: name
+ *   - LOBBIES:  n1 (count), n2 (snapshot version; 0 if not sent), span = the players/status digit pairs
+ *   - LOBBIES_UNCHANGED: n1 (snapshot version the client already holds)
+ *   - LOBBIES_LEGACY: n1 (count of following C45LOBBY lines)
+ *   - DOWN:     span = optional reason text
+ *   - WRONG:    nameTaken
+ *
+ * Table of contents:
+ *   - Opcodes: Op
+ *   - Fields
+ *   - Debug/error helpers: text(), spanText()
+ */
+final class ServerMessage {
+    /** Server message opcode (the token after {@code C45}). */
+    enum Op {
+        PING,
+        PONG,
+        DOWN,
+        BUSY,
+        REC_OK,
+        OPP_DOWN,
+        OPP_BACK,
+        OK,
+        JOIN_OK,
+        WRONG,
+        LOBBIES,
+        LOBBIES_UNCHANGED,
+        LOBBIES_LEGACY,
+        DEAL,
+        TURN,
+        CARD,
+        BUST,
+        TIMEOUT,
+        RESULT
+    }
+
+    Op op;
+    String name;
+    String name2;
+    String winner;
+    String card1;
+    String card2;
+    int n1;
+    int n2;
+    int n3;
+    boolean nameTaken;
+
+    /** Backing line and the trimmed line bounds (valid until the next decode). */
+    byte[] buf;
+    int start;
+    int end;
+
+    /** Opcode-specific raw byte span inside {@link #buf}. */
+    int spanOff;
+    int spanLen;
+
+    /** @return The trimmed line as a String (allocates; error and debug paths only). */
+    String text() {
+        return buf == null ? "" : new String(buf, start, end - start, StandardCharsets.UTF_8);
+    }
+
+    /** @return The opcode-specific span as a String (allocates; rare messages only). */
+    String spanText() {
+        return spanLen <= 0 ? "" : new String(buf, spanOff, spanLen, StandardCharsets.UTF_8);
+    }
+}
@@ -0,0 +1,433 @@
+package com.blackjack.net;
+
+import java.io.Closeable;
+import java.io.EOFException;
+import java.io.IOException;
+import java.net.InetSocketAddress;
+import java.net.StandardSocketOptions;
+import java.nio.ByteBuffer;
+import java.nio.channels.SelectionKey;
+import java.nio.channels.Selector;
+import java.nio.channels.SocketChannel;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Comparator;
+import java.util.Iterator;
+import java.util.LinkedHashSet;
+import java.util.PriorityQueue;
+import java.util.Queue;
+import java.util.Set;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.function.Function;
+
+/**
+ * SessionMultiplexer
+ *
+ * Purpose:
+ *   Headless, JavaFX-free client mode that drives many protocol sessions from a
+ *   single NIO selector thread (bot farms, load generation).
+ *
+ * Responsibilities:
+ *   - Open non-blocking connections and send the name handshake.
+ *   - Split incoming bytes into lines and feed them to each session's
+ *     {@link ClientProtocol} (the same state machine {@link NetClient} uses).
+ *   - Run heartbeat/timeout ticks for all sessions once per second.
+ *   - Queue outgoing commands and flush them when the socket is writable.
+ *   - Run delayed tasks ({@link #schedule(long, Runnable)}) on the selector thread.
+ *
+ * Threading:
+ *   - {@link #run()} is the selector loop; call it from one dedicated thread.
+ *   - {@link #open}, {@link #schedule} and {@link #stop()} may be called from any thread.
+ *   - Listener callbacks and {@link Session} methods run on the selector thread only.
+ *
+ * Differences from {@link NetClient}: there is no automatic reconnect. A dead or
+ * failed session reports {@link ProtocolListener#onServerError(String)} and is closed;
+ * the owner decides whether to open a new one.
+ *
+ * Table of contents:
+ *   - Construction and public API: open(), openAndJoin(), schedule(), stop(), sessionCount()
+ *   - Selector loop: run(), runTasks(), runTimers(), tickAll()
+ *   - Session: connect, read/line split, write queue, tick, close
+ */
+public final class SessionMultiplexer implements Closeable {
+    // Same cadence as NetClient's socket read timeout.
+    private static final int TICK_MS = 1000;
+    private static final int READ_BUF_BYTES = 16 * 1024;
+    private static final int MAX_LINE_BYTES = 4096;
+
+    private final InetSocketAddress server;
+    private final Selector selector;
+    private final Queue<Runnable> tasks = new ConcurrentLinkedQueue<>();
+    private final PriorityQueue<Timer> timers =
+            new PriorityQueue<>(Comparator.comparingLong((Timer t) -> t.atMs).thenComparingLong(t -> t.seq));
+    private final Set<Session> sessions = new LinkedHashSet<>();
+    private final ByteBuffer readBuf = ByteBuffer.allocateDirect(READ_BUF_BYTES);
+    private volatile boolean running = true;
+    private volatile int sessionCount = 0;
+    private long timerSeq = 0;
+
+    private static final class Timer {
+        final long atMs;
+        final long seq;
+        final Runnable task;
+
+        Timer(long atMs, long seq, Runnable task) {
+            this.atMs = atMs;
+            this.seq = seq;
+            this.task = task;
+        }
+    }
+
+    /**
+     * Create a multiplexer for one server.
+     *
+     * @param host Server host/IP.
+     * @param port Server port.
+     */
+    public SessionMultiplexer(String host, int port) throws IOException {
+        this.server = new InetSocketAddress(host, port);
+        this.selector = Selector.open();
+    }
+
+    /* --- Public API --- */
+    /**
+     * Open a new session: connect, then send the name handshake.
+     *
+     * The listener is created by {@code factory} on the selector thread before any
+     * event is delivered, so it can keep the {@link Session} handle for replies.
+     *
+     * @param name    Player name (must not contain whitespace).
+     * @param factory Creates the session's listener.
+     */
+    public void open(String name, Function<Session, ProtocolListener> factory) {
+        tasks.add(() -> startSession(name, -1, factory));
+        selector.wakeup();
+    }
+
+    /**
+     * Open a new session with the combined handshake ({@code C45JN <name> <lobby>}):
+     * the player is seated without a lobby-list round trip when a seat is free.
+     *
+     * @param name    Player name (must not contain whitespace).
+     * @param lobby   1-based lobby number, or 0 for any lobby.
+     * @param factory Creates the session's listener.
+     */
+    public void openAndJoin(String name, int lobby, Function<Session, ProtocolListener> factory) {
+        tasks.add(() -> startSession(name, lobby, factory));
+        selector.wakeup();
+    }
+
+    /**
+     * Run a task on the selector thread after a delay.
+     *
+     * @param delayMs Delay in milliseconds (0 = next loop iteration).
+     * @param task    Task to run.
+     */
+    public void schedule(long delayMs, Runnable task) {
+        long at = System.currentTimeMillis() + Math.max(0L, delayMs);
+        tasks.add(() -> timers.add(new Timer(at, timerSeq++, task)));
+        selector.wakeup();
+    }
+
+    /** Stop the selector loop; {@link #run()} closes all sessions and returns. */
+    public void stop() {
+        running = false;
+        selector.wakeup();
+    }
+
+    /** @return Number of open sessions. */
+    public int sessionCount() { return sessionCount; }
+
+    /** Stop the loop (if running) and release the selector. */
+    @Override
+    public void close() throws IOException {
+        stop();
+        selector.close();
+    }
+
+    /* --- Selector loop --- */
+    /**
+     * Selector loop. Returns after {@link #stop()}.
+     */
+    public void run() {
+        long nextTick = System.currentTimeMillis() + TICK_MS;
+        while (running) {
+            runTasks();
+
+            long now = System.currentTimeMillis();
+            long until = nextTick;
+            Timer first = timers.peek();
+            if (first != null && first.atMs < until) until = first.atMs;
+            try {
+                selector.select(Math.max(1L, until - now));
+            } catch (IOException ex) {
+                break;
+            }
+
+            Iterator<SelectionKey> it = selector.selectedKeys().iterator();
+            while (it.hasNext()) {
+                SelectionKey k = it.next();
+                it.remove();
+                Session s = (Session) k.attachment();
+                try {
+                    if (k.isValid() && k.isConnectable()) s.onConnectable();
+                    if (k.isValid() && k.isReadable()) s.onReadable();
+                    if (k.isValid() && k.isWritable()) s.onWritable();
+                } catch (IOException ex) {
+                    s.fail(ex);
+                }
+            }
+
+            now = System.currentTimeMillis();
+            runTimers(now);
+            if (now >= nextTick) {
+                tickAll(now);
+                nextTick = now + TICK_MS;
+            }
+        }
+
+        for (Session s : new ArrayList<>(sessions)) s.close();
+    }
+
+    /** Run tasks posted from other threads. */
+    private void runTasks() {
+        Runnable r;
+        while ((r = tasks.poll()) != null) r.run();
+    }
+
+    /**
+     * Run due delayed tasks.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    private void runTimers(long nowMs) {
+        while (!timers.isEmpty() && timers.peek().atMs <= nowMs) {
+            timers.poll().task.run();
+        }
+    }
+
+    /**
+     * Heartbeat/timeout tick for every session.
+     *
+     * @param nowMs Current time in milliseconds.
+     */
+    private void tickAll(long nowMs) {
+        for (Session s : new ArrayList<>(sessions)) s.tick(nowMs);
+    }
+
+    /**
+     * Create a session and start its non-blocking connect.
+     *
+     * @param name    Player name.
+     * @param lobby   Lobby for the combined handshake; -1 = plain name handshake.
+     * @param factory Listener factory.
+     */
+    private void startSession(String name, int lobby, Function<Session, ProtocolListener> factory) {
+        Session s = new Session(name, lobby);
+        s.listener = factory.apply(s);
+        sessions.add(s);
+        sessionCount = sessions.size();
+        try {
+            SocketChannel ch = SocketChannel.open();
+            s.channel = ch;
+            ch.configureBlocking(false);
+            ch.setOption(StandardSocketOptions.TCP_NODELAY, true);
+            boolean connected = ch.connect(server);
+            s.key = ch.register(selector, connected ? SelectionKey.OP_READ : SelectionKey.OP_CONNECT, s);
+            if (connected) s.onConnected();
+        } catch (IOException ex) {
+            s.fail(ex);
+        }
+    }
+
+    /* --- Session --- */
+    /**
+     * One headless protocol session. All methods must be called on the selector thread
+     * (i.e. from listener callbacks or scheduled tasks).
+     */
+    public final class Session {
+        private final String name;
+        private final int joinLobby;
+        private final ClientProtocol protocol = new ClientProtocol();
+        private final ArrayDeque<ByteBuffer> out = new ArrayDeque<>();
+        private final byte[] line = new byte[MAX_LINE_BYTES];
+        private int lineLen = 0;
+        private ProtocolListener listener;
+        private SocketChannel channel;
+        private SelectionKey key;
+        private boolean closed = false;
+
+        private Session(String name, int joinLobby) {
+            this.name = name;
+            this.joinLobby = joinLobby;
+        }
+
+        /** @return Player name of this session. */
+        public String name() { return name; }
+
+        /** @return Current protocol state. */
+        public ClientProtocol.State state() { return protocol.state(); }
+
+        /** @return true until the session is closed. */
+        public boolean isOpen() { return !closed; }
+
+        /**
+         * Join a lobby ({@code C45J <lobby>}).
+         *
+         * @param lobby 1-based lobby number.
+         */
+        public void sendJoin(int lobby) {
+            protocol.onJoinSent();
+            send("C45J " + lobby + "\n");
+        }
+
+        /** Send {@code C45H}. */
+        public void sendHit() { send("C45H\n"); }
+
+        /** Send {@code C45S}. */
+        public void sendStand() { send("C45S\n"); }
+
+        /** Request the lobby list / go back to it ({@code C45B}). */
+        public void sendBackToLobby() {
+            protocol.onBackSent();
+            send(protocol.backCommand());
+        }
+
+        /** Close the connection (no listener callback). */
+        public void close() {
+            if (closed) return;
+            closed = true;
+            if (key != null) key.cancel();
+            try { if (channel != null) channel.close(); } catch (IOException ignored) {}
+            out.clear();
+            sessions.remove(this);
+            sessionCount = sessions.size();
+        }
+
+        /** Non-blocking connect finished. */
+        private void onConnectable() throws IOException {
+            if (!channel.finishConnect()) return;
+            key.interestOps(out.isEmpty() ? SelectionKey.OP_READ : SelectionKey.OP_READ | SelectionKey.OP_WRITE);
+            onConnected();
+        }
+
+        /** Connection established: send the handshake. */
+        private void onConnected() {
+            long now = System.currentTimeMillis();
+            protocol.onConnected(now);
+            if (joinLobby >= 0) {
+                protocol.onNameJoinSent(now);
+                send("C45JN " + name + " " + joinLobby + "\n");
+            } else {
+                protocol.onNameSent(now);
+                send("C45" + name + "\n");
+            }
+        }
+
+        /** Read available bytes and dispatch complete lines. */
+        private void onReadable() throws IOException {
+            readBuf.clear();
+            int n = channel.read(readBuf);
+            if (n < 0) throw new EOFException("server closed");
+            readBuf.flip();
+            while (readBuf.hasRemaining() && !closed) {
+                byte b = readBuf.get();
+                if (b == '\n') {
+                    int len = lineLen;
+                    lineLen = 0;
+                    onLine(len);
+                } else if (lineLen < line.length) {
+                    line[lineLen++] = b;
+                } else {
+                    listener.onServerError("Server line too long");
+                    close();
+                }
+            }
+        }
+
+        /**
+         * Feed one line to the state machine and act on the outcome.
+         *
+         * @param len Length of the line in {@code line} (without the trailing newline).
+         */
+        private void onLine(int len) throws IOException {
+            try {
+                ClientProtocol.Outcome o = protocol.onLine(line, 0, len, System.currentTimeMillis(), listener);
+                if (o == ClientProtocol.Outcome.SEND_PONG) send("C45PO\n");
+                else if (o == ClientProtocol.Outcome.CLOSE) close();
+            } catch (ProtocolException | NumberFormatException ex) {
+                listener.onServerError(ex.getMessage());
+                close();
+            }
+        }
+
+        /** Flush queued output. */
+        private void onWritable() throws IOException {
+            while (!out.isEmpty()) {
+                ByteBuffer b = out.peek();
+                channel.write(b);
+                if (b.hasRemaining()) return;
+                out.poll();
+            }
+            if (!closed) key.interestOps(SelectionKey.OP_READ);
+        }
+
+        /**
+         * Queue a line; writes immediately when nothing is pending.
+         *
+         * @param s Line including the trailing newline.
+         */
+        private void send(String s) {
+            if (closed) return;
+            protocol.onDataSent(System.currentTimeMillis());
+            ByteBuffer b = ByteBuffer.wrap(s.getBytes(StandardCharsets.UTF_8));
+            try {
+                if (out.isEmpty() && channel.isConnected()) channel.write(b);
+                if (b.hasRemaining()) {
+                    out.add(b);
+                    if (channel.isConnected()) key.interestOps(SelectionKey.OP_READ | SelectionKey.OP_WRITE);
+                }
+            } catch (IOException ex) {
+                fail(ex);
+            }
+        }
+
+        /**
+         * Heartbeat/timeout tick.
+         *
+         * @param nowMs Current time in milliseconds.
+         */
+        private void tick(long nowMs) {
+            if (closed) return;
+            switch (protocol.onTick(nowMs)) {
+                case SEND_PING:
+                    send("C45PI\n");
+                    break;
+                case RECONNECT:
+                case FAIL_SILENT:
+                    listener.onServerError("Server is not responding");
+                    close();
+                    break;
+                case FAIL_NO_LOBBIES:
+                    listener.onServerError("Server did not send lobby list.");
+                    close();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        /**
+         * Transport failure: report and close.
+         *
+         * @param ex Failure.
+         */
+        private void fail(Exception ex) {
+            if (closed) return;
+            String msg = ex.getMessage();
+            listener.onServerError(msg == null || msg.isBlank() ? "Connection lost." : "Connection lost: " + msg);
+            close();
+        }
+    }
+}
@@ -3,6 +3,7 @@ package com.blackjack.ui;
 import com.blackjack.net.NetClient;
 import java.util.ArrayList;
 import java.util.List;
+import java.util.concurrent.Executor;
 import javafx.application.Platform;
 import javafx.geometry.Insets;
 import javafx.scene.Scene;
@@ -20,8 +21,12 @@ import javafx.scene.layout.*;
  *   - Enable/disable HIT/STAND based on turn ownership.
  *   - Provide a "Back to Lobby" action when the game ends.
  *
+ * Log lines and the score label are buffered and applied by {@link #flush()}, which the
+ * owner calls once per {@link UiDispatcher} batch; a burst of events therefore costs one
+ * text-area update instead of one per event.
+ *
  * Table of contents:
- *   - Lifecycle: GameView(), scene(), bindClient()
+ *   - Lifecycle: GameView(), scene(), bindClient(), flush()
  *   - Protocol callbacks: onDeal(), onTurn(), onCard(), onBust(), onOpponentDisconnected(), onOpponentReconnected(), onResult()
  *   - UI helpers: setTurnEnabled(), setBackEnabled(), append()
  *   - Hand helpers: addCardToHand(), updateScore(), handValue()
@@ -36,11 +41,14 @@ public class GameView {
     private final Button stand = new Button("STAND");
     private final Button backToLobby = new Button("Back to Lobby");
     private NetClient client;
+    private Executor sender;
     private Runnable onBackToLobby;
     private String myName;
     private final List<String> hand = new ArrayList<>();
     private boolean matchEnded = false;
     private boolean restoringHandSnapshot = false;
+    private final StringBuilder pendingLog = new StringBuilder();
+    private String pendingScore = null;
 
     /**
      * Create a game view for a given lobby number.
@@ -75,9 +83,27 @@ public class GameView {
     /**
      * Bind the view to a {@link NetClient} used to send game commands.
      *
-     * @param c NetClient instance.
+     * @param c      NetClient instance.
+     * @param sender Executor that performs the (blocking) sends off the FX thread.
      */
-    public void bindClient(NetClient c) { this.client = c; }
+    public void bindClient(NetClient c, Executor sender) {
+        this.client = c;
+        this.sender = sender;
+    }
+
+    /**
+     * Apply buffered log lines and the score label. Must be called from the JavaFX thread.
+     */
+    public void flush() {
+        if (pendingLog.length() > 0) {
+            log.appendText((log.getText().isEmpty() ? "" : "\n") + pendingLog);
+            pendingLog.setLength(0);
+        }
+        if (pendingScore != null) {
+            scoreLabel.setText(pendingScore);
+            pendingScore = null;
+        }
+    }
 
     /**
      * Show a connection/reconnect status text inside the game view.
@@ -181,7 +207,7 @@ public class GameView {
     public void onBust(String p, int v){
         boolean isMe = myName != null && myName.equals(p);
         if (isMe) {
-            scoreLabel.setText("Total score: " + v);
+            pendingScore = "Total score: " + v;
             append(p + " OverTake (" + v + ")");
         }
         setTurnEnabled(false);
@@ -252,27 +278,28 @@ public class GameView {
     }
 
     /**
-     * Append one line to the log.
+     * Queue one line for the log (applied by {@link #flush()}).
      *
      * @param s Text to append.
      */
-    private void append(String s){ log.appendText((log.getText().isEmpty()?"":"\n") + s); }
+    private void append(String s){
+        if (pendingLog.length() > 0) pendingLog.append('\n');
+        pendingLog.append(s);
+    }
 
     /**
-     * Send a command asynchronously to avoid blocking the JavaFX UI thread.
+     * Send a command on the sender executor to avoid blocking the JavaFX UI thread.
      *
      * @param io Operation that performs the send.
      */
     private void sendAsync(IO io){
-        Thread t = new Thread(() -> {
+        sender.execute(() -> {
             try {
                 io.run();
             } catch (Exception ex) {
-                Platform.runLater(() -> append("Error sending: " + ex.getMessage()));
+                Platform.runLater(() -> { append("Error sending: " + ex.getMessage()); flush(); });
             }
-        }, "send-game-cmd");
-        t.setDaemon(true);
-        t.start();
+        });
     }
 
     /**
@@ -320,7 +347,7 @@ public class GameView {
      * Update the score label based on current hand.
      */
     private void updateScore() {
-        scoreLabel.setText("Total score: " + handValue(hand));
+        pendingScore = "Total score: " + handValue(hand);
     }
 
     /**
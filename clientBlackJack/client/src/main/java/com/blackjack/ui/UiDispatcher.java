@@ -0,0 +1,94 @@
+package com.blackjack.ui;
+
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.atomic.AtomicBoolean;
+import javafx.application.Platform;
+
+/**
+ * UiDispatcher
+ *
+ * Purpose:
+ *   Coalesce UI updates posted from network threads into one FX-thread pass.
+ *
+ * Responsibilities:
+ *   - Queue updates from any thread; schedule at most one {@code Platform.runLater}
+ *     until the FX thread has drained the queue, so a burst of protocol events
+ *     (e.g. a reconnect replay: C45D followed by several C45C) costs one FX pulse.
+ *   - Run an "after batch" hook once per drain so views can flush buffered
+ *     text/labels once instead of per event.
+ *   - Measure FX-thread time, events and batches (read/reset per game).
+ *
+ * Updates run in posting order. Threading: {@link #post(Runnable)} is thread-safe;
+ * everything else must be called on the FX thread.
+ *
+ * Table of contents:
+ *   - post(), setAfterBatch()
+ *   - drain()
+ *   - Measurement: takeStats()
+ */
+public final class UiDispatcher {
+    private final ConcurrentLinkedQueue<Runnable> queue = new ConcurrentLinkedQueue<>();
+    private final AtomicBoolean scheduled = new AtomicBoolean(false);
+    private Runnable afterBatch;
+
+    // FX thread only.
+    private long statEvents = 0;
+    private long statBatches = 0;
+    private long statFxNanos = 0;
+
+    /**
+     * Queue a UI update. Safe to call from any thread.
+     *
+     * @param r Update to run on the FX thread.
+     */
+    public void post(Runnable r) {
+        queue.add(r);
+        if (scheduled.compareAndSet(false, true)) {
+            Platform.runLater(this::drain);
+        }
+    }
+
+    /**
+     * Set the hook that runs once at the end of every batch (FX thread).
+     *
+     * @param r Hook, or null.
+     */
+    public void setAfterBatch(Runnable r) { this.afterBatch = r; }
+
+    /**
+     * Run everything queued so far, then the after-batch hook.
+     */
+    private void drain() {
+        long t0 = System.nanoTime();
+        // Clear the flag first: anything posted while we drain schedules the next batch.
+        scheduled.set(false);
+        int n = 0;
+        Runnable r;
+        while ((r = queue.poll()) != null) {
+            try {
+                r.run();
+            } catch (RuntimeException ex) {
+                ex.printStackTrace();
+            }
+            n++;
+        }
+        if (afterBatch != null) afterBatch.run();
+        statEvents += n;
+        statBatches++;
+        statFxNanos += System.nanoTime() - t0;
+    }
+
+    /**
+     * Return FX-thread statistics since the previous call and reset them.
+     *
+     * @return Line like {@code events=12 batches=5 fx_ms=3.41}.
+     */
+    public String takeStats() {
+        String s = String.format("events=%d batches=%d fx_ms=%.2f",
+                statEvents, statBatches, statFxNanos / 1_000_000.0);
+        statEvents = 0;
+        statBatches = 0;
+        statFxNanos = 0;
+        return s;
+    }
+}
@@ -0,0 +1,154 @@
+package com.blackjack.net;
+
+import static org.junit.jupiter.api.Assertions.assertEquals;
+import static org.junit.jupiter.api.Assertions.assertThrows;
+
+import java.nio.charset.StandardCharsets;
+import org.junit.jupiter.api.Test;
+
+/**
+ * MessageDecoderTest
+ *
+ * Purpose:
+ *   Decode lines exactly as the server sends them (server/src/game.c, server/src/protocol.c).
+ *
+ * Run: {@code mvn test} (from clientBlackJack/client).
+ */
+class MessageDecoderTest {
+    private final MessageDecoder decoder = new MessageDecoder();
+    private final ServerMessage m = new ServerMessage();
+
+    private ServerMessage.Op decode(String line) throws Exception {
+        byte[] b = line.getBytes(StandardCharsets.US_ASCII);
+        return decoder.decode(b, 0, b.length, m);
+    }
+
+    @Test
+    void resultWithBustedHand() throws Exception {
+        assertEquals(ServerMessage.Op.RESULT, decode("C45R ann -1 bob 19 bob\n"));
+        assertEquals("ann", m.name);
+        assertEquals(-1, m.n1);
+        assertEquals("bob", m.name2);
+        assertEquals(19, m.n2);
+        assertEquals("bob", m.winner);
+    }
+
+    @Test
+    void resultBothBustedIsPush() throws Exception {
+        assertEquals(ServerMessage.Op.RESULT, decode("C45R ann -1 bob -1 PUSH"));
+        assertEquals(-1, m.n1);
+        assertEquals(-1, m.n2);
+        assertEquals("PUSH", m.winner);
+    }
+
+    @Test
+    void resultLongForm() throws Exception {
+        assertEquals(ServerMessage.Op.RESULT, decode("C45RESULT ann 20 bob -1 x ann"));
+        assertEquals(20, m.n1);
+        assertEquals(-1, m.n2);
+        assertEquals("ann", m.winner);
+    }
+
+    @Test
+    void resultWithRevealedSeed() throws Exception {
+        assertEquals(ServerMessage.Op.RESULT, decode("C45R ann -1 bob 19 bob 9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f\n"));
+        assertEquals("ann", m.name);
+        assertEquals(-1, m.n1);
+        assertEquals("bob", m.name2);
+        assertEquals(19, m.n2);
+        assertEquals("bob", m.winner);
+        assertEquals(ServerMessage.Op.RESULT, decode("C45R ann 20 bob 20 PUSH 9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f"));
+        assertEquals("PUSH", m.winner);
+    }
+
+    @Test
+    void resultRejectsMalformedScore() {
+        assertThrows(ProtocolException.class, () -> decode("C45R ann - bob 19 bob"));
+        assertThrows(ProtocolException.class, () -> decode("C45R ann 1-1 bob 19 bob"));
+    }
+
+    @Test
+    void handshakeAckWithKeepalive() throws Exception {
+        assertEquals(ServerMessage.Op.OK, decode("C45OK 10000 15000\n"));
+        assertEquals(10000, m.n1);
+        assertEquals(15000, m.n2);
+        assertEquals(ServerMessage.Op.REC_OK, decode("C45REC_OK 10000 15000"));
+        assertEquals(10000, m.n1);
+        assertEquals(15000, m.n2);
+    }
+
+    @Test
+    void handshakeAckPlain() throws Exception {
+        assertEquals(ServerMessage.Op.OK, decode("C45OK"));
+        assertEquals(0, m.n1);
+        assertEquals(0, m.n2);
+        assertEquals(ServerMessage.Op.REC_OK, decode("C45REC_OK\r\n"));
+        assertEquals(0, m.n1);
+        assertEquals(ServerMessage.Op.OK, decode("C45OK 0 0"));
+        assertEquals(0, m.n1);
+        assertThrows(ProtocolException.class, () -> decode("C45OK 10x00 15000"));
+    }
+
+    @Test
+    void combinedJoinAck() throws Exception {
+        assertEquals(ServerMessage.Op.JOIN_OK, decode("C45JOK 2 10000 15000\n"));
+        assertEquals(2, m.n3);
+        assertEquals(10000, m.n1);
+        assertEquals(15000, m.n2);
+        assertThrows(ProtocolException.class, () -> decode("C45JOK 2"));
+        assertThrows(ProtocolException.class, () -> decode("C45JOK 0 10000 15000"));
+    }
+
+    @Test
+    void gameplayLines() throws Exception {
+        assertEquals(ServerMessage.Op.DEAL, decode("C45D AS TD"));
+        assertEquals("AS", m.card1);
+        assertEquals("TD", m.card2);
+        assertEquals(ServerMessage.Op.DEAL, decode("C45D 7H KC 9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f9f\n"));
+        assertEquals("7H", m.card1);
+        assertEquals("KC", m.card2);
+        assertEquals(ServerMessage.Op.TURN, decode("C45T ann 30"));
+        assertEquals("ann", m.name);
+        assertEquals(30, m.n1);
+        assertEquals(ServerMessage.Op.BUST, decode("C45B ann 26"));
+        assertEquals(26, m.n1);
+    }
+
+    @Test
+    void snapshotPairs() throws Exception {
+        assertEquals(ServerMessage.Op.LOBBIES, decode("C45L 3 001020"));
+        assertEquals(3, m.n1);
+        assertEquals("001020", m.spanText());
+        assertThrows(ProtocolException.class, () -> decode("C45L 3 0010"));
+    }
+
+    @Test
+    void snapshotWithVersion() throws Exception {
+        assertEquals(ServerMessage.Op.LOBBIES, decode("C45L 3 001020 17\n"));
+        assertEquals(3, m.n1);
+        assertEquals(17, m.n2);
+        assertEquals("001020", m.spanText());
+        assertEquals(ServerMessage.Op.LOBBIES, decode("C45L 3 001020"));
+        assertEquals(0, m.n2);
+    }
+
+    @Test
+    void timingProfileLayouts() throws Exception {
+        // Blitz/bot turn: the exact clock in ms follows the rounded-up seconds.
+        assertEquals(ServerMessage.Op.TURN, decode("C45T ann 4 4000\n"));
+        assertEquals("ann", m.name);
+        assertEquals(4, m.n1);
+        // Profile letters after the version leave the pairs and version intact.
+        assertEquals(ServerMessage.Op.LOBBIES, decode("C45L 3 001020 17 SSB\n"));
+        assertEquals(3, m.n1);
+        assertEquals(17, m.n2);
+        assertEquals("001020", m.spanText());
+    }
+
+    @Test
+    void snapshotUnchanged() throws Exception {
+        assertEquals(ServerMessage.Op.LOBBIES_UNCHANGED, decode("C45LU 17"));
+        assertEquals(17, m.n1);
+        assertThrows(ProtocolException.class, () -> decode("C45LU"));
+    }
+}
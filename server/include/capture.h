@@ -0,0 +1,77 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/*
+ * capture.h
+ *
+ * Purpose:
+ *   Optional low-overhead capture of protocol traffic for trace-driven replay.
+ *   Protocol lines are timestamped and pushed into a lock-free ring buffer by
+ *   the I/O helpers; a background thread writes them to a compact binary file.
+ *
+ * File format (native endianness):
+ *   - 8-byte header: "BJCAP01\n"
+ *   - Records:       u64 ts_ns | u32 session | u8 dir | u8 flags | u16 len | len bytes
+ *     ts_ns is monotonic time since capture start; dir is CAPTURE_IN (client -> server)
+ *     or CAPTURE_OUT (server -> client). A record holds at most CAPTURE_LINE_MAX
+ *     bytes; a longer write is cut and marked CAPTURE_TRUNCATED in flags, and
+ *     tools/replay refuses captures that contain such records.
+ *
+ * Table of contents:
+ *   - Configuration: g_capture_path
+ *   - Lifecycle: capture_open(), capture_close()
+ *   - Recording: capture_session_begin(), capture_line()
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPTURE_IN   0
+#define CAPTURE_OUT  1
+
+#define CAPTURE_MAGIC "BJCAP01\n"
+
+/* Largest write stored in one record: covers every line the server emits
+ * (C45LX and C45HIST replies are built in 1024-byte buffers). */
+#define CAPTURE_LINE_MAX   1024
+
+/* Record flags. */
+#define CAPTURE_TRUNCATED  0x01   /* original write was longer than CAPTURE_LINE_MAX */
+
+/* Capture file path (CAPTURE_FILE in config.txt); empty string disables capture. */
+extern char g_capture_path[256];
+
+/**
+ * Start capturing into @p path (truncates the file) and spawn the writer thread.
+ *
+ * @param path Output file path.
+ * @return 0 on success; -1 on error.
+ */
+int  capture_open(const char* path);
+
+/**
+ * Flush pending records, stop the writer thread and close the file.
+ */
+void capture_close(void);
+
+/**
+ * Assign a new capture session id to a freshly accepted socket.
+ *
+ * @param fd Connected socket file descriptor.
+ */
+void capture_session_begin(int fd);
+
+/**
+ * Record one protocol line (no-op when capture is disabled).
+ *
+ * Never blocks: if the ring buffer is full, the record is dropped and counted.
+ * Writes longer than CAPTURE_LINE_MAX are cut and flagged CAPTURE_TRUNCATED.
+ *
+ * @param fd   Socket the line was read from / written to.
+ * @param dir  CAPTURE_IN or CAPTURE_OUT.
+ * @param data Line bytes (not necessarily NUL-terminated).
+ * @param len  Number of bytes in @p data.
+ */
+void capture_line(int fd, int dir, const char* data, size_t len);
+
+#endif /* CAPTURE_H */
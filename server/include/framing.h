@@ -0,0 +1,96 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+/*
+ * framing.h
+ *
+ * Purpose:
+ *   Vectorized scanning of received protocol bytes: newline positions of a
+ *   whole chunk, and the "C45<token>" shape of a single line (prefix, trimmed
+ *   token bounds, embedded whitespace) in one pass.
+ *
+ *   SSE2 (x86-64 baseline) and AVX2 (picked at runtime when the CPU has it)
+ *   compare 16/32 bytes at a time and turn the result into a bit mask; other
+ *   targets use the scalar reference code. Every level returns exactly what
+ *   the scalar code returns (tools/framefuzz.c checks this).
+ *
+ * Table of contents:
+ *   - Levels: FrameLevel, frame_level(), frame_set_level(), frame_level_name()
+ *   - Newlines: frame_newlines(), frame_newlines_scalar()
+ *   - Lines: FrameLine, frame_line(), frame_line_scalar()
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Implementation used by frame_newlines()/frame_line(). */
+typedef enum {
+    FRAME_SCALAR = 0,
+    FRAME_SSE2   = 1,
+    FRAME_AVX2   = 2
+} FrameLevel;
+
+/**
+ * Shape of one "C45..." line.
+ *
+ * Whitespace is the C locale isspace() set (' ', '\t', '\n', '\v', '\f', '\r').
+ * The token starts after "C45" and any ' '/'\t', and ends before trailing
+ * '\r', '\n', ' ' and '\t'.
+ */
+typedef struct {
+    int    c45;          /* 1 if the line starts with "C45" */
+    size_t tok_begin;    /* first token byte */
+    size_t tok_end;      /* one past the last token byte (== tok_begin if empty) */
+    size_t first_space;  /* first whitespace inside the token, or tok_end if none */
+} FrameLine;
+
+/**
+ * @return Level currently in use (the best one the CPU supports unless overridden).
+ */
+FrameLevel frame_level(void);
+
+/**
+ * Force an implementation (benchmarks and the equivalence fuzzer).
+ *
+ * @param level Level to use.
+ * @return 0 on success; -1 if the CPU/build does not support @p level.
+ */
+int frame_set_level(FrameLevel level);
+
+/**
+ * @param level Level.
+ * @return "scalar", "sse2" or "avx2".
+ */
+const char* frame_level_name(FrameLevel level);
+
+/**
+ * Find the positions of '\n' bytes in a buffer.
+ *
+ * @param p   Bytes to scan.
+ * @param n   Number of bytes.
+ * @param pos Output: offsets of the newlines, ascending.
+ * @param max Capacity of @p pos; scanning stops once it is full.
+ * @return Number of positions stored.
+ */
+size_t frame_newlines(const char* p, size_t n, uint32_t* pos, size_t max);
+
+/**
+ * Scalar reference for frame_newlines().
+ */
+size_t frame_newlines_scalar(const char* p, size_t n, uint32_t* pos, size_t max);
+
+/**
+ * Describe one line (prefix, token bounds, whitespace inside the token).
+ *
+ * @param p   Line bytes (may include the trailing "\r\n").
+ * @param n   Line length.
+ * @param out Output description.
+ */
+void frame_line(const char* p, size_t n, FrameLine* out);
+
+/**
+ * Scalar reference for frame_line().
+ */
+void frame_line_scalar(const char* p, size_t n, FrameLine* out);
+
+#endif
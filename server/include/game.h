@@ -12,19 +12,26 @@
  * Table of contents:
  *   - Constants and global configuration
  *   - Card/deck types and helpers
- *   - Lobby/player structures
+ *   - Lobby/player structures, shuffle commitments (ShuffleProof), per-table buffers (TableBuf)
+ *   - Timing profiles: LobbyProfile, g_blitz_turn_ms, g_blitz_reconnect_ms
+ *   - Bot lane: g_bot_lobbies, g_bot_turn_ms, g_bot_token, lobby_public_count(), bot_token_ok()
+ *   - Game loop counters: GameLoopStats, game_loop_stats_snapshot()
+ *   - Per-lobby counters: LobbyStats, LobbyStatsView, lobby_stats_snapshot(), lobby_stats_format()
  *   - Lobby lifecycle and game helpers
  */
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 #endif
 
 #define MAX_NAME_LEN 64
 #define LOBBY_SIZE  2
+#define LOBBY_COUNT_MAX 99 /* LOBBY_COUNT upper bound; sizes the lobby snapshot line */
 #define DECK_SIZE   52
+#define TABLE_LINE_BYTES 320   /* per-table line buffers (>= READ_BUF; fits C45R with two names and a seed) */
 
 /* --- Server network configuration (loaded from config.txt) --- */
 extern char g_server_ip[64];   /* Bind address, e.g. "0.0.0.0" or "127.0.0.1" */
@@ -45,29 +52,123 @@ typedef struct {
     int  hand_size;
     int  connected;   /* 0/1 */
     int fd, stood, busted;
+    int replaced_fd;  /* socket of a waiting session whose seat a C45REC took over (-1 = none) */
 } Player;
 
+/* Provably fair shuffle of the current game (see shuffle.h). */
+typedef struct {
+    char commit[65];   /* SHA-256(seed || deck order), hex; sent with C45D */
+    char seed[65];     /* server seed, hex; revealed in C45R */
+} ShuffleProof;
+
+/* Buffers owned by the lobby's game thread and reused by every game at the table:
+ * the turn loop formats and reads into these instead of fresh stack/heap buffers. */
+typedef struct {
+    char names[LOBBY_SIZE][MAX_NAME_LEN];  /* player names, copied once per game */
+    char in[TABLE_LINE_BYTES];             /* last line read from a player */
+    char out[TABLE_LINE_BYTES];            /* line being sent */
+} TableBuf;
+
+/* Rolling per-table counters. Written only by the lobby's game thread (one
+ * relaxed atomic update per event); read lock-free by snapshot/metrics code.
+ * Averages are exponentially weighted (1/8 per sample), in milliseconds. */
+typedef struct {
+    atomic_ullong games;         /* games completed */
+    atomic_ullong turns;         /* turns answered with HIT/STAND */
+    atomic_ullong disconnects;   /* players lost mid-game (reconnect wait started) */
+    atomic_ullong reconnects;    /* players that came back within the wait */
+    atomic_uint   game_ms_avg;   /* game duration */
+    atomic_uint   turn_ms_avg;   /* time from C45T to the player's HIT/STAND */
+} LobbyStats;
+
+/* Plain copy of LobbyStats. */
+typedef struct {
+    unsigned long long games, turns, disconnects, reconnects;
+    unsigned game_ms_avg, turn_ms_avg;
+} LobbyStatsView;
+
+/* Timing profile of a lobby: its turn clock and the reconnect window of a dropped player. */
+typedef enum {
+    LOBBY_PROFILE_STANDARD = 0,   /* 60 s turns, 60 s reconnect window */
+    LOBBY_PROFILE_BLITZ    = 1,   /* BLITZ_TURN_MS turns, BLITZ_RECONNECT_MS window */
+    LOBBY_PROFILE_BOT      = 2    /* BOT_TURN_MS turns, no reconnect window (bot lane) */
+} LobbyProfile;
+
 typedef struct {
     Player players[LOBBY_SIZE];
     int    player_count;
     int    is_running;    /* 0 = not running, 1 = running */
     Deck   deck;
+    ShuffleProof proof;   /* commitment of the current deck (game thread, under mtx) */
+    int    turn;          /* seat whose turn it is (game thread, under mtx) */
+    unsigned long long turn_deadline_ms; /* CLOCK_MONOTONIC ms the current turn times out, 0 = none */
+    int    profile;       /* LobbyProfile (fixed at init) */
+    int    turn_ms;       /* turn clock of this table in milliseconds (fixed at init) */
+    int    reconnect_ms;  /* how long a dropped player's seat is held; 0 = no window (fixed at init) */
+    int    bot;           /* 1 = bot lane: bot sessions only, no keep-alive, no reconnect window */
+    int    resume;        /* 1 = the next game thread continues a restored game (replica.h) */
+    pthread_t worker;     /* bot lane: persistent game loop of this table (bot_table_worker()) */
+    int    worker_on;     /* 1 = worker started (under mtx) */
+    int    worker_stop;   /* 1 = worker exits once idle (lobbies_free(), under mtx) */
+    atomic_int repl_dirty; /* changed since the last replication batch */
+    TableBuf tb;          /* game thread only */
+    LobbyStats stats;
     pthread_mutex_t mtx;
+    pthread_cond_t  changed;  /* broadcast when a game starts (wakes a bot worker), drops a player's socket or has released its players */
 } Lobby;
 
+/* --- Game loop counters (process-wide, read by tools/syscallbench) --- */
+typedef struct {
+    unsigned long long games;        /* game threads started */
+    unsigned long long name_copies;  /* player-name copies made by game threads */
+} GameLoopStats;
+
 /* --- Global lobby pool and server lifecycle flag --- */
 extern atomic_int  g_server_running;
 /* Dynamic lobby configuration */
 extern int   g_lobby_count;
 extern Lobby *g_lobbies;
 
+/* --- Keepalive (advertised to clients as "C45OK <interval_ms> <timeout_ms>") ---
+ * Clients originate PINGs at the interval; the server only answers and treats any
+ * received line as liveness, dropping a player after the timeout. */
+extern int g_keepalive_interval_sec;
+extern int g_keepalive_timeout_sec;
+
+/* --- Bot lane (loaded from config.txt) ---
+ * BOT_LOBBIES extra lobbies follow the LOBBY_COUNT public ones (g_lobby_count
+ * covers both). They seat only sessions opened with "C45BOT <name> <token>",
+ * run on a millisecond turn clock and skip keep-alive and reconnect waits. */
+extern int  g_bot_lobbies;       /* BOT_LOBBIES: number of bot lobbies (default 0) */
+extern int  g_bot_turn_ms;       /* BOT_TURN_MS: turn clock of bot lobbies (default 250) */
+extern char g_bot_token[64];     /* BOT_TOKEN: shared secret of bot sessions; empty disables the lane */
+
+/* --- Timing profiles (loaded from config.txt) ---
+ * "LOBBY_PROFILE <lobby>[-<last>] <standard|blitz>" assigns public lobbies a
+ * profile; the blitz clocks are shared by all blitz lobbies. */
+extern int g_blitz_turn_ms;       /* BLITZ_TURN_MS: turn clock of blitz lobbies (default 4000) */
+extern int g_blitz_reconnect_ms;  /* BLITZ_RECONNECT_MS: reconnect window of blitz lobbies (default 10000) */
+
 /**
  * Load server configuration from a text file.
  *
  * Recognized keys:
- *   - LOBBY_COUNT (1..1000)
+ *   - LOBBY_COUNT (1..LOBBY_COUNT_MAX)
  *   - IP (bind address)
  *   - PORT (1..65535)
+ *   - FAULT_* (optional network fault injection, see protocol.h)
+ *   - CAPTURE_FILE (optional traffic capture, see capture.h)
+ *   - MAX_CLIENTS, THREAD_STACK_KB, MEM_BUDGET_MB (memory accounting, see metrics.h)
+ *   - MONITOR_TOKEN (secret for C45METRICS and C45PROF, see metrics.h)
+ *   - MAX_OPEN_FILES (RLIMIT_NOFILE target; 0 = raise to the hard limit)
+ *   - KEEPALIVE_INTERVAL_SEC, KEEPALIVE_TIMEOUT_SEC (client ping interval, server liveness timeout)
+ *   - REPLICA_ROLE, REPLICA_SOCKET, REPLICA_BATCH_MS, REPLICA_MAX_LAG_MS (hot standby, see replica.h)
+ *   - TRACE_FILE, TRACE_SAMPLE (optional session lifecycle tracing, see trace.h)
+ *   - PROFILE_HZ, PROFILE_FILE (optional sampling profiler, see profiler.h)
+ *   - BOT_LOBBIES, BOT_TURN_MS, BOT_TOKEN (bot lane)
+ *   - LOBBY_PROFILE, BLITZ_TURN_MS, BLITZ_RECONNECT_MS (per-lobby timing profiles)
+ *   - RESULTS_DIR, RESULTS_ROTATE_MB, RESULTS_ROTATE_SEC (optional game results export, see results.h)
+ *   - HISTORY_FILE (optional game-history archive for C45HIST/C45GAME, see history.h)
  *
  * @param filename Path to config file.
  * @return 0 on success (including "file missing" fallback); -1 on fatal error.
@@ -82,7 +183,8 @@ int  load_config(const char* filename);
 int lobbies_init(void);
 
 /**
- * Free the global lobby array (@p g_lobbies) and associated mutexes.
+ * Stop the bot table workers and free the global lobby array (@p g_lobbies)
+ * and associated mutexes.
  */
 void lobbies_free(void);
 
@@ -100,11 +202,40 @@ int  hand_value(const Card* hand, int n);
 /**
  * Start a game thread if the lobby has enough players and is not already running.
  *
+ * With Lobby.resume set (a game restored by a standby), the thread skips the deal
+ * and continues the game once its players reconnect.
+ *
  * @param lobby_index Zero-based lobby index.
  * @return 0 on success.
  */
 int  start_game_if_ready(int lobby_index);
 
+/**
+ * Copy the game loop counters.
+ *
+ * @param out Output counters.
+ */
+void game_loop_stats_snapshot(GameLoopStats* out);
+
+/**
+ * Copy one lobby's counters.
+ *
+ * @param lobby_index Zero-based lobby index.
+ * @param out         Output counters (zeroed if the index is invalid).
+ */
+void lobby_stats_snapshot(int lobby_index, LobbyStatsView* out);
+
+/**
+ * Format the counters summed over all lobbies as "key=value" pairs for C45METRICS:
+ * games, turns, disconnects, reconnects, game_ms_avg, turn_ms_avg (averages are
+ * weighted by each lobby's games/turns).
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int lobby_stats_format(char* out, size_t cap);
+
 /**
  * Check whether a player name currently exists in any lobby.
  *
@@ -132,6 +263,30 @@ int  lobby_try_add_player(int lobby_index, const char* name);
  */
 int  lobby_attach_fd(int lobby_index, const char* name, int fd);
 
+/**
+ * Mark the lobby list as changed. Call whenever a lobby's player count or
+ * running flag changes, so cached snapshots are rebuilt.
+ */
+void lobby_version_bump(void);
+
+/**
+ * @return Current lobby list version (1..999999999; 0 is never used).
+ */
+unsigned lobby_version(void);
+
+/**
+ * @return Number of public lobbies (listed in C45L/C45LX); bot lobbies follow them.
+ */
+int lobby_public_count(void);
+
+/**
+ * Check a bot session's shared secret against BOT_TOKEN (constant time).
+ *
+ * @param token Token sent by the client.
+ * @return 1 if the bot lane is enabled and the token matches; 0 otherwise.
+ */
+int bot_token_ok(const char* token);
+
 /**
  * Remove a player from any lobby by name (if present).
  *
@@ -0,0 +1,55 @@
+#ifndef GAMEFEED_H
+#define GAMEFEED_H
+
+/*
+ * gamefeed.h
+ *
+ * Purpose:
+ *   One stream of finished games for every consumer of them: the columnar
+ *   results export (results.h) and the game-history archive (history.h).
+ *   The game thread fills a GameResult in place in a lock-free ring (no copy,
+ *   no locks, no syscalls at end_game); a single writer thread hands each game
+ *   to every consumer that is open.
+ *
+ * Order: open the consumers (results_open(), history_open()) before
+ *   gamefeed_open(), and close them after gamefeed_close().
+ *
+ * Table of contents:
+ *   - Lifecycle: gamefeed_open(), gamefeed_close()
+ *   - Recording: gamefeed_claim(), gamefeed_publish()
+ */
+
+#include "results.h"
+
+#include <stddef.h>
+
+/**
+ * Start the writer thread if any consumer is open.
+ *
+ * @return 0 on success or when there is nothing to feed; -1 on error.
+ */
+int  gamefeed_open(void);
+
+/**
+ * Hand the queued games to the consumers and stop the writer thread.
+ */
+void gamefeed_close(void);
+
+/**
+ * Claim the slot of one finished game (game thread).
+ *
+ * Never blocks: if the ring is full, the game is dropped and counted.
+ *
+ * @param ticket Output: ticket for gamefeed_publish().
+ * @return Slot to fill completely, or NULL when the feed is off or full.
+ */
+GameResult* gamefeed_claim(size_t* ticket);
+
+/**
+ * Pass a filled slot to the writer thread.
+ *
+ * @param ticket Ticket returned by gamefeed_claim().
+ */
+void gamefeed_publish(size_t ticket);
+
+#endif /* GAMEFEED_H */
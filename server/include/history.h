@@ -0,0 +1,119 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/*
+ * history.h
+ *
+ * Purpose:
+ *   Optional indexed game-history archive: players ask for their last games
+ *   (C45HIST) and support looks any game up by id (C45GAME) without scanning logs.
+ *
+ *   The game thread queues each finished game (the GameResult of results.h) in
+ *   the game feed (gamefeed.h); its writer thread appends it to a memory-mapped
+ *   archive file and updates two in-memory indexes:
+ *     - per player: name -> the player's latest record; every record links to
+ *       the previous game of each seat's player (HistoryRecord.prev), so the
+ *       last N games of a player are N hops, O(N) for the page;
+ *     - per game: game id -> record.
+ *   The links live in the archive itself, so reopening the file rebuilds both
+ *   indexes with one sequential pass.
+ *
+ * File format (native endianness, append-only):
+ *   - 64-byte header: "BJHIS01\n" | u32 record size | u32 reserved | u64 committed records | padding
+ *   - fixed-size HistoryRecords; the file grows in steps of HISTORY_GROW_RECORDS,
+ *     records past the committed count are not valid yet.
+ *
+ * Table of contents:
+ *   - Configuration: g_history_path
+ *   - Records: HistoryRecord, HistoryEntry
+ *   - Lifecycle: history_open(), history_close(), history_is_open()
+ *   - Game feed consumer: history_append()
+ *   - Queries: history_player_games(), history_find_game()
+ */
+
+#include "results.h"
+
+#include <stdint.h>
+
+#define HISTORY_MAGIC        "BJHIS01\n"
+#define HISTORY_HEADER_BYTES 64
+#define HISTORY_GROW_RECORDS 16384
+#define HISTORY_MAX_PAGE     20     /* games per C45HIST answer */
+
+/* One archived game. */
+typedef struct {
+    uint64_t game_id;
+    uint64_t end_ms;                    /* unix milliseconds */
+    uint32_t duration_ms;
+    uint32_t prev[LOBBY_SIZE];          /* record number + 1 of the seat player's previous game; 0 = none */
+    uint16_t lobby;
+    uint16_t turns;
+    uint8_t  profile;                   /* LobbyProfile */
+    uint8_t  end_reason;                /* GameEndReason */
+    uint8_t  winner;                    /* seat 0/1, 2 = push */
+    uint8_t  reserved;
+    int8_t   value[LOBBY_SIZE];         /* -1 = bust */
+    uint8_t  hand_size[LOBBY_SIZE];
+    uint8_t  hand[LOBBY_SIZE][RESULTS_MAX_CARDS];   /* rank | suit << 4 */
+    char     name[LOBBY_SIZE][MAX_NAME_LEN];
+} HistoryRecord;
+
+/* One game of a player's history, seen from that player. */
+typedef struct {
+    uint64_t game_id;
+    uint64_t end_ms;
+    int8_t   my_value;
+    int8_t   opp_value;
+    char     result;                    /* 'W', 'L' or 'P' (push) */
+    char     opponent[MAX_NAME_LEN];
+} HistoryEntry;
+
+/* --- Configuration (loaded from config.txt) --- */
+extern char g_history_path[256];   /* HISTORY_FILE: archive path; empty disables the archive */
+
+/**
+ * Open (or create) the archive and rebuild the indexes (before gamefeed_open()).
+ *
+ * @param path Archive file path.
+ * @return 0 on success; -1 on error (including a file of another format).
+ */
+int  history_open(const char* path);
+
+/**
+ * Unmap the archive (after gamefeed_close()). Queries afterwards return nothing.
+ */
+void history_close(void);
+
+/**
+ * @return 1 if the archive is open; 0 otherwise.
+ */
+int  history_is_open(void);
+
+/**
+ * Append one finished game to the archive and index it (game feed writer
+ * thread; no-op when the archive is off).
+ *
+ * @param g Finished game.
+ */
+void history_append(const GameResult* g);
+
+/**
+ * Copy a player's latest games, newest first.
+ *
+ * @param name Player name.
+ * @param max  Maximum number of games (at most HISTORY_MAX_PAGE are returned).
+ * @param out  Output array of at least min(@p max, HISTORY_MAX_PAGE) entries.
+ * @return Number of games copied (0 if none or the archive is off).
+ */
+int  history_player_games(const char* name, int max, HistoryEntry* out);
+
+/**
+ * Look a game up by id.
+ *
+ * @param game_id Game id (GameResult.game_id).
+ * @param out     Output record.
+ * @return 0 if found; -1 otherwise.
+ */
+int  history_find_game(uint64_t game_id, HistoryRecord* out);
+
+#endif /* HISTORY_H */
@@ -0,0 +1,205 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * metrics.h
+ *
+ * Purpose:
+ *   Memory accounting for connections and game tables, and the admission
+ *   control built on top of it.
+ *
+ *   Every connection costs one client thread (stack + guard page + thread
+ *   arguments); every running game costs one game thread (stack + guard page).
+ *   The game's turn buffers (TableBuf) are part of each Lobby, so registries
+ *   (sized by MAX_CLIENTS) and the lobby array (LOBBY_COUNT) are fixed costs
+ *   allocated once at startup.
+ *
+ *   Admission reserves a connection's own cost plus its share of a table
+ *   (table / LOBBY_SIZE), so a game can always start for admitted players.
+ *
+ *   File descriptors are the other admission resource: RLIMIT_NOFILE is raised
+ *   at startup (MAX_OPEN_FILES), each connection holds FD_PER_CONN fds (the
+ *   socket and its tracking dup()), and FD_RESERVED fds are kept for the
+ *   listen socket, stdio, log/capture files and the accept loop's reserve fd.
+ *   Fds a connection opens beyond that (the socketpair of each extra table of a
+ *   multi-table session) are charged with fd_admit_extra() against the same
+ *   limit, so they cannot eat the budget of connections already admitted.
+ *
+ * Table of contents:
+ *   - Configuration: g_max_clients, g_thread_stack_kb, g_mem_budget_mb, g_max_open_files
+ *   - Costs: mem_set_costs(), mem_connection_cost(), mem_table_cost(), mem_max_connections()
+ *   - Accounting: mem_admit_connection(), mem_release_connection(), mem_table_start(), mem_table_end()
+ *   - Threads: mem_thread_create(), mem_thread_create_joinable()
+ *   - File descriptors: fd_limit_raise(), fd_limit(), fd_admit_extra(), fd_release_extra(),
+ *     fd_note_accept_error(), fd_note_shed()
+ *   - Reporting: MemStats, mem_stats_snapshot(), mem_stats_format()
+ *   - Monitoring access: g_monitor_token, monitor_token_ok()
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+
+/* --- Configuration (loaded from config.txt) --- */
+extern int g_max_clients;      /* MAX_CLIENTS: connection limit and registry capacity (default 1024) */
+extern int g_thread_stack_kb;  /* THREAD_STACK_KB: stack size of client/game threads (default 128) */
+extern int g_mem_budget_mb;    /* MEM_BUDGET_MB: accounted memory budget, 0 = unlimited */
+extern char g_monitor_token[64]; /* MONITOR_TOKEN: secret required by C45METRICS and C45PROF; empty disables them */
+extern int g_max_open_files;   /* MAX_OPEN_FILES: RLIMIT_NOFILE target, 0 = the hard limit */
+
+#define FD_PER_CONN  2         /* client socket + tracking dup() */
+#define FD_RESERVED  32        /* listen socket, stdio, logs/capture, reserve fd, spare */
+#define FD_PER_MT_SEAT 2       /* socketpair of one multi-table seat */
+
+typedef struct {
+    int    conns;                        /* admitted connections */
+    int    peak_conns;                   /* high-water mark of conns */
+    int    tables;                       /* running games */
+    int    max_conns;                    /* admission limit (MAX_CLIENTS, budget, fd limit) */
+    size_t conn_bytes;                   /* accounted cost of one connection */
+    size_t table_bytes;                  /* accounted cost of one running game */
+    size_t fixed_bytes;                  /* registries + lobby array */
+    unsigned long long accounted_bytes;  /* fixed + conns * conn_bytes + tables * table_bytes */
+    unsigned long long budget_bytes;     /* 0 = unlimited */
+    unsigned long long rejected;         /* connections refused by admission control */
+    unsigned long long rss_bytes;        /* process resident set size (0 if unavailable) */
+    int    fd_limit;                     /* current RLIMIT_NOFILE soft limit */
+    int    fd_open;                      /* open fds (from /proc/self/fd; -1 if unavailable) */
+    unsigned long long accept_errors;    /* failed accept() calls survived with backoff */
+    unsigned long long fd_shed;          /* connections answered C45BUSY for lack of fds */
+    int    extra_fds;                    /* fds charged with fd_admit_extra() */
+} MemStats;
+
+/**
+ * Record the server's allocation sizes (called once at startup).
+ *
+ * @param fixed_bytes    Memory allocated once (registries, lobby array).
+ * @param conn_arg_bytes Per-connection heap bytes (thread arguments, input queue).
+ */
+void mem_set_costs(size_t fixed_bytes, size_t conn_arg_bytes);
+
+/**
+ * Accounted cost of one connection (client thread stack + guard + heap bytes).
+ *
+ * @return Bytes.
+ */
+size_t mem_connection_cost(void);
+
+/**
+ * Accounted cost of one running game (game thread stack + guard + arguments).
+ *
+ * @return Bytes.
+ */
+size_t mem_table_cost(void);
+
+/**
+ * Current admission limit: MAX_CLIENTS, lowered by MEM_BUDGET_MB when set and
+ * by the fd limit ((fd_limit - FD_RESERVED - extra fds) / FD_PER_CONN).
+ *
+ * @return Maximum number of concurrent connections.
+ */
+int mem_max_connections(void);
+
+/**
+ * Try to admit one more connection.
+ *
+ * @return 0 if admitted (call mem_release_connection() when it closes); -1 if over the limit.
+ */
+int mem_admit_connection(void);
+
+/**
+ * Release a connection previously admitted with mem_admit_connection().
+ */
+void mem_release_connection(void);
+
+/**
+ * Account a game thread starting.
+ */
+void mem_table_start(void);
+
+/**
+ * Account a game thread finishing.
+ */
+void mem_table_end(void);
+
+/**
+ * Create a detached worker thread with the accounted stack size (THREAD_STACK_KB).
+ *
+ * @param fn  Thread entry point.
+ * @param arg Thread argument.
+ * @return 0 on success; error number from pthread_create() otherwise.
+ */
+int mem_thread_create(void* (*fn)(void*), void* arg);
+
+/**
+ * Create a joinable worker thread with the accounted stack size (THREAD_STACK_KB).
+ *
+ * @param th  Receives the thread handle (for pthread_join()).
+ * @param fn  Thread entry point.
+ * @param arg Thread argument.
+ * @return 0 on success; error number from pthread_create() otherwise.
+ */
+int mem_thread_create_joinable(pthread_t* th, void* (*fn)(void*), void* arg);
+
+/**
+ * Raise RLIMIT_NOFILE towards MAX_OPEN_FILES (or the hard limit) and remember
+ * the result for admission control. Call once at startup.
+ *
+ * @return Soft limit in effect afterwards.
+ */
+int fd_limit_raise(void);
+
+/**
+ * @return Soft RLIMIT_NOFILE recorded by fd_limit_raise() (0 before it ran).
+ */
+int fd_limit(void);
+
+/**
+ * Charge @p n fds opened by an admitted connection beyond FD_PER_CONN.
+ *
+ * @param n Number of fds.
+ * @return 0 if they fit the fd limit (call fd_release_extra() after closing them); -1 otherwise.
+ */
+int fd_admit_extra(int n);
+
+/**
+ * Release fds charged with fd_admit_extra().
+ *
+ * @param n Number of fds.
+ */
+void fd_release_extra(int n);
+
+/**
+ * Count an accept() failure the server survived (backoff instead of shutdown).
+ */
+void fd_note_accept_error(void);
+
+/**
+ * Count a connection turned away with C45BUSY because fds ran out.
+ */
+void fd_note_shed(void);
+
+/**
+ * Take a snapshot of the memory accounting counters (and current RSS).
+ *
+ * @param out Output snapshot.
+ */
+void mem_stats_snapshot(MemStats* out);
+
+/**
+ * Format a snapshot as space-separated key=value pairs (no newline).
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int mem_stats_format(char* out, size_t cap);
+
+/**
+ * Check the secret of a monitoring request ("C45METRICS <token>") against MONITOR_TOKEN.
+ *
+ * @param token Token sent by the client.
+ * @return 1 if MONITOR_TOKEN is set and the token matches; 0 otherwise.
+ */
+int monitor_token_ok(const char* token);
+
+#endif /* METRICS_H */
@@ -0,0 +1,125 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+/*
+ * mpsc.h
+ *
+ * Purpose:
+ *   Bounded lock-free multi-producer / single-consumer ring of fixed-size slots.
+ *   Used to hand records from network/game threads to background writer threads
+ *   without taking locks on the hot path.
+ *
+ * Usage:
+ *   Producer: p = mpsc_claim(r, &t); if (p) { fill *p; mpsc_publish(r, t); }
+ *   Consumer: while ((p = mpsc_peek(r))) { use *p; mpsc_release(r); }
+ *
+ *   MpscWriter bundles a ring with the background thread that drains it, for
+ *   the file writers (capture, trace, finished games): producers check `on`
+ *   and use the ring directly; the thread hands every record to `consume` and
+ *   sleeps `idle_ns` when a pass found nothing.
+ *
+ * Table of contents:
+ *   - MpscRing
+ *   - Lifecycle: mpsc_init(), mpsc_free()
+ *   - Producer side: mpsc_claim(), mpsc_publish()
+ *   - Consumer side: mpsc_peek(), mpsc_release()
+ *   - Background writer: MpscWriter, mpsc_writer_start(), mpsc_writer_stop()
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef struct {
+    unsigned char* cells;     /* capacity * stride bytes */
+    size_t         stride;    /* slot size including the sequence header */
+    size_t         mask;      /* capacity - 1 */
+    atomic_size_t  head;      /* next ticket handed to producers */
+    size_t         tail;      /* next ticket read by the consumer */
+    atomic_size_t  dropped;   /* claims rejected because the ring was full */
+} MpscRing;
+
+/**
+ * Initialize a ring.
+ *
+ * @param r         Ring to initialize.
+ * @param capacity  Number of slots (rounded up to a power of two).
+ * @param elem_size Payload size of one slot in bytes.
+ * @return 0 on success; -1 on allocation failure.
+ */
+int  mpsc_init(MpscRing* r, size_t capacity, size_t elem_size);
+
+/**
+ * Release ring memory (no producers/consumer may be active).
+ *
+ * @param r Ring.
+ */
+void mpsc_free(MpscRing* r);
+
+/**
+ * Claim a free slot (producer side, lock-free, never blocks).
+ *
+ * @param r          Ring.
+ * @param out_ticket Output: ticket to pass to mpsc_publish().
+ * @return Pointer to the slot payload, or NULL if the ring is full (counted in @p r->dropped).
+ */
+void* mpsc_claim(MpscRing* r, size_t* out_ticket);
+
+/**
+ * Make a claimed slot visible to the consumer.
+ *
+ * @param r      Ring.
+ * @param ticket Ticket returned by mpsc_claim().
+ */
+void mpsc_publish(MpscRing* r, size_t ticket);
+
+/**
+ * Return the oldest published slot (consumer side).
+ *
+ * @param r Ring.
+ * @return Pointer to the slot payload, or NULL if nothing is ready.
+ */
+void* mpsc_peek(MpscRing* r);
+
+/**
+ * Return the slot obtained by mpsc_peek() to the producers.
+ *
+ * @param r Ring.
+ */
+void mpsc_release(MpscRing* r);
+
+/* --- Background writer --- */
+
+/* A ring and the thread that drains it. Set idle_ns, consume and idle before mpsc_writer_start(). */
+typedef struct {
+    MpscRing   ring;
+    atomic_int on;                       /* 1 while running; producers check it before mpsc_claim() */
+    atomic_int stop;
+    pthread_t  thread;
+    long       idle_ns;                  /* sleep after a pass that found the ring empty */
+    void     (*consume)(const void* rec);   /* one record, on the writer thread */
+    void     (*idle)(int drained);       /* after every pass (flush, rotate); NULL = none */
+} MpscWriter;
+
+/**
+ * Initialize the ring and start the writer thread.
+ *
+ * @param w         Writer (idle_ns, consume and idle already set).
+ * @param capacity  Ring slots (rounded up to a power of two).
+ * @param elem_size Record size in bytes.
+ * @return 0 on success; -1 on error (nothing left allocated).
+ */
+int  mpsc_writer_start(MpscWriter* w, size_t capacity, size_t elem_size);
+
+/**
+ * Stop taking records, drain what is queued and join the writer thread.
+ *
+ * The ring is not freed: producers that passed the `on` check may still be
+ * claiming slots (they only ever see a ring that nobody drains).
+ *
+ * @param w Writer.
+ * @return 1 if the writer was running; 0 if it was not started.
+ */
+int  mpsc_writer_stop(MpscWriter* w);
+
+#endif /* MPSC_H */
@@ -0,0 +1,98 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+ * profiler.h
+ *
+ * Purpose:
+ *   Optional always-on sampling profiler for production, where perf cannot be
+ *   attached. Every registered server thread gets a CPU-time timer
+ *   (timer_create(CLOCK_THREAD_CPUTIME_ID) delivering SIGPROF to that thread) at
+ *   PROFILE_HZ; the signal handler walks the frame-pointer chain and counts the
+ *   stack in a fixed lock-free hash table (no locks, no allocations).
+ *
+ *   Idle threads (blocked in poll/read) burn no CPU time and are not sampled, so
+ *   the profile shows where CPU goes. The handler's own time is measured and
+ *   reported as prof_overhead_pct (target: well under 1% at 99 Hz).
+ *
+ * Dump format: collapsed stacks, one line per distinct stack, ready for
+ *   flamegraph.pl / speedscope:  "<thread>;<root frame>;...;<leaf frame> <samples>"
+ *   Functions of the server binary are named from its ELF symbol table (including
+ *   static functions); other code is named via dladdr() or "<module>+0x<offset>".
+ *
+ * Limits:
+ *   - The server is built with -fno-omit-frame-pointer; frames in code built
+ *     without frame pointers (libc) can hide their direct caller.
+ *   - At most PROFILE_MAX_DEPTH frames per stack and PROFILE_SLOTS distinct
+ *     stacks; further distinct stacks are counted in prof_dropped.
+ *
+ * Table of contents:
+ *   - Configuration: g_profile_hz, g_profile_path
+ *   - Threads: ProfileThread, profiler_thread_begin(), profiler_thread_end()
+ *   - Lifecycle: profiler_start(), profiler_stop()
+ *   - Output: profiler_dump(), profiler_stats_format()
+ */
+
+#include <stddef.h>
+
+#define PROFILE_MAX_DEPTH  32
+#define PROFILE_SLOTS      4096   /* distinct stacks (power of two) */
+
+/* Thread roles; the first frame of every collapsed stack. */
+typedef enum {
+    PROFILE_THREAD_MAIN   = 0,   /* accept loop */
+    PROFILE_THREAD_CLIENT = 1,   /* client session */
+    PROFILE_THREAD_GAME   = 2    /* lobby game */
+} ProfileThread;
+
+/* --- Configuration (loaded from config.txt) --- */
+extern int  g_profile_hz;          /* PROFILE_HZ: samples per CPU-second per thread; 0 = off (default) */
+extern char g_profile_path[256];   /* PROFILE_FILE: dump path (default "blackjack.folded") */
+
+/**
+ * Install the SIGPROF handler and start sampling the calling thread
+ * (registered as PROFILE_THREAD_MAIN).
+ *
+ * @param hz Sampling frequency per thread (1..1000).
+ * @return 0 on success; -1 on error (profiling stays off).
+ */
+int profiler_start(int hz);
+
+/**
+ * Stop sampling. The handler stays installed (timers of running threads may
+ * still fire) and ignores further signals; the table is kept for profiler_dump().
+ */
+void profiler_stop(void);
+
+/**
+ * Start sampling the calling thread (no-op when the profiler is off).
+ *
+ * @param role ProfileThread.
+ */
+void profiler_thread_begin(int role);
+
+/**
+ * Stop sampling the calling thread (deletes its timer). Call before the thread exits.
+ */
+void profiler_thread_end(void);
+
+/**
+ * Write the aggregated stacks in collapsed-stack format (to a temporary file
+ * renamed over @p path, so readers never see a partial dump).
+ *
+ * @param path Output path.
+ * @return Number of distinct stacks written; -1 on error or when the profiler never ran.
+ */
+int profiler_dump(const char* path);
+
+/**
+ * Format profiler counters as "key=value" pairs for C45METRICS:
+ * prof_hz, prof_samples, prof_stacks, prof_dropped, prof_overhead_pct.
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int profiler_stats_format(char* out, size_t cap);
+
+#endif /* PROFILER_H */
@@ -7,17 +7,93 @@
  * Purpose:
  *   Shared networking/protocol helpers for the Blackjack server:
  *   - Line-based TCP I/O helpers (read/write whole lines safely).
+ *   - Optional network fault injection applied inside those helpers.
  *
  * Table of contents:
- *   - Constants: READ_BUF
- *   - Line I/O: write_all(), read_line(), read_line_timeout()
- *   - Misc: is_c45_prefix(), send_lobbies_snapshot()
+ *   - Constants: READ_BUF, INPUT_QUEUE_BYTES
+ *   - Syscall accounting: IoStats, io_stats_snapshot(), io_poll(), io_sleep_us()
+ *   - Fault injection: FaultConfig, g_fault, fault_start(), fault_stop(), fault_conn_begin()
+ *   - Line I/O: write_all(), read_line(), read_line_timeout(), read_line_timeout_ms(), peek_line()
+ *   - Input queue: INPUT_QUEUE_BYTES, input_queue_reset(), has_queued_line(), take_keepalive_line()
+ *   - Misc: is_c45_prefix(), send_lobbies_snapshot(), send_lobbies_snapshot_since(), send_lobby_stats()
+ *   - Game history: send_history(), send_game_record()
  */
 
+#include <poll.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 #define READ_BUF 256
 
+/* Per-connection input queue: room for several pipelined lines. */
+#define INPUT_QUEUE_BYTES (READ_BUF * 4)
+
+/* --- Fault injection (loaded from config.txt, disabled by default) --- */
+typedef struct {
+    int enabled;          /* FAULT_ENABLE: 0/1 master switch */
+    int fragment_bytes;   /* FAULT_FRAGMENT_BYTES: max bytes per send() (0 = no fragmentation) */
+    int fragment_gap_ms;  /* FAULT_FRAGMENT_GAP_MS: pause between fragments */
+    int latency_ms;       /* FAULT_LATENCY_MS: delay of every outgoing write (per connection, in order) */
+    int jitter_ms;        /* FAULT_JITTER_MS: extra random delay 0..jitter_ms per write */
+    int drop_permille;    /* FAULT_DROP_PERMILLE: chance per I/O call to drop the connection */
+    int stall_permille;   /* FAULT_STALL_PERMILLE: chance per read to stall the connection's input */
+    int stall_ms;         /* FAULT_STALL_MS: duration of a read stall */
+} FaultConfig;
+
+extern FaultConfig g_fault;
+
+/**
+ * Start the fault sender thread that delivers delayed and fragmented writes
+ * (no-op unless FAULT_ENABLE is set). Callers of write_all() never sleep.
+ *
+ * @return 0 on success or when fault injection is off; -1 on error.
+ */
+int  fault_start(void);
+
+/**
+ * Send every write still queued by fault injection and stop the sender thread.
+ */
+void fault_stop(void);
+
+/**
+ * Reset the fault state of @p fd for a new connection (pending writes of the
+ * previous connection on this fd number are still delivered to it).
+ *
+ * @param fd Socket file descriptor of the new connection.
+ */
+void fault_conn_begin(int fd);
+
+/* --- Syscall accounting (process-wide counters of socket/sleep syscalls) --- */
+typedef struct {
+    unsigned long long recv;   /* recv() calls */
+    unsigned long long send;   /* send() calls */
+    unsigned long long poll;   /* poll() calls */
+    unsigned long long sleep;  /* usleep()/nanosleep() calls */
+} IoStats;
+
+/**
+ * Copy the current I/O syscall counters.
+ *
+ * @param out Output counters.
+ */
+void io_stats_snapshot(IoStats* out);
+
+/**
+ * poll() wrapper that is counted in IoStats.
+ *
+ * @param fds        Poll set.
+ * @param nfds       Number of entries in @p fds.
+ * @param timeout_ms Timeout in milliseconds (-1 = infinite).
+ * @return Same as poll().
+ */
+int  io_poll(struct pollfd* fds, nfds_t nfds, int timeout_ms);
+
+/**
+ * usleep() wrapper that is counted in IoStats.
+ *
+ * @param us Duration in microseconds.
+ */
+void io_sleep_us(unsigned us);
 
 /**
  * Write the full NUL-terminated string to a socket.
@@ -32,8 +108,10 @@ int  write_all(int fd, const char* s);
 /**
  * Read one text line (up to '\n') from a socket.
  *
- * The line is always NUL-terminated. If the input line is longer than the buffer,
- * it is truncated.
+ * Reads go through the connection's input queue: lines the client pipelined
+ * are returned in order without further syscalls. The line is always
+ * NUL-terminated. If the input line is longer than the buffer, it is
+ * returned in buffer-sized pieces.
  *
  * @param fd      Connected socket file descriptor.
  * @param buf     Destination buffer.
@@ -54,17 +132,68 @@ int  read_line(int fd, char* buf, size_t buf_sz);
 int  is_c45_prefix(const char* s);
 
 /**
- * Send the current lobby snapshot to a client.
+ * Send the current lobby snapshot to a client ("C45L <n> <pairs> <version>").
  *
  * @param fd Connected socket file descriptor.
  * @return 0 on success; -1 on error.
  */
 int  send_lobbies_snapshot(int fd);
 
+/**
+ * Conditional refresh: reply "C45LU <version>" if the client already holds the
+ * current lobby version, otherwise send the (cached) snapshot.
+ *
+ * @param fd           Connected socket file descriptor.
+ * @param have_version Client's version from "C45B <version>"; 0 = none.
+ * @return 0 on success; -1 on error.
+ */
+int  send_lobbies_snapshot_since(int fd, unsigned have_version);
+
+/**
+ * Send the opt-in extended lobby listing with per-lobby counters:
+ * "C45LX <n> <entry>...", entry = "<players><status>:<games>:<game_ms>:<turn_ms>:<disconnects>:<reconnects>".
+ * Without @p full (before the handshake) each entry is only "<games>".
+ *
+ * @param fd   Connected socket file descriptor.
+ * @param full 1 for the full entries; 0 for per-lobby game counts only.
+ * @return 0 on success; -1 on error.
+ */
+int  send_lobby_stats(int fd, int full);
+
+/**
+ * Send a player's latest games from the history archive:
+ * "C45HIST <n> <entry>...", entry = "<game_id>:<end_ms>:<W|L|P>:<my_value>:<opp_value>:<opponent>".
+ *
+ * @param fd   Connected socket file descriptor.
+ * @param name Player name.
+ * @param max  Games wanted (1..HISTORY_MAX_PAGE; out of range = 10).
+ * @return 0 on success; -1 on error.
+ */
+int  send_history(int fd, const char* name, int max);
+
+/**
+ * Send one game from the history archive ("C45GAME <id> ..." or "C45GAME <id> NONE").
+ *
+ * @param fd      Connected socket file descriptor.
+ * @param game_id Game id.
+ * @param viewer  Player name: only games they played are sent (others answer NONE);
+ *                NULL = any game (caller checked the monitor token).
+ * @return 0 on success; -1 on error.
+ */
+int  send_game_record(int fd, unsigned long long game_id, const char* viewer);
+
+/**
+ * Parse the optional version of a "C45B [version]" refresh request.
+ *
+ * @param line Received line.
+ * @return Version, or 0 if absent.
+ */
+unsigned lobby_request_version(const char* line);
+
 /**
  * Read one line with an overall timeout.
  *
- * Internally uses poll() to wait for data and then reads byte-by-byte.
+ * Returns a queued line immediately; otherwise uses poll() to wait for data.
  *
  * @param fd           Connected socket file descriptor.
  * @param buf          Destination buffer.
@@ -78,4 +207,68 @@ int  send_lobbies_snapshot(int fd);
  */
 int read_line_timeout(int fd, char* buf, size_t sz, int timeout_sec);
 
+/**
+ * Like read_line_timeout(), but @p timeout_ms bounds the whole call (turn clocks
+ * and reconnect windows that must fire within milliseconds of their deadline).
+ * A partial line stays queued for the next call instead of extending the wait.
+ *
+ * @param fd         Connected socket file descriptor.
+ * @param buf        Destination buffer.
+ * @param sz         Size of @p buf in bytes.
+ * @param timeout_ms Timeout in milliseconds (0 = no wait).
+ *
+ * @return Same as read_line_timeout().
+ */
+int read_line_timeout_ms(int fd, char* buf, size_t sz, int timeout_ms);
+
+/**
+ * Non-blocking look at the next line, leaving it queued.
+ *
+ * Lets a state decide whether a line belongs to it before consuming it:
+ * lines meant for a later state stay queued and are read there, in order.
+ *
+ * @param fd  Connected socket file descriptor.
+ * @param buf Destination buffer.
+ * @param sz  Size of @p buf in bytes.
+ *
+ * @return >0 Length of the line in @p buf.
+ * @return  0 Peer closed the connection.
+ * @return -2 No complete line available yet.
+ * @return -1 Error.
+ */
+int peek_line(int fd, char* buf, size_t sz);
+
+/**
+ * Take a C45PI/C45PO queued behind the head line, which stays queued (e.g. a
+ * pipelined HIT/STAND parked until the player's turn).
+ *
+ * @param fd  Socket file descriptor.
+ * @param buf Destination buffer.
+ * @param sz  Size of @p buf in bytes.
+ *
+ * @return >0 Length of the keep-alive line in @p buf (removed from the queue).
+ * @return  0 Peer closed the connection.
+ * @return -2 None queued.
+ * @return -3 None queued and the queue is full (no point waiting for POLLIN).
+ * @return -1 Error.
+ */
+int take_keepalive_line(int fd, char* buf, size_t sz);
+
+/**
+ * Drop any queued input of @p fd (call when a new connection gets the fd).
+ *
+ * @param fd Socket file descriptor.
+ */
+void input_queue_reset(int fd);
+
+/**
+ * Check whether a complete line is queued for @p fd.
+ *
+ * poll() cannot see queued input; check this before waiting on the socket.
+ *
+ * @param fd Socket file descriptor.
+ * @return 1 if a line is queued; 0 otherwise.
+ */
+int has_queued_line(int fd);
+
 #endif /* PROTOCOL_H */
@@ -0,0 +1,145 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+/*
+ * replica.h
+ *
+ * Purpose:
+ *   Optional hot standby. A primary server streams the state of its running
+ *   tables (seats, hands, deck and its shuffle proof, turn, turn deadline) to a
+ *   standby server over a local (AF_UNIX) socket. When the primary dies, the
+ *   standby binds the game port, restores those tables and lets their players
+ *   resume with C45REC.
+ *
+ *   The game threads only flag a table as changed (replica_mark(): one relaxed
+ *   atomic store). A replication thread wakes every REPLICA_BATCH_MS, copies the
+ *   flagged tables under their mutex and sends them in one write; a standby that
+ *   stays REPLICA_MAX_LAG_MS behind is dropped and resynchronized on reconnect.
+ *
+ * Stream format (native endianness, same binary on both ends):
+ *   - Batches: ReplicaBatch header followed by `count` ReplicaTable images.
+ *   - A new standby first receives every table (running or not).
+ *
+ * Failover:
+ *   - The standby treats EOF as "primary gone" only if the replica socket then
+ *     refuses connections; otherwise it reconnects and resynchronizes.
+ *   - Restored tables keep their hands, deck and turn; players are detached
+ *     (fd -1) and have the lobby's reconnect window (Lobby.reconnect_ms) to come
+ *     back via C45REC. The turn in progress keeps its remaining time in ms,
+ *     bounded by the lobby's turn clock (see REPLICA_MIN_TURN_MS).
+ *   - Lobbies that were only waiting for an opponent are not restored; their
+ *     players fall back to the lobby list.
+ *
+ * Table of contents:
+ *   - Configuration: ReplicaRole, g_replica_role, g_replica_socket, g_replica_batch_ms, g_replica_max_lag_ms
+ *   - Stream records: ReplicaBatch, ReplicaTable
+ *   - Game path: replica_mark()
+ *   - Primary: replica_start(), replica_stop()
+ *   - Standby: replica_follow(), replica_bind_retries()
+ *   - Reporting: replica_stats_format()
+ */
+
+#include "game.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPLICA_MAGIC         0x52353443u   /* "C45R" */
+#define REPLICA_MIN_TURN_MS   10000   /* or half the lobby's turn clock if that is shorter */
+
+typedef enum {
+    REPLICA_OFF     = 0,
+    REPLICA_PRIMARY = 1,
+    REPLICA_STANDBY = 2
+} ReplicaRole;
+
+/* --- Configuration (loaded from config.txt; "-standby" on the CLI) --- */
+extern int  g_replica_role;          /* REPLICA_ROLE: off | primary | standby */
+extern char g_replica_socket[108];   /* REPLICA_SOCKET: AF_UNIX path (default "blackjack.replica") */
+extern int  g_replica_batch_ms;      /* REPLICA_BATCH_MS: batch interval (default 20) */
+extern int  g_replica_max_lag_ms;    /* REPLICA_MAX_LAG_MS: drop a standby this far behind (default 1000) */
+
+/* Batch header. */
+typedef struct {
+    uint32_t magic;     /* REPLICA_MAGIC */
+    uint32_t count;     /* ReplicaTable records that follow */
+    uint64_t seq;       /* batch number since the standby attached */
+    uint64_t sent_ms;   /* primary wall clock (ms) when the batch was built */
+} ReplicaBatch;
+
+/* One seat of a table image. */
+typedef struct {
+    char    name[MAX_NAME_LEN];
+    int32_t hand_size, stood, busted;
+    Card    hand[12];
+} ReplicaSeat;
+
+/* Image of one table, copied under its mutex. */
+typedef struct {
+    int32_t     lobby;           /* zero-based lobby index */
+    int32_t     running;         /* 0 = no game (the standby forgets the table) */
+    int32_t     player_count;
+    int32_t     turn;            /* seat whose turn it is */
+    int32_t     turn_left_ms;    /* time left on the turn clock when copied, -1 = no turn */
+    ShuffleProof proof;          /* commitment and seed of the deck */
+    ReplicaSeat seats[LOBBY_SIZE];
+    Deck        deck;
+} ReplicaTable;
+
+/**
+ * Parse a REPLICA_ROLE value.
+ *
+ * @param s "off", "primary" or "standby".
+ * @return ReplicaRole value; -1 if unknown.
+ */
+int replica_parse_role(const char* s);
+
+/**
+ * Flag a table as changed since the last batch (no-op unless this server is a primary).
+ *
+ * Called by the game thread after every change of seats, hands, deck or turn.
+ *
+ * @param L Lobby.
+ */
+void replica_mark(Lobby* L);
+
+/**
+ * Start the replication thread (primary role): listen on g_replica_socket and
+ * stream table changes to the standby that connects.
+ *
+ * @return 0 on success; -1 on error (replication disabled, the server keeps running).
+ */
+int replica_start(void);
+
+/**
+ * Stop the replication thread and remove the socket file.
+ */
+void replica_stop(void);
+
+/**
+ * Run as a standby: mirror the primary's tables until it dies, then restore the
+ * running games into g_lobbies and switch g_replica_role to REPLICA_PRIMARY.
+ *
+ * Blocks until the takeover (or until the process is interrupted).
+ *
+ * @return 0 when the caller should start serving; -1 on fatal error.
+ */
+int replica_follow(void);
+
+/**
+ * @return How many times run_server() should retry a busy port (nonzero right
+ *         after a takeover, while the dead primary's listen socket is released).
+ */
+int replica_bind_retries(void);
+
+/**
+ * Format replication counters as "key=value" pairs for C45METRICS:
+ * repl_role, repl_standby, repl_batches, repl_tables, repl_bytes, repl_drops, repl_lag_ms.
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int replica_stats_format(char* out, size_t cap);
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+/*
+ * results.h
+ *
+ * Purpose:
+ *   Optional export of finished games for analytics. The game thread hands one
+ *   fixed-size GameResult per game to the game feed (gamefeed.h: no locks, no
+ *   syscalls at end_game); its writer thread groups them into columnar batches
+ *   and appends them to batch files that are rotated by size or age.
+ *
+ * Files: RESULTS_DIR/results-<unix_sec>-<seq>.bjr, written as "<name>.part" and
+ *   renamed when rotated or closed, so readers only ever see complete files.
+ *
+ * File format (native endianness):
+ *   - 8-byte header: "BJRES01\n"
+ *   - Batches:  u32 rows | u32 columns | columns...
+ *   - Column:   u8 id | u8 kind | u16 width | u32 bytes | bytes of data
+ *       kind RESULTS_FIXED: rows values of width bytes each
+ *       kind RESULTS_VAR:   u32 offsets[rows + 1], then the concatenated values
+ *   A reader skips columns it does not know by their byte count.
+ *
+ * Columns (ResultsColumn): game id, end time, lobby, profile, end reason,
+ *   winner, turns, duration, per-seat think time, names, final hands
+ *   (one byte per card: rank | suit << 4) and values (-1 = bust).
+ *
+ * Table of contents:
+ *   - Configuration: g_results_dir, g_results_rotate_mb, g_results_rotate_sec
+ *   - Records: GameEndReason, GameResult
+ *   - Lifecycle: results_open(), results_close(), results_is_open()
+ *   - Game feed consumer: results_add(), results_tick()
+ */
+
+#include "game.h"
+
+#include <stdint.h>
+
+#define RESULTS_MAGIC      "BJRES01\n"
+#define RESULTS_FIXED      0
+#define RESULTS_VAR        1
+#define RESULTS_MAX_CARDS  12
+
+/* Why a game ended. */
+typedef enum {
+    GAME_END_NORMAL    = 0,   /* both players stood or busted */
+    GAME_END_FORFEIT   = 1,   /* a player left the table (C45B) mid-game */
+    GAME_END_VIOLATION = 2,   /* a player sent an invalid line and was kicked */
+    GAME_END_ABANDONED = 3,   /* a dropped player did not come back within the reconnect window */
+    GAME_END_LOST      = 4    /* both players gone (or nobody back after a takeover) */
+} GameEndReason;
+
+/* Column ids of a batch, in file order. */
+typedef enum {
+    RESULTS_COL_GAME_ID = 1,   /* u64 */
+    RESULTS_COL_END_MS,        /* u64 unix milliseconds */
+    RESULTS_COL_LOBBY,         /* u16, 1-based */
+    RESULTS_COL_PROFILE,       /* u8 LobbyProfile */
+    RESULTS_COL_END_REASON,    /* u8 GameEndReason */
+    RESULTS_COL_WINNER,        /* u8 seat 0/1, 2 = push */
+    RESULTS_COL_TURNS,         /* u16 turns offered (C45T) */
+    RESULTS_COL_DURATION_MS,   /* u32 game duration */
+    RESULTS_COL_THINK_MS_1,    /* u32 time seat 0 spent on its turns */
+    RESULTS_COL_THINK_MS_2,    /* u32 same for seat 1 */
+    RESULTS_COL_VALUE_1,       /* i8 final hand value, -1 = bust */
+    RESULTS_COL_VALUE_2,       /* i8 */
+    RESULTS_COL_NAME_1,        /* var: player name */
+    RESULTS_COL_NAME_2,        /* var */
+    RESULTS_COL_HAND_1,        /* var: cards, rank | suit << 4 */
+    RESULTS_COL_HAND_2,        /* var */
+    RESULTS_COL_COUNT = RESULTS_COL_HAND_2
+} ResultsColumn;
+
+/* One finished game (game feed slot). */
+typedef struct {
+    uint64_t game_id;
+    uint64_t end_ms;             /* unix milliseconds */
+    uint32_t duration_ms;
+    uint32_t think_ms[LOBBY_SIZE];
+    uint16_t lobby;
+    uint16_t turns;
+    uint8_t  profile;
+    uint8_t  end_reason;
+    uint8_t  winner;
+    int8_t   value[LOBBY_SIZE];
+    uint8_t  hand_size[LOBBY_SIZE];
+    uint8_t  hand[LOBBY_SIZE][RESULTS_MAX_CARDS];
+    char     name[LOBBY_SIZE][MAX_NAME_LEN];
+} GameResult;
+
+/* --- Configuration (loaded from config.txt) --- */
+extern char g_results_dir[256];     /* RESULTS_DIR: batch file directory; empty disables the export */
+extern int  g_results_rotate_mb;    /* RESULTS_ROTATE_MB: start a new file at this size (default 64) */
+extern int  g_results_rotate_sec;   /* RESULTS_ROTATE_SEC: ... or at this age (default 3600) */
+
+/**
+ * Start exporting into @p dir (before gamefeed_open()).
+ *
+ * @param dir Existing directory for the batch files.
+ * @return 0 on success; -1 on error.
+ */
+int  results_open(const char* dir);
+
+/**
+ * Write the pending batch and close (rename) the current file (after gamefeed_close()).
+ */
+void results_close(void);
+
+/**
+ * @return 1 if the export is open; 0 otherwise.
+ */
+int  results_is_open(void);
+
+/**
+ * Add one finished game to the current batch (game feed writer thread; no-op
+ * when the export is off). A full batch is written at once.
+ *
+ * @param r Result.
+ */
+void results_add(const GameResult* r);
+
+/**
+ * Write a batch that waited RESULTS_FLUSH_MS and close a file that reached
+ * RESULTS_ROTATE_SEC while idle (game feed writer thread, after every pass).
+ */
+void results_tick(void);
+
+#endif /* RESULTS_H */
@@ -0,0 +1,71 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+/*
+ * sha256.h
+ *
+ * Purpose:
+ *   Self-contained SHA-256 (FIPS 180-4) for shuffle commitments; the server
+ *   links no crypto library.
+ *
+ * Table of contents:
+ *   - Streaming: Sha256, sha256_init(), sha256_update(), sha256_final()
+ *   - One shot: sha256()
+ *   - Hex: sha256_hex()
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BYTES 32
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;          /* bytes hashed so far */
+    uint8_t  buf[64];
+    size_t   used;         /* bytes pending in buf */
+} Sha256;
+
+/**
+ * Start a new hash.
+ *
+ * @param c Context.
+ */
+void sha256_init(Sha256* c);
+
+/**
+ * Hash more bytes.
+ *
+ * @param c    Context.
+ * @param data Bytes.
+ * @param n    Number of bytes.
+ */
+void sha256_update(Sha256* c, const void* data, size_t n);
+
+/**
+ * Finish the hash.
+ *
+ * @param c   Context (must be re-initialized before reuse).
+ * @param out Digest.
+ */
+void sha256_final(Sha256* c, uint8_t out[SHA256_BYTES]);
+
+/**
+ * Hash a buffer in one call.
+ *
+ * @param data Bytes.
+ * @param n    Number of bytes.
+ * @param out  Digest.
+ */
+void sha256(const void* data, size_t n, uint8_t out[SHA256_BYTES]);
+
+/**
+ * Lowercase hex encoding of @p n bytes.
+ *
+ * @param in  Bytes.
+ * @param n   Number of bytes.
+ * @param out Output, 2 * n + 1 chars (NUL-terminated).
+ */
+void sha256_hex(const uint8_t* in, size_t n, char* out);
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef SHUFFLE_H
+#define SHUFFLE_H
+
+/*
+ * shuffle.h
+ *
+ * Purpose:
+ *   Provably fair shuffles. Every game's deck is derived from a fresh 32-byte
+ *   server seed; the server commits to it at the deal and reveals the seed in
+ *   the result, so anyone can recompute the deck and check the commitment.
+ *
+ *   Seeds (getrandom), shuffles and SHA-256 commitments are computed in batches
+ *   of SHUFFLE_BATCH by a background thread into a ready queue of
+ *   SHUFFLE_POOL_TICKETS; a game thread only copies a ticket out. When the queue
+ *   is empty (a burst of game starts), the ticket is computed inline.
+ *
+ * Definition (what an auditor recomputes):
+ *   - Stream: block k = SHA-256(seed || k as 4-byte big-endian), k = 0, 1, ...;
+ *     read as consecutive 4-byte big-endian words.
+ *   - Deck: start from deck_init() order; for i = 51 down to 1 swap card i with
+ *     card j = uniform(0..i), drawing words and rejecting w >= 2^32 - (2^32 mod (i+1)),
+ *     then j = w mod (i+1). Cards are dealt from index 0.
+ *   - Commitment: SHA-256(seed || order), order = 52 bytes, card = suit * 13 + rank - 1
+ *     (suits in Suit order).
+ *   - On the wire: "C45D <c1> <c2> <commitment hex>" and
+ *     "C45R <p1> <s1> <p2> <s2> <winner> <seed hex>".
+ *
+ * Table of contents:
+ *   - Tickets: ShuffleTicket, shuffle_make(), shuffle_from_seed(), shuffle_commit()
+ *   - Pool: shuffle_pool_start(), shuffle_pool_stop(), shuffle_take()
+ *   - Audit: shuffle_verify()
+ *   - Benchmarks: shuffle_fixed_seeds(), ShuffleStats, shuffle_stats_snapshot()
+ */
+
+#include "game.h"
+
+#include <stdint.h>
+
+#define SHUFFLE_SEED_BYTES    32
+#define SHUFFLE_POOL_TICKETS  128   /* ready queue capacity */
+#define SHUFFLE_BATCH         32    /* tickets computed per refill */
+
+/* A precomputed shuffle: the deck and its proof. */
+typedef struct {
+    Deck         deck;    /* shuffled, top = 0 */
+    ShuffleProof proof;
+} ShuffleTicket;
+
+/* Counters since startup. */
+typedef struct {
+    unsigned long long made;      /* tickets computed (pool and inline) */
+    unsigned long long taken;     /* tickets handed to games */
+    unsigned long long misses;    /* taken while the queue was empty (computed inline) */
+    unsigned long long refills;   /* batches computed by the background thread */
+    unsigned long long make_ns;   /* total time spent computing tickets */
+    int ready;                    /* tickets queued now */
+} ShuffleStats;
+
+/**
+ * Compute one ticket: fresh seed, deck, commitment.
+ *
+ * @param out Output ticket.
+ */
+void shuffle_make(ShuffleTicket* out);
+
+/**
+ * Derive the deck order from a seed.
+ *
+ * @param seed Seed.
+ * @param out  Output deck (top = 0).
+ */
+void shuffle_from_seed(const uint8_t seed[SHUFFLE_SEED_BYTES], Deck* out);
+
+/**
+ * Commitment of a seed and a deck order.
+ *
+ * @param seed Seed.
+ * @param d    Deck.
+ * @param out  SHA-256 digest.
+ */
+void shuffle_commit(const uint8_t seed[SHUFFLE_SEED_BYTES], const Deck* d, uint8_t out[32]);
+
+/**
+ * Start the background thread that keeps the ready queue filled.
+ *
+ * @return 0 on success; -1 on error (games then compute tickets inline).
+ */
+int shuffle_pool_start(void);
+
+/**
+ * Stop the background thread (queued tickets stay usable).
+ */
+void shuffle_pool_stop(void);
+
+/**
+ * Take the next ticket from the ready queue (or compute one inline if empty).
+ *
+ * @param out Output ticket.
+ */
+void shuffle_take(ShuffleTicket* out);
+
+/**
+ * Check a revealed seed against a commitment.
+ *
+ * @param seed_hex   Seed from C45R (64 hex chars).
+ * @param commit_hex Commitment from C45D (64 hex chars).
+ * @param out        Optional output: the deck derived from the seed.
+ * @return 1 if the commitment matches; 0 if not; -1 if an argument is malformed.
+ */
+int shuffle_verify(const char* seed_hex, const char* commit_hex, Deck* out);
+
+/**
+ * Benchmarks only: derive seeds as SHA-256(base || n) instead of getrandom(),
+ * making every game's deck reproducible. Call before shuffle_pool_start().
+ *
+ * @param base Seed base.
+ */
+void shuffle_fixed_seeds(unsigned long long base);
+
+/**
+ * Copy the counters.
+ *
+ * @param out Output counters.
+ */
+void shuffle_stats_snapshot(ShuffleStats* out);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * trace.h
+ *
+ * Purpose:
+ *   Optional session lifecycle tracing. For a sample of connections, the server
+ *   records monotonic timestamps from TCP accept to the first C45D and through
+ *   every turn, and exports the phases as spans in Chrome trace JSON (load the
+ *   file in chrome://tracing or Perfetto; one track per session).
+ *
+ *   Hooks only push small fixed-size events into a lock-free ring (no locks, no
+ *   syscalls besides clock_gettime); a background thread pairs them into spans
+ *   and writes the file. Unsampled sessions cost one relaxed load per hook.
+ *
+ * Spans (name, from -> to):
+ *   - handshake:          accept -> handshake OK (name accepted)
+ *   - lobby_list:         handshake OK -> lobby snapshot sent
+ *   - lobby_select:       previous step -> join OK (C45OK after C45J, or C45JOK)
+ *   - wait_opponent:      join OK -> game start
+ *   - deal:               game start -> C45D written
+ *   - time_to_first_card: accept -> first C45D (the session SLO), once per session
+ *   - turn:               C45T sent to the player -> HIT / STAND / timeout (args.action)
+ *   - session:            accept -> disconnect (args: games, turns)
+ *
+ * File format: a JSON array of trace events ("ph":"X" complete events, "ts" and
+ *   "dur" in microseconds since trace start, "pid" 1, "tid" = session id) plus a
+ *   "thread_name" metadata event per session carrying the player name.
+ *
+ * Table of contents:
+ *   - Configuration: g_trace_path, g_trace_sample
+ *   - Events: TraceKind
+ *   - Lifecycle: trace_open(), trace_close()
+ *   - Recording: trace_session_begin(), trace_event(), trace_session_end()
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_LABEL_LEN  32
+
+/* Lifecycle points recorded per session. */
+typedef enum {
+    TRACE_ACCEPT        = 0,
+    TRACE_HANDSHAKE_OK  = 1,   /* label: player name */
+    TRACE_SNAPSHOT_SENT = 2,
+    TRACE_JOIN_OK       = 3,   /* arg: lobby number */
+    TRACE_GAME_START    = 4,   /* arg: lobby number */
+    TRACE_DEAL          = 5,
+    TRACE_TURN_REQUEST  = 6,
+    TRACE_TURN_RESPONSE = 7,   /* arg: 'H' (hit), 'S' (stand) or 'T' (timeout) */
+    TRACE_END           = 8
+} TraceKind;
+
+/* --- Configuration (loaded from config.txt) --- */
+extern char g_trace_path[256];   /* TRACE_FILE: output path; empty disables tracing */
+extern int  g_trace_sample;      /* TRACE_SAMPLE: trace every Nth accepted connection (default 1) */
+
+/**
+ * Start tracing into @p path (truncates the file) and spawn the writer thread.
+ *
+ * @param path Output file path.
+ * @return 0 on success; -1 on error.
+ */
+int  trace_open(const char* path);
+
+/**
+ * Write pending spans, stop the writer thread, terminate the JSON array and
+ * print a per-phase summary (count, average, maximum).
+ */
+void trace_close(void);
+
+/**
+ * Start a session for a freshly accepted socket (records TRACE_ACCEPT) if the
+ * connection is sampled.
+ *
+ * @param fd Connected socket file descriptor.
+ */
+void trace_session_begin(int fd);
+
+/**
+ * Record a lifecycle point of the session on @p fd (no-op when the session is
+ * not traced). Never blocks: if the ring buffer is full, the event is dropped.
+ *
+ * @param fd    Socket of the session.
+ * @param kind  TraceKind.
+ * @param arg   Kind-specific argument.
+ * @param label Optional text (NULL for none), truncated to TRACE_LABEL_LEN - 1.
+ */
+void trace_event(int fd, int kind, int arg, const char* label);
+
+/**
+ * End the session on @p fd (records TRACE_END); its session span is written.
+ *
+ * @param fd Socket file descriptor.
+ */
+void trace_session_end(int fd);
+
+#endif /* TRACE_H */
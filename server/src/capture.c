@@ -0,0 +1,190 @@
+/*
+ * capture.c
+ *
+ * Purpose:
+ *   Protocol traffic capture for trace-driven replay (see capture.h for the file format).
+ *
+ * Responsibilities:
+ *   - Map sockets to capture session ids.
+ *   - Enqueue timestamped lines from I/O threads into an MPSC ring (no locks, no syscalls).
+ *   - Drain the ring from a background writer thread into a buffered binary file.
+ *
+ * Table of contents:
+ *   - Session ids: capture_session_begin(), session_of()
+ *   - Recording: capture_line()
+ *   - Writer thread: write_record(), capture_idle()
+ *   - Lifecycle: capture_open(), capture_close()
+ */
+
+#define _GNU_SOURCE
+#include "capture.h"
+#include "mpsc.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CAPTURE_RING_SLOTS  8192
+#define CAPTURE_MAX_FD      65536
+#define CAPTURE_IDLE_NS     2000000L   /* writer sleep when the ring is empty (2 ms) */
+
+typedef struct {
+    uint64_t ts_ns;
+    uint32_t session;
+    uint8_t  dir;
+    uint8_t  flags;
+    uint16_t len;
+    char     data[CAPTURE_LINE_MAX];
+} CaptureRecord;
+
+static void write_record(const void* rec);
+static void capture_idle(int drained);
+
+char g_capture_path[256] = "";
+
+static MpscWriter       g_writer = { .idle_ns = CAPTURE_IDLE_NS, .consume = write_record, .idle = capture_idle };
+static FILE*            g_out = NULL;
+static struct timespec  g_t0;
+static _Atomic uint32_t g_session_by_fd[CAPTURE_MAX_FD];
+static atomic_uint      g_session_seq = 0;
+static atomic_size_t    g_truncated = 0;
+
+/**
+ * Monotonic nanoseconds since capture start.
+ */
+static uint64_t capture_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - g_t0.tv_sec) * 1000000000ull +
+           (uint64_t)(ts.tv_nsec - g_t0.tv_nsec);
+}
+
+/* --- Session ids --- */
+
+/**
+ * Assign a new capture session id to a freshly accepted socket.
+ *
+ * @param fd Connected socket file descriptor.
+ */
+void capture_session_begin(int fd) {
+    if (!atomic_load_explicit(&g_writer.on, memory_order_relaxed)) return;
+    if (fd < 0 || fd >= CAPTURE_MAX_FD) return;
+    uint32_t id = atomic_fetch_add_explicit(&g_session_seq, 1, memory_order_relaxed) + 1;
+    atomic_store_explicit(&g_session_by_fd[fd], id, memory_order_relaxed);
+}
+
+/**
+ * Look up the session id for a socket.
+ *
+ * Sockets outside the table are tagged with their fd and the high bit set.
+ */
+static uint32_t session_of(int fd) {
+    if (fd < 0 || fd >= CAPTURE_MAX_FD) return 0x80000000u | (uint32_t)fd;
+    return atomic_load_explicit(&g_session_by_fd[fd], memory_order_relaxed);
+}
+
+/* --- Recording --- */
+
+/**
+ * Record one protocol line (no-op when capture is disabled).
+ *
+ * @param fd   Socket the line was read from / written to.
+ * @param dir  CAPTURE_IN or CAPTURE_OUT.
+ * @param data Line bytes.
+ * @param len  Number of bytes in @p data.
+ */
+void capture_line(int fd, int dir, const char* data, size_t len) {
+    if (!atomic_load_explicit(&g_writer.on, memory_order_relaxed)) return;
+    uint8_t flags = 0;
+    if (len > CAPTURE_LINE_MAX) {
+        len = CAPTURE_LINE_MAX;
+        flags = CAPTURE_TRUNCATED;
+    }
+
+    size_t ticket;
+    CaptureRecord* rec = (CaptureRecord*)mpsc_claim(&g_writer.ring, &ticket);
+    if (!rec) return; // ring full: dropped (counted by the ring)
+    if (flags) atomic_fetch_add_explicit(&g_truncated, 1, memory_order_relaxed);
+
+    rec->ts_ns = capture_now_ns();
+    rec->session = session_of(fd);
+    rec->dir = (uint8_t)dir;
+    rec->flags = flags;
+    rec->len = (uint16_t)len;
+    memcpy(rec->data, data, len);
+    mpsc_publish(&g_writer.ring, ticket);
+}
+
+/* --- Writer thread --- */
+
+/**
+ * Serialize one record into the capture file.
+ *
+ * @param r CaptureRecord.
+ */
+static void write_record(const void* r) {
+    const CaptureRecord* rec = (const CaptureRecord*)r;
+    fwrite(&rec->ts_ns, sizeof(rec->ts_ns), 1, g_out);
+    fwrite(&rec->session, sizeof(rec->session), 1, g_out);
+    fwrite(&rec->dir, sizeof(rec->dir), 1, g_out);
+    fwrite(&rec->flags, sizeof(rec->flags), 1, g_out);
+    fwrite(&rec->len, sizeof(rec->len), 1, g_out);
+    fwrite(rec->data, 1, rec->len, g_out);
+}
+
+/**
+ * Flush the file once the ring ran empty.
+ *
+ * @param drained Nonzero if the pass wrote records.
+ */
+static void capture_idle(int drained) {
+    if (!drained) fflush(g_out);
+}
+
+/* --- Lifecycle --- */
+
+/**
+ * Start capturing into @p path and spawn the writer thread.
+ *
+ * @param path Output file path.
+ * @return 0 on success; -1 on error.
+ */
+int capture_open(const char* path) {
+    if (!path || !*path) return -1;
+    g_out = fopen(path, "wb");
+    if (!g_out) {
+        perror("capture");
+        return -1;
+    }
+    setvbuf(g_out, NULL, _IOFBF, 1 << 16);
+    fwrite(CAPTURE_MAGIC, 1, 8, g_out);
+
+    clock_gettime(CLOCK_MONOTONIC, &g_t0);
+    if (mpsc_writer_start(&g_writer, CAPTURE_RING_SLOTS, sizeof(CaptureRecord)) != 0) {
+        fclose(g_out);
+        g_out = NULL;
+        return -1;
+    }
+    printf("[CAPTURE] Recording protocol traffic to %s\n", path);
+    return 0;
+}
+
+/**
+ * Flush pending records, stop the writer thread and close the file.
+ *
+ * The ring itself is not freed: detached client threads may still be inside
+ * capture_line() while the server shuts down.
+ */
+void capture_close(void) {
+    if (!mpsc_writer_stop(&g_writer)) return;
+    fclose(g_out);
+    g_out = NULL;
+
+    size_t dropped = atomic_load(&g_writer.ring.dropped);
+    if (dropped) printf("[CAPTURE] %zu records dropped (ring full)\n", dropped);
+    size_t truncated = atomic_load(&g_truncated);
+    if (truncated) printf("[CAPTURE] %zu records truncated to %d bytes; replay will refuse this capture\n",
+                          truncated, CAPTURE_LINE_MAX);
+}
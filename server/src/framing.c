@@ -0,0 +1,354 @@
+/*
+ * framing.c
+ *
+ * Purpose:
+ *   Newline and token scanning for the line protocol, with SSE2/AVX2 paths and
+ *   a scalar reference.
+ *
+ *   Each vector block is compared against the interesting bytes and reduced to
+ *   bit masks with movemask; positions then come from count-trailing-zeros.
+ *   A partial last block is copied into a zeroed scratch block so loads never
+ *   read past the caller's buffer, and its mask is cut to the valid bytes.
+ *
+ * Table of contents:
+ *   - Levels: frame_level(), frame_set_level(), frame_level_name()
+ *   - Scalar reference: frame_newlines_scalar(), frame_line_scalar()
+ *   - Mask folding: LineScan, line_fold(), line_finish()
+ *   - SSE2: newlines_sse2(), line_sse2()
+ *   - AVX2: newlines_avx2(), line_avx2()
+ *   - Dispatch: frame_newlines(), frame_line()
+ */
+
+#include "framing.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FRAME_X86 1
+#include <immintrin.h>
+#else
+#define FRAME_X86 0
+#endif
+
+/* --- Levels --- */
+
+static atomic_int g_frame_level = -1;   /* -1: not chosen yet */
+
+/**
+ * Best level supported by this build and CPU.
+ */
+static FrameLevel frame_best_level(void) {
+#if FRAME_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return FRAME_AVX2;
+    return FRAME_SSE2;
+#else
+    return FRAME_SCALAR;
+#endif
+}
+
+/**
+ * @return Level currently in use (the best one the CPU supports unless overridden).
+ */
+FrameLevel frame_level(void) {
+    int l = atomic_load_explicit(&g_frame_level, memory_order_relaxed);
+    if (l < 0) {
+        // Racing first callers compute the same value.
+        l = (int)frame_best_level();
+        atomic_store_explicit(&g_frame_level, l, memory_order_relaxed);
+    }
+    return (FrameLevel)l;
+}
+
+/**
+ * Force an implementation (benchmarks and the equivalence fuzzer).
+ *
+ * @param level Level to use.
+ * @return 0 on success; -1 if the CPU/build does not support @p level.
+ */
+int frame_set_level(FrameLevel level) {
+    if (level < FRAME_SCALAR || level > frame_best_level()) return -1;
+    atomic_store_explicit(&g_frame_level, (int)level, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @param level Level.
+ * @return "scalar", "sse2" or "avx2".
+ */
+const char* frame_level_name(FrameLevel level) {
+    switch (level) {
+        case FRAME_SSE2: return "sse2";
+        case FRAME_AVX2: return "avx2";
+        default:         return "scalar";
+    }
+}
+
+/* --- Scalar reference --- */
+
+/** ' ' or '\t' (skipped before the token). */
+static int is_blank(char c) { return c == ' ' || c == '\t'; }
+
+/** Bytes trimmed after the token. */
+static int is_trim(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+/** C locale isspace(). */
+static int is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+/**
+ * Scalar reference for frame_newlines().
+ *
+ * @param p   Bytes to scan.
+ * @param n   Number of bytes.
+ * @param pos Output: offsets of the newlines, ascending.
+ * @param max Capacity of @p pos.
+ * @return Number of positions stored.
+ */
+size_t frame_newlines_scalar(const char* p, size_t n, uint32_t* pos, size_t max) {
+    size_t k = 0;
+    for (size_t i = 0; i < n && k < max; ++i) {
+        if (p[i] == '\n') pos[k++] = (uint32_t)i;
+    }
+    return k;
+}
+
+/**
+ * Scalar reference for frame_line().
+ *
+ * @param p   Line bytes.
+ * @param n   Line length.
+ * @param out Output description.
+ */
+void frame_line_scalar(const char* p, size_t n, FrameLine* out) {
+    out->c45 = n >= 3 && p[0] == 'C' && p[1] == '4' && p[2] == '5';
+    size_t b = n < 3 ? n : 3;
+    while (b < n && is_blank(p[b])) b++;
+    size_t e = n;
+    while (e > b && is_trim(p[e - 1])) e--;
+    size_t s = b;
+    while (s < e && !is_space(p[s])) s++;
+    out->tok_begin = b;
+    out->tok_end = e;
+    out->first_space = s;
+}
+
+/* --- Mask folding --- */
+
+#define FRAME_NONE ((size_t)-1)
+
+/*
+ * Running state of a vector frame_line() pass. Blocks arrive in order, so the
+ * token start is known before any later block is folded.
+ */
+typedef struct {
+    size_t begin;      /* first non-blank at/after byte 3 */
+    size_t keep_end;   /* one past the last non-trim byte at/after byte 3 */
+    size_t space;      /* first whitespace at/after begin */
+} LineScan;
+
+/**
+ * Fold the masks of one block (bit i = byte base + i) into the scan state.
+ *
+ * @param s     Scan state.
+ * @param base  Offset of the block in the line.
+ * @param valid Bits that are inside the line.
+ * @param ws    Whitespace bytes.
+ * @param blank ' '/'\t' bytes.
+ * @param trim  ' '/'\t'/'\r'/'\n' bytes.
+ */
+static inline void line_fold(LineScan* s, size_t base, uint32_t valid,
+                             uint32_t ws, uint32_t blank, uint32_t trim) {
+    // "C45" is never part of the token (blocks are at least 16 bytes wide).
+    if (base == 0) valid &= ~(uint32_t)7u;
+    if (s->begin == FRAME_NONE) {
+        uint32_t m = ~blank & valid;
+        if (m) s->begin = base + (size_t)__builtin_ctz(m);
+    }
+    if (s->begin != FRAME_NONE && s->space == FRAME_NONE) {
+        uint32_t m = ws & valid;
+        if (s->begin > base) m &= ~(uint32_t)0 << (s->begin - base);
+        if (m) s->space = base + (size_t)__builtin_ctz(m);
+    }
+    uint32_t keep = ~trim & valid;
+    if (keep) s->keep_end = base + 32u - (size_t)__builtin_clz(keep);
+}
+
+/**
+ * Turn the scan state into a FrameLine (n >= 3).
+ */
+static inline void line_finish(const LineScan* s, const char* p, size_t n, FrameLine* out) {
+    out->c45 = p[0] == 'C' && p[1] == '4' && p[2] == '5';
+    size_t b = s->begin == FRAME_NONE ? n : s->begin;
+    // A non-trim byte is also non-blank, so keep_end > begin whenever it is set.
+    size_t e = s->keep_end == FRAME_NONE ? b : s->keep_end;
+    size_t sp = (s->space == FRAME_NONE || s->space > e) ? e : s->space;
+    out->tok_begin = b;
+    out->tok_end = e;
+    out->first_space = sp;
+}
+
+#if FRAME_X86
+
+/* --- SSE2 --- */
+
+/**
+ * SSE2 frame_newlines().
+ */
+static size_t newlines_sse2(const char* p, size_t n, uint32_t* pos, size_t max) {
+    const __m128i lf = _mm_set1_epi8('\n');
+    size_t k = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(const void*)(p + i));
+        uint32_t m = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+        for (; m; m &= m - 1) {
+            if (k == max) return k;
+            pos[k++] = (uint32_t)(i + (size_t)__builtin_ctz(m));
+        }
+    }
+    for (; i < n && k < max; ++i) {
+        if (p[i] == '\n') pos[k++] = (uint32_t)i;
+    }
+    return k;
+}
+
+/**
+ * SSE2 frame_line() (n >= 3).
+ */
+static void line_sse2(const char* p, size_t n, FrameLine* out) {
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i c4 = _mm_set1_epi8(4);
+    LineScan s = { FRAME_NONE, FRAME_NONE, FRAME_NONE };
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i v;
+        uint32_t valid = 0xFFFFu;
+        if (i + 16 <= n) {
+            v = _mm_loadu_si128((const __m128i*)(const void*)(p + i));
+        } else {
+            char tail[16] = {0};
+            memcpy(tail, p + i, n - i);
+            v = _mm_loadu_si128((const __m128i*)(const void*)tail);
+            valid = (1u << (n - i)) - 1u;
+        }
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab));
+        __m128i trim = _mm_or_si128(blank, _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        // '\t'..'\r' is (unsigned)(c - '\t') <= 4.
+        __m128i x = _mm_sub_epi8(v, tab);
+        __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(x, c4), x);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, sp), ctl);
+        line_fold(&s, i, valid,
+                  (uint32_t)_mm_movemask_epi8(ws),
+                  (uint32_t)_mm_movemask_epi8(blank),
+                  (uint32_t)_mm_movemask_epi8(trim));
+    }
+    line_finish(&s, p, n, out);
+}
+
+/* --- AVX2 --- */
+
+/**
+ * AVX2 frame_newlines().
+ */
+__attribute__((target("avx2")))
+static size_t newlines_avx2(const char* p, size_t n, uint32_t* pos, size_t max) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    size_t k = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(const void*)(p + i));
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf));
+        for (; m; m &= m - 1) {
+            if (k == max) return k;
+            pos[k++] = (uint32_t)(i + (size_t)__builtin_ctz(m));
+        }
+    }
+    // Finish the last partial block 16 bytes at a time.
+    if (k < max && i < n) {
+        size_t t = newlines_sse2(p + i, n - i, pos + k, max - k);
+        for (size_t j = k; j < k + t; ++j) pos[j] += (uint32_t)i;
+        k += t;
+    }
+    return k;
+}
+
+/**
+ * AVX2 frame_line() (n >= 3).
+ */
+__attribute__((target("avx2")))
+static void line_avx2(const char* p, size_t n, FrameLine* out) {
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i c4 = _mm256_set1_epi8(4);
+    LineScan s = { FRAME_NONE, FRAME_NONE, FRAME_NONE };
+    for (size_t i = 0; i < n; i += 32) {
+        __m256i v;
+        uint32_t valid = 0xFFFFFFFFu;
+        if (i + 32 <= n) {
+            v = _mm256_loadu_si256((const __m256i*)(const void*)(p + i));
+        } else {
+            char tail[32] = {0};
+            memcpy(tail, p + i, n - i);
+            v = _mm256_loadu_si256((const __m256i*)(const void*)tail);
+            valid = (1u << (n - i)) - 1u;
+        }
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab));
+        __m256i trim = _mm256_or_si256(blank, _mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+                                                              _mm256_cmpeq_epi8(v, lf)));
+        __m256i x = _mm256_sub_epi8(v, tab);
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(x, c4), x);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), ctl);
+        line_fold(&s, i, valid,
+                  (uint32_t)_mm256_movemask_epi8(ws),
+                  (uint32_t)_mm256_movemask_epi8(blank),
+                  (uint32_t)_mm256_movemask_epi8(trim));
+    }
+    line_finish(&s, p, n, out);
+}
+
+#endif /* FRAME_X86 */
+
+/* --- Dispatch --- */
+
+/**
+ * Find the positions of '\n' bytes in a buffer.
+ *
+ * @param p   Bytes to scan.
+ * @param n   Number of bytes.
+ * @param pos Output: offsets of the newlines, ascending.
+ * @param max Capacity of @p pos; scanning stops once it is full.
+ * @return Number of positions stored.
+ */
+size_t frame_newlines(const char* p, size_t n, uint32_t* pos, size_t max) {
+#if FRAME_X86
+    switch (frame_level()) {
+        case FRAME_AVX2: return newlines_avx2(p, n, pos, max);
+        case FRAME_SSE2: return newlines_sse2(p, n, pos, max);
+        default: break;
+    }
+#endif
+    return frame_newlines_scalar(p, n, pos, max);
+}
+
+/**
+ * Describe one line (prefix, token bounds, whitespace inside the token).
+ *
+ * @param p   Line bytes (may include the trailing "\r\n").
+ * @param n   Line length.
+ * @param out Output description.
+ */
+void frame_line(const char* p, size_t n, FrameLine* out) {
+#if FRAME_X86
+    if (n >= 3) {
+        switch (frame_level()) {
+            case FRAME_AVX2: line_avx2(p, n, out); return;
+            case FRAME_SSE2: line_sse2(p, n, out); return;
+            default: break;
+        }
+    }
+#endif
+    frame_line_scalar(p, n, out);
+}
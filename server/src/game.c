@@ -7,19 +7,45 @@
  * Responsibilities:
  *   - Load configuration (lobby count, bind IP/port).
  *   - Manage lobby lifecycle (add/remove players, attach fds, start game threads).
- *   - Run the actual Blackjack match between two players in a lobby thread.
+ *   - Run the actual Blackjack match between two players in a lobby thread, using
+ *     the lobby's preallocated TableBuf (no allocations or name copies per turn).
+ *   - Deal from a precomputed, committed shuffle (shuffle_take()): the commitment
+ *     goes out with C45D, the seed with C45R.
  *   - Handle disconnects and reconnects during a running game.
+ *   - Run each table on its own timing profile (LobbyProfile): a turn clock and a
+ *     reconnect window in milliseconds. Blitz lobbies use BLITZ_TURN_MS and
+ *     BLITZ_RECONNECT_MS; bot lobbies use BOT_TURN_MS and skip keep-alive and
+ *     reconnect waits, and run their games on one persistent worker thread per table.
+ *   - Publish table changes to a standby (replica_mark()) and continue games
+ *     restored by a standby after a takeover.
+ *   - Mark game start, deal and each turn for session tracing (trace_event()).
+ *   - Hand every finished game to the game feed (gamefeed_claim()), which serves
+ *     the results export and the game-history archive.
  *
  * Table of contents:
- *   - Configuration: load_config()
+ *   - Configuration: load_config(), parse_lobby_profile()
  *   - Lobby lifecycle: lobbies_init(), lobbies_free(), lobby_try_add_player(), lobby_remove_player_by_name(), lobby_attach_fd()
+ *   - Bot lane: lobby_public_count(), bot_token_ok()
  *   - Game helpers: hand_value(), card_to_str(), deck_*()
- *   - Game thread: lobby_game_thread() and reconnect helpers
+ *   - Game thread: run_game(), lobby_game_thread(), bot_table_worker() and reconnect helpers,
+ *     wait_for_resume(), resume_turn_ms(), record_result()
+ *   - Game loop counters: game_loop_stats_snapshot(), table_take_names()
+ *   - Per-lobby counters: mono_ms(), stats_ewma(), lobby_note_turn(), lobby_stats_snapshot(), lobby_stats_format()
  */
 
 #include "game.h"
+#include "capture.h"
+#include "gamefeed.h"
+#include "history.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "protocol.h"
+#include "replica.h"
+#include "results.h"
+#include "shuffle.h"
 #include "server.h"
+#include "trace.h"
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,13 +57,121 @@
 
 #define TURN_TIMEOUT_SEC       60
 #define RECONNECT_TIMEOUT_SEC  60
-#define PING_INTERVAL_SEC      10
-#define PONG_TIMEOUT_SEC       15
 
 Lobby* g_lobbies = NULL;
+static atomic_uint g_lobby_version = 1;
+int    g_keepalive_interval_sec = 10;
+int    g_keepalive_timeout_sec = 15;
 int    g_lobby_count = 5; // default value
+int    g_bot_lobbies = 0;
+int    g_bot_turn_ms = 250;
+char   g_bot_token[64] = "";
+int    g_blitz_turn_ms = 4000;
+int    g_blitz_reconnect_ms = 10000;
+static unsigned char g_public_profile[LOBBY_COUNT_MAX];   // LOBBY_PROFILE per public lobby
 atomic_int g_server_running = 1;
 static void* lobby_game_thread(void* arg);
+static void* bot_table_worker(void* arg);
+
+static atomic_ullong g_games_started = 0;
+static atomic_ullong g_game_seq = 0;   // game ids (results.h); seeded with the start time in lobbies_init()
+static atomic_ullong g_name_copies = 0;
+
+/**
+ * Copy the game loop counters.
+ *
+ * @param out Output counters.
+ */
+void game_loop_stats_snapshot(GameLoopStats* out) {
+    out->games       = atomic_load_explicit(&g_games_started, memory_order_relaxed);
+    out->name_copies = atomic_load_explicit(&g_name_copies, memory_order_relaxed);
+}
+
+/* --- Per-lobby counters --- */
+
+/**
+ * Monotonic time in milliseconds.
+ */
+static unsigned long long mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000ull;
+}
+
+/**
+ * Fold one sample into an exponentially weighted average (weight 1/8).
+ *
+ * Only the lobby's game thread writes, so load + store is enough.
+ *
+ * @param avg   Average to update.
+ * @param first 1 if this is the first sample (the average starts at it).
+ * @param ms    Sample in milliseconds.
+ */
+static void stats_ewma(atomic_uint* avg, int first, unsigned long long ms) {
+    unsigned v = ms > UINT_MAX ? UINT_MAX : (unsigned)ms;
+    unsigned old = atomic_load_explicit(avg, memory_order_relaxed);
+    unsigned next = first ? v : (unsigned)(((unsigned long long)old * 7u + v) / 8u);
+    atomic_store_explicit(avg, next, memory_order_relaxed);
+}
+
+/**
+ * Record a turn answered with HIT/STAND.
+ *
+ * @param L            Lobby.
+ * @param turn_sent_ms mono_ms() when C45T was sent.
+ */
+static void lobby_note_turn(Lobby* L, unsigned long long turn_sent_ms) {
+    LobbyStats* s = &L->stats;
+    int first = atomic_load_explicit(&s->turns, memory_order_relaxed) == 0;
+    stats_ewma(&s->turn_ms_avg, first, mono_ms() - turn_sent_ms);
+    atomic_fetch_add_explicit(&s->turns, 1, memory_order_relaxed);
+}
+
+/**
+ * Copy one lobby's counters.
+ *
+ * @param lobby_index Zero-based lobby index.
+ * @param out         Output counters (zeroed if the index is invalid).
+ */
+void lobby_stats_snapshot(int lobby_index, LobbyStatsView* out) {
+    memset(out, 0, sizeof(*out));
+    if (lobby_index < 0 || lobby_index >= g_lobby_count) return;
+    LobbyStats* s = &g_lobbies[lobby_index].stats;
+    out->games       = atomic_load_explicit(&s->games, memory_order_relaxed);
+    out->turns       = atomic_load_explicit(&s->turns, memory_order_relaxed);
+    out->disconnects = atomic_load_explicit(&s->disconnects, memory_order_relaxed);
+    out->reconnects  = atomic_load_explicit(&s->reconnects, memory_order_relaxed);
+    out->game_ms_avg = atomic_load_explicit(&s->game_ms_avg, memory_order_relaxed);
+    out->turn_ms_avg = atomic_load_explicit(&s->turn_ms_avg, memory_order_relaxed);
+}
+
+/**
+ * Format the counters summed over all lobbies as "key=value" pairs for C45METRICS.
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int lobby_stats_format(char* out, size_t cap) {
+    LobbyStatsView sum = {0};
+    unsigned long long game_ms = 0, turn_ms = 0;
+    for (int i = 0; i < g_lobby_count; ++i) {
+        LobbyStatsView v;
+        lobby_stats_snapshot(i, &v);
+        sum.games += v.games;
+        sum.turns += v.turns;
+        sum.disconnects += v.disconnects;
+        sum.reconnects += v.reconnects;
+        game_ms += v.games * v.game_ms_avg;
+        turn_ms += v.turns * v.turn_ms_avg;
+    }
+    return snprintf(out, cap,
+                    "games=%llu turns=%llu disconnects=%llu reconnects=%llu "
+                    "game_ms_avg=%llu turn_ms_avg=%llu",
+                    sum.games, sum.turns, sum.disconnects, sum.reconnects,
+                    sum.games ? game_ms / sum.games : 0ull,
+                    sum.turns ? turn_ms / sum.turns : 0ull);
+}
 
 /**
  * Check whether a received line matches a protocol token exactly.
@@ -107,13 +241,75 @@ Card deck_draw(Deck *d) {
 }
 
 /* --------- Lobbies ---------- */
+/**
+ * Mark the lobby list as changed (player count or running flag).
+ *
+ * Versions stay within 1..999999999 so clients can parse them as small ints;
+ * 0 is reserved for "no version".
+ */
+void lobby_version_bump(void) {
+    unsigned v = atomic_load(&g_lobby_version);
+    unsigned next;
+    do {
+        next = (v >= 999999999u) ? 1u : v + 1u;
+    } while (!atomic_compare_exchange_weak(&g_lobby_version, &v, next));
+}
+
+/**
+ * @return Current lobby list version (never 0).
+ */
+unsigned lobby_version(void) {
+    return atomic_load(&g_lobby_version);
+}
+
+/**
+ * Parse a "LOBBY_PROFILE <lobby>[-<last>] <standard|blitz>" config line.
+ *
+ * Lobby numbers are 1-based; numbers beyond LOBBY_COUNT are kept and simply
+ * never used, so the key may come before LOBBY_COUNT in the file.
+ *
+ * @param line Whole config line.
+ * @return 0 on success; -1 on a malformed line.
+ */
+static int parse_lobby_profile(const char* line) {
+    char range[32] = {0}, name[32] = {0};
+    if (sscanf(line, " %*s %31s %31s", range, name) != 2) return -1;
+
+    int first = 0, last = 0;
+    int k = sscanf(range, "%d-%d", &first, &last);
+    if (k == 1) last = first;
+    if (k < 1 || first < 1 || last < first || last > (int)sizeof(g_public_profile)) return -1;
+
+    int profile;
+    if (strcmp(name, "standard") == 0) profile = LOBBY_PROFILE_STANDARD;
+    else if (strcmp(name, "blitz") == 0) profile = LOBBY_PROFILE_BLITZ;
+    else return -1;
+
+    for (int i = first; i <= last; ++i) g_public_profile[i - 1] = (unsigned char)profile;
+    return 0;
+}
+
 /**
  * Load runtime configuration from a text file.
  *
  * Recognized keys:
- *   - LOBBY_COUNT (1..1000)
+ *   - LOBBY_COUNT (1..LOBBY_COUNT_MAX)
  *   - PORT (1..65535)
  *   - IP (bind address; "0.0.0.0" binds on all interfaces)
+ *   - FAULT_* (network fault injection, see FaultConfig in protocol.h)
+ *   - CAPTURE_FILE (record protocol traffic for replay, see capture.h)
+ *   - MAX_CLIENTS, THREAD_STACK_KB, MEM_BUDGET_MB (memory accounting, see metrics.h)
+ *   - MONITOR_TOKEN (secret for C45METRICS and C45PROF; not set = both are refused)
+ *   - MAX_OPEN_FILES (RLIMIT_NOFILE target; 0 = raise to the hard limit)
+ *   - KEEPALIVE_INTERVAL_SEC, KEEPALIVE_TIMEOUT_SEC (advertised to clients in C45OK)
+ *   - REPLICA_ROLE, REPLICA_SOCKET, REPLICA_BATCH_MS, REPLICA_MAX_LAG_MS (hot standby, see replica.h)
+ *   - TRACE_FILE, TRACE_SAMPLE (session lifecycle tracing, see trace.h)
+ *   - PROFILE_HZ, PROFILE_FILE (sampling profiler, see profiler.h)
+ *   - BOT_LOBBIES, BOT_TURN_MS, BOT_TOKEN (bot lane; bot lobbies are added after LOBBY_COUNT)
+ *   - LOBBY_PROFILE <lobby>[-<last>] <standard|blitz> (may repeat), BLITZ_TURN_MS (200..60000),
+ *     BLITZ_RECONNECT_MS (0..60000; 0 = a dropped player loses at once)
+ *   - RESULTS_DIR, RESULTS_ROTATE_MB, RESULTS_ROTATE_SEC (columnar game results export, see results.h)
+ *   - HISTORY_FILE (indexed game-history archive, see history.h)
  *
  * Missing file is not considered an error; defaults remain in effect.
  *
@@ -137,8 +333,8 @@ int load_config(const char* filename) {
 
         if (strcmp(key, "LOBBY_COUNT") == 0) {
             int v = atoi(val);
-            if (v >= 1 && v < 100) g_lobby_count = v;
-            else printf("Lobby_Count cannot be over 100. Used default value 5\n\n");
+            if (v >= 1 && v <= LOBBY_COUNT_MAX) g_lobby_count = v;
+            else printf("Lobby_Count must be 1..%d. Used default value 5\n\n", LOBBY_COUNT_MAX);
         } else if (strcmp(key, "PORT") == 0) {
             int p = atoi(val);
             if (p >= 1 && p <= 65535) g_server_port = p;
@@ -146,10 +342,118 @@ int load_config(const char* filename) {
             // Accept "0.0.0.0" to bind on all interfaces
             strncpy(g_server_ip, val, sizeof(g_server_ip) - 1);
             g_server_ip[sizeof(g_server_ip) - 1] = '\0';
+        } else if (strncmp(key, "FAULT_", 6) == 0) {
+            int v = atoi(val);
+            if (v < 0) v = 0;
+            if (strcmp(key, "FAULT_ENABLE") == 0) g_fault.enabled = v ? 1 : 0;
+            else if (strcmp(key, "FAULT_FRAGMENT_BYTES") == 0) g_fault.fragment_bytes = v;
+            else if (strcmp(key, "FAULT_FRAGMENT_GAP_MS") == 0) g_fault.fragment_gap_ms = v;
+            else if (strcmp(key, "FAULT_LATENCY_MS") == 0) g_fault.latency_ms = v;
+            else if (strcmp(key, "FAULT_JITTER_MS") == 0) g_fault.jitter_ms = v;
+            else if (strcmp(key, "FAULT_DROP_PERMILLE") == 0) g_fault.drop_permille = v > 1000 ? 1000 : v;
+            else if (strcmp(key, "FAULT_STALL_PERMILLE") == 0) g_fault.stall_permille = v > 1000 ? 1000 : v;
+            else if (strcmp(key, "FAULT_STALL_MS") == 0) g_fault.stall_ms = v;
+        } else if (strcmp(key, "CAPTURE_FILE") == 0) {
+            snprintf(g_capture_path, sizeof(g_capture_path), "%s", val);
+        } else if (strcmp(key, "PROFILE_HZ") == 0) {
+            int v = atoi(val);
+            if (v >= 0 && v <= 1000) g_profile_hz = v;
+        } else if (strcmp(key, "PROFILE_FILE") == 0) {
+            snprintf(g_profile_path, sizeof(g_profile_path), "%s", val);
+        } else if (strcmp(key, "RESULTS_DIR") == 0) {
+            snprintf(g_results_dir, sizeof(g_results_dir), "%s", val);
+        } else if (strcmp(key, "RESULTS_ROTATE_MB") == 0) {
+            int v = atoi(val);
+            if (v >= 1 && v <= 4096) g_results_rotate_mb = v;
+        } else if (strcmp(key, "RESULTS_ROTATE_SEC") == 0) {
+            int v = atoi(val);
+            if (v >= 1) g_results_rotate_sec = v;
+        } else if (strcmp(key, "HISTORY_FILE") == 0) {
+            snprintf(g_history_path, sizeof(g_history_path), "%s", val);
+        } else if (strcmp(key, "TRACE_FILE") == 0) {
+            snprintf(g_trace_path, sizeof(g_trace_path), "%s", val);
+        } else if (strcmp(key, "TRACE_SAMPLE") == 0) {
+            int v = atoi(val);
+            if (v >= 1) g_trace_sample = v;
+        } else if (strcmp(key, "MAX_CLIENTS") == 0) {
+            int v = atoi(val);
+            if (v >= 2) g_max_clients = v;
+        } else if (strcmp(key, "THREAD_STACK_KB") == 0) {
+            int v = atoi(val);
+            if (v >= 16) g_thread_stack_kb = v;
+        } else if (strcmp(key, "MEM_BUDGET_MB") == 0) {
+            int v = atoi(val);
+            if (v >= 0) g_mem_budget_mb = v;
+        } else if (strcmp(key, "MONITOR_TOKEN") == 0) {
+            snprintf(g_monitor_token, sizeof(g_monitor_token), "%s", val);
+        } else if (strcmp(key, "MAX_OPEN_FILES") == 0) {
+            int v = atoi(val);
+            if (v == 0 || v >= 64) g_max_open_files = v;
+        } else if (strcmp(key, "KEEPALIVE_INTERVAL_SEC") == 0) {
+            int v = atoi(val);
+            if (v >= 1 && v <= 300) g_keepalive_interval_sec = v;
+        } else if (strcmp(key, "KEEPALIVE_TIMEOUT_SEC") == 0) {
+            int v = atoi(val);
+            if (v >= 2 && v <= 600) g_keepalive_timeout_sec = v;
+        } else if (strcmp(key, "BOT_LOBBIES") == 0) {
+            int v = atoi(val);
+            if (v >= 0 && v <= 1000) g_bot_lobbies = v;
+        } else if (strcmp(key, "BOT_TURN_MS") == 0) {
+            int v = atoi(val);
+            if (v >= 10 && v <= 60000) g_bot_turn_ms = v;
+        } else if (strcmp(key, "BOT_TOKEN") == 0) {
+            snprintf(g_bot_token, sizeof(g_bot_token), "%s", val);
+        } else if (strcmp(key, "LOBBY_PROFILE") == 0) {
+            if (parse_lobby_profile(line) != 0)
+                printf("LOBBY_PROFILE must be <lobby>[-<last>] <standard|blitz>. Line ignored\n\n");
+        } else if (strcmp(key, "BLITZ_TURN_MS") == 0) {
+            int v = atoi(val);
+            if (v >= 200 && v <= 60000) g_blitz_turn_ms = v;
+        } else if (strcmp(key, "BLITZ_RECONNECT_MS") == 0) {
+            int v = atoi(val);
+            if (v >= 0 && v <= 60000) g_blitz_reconnect_ms = v;
+        } else if (strcmp(key, "REPLICA_ROLE") == 0) {
+            int v = replica_parse_role(val);
+            if (v >= 0) g_replica_role = v;
+            else printf("REPLICA_ROLE must be off, primary or standby. Replication stays off\n\n");
+        } else if (strcmp(key, "REPLICA_SOCKET") == 0) {
+            snprintf(g_replica_socket, sizeof(g_replica_socket), "%s", val);
+        } else if (strcmp(key, "REPLICA_BATCH_MS") == 0) {
+            int v = atoi(val);
+            if (v >= 1 && v <= 1000) g_replica_batch_ms = v;
+        } else if (strcmp(key, "REPLICA_MAX_LAG_MS") == 0) {
+            int v = atoi(val);
+            if (v >= 10 && v <= 60000) g_replica_max_lag_ms = v;
         }
     }
 
     fclose(f);
+
+    // A batch must be able to wait for the socket at least one interval before the standby is dropped.
+    if (g_replica_max_lag_ms < 2 * g_replica_batch_ms) {
+        g_replica_max_lag_ms = 2 * g_replica_batch_ms;
+        printf("REPLICA_MAX_LAG_MS must be at least twice REPLICA_BATCH_MS. Using %d\n\n", g_replica_max_lag_ms);
+    }
+
+    // A client pings once per interval, so the timeout must leave room for one lost round trip.
+    if (g_keepalive_timeout_sec <= g_keepalive_interval_sec) {
+        g_keepalive_timeout_sec = g_keepalive_interval_sec + 5;
+        printf("KEEPALIVE_TIMEOUT_SEC must exceed KEEPALIVE_INTERVAL_SEC. Using %d\n\n", g_keepalive_timeout_sec);
+    }
+
+    // Bot lobbies follow the public ones; without a token nobody could sit there.
+    if (g_bot_lobbies > 0 && g_bot_token[0] == '\0') {
+        printf("BOT_LOBBIES needs BOT_TOKEN. Bot lane disabled\n\n");
+        g_bot_lobbies = 0;
+    }
+    g_lobby_count += g_bot_lobbies;
+
+    if (g_fault.enabled) {
+        printf("[FAULT] Fault injection enabled: frag=%dB/%dms latency=%d+%dms drop=%d/1000 stall=%d/1000x%dms\n",
+               g_fault.fragment_bytes, g_fault.fragment_gap_ms,
+               g_fault.latency_ms, g_fault.jitter_ms,
+               g_fault.drop_permille, g_fault.stall_permille, g_fault.stall_ms);
+    }
     return 0;
 }
 
@@ -166,11 +470,30 @@ int lobbies_init(void) {
 
     g_lobbies = (Lobby*)calloc((size_t)g_lobby_count, sizeof(Lobby));
     if (!g_lobbies) return -1;
+    // Ids stay unique across restarts as long as fewer than 2^20 games end per second.
+    atomic_store(&g_game_seq, (unsigned long long)time(NULL) << 20);
 
     for (int i = 0; i < g_lobby_count; ++i) {
         g_lobbies[i].player_count = 0;
         g_lobbies[i].is_running   = 0;
+        g_lobbies[i].bot          = i >= lobby_public_count();
+        g_lobbies[i].profile      = g_lobbies[i].bot ? LOBBY_PROFILE_BOT : g_public_profile[i];
+        switch (g_lobbies[i].profile) {
+        case LOBBY_PROFILE_BLITZ:
+            g_lobbies[i].turn_ms      = g_blitz_turn_ms;
+            g_lobbies[i].reconnect_ms = g_blitz_reconnect_ms;
+            break;
+        case LOBBY_PROFILE_BOT:
+            g_lobbies[i].turn_ms      = g_bot_turn_ms;
+            g_lobbies[i].reconnect_ms = 0;
+            break;
+        default:
+            g_lobbies[i].turn_ms      = TURN_TIMEOUT_SEC * 1000;
+            g_lobbies[i].reconnect_ms = RECONNECT_TIMEOUT_SEC * 1000;
+            break;
+        }
         pthread_mutex_init(&g_lobbies[i].mtx, NULL);
+        pthread_cond_init(&g_lobbies[i].changed, NULL);
 
         deck_init(&g_lobbies[i].deck);
         deck_shuffle(&g_lobbies[i].deck);
@@ -183,12 +506,37 @@ int lobbies_init(void) {
             pl->fd = -1;
             pl->stood = 0;
             pl->busted = 0;
+            pl->replaced_fd = -1;
         }
     }
 
     return 0;
 }
 
+/**
+ * @return Number of public lobbies; bot lobbies have the indices after them.
+ */
+int lobby_public_count(void) {
+    return g_lobby_count - g_bot_lobbies;
+}
+
+/**
+ * Check a bot session's shared secret against BOT_TOKEN.
+ *
+ * Compares every byte regardless of mismatches, so the reply time does not
+ * reveal the length of the matching prefix.
+ *
+ * @param token Token sent by the client.
+ * @return 1 if the bot lane is enabled and the token matches; 0 otherwise.
+ */
+int bot_token_ok(const char* token) {
+    if (g_bot_lobbies <= 0 || !token) return 0;
+    size_t n = strlen(g_bot_token);
+    if (strlen(token) != n) return 0;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < n; ++i) diff |= (unsigned char)(token[i] ^ g_bot_token[i]);
+    return diff == 0;
+}
 
 /**
  * Try to add a player into a lobby.
@@ -217,7 +565,9 @@ int lobby_try_add_player(int lobby_index, const char* name) {
             pl->name[MAX_NAME_LEN - 1] = '\0';
             pl->hand_size = 0;
             pl->connected = 1;
+            pl->replaced_fd = -1;
             L->player_count++;
+            lobby_version_bump();
             printf("[LOBBY] '%s' add in lobby #%d (status %d/%d)\n",
                    pl->name, lobby_index+1, L->player_count, LOBBY_SIZE);
             pthread_mutex_unlock(&L->mtx);
@@ -229,6 +579,31 @@ int lobby_try_add_player(int lobby_index, const char* name) {
     return -1;
 }
 
+/**
+ * Remove a player from one lobby by name. Caller holds the lobby mutex.
+ *
+ * @param li   Zero-based lobby index.
+ * @param name Player name.
+ * @return 0 if the player was removed; -1 if the lobby has no such player.
+ */
+static int lobby_remove_player_locked(int li, const char* name) {
+    Lobby* L = &g_lobbies[li];
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        Player *pl = &L->players[p];
+        if (pl->connected && strncmp(pl->name, name, MAX_NAME_LEN) == 0) {
+            pl->connected = 0;
+            pl->name[0] = '\0';
+            pl->hand_size = 0;
+            L->player_count--;
+            lobby_version_bump();
+            printf("[LOBBY] Player '%s' removed from lobby #%d (status %d/%d)\n",
+                   name, li+1, L->player_count, LOBBY_SIZE);
+            return 0;
+        }
+    }
+    return -1;
+}
+
 /**
  * Remove a player from the lobby pool by name (first match wins).
  *
@@ -236,22 +611,10 @@ int lobby_try_add_player(int lobby_index, const char* name) {
  */
 void lobby_remove_player_by_name(const char* name) {
     for (int i = 0; i < g_lobby_count; ++i) {
-        Lobby* L = &g_lobbies[i];
-        pthread_mutex_lock(&L->mtx);
-        for (int p = 0; p < LOBBY_SIZE; ++p) {
-            Player *pl = &L->players[p];
-            if (pl->connected && strncmp(pl->name, name, MAX_NAME_LEN) == 0) {
-                pl->connected = 0;
-                pl->name[0] = '\0';
-                pl->hand_size = 0;
-                L->player_count--;
-                printf("[LOBBY] Player '%s' removed from lobby #%d (status %d/%d)\n",
-                       name, i+1, L->player_count, LOBBY_SIZE);
-                pthread_mutex_unlock(&L->mtx);
-                return;
-            }
-        }
-        pthread_mutex_unlock(&L->mtx);
+        pthread_mutex_lock(&g_lobbies[i].mtx);
+        int removed = lobby_remove_player_locked(i, name) == 0;
+        pthread_mutex_unlock(&g_lobbies[i].mtx);
+        if (removed) return;
     }
 }
 
@@ -326,11 +689,25 @@ int start_game_if_ready(int li) {
     Lobby* L = &g_lobbies[li];
     pthread_mutex_lock(&L->mtx);
     if (!L->is_running && L->player_count == LOBBY_SIZE) {
-        L->is_running = 1;
-        pthread_t th;
-        int* box = malloc(sizeof(int)); *box = li;
-        pthread_create(&th, NULL, lobby_game_thread, box);
-        pthread_detach(th);
+        // The lobby itself is the thread argument (it outlives every game).
+        mem_table_start();
+        if (L->bot && !L->worker_on &&
+            mem_thread_create_joinable(&L->worker, bot_table_worker, L) == 0) {
+            L->worker_on = 1;   // started on the first game; every later game reuses it
+        }
+        if (L->worker_on) {
+            // The broadcast below wakes the bot worker.
+            L->is_running = 1;
+            lobby_version_bump();
+            pthread_cond_broadcast(&L->changed);
+        } else if (mem_thread_create(lobby_game_thread, L) == 0) {
+            L->is_running = 1;
+            lobby_version_bump();
+            pthread_cond_broadcast(&L->changed);
+        } else {
+            mem_table_end();
+            printf("[GAME] Cannot start game thread for lobby #%d\n", li + 1);
+        }
     }
     pthread_mutex_unlock(&L->mtx);
     return 0;
@@ -347,6 +724,7 @@ static void player_disconnect_fd(Lobby* L, int player_index) {
     pthread_mutex_lock(&L->mtx);
     old_fd = L->players[player_index].fd;
     L->players[player_index].fd = -1;
+    pthread_cond_broadcast(&L->changed);   // a multi-table session waits for its seat to be let go
     pthread_mutex_unlock(&L->mtx);
     if (old_fd >= 0) (void)shutdown(old_fd, SHUT_RDWR);
 }
@@ -354,25 +732,43 @@ static void player_disconnect_fd(Lobby* L, int player_index) {
 /**
  * Send the current hand state to a reconnected player.
  *
+ * @param T         Table buffers (out is used for formatting).
  * @param fd        Connected socket file descriptor.
  * @param hand      Array of cards.
  * @param hand_size Number of cards in @p hand.
+ * @param commit    Shuffle commitment of the game (repeated in C45D).
  */
-static void send_hand_snapshot(int fd, const Card* hand, int hand_size) {
+static void send_hand_snapshot(TableBuf* T, int fd, const Card* hand, int hand_size, const char* commit) {
     if (fd < 0) return;
     if (hand_size < 2) return;
 
-    char c1[3], c2[3], line[128];
+    char c1[3], c2[3];
     card_to_str(hand[0], c1);
     card_to_str(hand[1], c2);
-    snprintf(line, sizeof(line), "C45D %s %s\n", c1, c2);
-    write_all(fd, line);
+    snprintf(T->out, sizeof(T->out), "C45D %s %s %s\n", c1, c2, commit);
+    write_all(fd, T->out);
 
     for (int i = 2; i < hand_size; ++i) {
         char cs[3];
         card_to_str(hand[i], cs);
-        snprintf(line, sizeof(line), "C45C %s\n", cs);
-        write_all(fd, line);
+        snprintf(T->out, sizeof(T->out), "C45C %s\n", cs);
+        write_all(fd, T->out);
+    }
+}
+
+/**
+ * Copy the players' names into the table buffers, once per game.
+ *
+ * Names do not change while a game runs (a reconnect keeps the name), so the
+ * turn loop and the reconnect/result paths use these copies without locking.
+ *
+ * @param L Lobby (caller holds L->mtx).
+ */
+static void table_take_names(Lobby* L) {
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        memcpy(L->tb.names[p], L->players[p].name, MAX_NAME_LEN);
+        L->tb.names[p][MAX_NAME_LEN - 1] = '\0';
+        atomic_fetch_add_explicit(&g_name_copies, 1, memory_order_relaxed);
     }
 }
 
@@ -395,35 +791,28 @@ static int is_back_request_for_name(const char* line, const char* expected_name)
     // New compact format: "C45B\n" (name is implied by the connection).
     if (is_token(line, "C45B")) return 1;
 
-    // Legacy format: "C45<name>back\n".
+    // Legacy format: "C45<name>back\n" (parsed in place).
     if (!expected_name || expected_name[0] == '\0') return 0;
     if (strncmp(line, "C45", 3) != 0) return 0;
 
     const char* s = line + 3;
     while (*s == ' ' || *s == '\t') s++;
 
-    char tmp[READ_BUF];
-    strncpy(tmp, s, sizeof(tmp) - 1);
-    tmp[sizeof(tmp) - 1] = '\0';
-
-    for (int i = (int)strlen(tmp) - 1; i >= 0 &&
-             (tmp[i] == '\r' || tmp[i] == '\n' || tmp[i] == ' ' || tmp[i] == '\t'); --i) {
-        tmp[i] = '\0';
-    }
+    const char* e = s + strlen(s);
+    while (e > s && (e[-1] == '\r' || e[-1] == '\n' || e[-1] == ' ' || e[-1] == '\t')) e--;
 
     const char* suffix = "back";
-    size_t len = strlen(tmp);
     size_t slen = strlen(suffix);
-    if (len <= slen) return 0;
-    if (strcmp(tmp + (len - slen), suffix) != 0) return 0;
+    if ((size_t)(e - s) <= slen) return 0;
+    if (memcmp(e - slen, suffix, slen) != 0) return 0;
 
-    tmp[len - slen] = '\0';
-    for (int i = (int)strlen(tmp) - 1; i >= 0 && (tmp[i] == ' ' || tmp[i] == '\t'); --i) {
-        tmp[i] = '\0';
-    }
-    if (tmp[0] == '\0') return -1;
+    e -= slen;
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t')) e--;
+    if (e == s) return -1;
 
-    return (strncmp(tmp, expected_name, MAX_NAME_LEN) == 0) ? 1 : -1;
+    size_t n = (size_t)(e - s);
+    if (n >= MAX_NAME_LEN) return -1;
+    return (strlen(expected_name) == n && memcmp(s, expected_name, n) == 0) ? 1 : -1;
 }
 
 /**
@@ -434,92 +823,72 @@ static int is_back_request_for_name(const char* line, const char* expected_name)
  *   - allow "back to lobby",
  *   - detect protocol violations while out-of-turn.
  *
+ * A pipelined HIT/STAND is left queued (together with everything behind it) and
+ * is read as that player's move once the turn passes to them; only pings and
+ * pongs queued behind it are taken out of order.
+ *
  * @param L                 Lobby.
  * @param other_idx         Index of the non-active player.
  * @param other_fd          Socket fd of the non-active player.
  * @param active_idx        Index of the active player.
  * @param forced_winner_idx Output: set to the winner index on protocol violation.
- * @param inbuf             Per-player buffer with pending bytes.
- * @param inlen             In/out: current size of @p inbuf.
  *
  * @return  0 OK.
  * @return  1 Protocol violation; caller should end the game (winner is set).
+ * @return  2 The player left the table (C45B); caller should end the game (winner is set).
  * @return -1 Disconnect/error; caller should pause and wait for reconnect.
  */
 static int drain_nonactive_player_input(Lobby* L,
                                         int other_idx,
                                         int other_fd,
                                         int active_idx,
-                                        int* forced_winner_idx,
-                                        char* inbuf,
-                                        size_t* inlen) {
+                                        int* forced_winner_idx) {
+    TableBuf* T = &L->tb;
+    char* line = T->in;
     for (;;) {
-        if (*inlen >= READ_BUF - 1) {
-            player_disconnect_fd(L, other_idx);
-            *forced_winner_idx = active_idx;
-            return 1;
-        }
-
-        ssize_t r = recv(other_fd,
-                         inbuf + *inlen,
-                         (READ_BUF - 1) - *inlen,
-                         MSG_DONTWAIT);
-        if (r > 0) {
-            *inlen += (size_t)r;
-            inbuf[*inlen] = '\0';
+        int r = peek_line(other_fd, line, sizeof(T->in));
+        if (r == -2) return 0;
+        if (r <= 0) return -1; // peer closed or error
 
+        // Moves wait in the queue for this player's turn; pings behind them are answered.
+        if (is_token(line, "C45H") || is_token(line, "C45S")) {
             for (;;) {
-                char* nl = memchr(inbuf, '\n', *inlen);
-                if (!nl) break;
-
-                size_t line_len = (size_t)(nl - inbuf + 1);
-                char line[READ_BUF];
-                if (line_len >= sizeof(line)) line_len = sizeof(line) - 1;
-                memcpy(line, inbuf, line_len);
-                line[line_len] = '\0';
-
-                memmove(inbuf, inbuf + line_len, *inlen - line_len);
-                *inlen -= line_len;
-
-                if (is_token(line, "C45PO")) continue;
-                if (is_token(line, "C45PI")) {
-                    (void)write_all(other_fd, "C45PO\n");
-                    continue;
-                }
-                if (is_token(line, "C45YES")) continue;
-
-                // Allow quitting the game from the non-active side too.
-                pthread_mutex_lock(&L->mtx);
-                char other_name[MAX_NAME_LEN];
-                strncpy(other_name, L->players[other_idx].name, sizeof(other_name) - 1);
-                other_name[sizeof(other_name) - 1] = '\0';
-                pthread_mutex_unlock(&L->mtx);
-                if (is_back_request_for_name(line, other_name) == 1) {
-                    active_name_mark_back(other_name, other_fd);
-                    *forced_winner_idx = active_idx;
-                    return 1;
-                }
-
-                // Out-of-turn commands (or any other garbage) are a protocol violation.
-                player_disconnect_fd(L, other_idx);
-                *forced_winner_idx = active_idx;
-                return 1;
+                int k = take_keepalive_line(other_fd, line, sizeof(T->in));
+                if (k == -2 || k == -3) return 0;
+                if (k <= 0) return -1; // peer closed or error
+                if (is_token(line, "C45PI")) (void)write_all(other_fd, "C45PO\n");
             }
+        }
+        (void)read_line(other_fd, line, sizeof(T->in));
+
+        if (is_token(line, "C45PO")) continue;
+        if (is_token(line, "C45PI")) {
+            (void)write_all(other_fd, "C45PO\n");
             continue;
         }
+        if (is_token(line, "C45YES")) continue;
 
-        if (r == 0) return -1; // peer closed
-        if (errno == EINTR) continue;
-        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
-        return -1;
+        // Allow quitting the game from the non-active side too.
+        if (is_back_request_for_name(line, T->names[other_idx]) == 1) {
+            active_name_mark_back(T->names[other_idx], other_fd);
+            *forced_winner_idx = active_idx;
+            return 2;
+        }
+
+        // Any other line (garbage, overlong input) is a protocol violation.
+        player_disconnect_fd(L, other_idx);
+        *forced_winner_idx = active_idx;
+        return 1;
     }
 }
 
 /**
- * Wait up to RECONNECT_TIMEOUT_SEC for a missing player to reconnect.
+ * Wait up to the lobby's reconnect window (Lobby.reconnect_ms) for a missing
+ * player to reconnect.
  *
- * While waiting, the remaining player is kept alive with PING/PONG and receives
- * notifications about the opponent status.
+ * While waiting, the remaining player receives notifications about the opponent
+ * status; its own client keeps the connection alive with PING (any line counts).
+ * The window is kept to the millisecond; C45OD advertises it rounded up to seconds.
  *
  * @param L           Lobby.
  * @param missing_idx Index of the disconnected player.
@@ -530,23 +899,20 @@ static int drain_nonactive_player_input(Lobby* L,
  * @return -1 The other player disconnected while waiting.
  */
 static int wait_for_reconnect(Lobby* L, int missing_idx, int other_idx) {
-    char missing_name[MAX_NAME_LEN];
-    char other_name[MAX_NAME_LEN];
+    TableBuf* T = &L->tb;
+    const char* missing_name = T->names[missing_idx];
+    const char* other_name = T->names[other_idx];
     pthread_mutex_lock(&L->mtx);
-    strncpy(missing_name, L->players[missing_idx].name, sizeof(missing_name) - 1);
-    missing_name[sizeof(missing_name) - 1] = '\0';
-    strncpy(other_name, L->players[other_idx].name, sizeof(other_name) - 1);
-    other_name[sizeof(other_name) - 1] = '\0';
     int other_fd = L->players[other_idx].fd;
     pthread_mutex_unlock(&L->mtx);
 
-    char msg[128];
-    snprintf(msg, sizeof(msg), "C45OD %s %d\n", missing_name, RECONNECT_TIMEOUT_SEC);
-    if (other_fd >= 0) write_all(other_fd, msg);
+    atomic_fetch_add_explicit(&L->stats.disconnects, 1, memory_order_relaxed);
+    if (L->reconnect_ms <= 0) return 1;   // no reconnect window (bot lane): the opponent wins at once
+    snprintf(T->out, sizeof(T->out), "C45OD %s %d\n", missing_name, (L->reconnect_ms + 999) / 1000);
+    if (other_fd >= 0) write_all(other_fd, T->out);
 
-    time_t deadline = time(NULL) + RECONNECT_TIMEOUT_SEC;
-    time_t last_ping = 0;
-    time_t last_pong = time(NULL);
+    unsigned long long deadline_ms = mono_ms() + (unsigned long long)L->reconnect_ms;
+    time_t last_rx = time(NULL);
 
     for (;;) {
         time_t now = time(NULL);
@@ -566,83 +932,234 @@ static int wait_for_reconnect(Lobby* L, int missing_idx, int other_idx) {
             memcpy(hand, L->players[missing_idx].hand, (size_t)hand_size * sizeof(Card));
             pthread_mutex_unlock(&L->mtx);
 
-            send_hand_snapshot(missing_fd, hand, hand_size);
+            send_hand_snapshot(T, missing_fd, hand, hand_size, L->proof.commit);
 
-            snprintf(msg, sizeof(msg), "C45OB %s\n", missing_name);
-            if (other_fd >= 0) write_all(other_fd, msg);
+            snprintf(T->out, sizeof(T->out), "C45OB %s\n", missing_name);
+            if (other_fd >= 0) write_all(other_fd, T->out);
+            atomic_fetch_add_explicit(&L->stats.reconnects, 1, memory_order_relaxed);
             return 0;
         }
 
-        if (now >= deadline) return 1;
+        unsigned long long now_ms = mono_ms();
+        if (now_ms >= deadline_ms) return 1;
         if (other_fd < 0) return -1;
 
-        if (now - last_ping >= PING_INTERVAL_SEC) {
-            if (write_all(other_fd, "C45PI\n") < 0) return -1;
-            last_ping = now;
-        }
-
-        char buf[READ_BUF];
-        int r = read_line_timeout(other_fd, buf, sizeof(buf), 1);
+        // Wake at the end of the window or each second to look for the missing player.
+        int wait_ms = deadline_ms - now_ms > 1000 ? 1000 : (int)(deadline_ms - now_ms);
+        int r = read_line_timeout_ms(other_fd, T->in, sizeof(T->in), wait_ms);
         if (r == -2) {
             // no data
         } else if (r <= 0) {
             return -1;
-        } else if (is_token(buf, "C45PO")) {
-            last_pong = now;
-        } else if (is_token(buf, "C45PI")) {
-            (void)write_all(other_fd, "C45PO\n");
-            last_pong = now;
-        } else if (is_back_request_for_name(buf, other_name) == 1) {
-            active_name_mark_back(other_name, other_fd);
-            return 1; // treat as disconnect-timeout -> end game early
+        } else {
+            last_rx = now;
+            if (is_token(T->in, "C45PI")) {
+                (void)write_all(other_fd, "C45PO\n");
+            } else if (is_back_request_for_name(T->in, other_name) == 1) {
+                active_name_mark_back(other_name, other_fd);
+                return 1; // treat as disconnect-timeout -> end game early
+            }
         }
 
-        if (now - last_pong > PONG_TIMEOUT_SEC) return -1;
+        if (now - last_rx > g_keepalive_timeout_sec) return -1;
     }
 }
 
 /**
- * Lobby game thread entry point.
+ * Wait for the players of a restored game to reconnect (C45REC after a takeover).
  *
- * Runs a two-player Blackjack match, handles turn timeouts, keep-alive, and
- * reconnects. When the match ends, it announces the result and resets lobby state.
+ * Returns as soon as every seat is back, or shortly after the first one is back
+ * (the other is then handled by wait_for_reconnect() like any disconnect).
  *
- * @param arg Pointer to heap-allocated int containing the lobby index.
- * @return NULL.
+ * @param L           Lobby.
+ * @param missing_idx Output: the seat still missing when one player is back.
+ * @return Number of players back (0 after the lobby's reconnect window without anyone).
  */
-static void* lobby_game_thread(void* arg) {
-    int li = *(int*)arg; free(arg);
-    Lobby* L = &g_lobbies[li];
-    int forced_winner_idx = -1;
-    char nonactive_inbuf[LOBBY_SIZE][READ_BUF] = {{0}};
-    size_t nonactive_inlen[LOBBY_SIZE] = {0};
+static int wait_for_resume(Lobby* L, int* missing_idx) {
+    const int step_us = 100000;
+    const int grace_steps = 20;   // 2 s for the second player once the first is back
+    unsigned long long deadline_ms = mono_ms() + (unsigned long long)L->reconnect_ms;
+    int back_steps = 0;
 
-    // preparing deck and hands
+    for (;;) {
+        int back = 0;
+        pthread_mutex_lock(&L->mtx);
+        for (int p = 0; p < LOBBY_SIZE; ++p) {
+            if (L->players[p].fd >= 0) back++;
+            else *missing_idx = p;
+        }
+        pthread_mutex_unlock(&L->mtx);
+
+        if (back == LOBBY_SIZE) return back;
+        if (back > 0 && ++back_steps >= grace_steps) return back;
+        if (back == 0 && mono_ms() >= deadline_ms) return 0;
+        if (!atomic_load(&g_server_running)) return back;
+        io_sleep_us(step_us);
+    }
+}
+
+/**
+ * Time left for the turn that was running when a standby took over.
+ *
+ * The lobby's own clock bounds the result: at least REPLICA_MIN_TURN_MS or half
+ * of L->turn_ms, whichever is shorter (blitz and bot clocks stay short), and at
+ * most L->turn_ms.
+ *
+ * @param L Lobby (caller holds L->mtx; L->turn_deadline_ms restored from the replica).
+ * @return Milliseconds for the resumed turn.
+ */
+static int resume_turn_ms(const Lobby* L) {
+    if (L->turn_deadline_ms == 0) return L->turn_ms;
+    int floor_ms = L->turn_ms / 2 < REPLICA_MIN_TURN_MS ? L->turn_ms / 2 : REPLICA_MIN_TURN_MS;
+    unsigned long long now = mono_ms();
+    unsigned long long left = L->turn_deadline_ms > now ? L->turn_deadline_ms - now : 0;
+    if (left < (unsigned long long)floor_ms) return floor_ms;
+    if (left > (unsigned long long)L->turn_ms) return L->turn_ms;
+    return (int)left;
+}
+
+/**
+ * Hand a finished game to the game feed (results export and history archive):
+ * the GameResult is filled in its ring slot, no copy and no syscalls.
+ *
+ * @param L             Lobby (names in L->tb, hands under L->mtx).
+ * @param va            Final value of seat 0 (-1 = bust).
+ * @param vb            Final value of seat 1 (-1 = bust).
+ * @param winner        Winning seat, 2 = push.
+ * @param end_reason    GameEndReason.
+ * @param turns         Turns offered (C45T sent).
+ * @param think_ms      Time each seat spent on its turns.
+ * @param game_start_ms mono_ms() at game start.
+ */
+static void record_result(Lobby* L, int va, int vb, int winner, int end_reason, int turns,
+                          const unsigned long long* think_ms, unsigned long long game_start_ms) {
+    size_t ticket;
+    GameResult* r = gamefeed_claim(&ticket);
+    if (!r) return; // feed off, or full (counted by the ring)
+    memset(r, 0, sizeof(*r));
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    r->game_id     = atomic_fetch_add_explicit(&g_game_seq, 1, memory_order_relaxed);
+    r->end_ms      = (uint64_t)now.tv_sec * 1000ull + (uint64_t)now.tv_nsec / 1000000ull;
+    r->duration_ms = (uint32_t)(mono_ms() - game_start_ms);
+    r->lobby       = (uint16_t)(L - g_lobbies + 1);
+    r->turns       = (uint16_t)turns;
+    r->profile     = (uint8_t)L->profile;
+    r->end_reason  = (uint8_t)end_reason;
+    r->winner      = (uint8_t)winner;
+    r->value[0]    = (int8_t)va;
+    r->value[1]    = (int8_t)vb;
     pthread_mutex_lock(&L->mtx);
-    deck_shuffle(&L->deck);
     for (int p = 0; p < LOBBY_SIZE; ++p) {
-        L->players[p].hand_size = 0;
-        L->players[p].stood = 0;    
-        L->players[p].busted = 0;
+        const Player* P = &L->players[p];
+        int n = P->hand_size > RESULTS_MAX_CARDS ? RESULTS_MAX_CARDS : P->hand_size;
+        for (int c = 0; c < n; ++c) r->hand[p][c] = (uint8_t)(P->hand[c].rank | (int)P->hand[c].suit << 4);
+        r->hand_size[p] = (uint8_t)n;
     }
+    pthread_mutex_unlock(&L->mtx);
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        r->think_ms[p] = think_ms[p] > UINT32_MAX ? UINT32_MAX : (uint32_t)think_ms[p];
+        memcpy(r->name[p], L->tb.names[p], MAX_NAME_LEN);
+    }
+    gamefeed_publish(ticket);
+}
+
+/**
+ * Run one game of a lobby (on its game thread or its bot worker).
+ *
+ * Runs a two-player Blackjack match, handles turn timeouts, keep-alive, and
+ * reconnects. When the match ends, it announces the result and resets lobby state.
+ * A game restored by a standby (Lobby.resume) skips the deal, waits for its
+ * players to reconnect and continues at the replicated turn.
+ *
+ * @param L The Lobby to run (is_running already set by start_game_if_ready()).
+ */
+static void run_game(Lobby* L) {
+    TableBuf* T = &L->tb;
+    char* line = T->out;
+    char* buf = T->in;
+    int forced_winner_idx = -1;
+    int end_reason = GAME_END_NORMAL;
+    int turns_offered = 0;
+    unsigned long long think_ms[LOBBY_SIZE] = {0};
+    unsigned long long game_start_ms = mono_ms();
+    atomic_fetch_add_explicit(&g_games_started, 1, memory_order_relaxed);
+
     // Step-by-step: player #1 (slot 0) goes first, then player #2 (slot 1).
     int p0 = 0;
     int p1 = 1;
     Player *A = &L->players[p0], *B = &L->players[p1];
+    int turn = 0; // player #1 starts
+    int turn_ms = L->turn_ms;
 
-    // deals 2 cards
-    for (int p = 0; p < 2; ++p) {
-        A->hand[A->hand_size++] = deck_draw(&L->deck);
-        B->hand[B->hand_size++] = deck_draw(&L->deck);
+    // The shuffle was precomputed off the game path; a restored game keeps its replicated deck.
+    ShuffleTicket tk;
+    pthread_mutex_lock(&L->mtx);
+    int resume_pending = L->resume;
+    pthread_mutex_unlock(&L->mtx);
+    if (!resume_pending) shuffle_take(&tk);
+
+    // preparing deck and hands
+    pthread_mutex_lock(&L->mtx);
+    table_take_names(L);
+    int resumed = L->resume;
+    L->resume = 0;
+    if (resumed) {
+        // Restored by a standby: hands, deck and turn come from the replica.
+        turn = L->turn;
+        turn_ms = resume_turn_ms(L);
+    } else {
+        int lobby_no = (int)(L - g_lobbies) + 1;
+        trace_event(A->fd, TRACE_GAME_START, lobby_no, NULL);
+        trace_event(B->fd, TRACE_GAME_START, lobby_no, NULL);
+        L->deck = tk.deck;
+        L->proof = tk.proof;
+        for (int p = 0; p < LOBBY_SIZE; ++p) {
+            L->players[p].hand_size = 0;
+            L->players[p].stood = 0;
+            L->players[p].busted = 0;
+        }
+
+        // deals 2 cards
+        for (int p = 0; p < 2; ++p) {
+            A->hand[A->hand_size++] = deck_draw(&L->deck);
+            B->hand[B->hand_size++] = deck_draw(&L->deck);
+        }
+        char c1[3], c2[3];
+        card_to_str(A->hand[0], c1); card_to_str(A->hand[1], c2);
+        snprintf(line, sizeof(T->out), "C45D %s %s %s\n", c1, c2, L->proof.commit); write_all(A->fd, line);
+        trace_event(A->fd, TRACE_DEAL, 0, NULL);
+        card_to_str(B->hand[0], c1); card_to_str(B->hand[1], c2);
+        snprintf(line, sizeof(T->out), "C45D %s %s %s\n", c1, c2, L->proof.commit); write_all(B->fd, line);
+        trace_event(B->fd, TRACE_DEAL, 0, NULL);
     }
-    char c1[3], c2[3], line[128];
-    card_to_str(A->hand[0], c1); card_to_str(A->hand[1], c2);
-    snprintf(line, sizeof(line), "C45D %s %s\n", c1, c2); write_all(A->fd, line);
-    card_to_str(B->hand[0], c1); card_to_str(B->hand[1], c2);
-    snprintf(line, sizeof(line), "C45D %s %s\n", c1, c2); write_all(B->fd, line);
     pthread_mutex_unlock(&L->mtx);
+    replica_mark(L);
+
+    if (resumed) {
+        int missing = -1;
+        int back = wait_for_resume(L, &missing);
+        printf("[GAME] Lobby #%d resumed after takeover: %d of %d players back\n",
+               (int)(L - g_lobbies) + 1, back, LOBBY_SIZE);
+        if (back == 0) {
+            end_reason = GAME_END_LOST;
+            goto end_game;
+        }
+        for (int p = 0; p < LOBBY_SIZE; ++p) {
+            if (p == missing && back < LOBBY_SIZE) continue;
+            send_hand_snapshot(T, L->players[p].fd, L->players[p].hand, L->players[p].hand_size,
+                               L->proof.commit);
+        }
+        if (back < LOBBY_SIZE) {
+            int rr = wait_for_reconnect(L, missing, 1 - missing);
+            if (rr == 1) forced_winner_idx = 1 - missing;
+            if (rr != 0) {
+                end_reason = rr == 1 ? GAME_END_ABANDONED : GAME_END_LOST;
+                goto end_game;
+            }
+        }
+    }
 
-    int turn = 0; // player #1 starts
     for (;;) {
 	turn_loop:
 	        pthread_mutex_lock(&L->mtx);
@@ -656,20 +1173,29 @@ static void* lobby_game_thread(void* arg) {
 	            pthread_mutex_unlock(&L->mtx);
 	            continue;
 	        }
-	        char turn_name[MAX_NAME_LEN];
-	        strncpy(turn_name, L->players[turn].name, sizeof(turn_name) - 1);
-	        turn_name[sizeof(turn_name) - 1] = '\0';
 	        int fdA = A->fd;
 	        int fdB = B->fd;
+	        int this_turn_ms = turn_ms;
+	        int this_turn_secs = (this_turn_ms + 999) / 1000;
+	        turn_ms = L->turn_ms;
+	        L->turn = turn;
+	        L->turn_deadline_ms = mono_ms() + (unsigned long long)this_turn_ms;
         pthread_mutex_unlock(&L->mtx);
+        replica_mark(L);
 
-        snprintf(line, sizeof(line), "C45T %s %d\n", turn_name, TURN_TIMEOUT_SEC);
+        // Blitz and bot lanes also get the exact clock: "C45T <name> <sec> <ms>".
+        if (L->profile != LOBBY_PROFILE_STANDARD) snprintf(line, sizeof(T->out), "C45T %s %d %d\n", T->names[turn], this_turn_secs, this_turn_ms);
+        else snprintf(line, sizeof(T->out), "C45T %s %d\n", T->names[turn], this_turn_secs);
         if (fdA >= 0 && write_all(fdA, line) < 0) goto pause_a;
         if (fdB >= 0 && write_all(fdB, line) < 0) goto pause_b;
+        trace_event(turn == p0 ? fdA : fdB, TRACE_TURN_REQUEST, turn, NULL);
+        turns_offered++;
 
-        time_t turn_start = time(NULL);
-        time_t last_ping = 0;
-        time_t last_pong = time(NULL);
+        time_t last_rx = time(NULL);
+        unsigned long long turn_sent_ms = mono_ms();
+        unsigned long long turn_end_ms = turn_sent_ms + (unsigned long long)this_turn_ms;
+        // Bot lanes have no keep-alive: silence only ends the turn, a hangup ends the session.
+        int keepalive = !L->bot;
 
 	        for (;;) {
 	            time_t now = time(NULL);
@@ -685,67 +1211,72 @@ static void* lobby_game_thread(void* arg) {
 		            // If the other player disconnects during this turn, pause and wait for reconnect.
 		            if (other_fd >= 0) {
 		                struct pollfd op = { .fd = other_fd, .events = POLLIN | POLLHUP | POLLERR };
-		                int pr = poll(&op, 1, 0);
-		                if (pr > 0) {
-		                    if (op.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+		                int pr = io_poll(&op, 1, 0);
+		                if (pr > 0 && (op.revents & (POLLHUP | POLLERR | POLLNVAL))) {
+		                    if (other_idx == p0) goto pause_a;
+		                    else goto pause_b;
+		                }
+		                // Lines queued before this turn (e.g. pipelined behind the join) are invisible to poll().
+		                if ((pr > 0 && (op.revents & POLLIN)) || has_queued_line(other_fd)) {
+		                    int dr = drain_nonactive_player_input(
+		                        L, other_idx, other_fd, turn, &forced_winner_idx);
+		                    if (dr < 0) {
 		                        if (other_idx == p0) goto pause_a;
 		                        else goto pause_b;
 		                    }
-		                    if (op.revents & POLLIN) {
-		                        int dr = drain_nonactive_player_input(
-		                            L, other_idx, other_fd, turn, &forced_winner_idx,
-		                            nonactive_inbuf[other_idx], &nonactive_inlen[other_idx]);
-		                        if (dr < 0) {
-		                            if (other_idx == p0) goto pause_a;
-		                            else goto pause_b;
-		                        }
-		                        if (dr > 0) goto end_game;
+		                    if (dr > 0) {
+		                        end_reason = dr == 2 ? GAME_END_FORFEIT : GAME_END_VIOLATION;
+		                        goto end_game;
 		                    }
 		                }
 		            }
 
-		            // Keep the current player alive with PING/PONG.
-		            // The non-active player's socket is handled non-blocking above (PING/PONG + violations).
-		            if (now - last_ping >= PING_INTERVAL_SEC) {
-	                if (write_all(pfd, "C45PI\n") < 0) goto pause_turn;
-	                last_ping = now;
-	            }
-
-            char buf[READ_BUF];
-	            int r = read_line_timeout(pfd, buf, sizeof(buf), 1);
+		            // The client originates keep-alive PINGs (interval advertised in C45OK); any line
+		            // from the current player counts as liveness. The non-active player's socket is
+		            // handled non-blocking above (PING/PONG + violations).
+	            // Wake at the turn deadline (to the millisecond) or each second for the liveness check.
+	            unsigned long long now_ms = mono_ms();
+	            int wait_ms = now_ms >= turn_end_ms ? 0 : (int)(turn_end_ms - now_ms);
+	            if (wait_ms > 1000) wait_ms = 1000;
+	            int r = read_line_timeout_ms(pfd, buf, sizeof(T->in), wait_ms);
+	            if (r > 0) last_rx = now;
 	            if (r == -2) {
-	                // no input this second
+	                // no input before the wakeup
 		            } else if (r <= 0) {
 		                goto pause_turn;
 			            } else if (is_token(buf, "C45PO")) {
-			                last_pong = now;
 			                continue;
 			            } else if (is_token(buf, "C45PI")) {
 			                (void)write_all(pfd, "C45PO\n");
-			                last_pong = now;
 			                continue;
 			            } else if (is_token(buf, "C45YES")) {
 			                continue;
-		            } else if (is_back_request_for_name(buf, L->players[turn].name) == 1) {
-	                active_name_mark_back(L->players[turn].name, pfd);
+		            } else if (is_back_request_for_name(buf, T->names[turn]) == 1) {
+	                active_name_mark_back(T->names[turn], pfd);
 	                forced_winner_idx = 1 - turn;
+	                end_reason = GAME_END_FORFEIT;
 	                goto end_game;
 		            } else if (is_token(buf, "C45H")) {
+	            lobby_note_turn(L, turn_sent_ms);
+	            think_ms[turn] += mono_ms() - turn_sent_ms;
+	            trace_event(pfd, TRACE_TURN_RESPONSE, 'H', NULL);
 	            pthread_mutex_lock(&L->mtx);
 	            Card nc = deck_draw(&L->deck);
 	            Player* P = &L->players[turn];
 	            P->hand[P->hand_size++] = nc;
             char cs[3]; card_to_str(nc, cs);
             pthread_mutex_unlock(&L->mtx);
-	            char msg[32]; snprintf(msg, sizeof(msg), "C45C %s\n", cs);
-	            if (write_all(pfd, msg) < 0) goto pause_turn;
+            replica_mark(L);
+	            snprintf(line, sizeof(T->out), "C45C %s\n", cs);
+	            if (write_all(pfd, line) < 0) goto pause_turn;
 	            // check for overhand
 	            pthread_mutex_lock(&L->mtx);
 	            int v = hand_value(P->hand, P->hand_size);
 		            if (v > 21) {
 		                P->busted = 1;
 		                pthread_mutex_unlock(&L->mtx);
-			                snprintf(line, sizeof(line), "C45B %s %d\n", P->name, v);
+		                replica_mark(L);
+			                snprintf(line, sizeof(T->out), "C45B %s %d\n", T->names[turn], v);
 			                // Send bust only to the player who busted (do not reveal to opponent mid-game).
 			                if (write_all(pfd, line) < 0) goto pause_turn;
 		            } else {
@@ -755,28 +1286,36 @@ static void* lobby_game_thread(void* arg) {
 	            turn = 1 - turn;
 	            break;
 		            } else if (is_token(buf, "C45S")) {
+		                lobby_note_turn(L, turn_sent_ms);
+		                think_ms[turn] += mono_ms() - turn_sent_ms;
+		                trace_event(pfd, TRACE_TURN_RESPONSE, 'S', NULL);
 		                pthread_mutex_lock(&L->mtx);
 		                L->players[turn].stood = 1;
 	                pthread_mutex_unlock(&L->mtx);
+	                replica_mark(L);
                 turn = 1 - turn;
                 break;
 	            } else {
 	                // Any other line is a protocol violation: kick the current player and end the game.
 	                player_disconnect_fd(L, turn);
 	                forced_winner_idx = 1 - turn;
+	                end_reason = GAME_END_VIOLATION;
 	                goto end_game;
 	            }
 
-	            if (now - last_pong > PONG_TIMEOUT_SEC) goto pause_turn;
+	            if (keepalive && now - last_rx > g_keepalive_timeout_sec) goto pause_turn;
 
-	            if (now - turn_start >= TURN_TIMEOUT_SEC) {
-                // If the client is alive (keeps answering pong) -> timeout means auto-stand.
+	            if (mono_ms() >= turn_end_ms) {
+                // If the client is alive (keeps pinging) -> timeout means auto-stand.
                 // If not -> treat as disconnect and allow reconnect.
-                if (now - last_pong > PONG_TIMEOUT_SEC) goto pause_turn;
+                if (keepalive && now - last_rx > g_keepalive_timeout_sec) goto pause_turn;
 
                 pthread_mutex_lock(&L->mtx);
                 L->players[turn].stood = 1;
                 pthread_mutex_unlock(&L->mtx);
+                replica_mark(L);
+	                trace_event(pfd, TRACE_TURN_RESPONSE, 'T', NULL);
+	                think_ms[turn] += mono_ms() - turn_sent_ms;
 	                if (pfd >= 0) write_all(pfd, "C45TO\n");
 	                turn = 1 - turn;
 	                break;
@@ -793,6 +1332,7 @@ pause_a: {
         int rr = wait_for_reconnect(L, missing, other);
         if (rr == 0) goto turn_loop;
         if (rr == 1) forced_winner_idx = other;
+        end_reason = rr == 1 ? GAME_END_ABANDONED : GAME_END_LOST;
         goto end_game;
     }
 pause_b: {
@@ -802,6 +1342,7 @@ pause_b: {
         int rr = wait_for_reconnect(L, missing, other);
         if (rr == 0) goto turn_loop;
         if (rr == 1) forced_winner_idx = other;
+        end_reason = rr == 1 ? GAME_END_ABANDONED : GAME_END_LOST;
         goto end_game;
     }
 pause_turn: {
@@ -811,45 +1352,101 @@ pause_turn: {
         int rr = wait_for_reconnect(L, missing, other);
         if (rr == 0) goto turn_loop;
         if (rr == 1) forced_winner_idx = other;
+        end_reason = rr == 1 ? GAME_END_ABANDONED : GAME_END_LOST;
         goto end_game;
     }
 
 end_game:
+    {
+        LobbyStats* st = &L->stats;
+        int first = atomic_load_explicit(&st->games, memory_order_relaxed) == 0;
+        stats_ewma(&st->game_ms_avg, first, mono_ms() - game_start_ms);
+        atomic_fetch_add_explicit(&st->games, 1, memory_order_relaxed);
+    }
+
     // count the points and announce the result
     pthread_mutex_lock(&L->mtx);
     int va = A->busted ? -1 : hand_value(A->hand, A->hand_size);
     int vb = B->busted ? -1 : hand_value(B->hand, B->hand_size);
-    char winner_name[MAX_NAME_LEN];
-    if (forced_winner_idx == p0) strncpy(winner_name, A->name, sizeof(winner_name) - 1);
-    else if (forced_winner_idx == p1) strncpy(winner_name, B->name, sizeof(winner_name) - 1);
-    else if (va > vb) strncpy(winner_name, A->name, sizeof(winner_name) - 1);
-    else if (vb > va) strncpy(winner_name, B->name, sizeof(winner_name) - 1);
-    else strncpy(winner_name, "PUSH", sizeof(winner_name) - 1);
-    winner_name[sizeof(winner_name) - 1] = '\0';
+    int fdA = A->fd;
+    int fdB = B->fd;
     pthread_mutex_unlock(&L->mtx);
-
-    char res[256];
-    int res_len = snprintf(res, sizeof(res), "C45R %s %d %s %d %s\n",
-                           A->name, va, B->name, vb, winner_name);
-    if (res_len < 0 || (size_t)res_len >= sizeof(res)) {
-        snprintf(res, sizeof(res), "C45R %s %d %s %d %s\n",
-                 "?", va, "?", vb, "PUSH");
+    const char* winner_name = "PUSH";
+    if (forced_winner_idx == p0) winner_name = T->names[p0];
+    else if (forced_winner_idx == p1) winner_name = T->names[p1];
+    else if (va > vb) winner_name = T->names[p0];
+    else if (vb > va) winner_name = T->names[p1];
+
+    // The seed is revealed only now, so players can check the deck against C45D's commitment.
+    char* res = T->out;
+    int res_len = snprintf(res, sizeof(T->out), "C45R %s %d %s %d %s %s\n",
+                           T->names[p0], va, T->names[p1], vb, winner_name, L->proof.seed);
+    if (res_len < 0 || (size_t)res_len >= sizeof(T->out)) {
+        snprintf(res, sizeof(T->out), "C45R %s %d %s %d %s %s\n",
+                 "?", va, "?", vb, "PUSH", L->proof.seed);
     }
-    if (A->fd >= 0) write_all(A->fd, res);
-    if (B->fd >= 0) write_all(B->fd, res);
+    if (fdA >= 0) write_all(fdA, res);
+    if (fdB >= 0) write_all(fdB, res);
+
+    int winner_seat = winner_name == T->names[p0] ? 0 : winner_name == T->names[p1] ? 1 : 2;
+    record_result(L, va, vb, winner_seat, end_reason, turns_offered, think_ms, game_start_ms);
 
     pthread_mutex_lock(&L->mtx);
     L->is_running = 0; // end for game
+    L->turn_deadline_ms = 0;
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        // Keep the name reserved until the client disconnects; just free the seat,
+        // in the same critical section as is_running so no join slips in between
+        // (this lobby only: a multi-table session may sit at other tables under the same name).
+        (void)lobby_remove_player_locked((int)(L - g_lobbies), T->names[p]);
+    }
+    lobby_version_bump();
+    // Wake the client threads and multi-table sessions waiting for the end of this game.
+    pthread_cond_broadcast(&L->changed);
     pthread_mutex_unlock(&L->mtx);
+    replica_mark(L);
+}
 
+/**
+ * Lobby game thread entry point: one detached thread per game (public lobbies).
+ *
+ * @param arg The Lobby to run.
+ * @return NULL.
+ */
+static void* lobby_game_thread(void* arg) {
+    Lobby* L = (Lobby*)arg;
+    profiler_thread_begin(PROFILE_THREAD_GAME);
+    run_game(L);
+    mem_table_end();
+    profiler_thread_end();
+    return NULL;
+}
 
-    for (int p = 0; p < LOBBY_SIZE; ++p) {
-        // Keep the name reserved until the client disconnects;
-        // just remove the player from the lobby after the game ends.
-        char* n = L->players[p].name;
-        lobby_remove_player_by_name(n);
+/**
+ * Bot lobby worker: a persistent game loop for one bot table.
+ *
+ * Bot games are short and back to back, so the table keeps one thread that
+ * sleeps on Lobby.changed until start_game_if_ready() sets is_running, instead
+ * of creating a thread per game. Exits once idle after lobbies_free() sets
+ * worker_stop.
+ *
+ * @param arg The Lobby to run.
+ * @return NULL.
+ */
+static void* bot_table_worker(void* arg) {
+    Lobby* L = (Lobby*)arg;
+    profiler_thread_begin(PROFILE_THREAD_GAME);
+    pthread_mutex_lock(&L->mtx);
+    for (;;) {
+        while (!L->is_running && !L->worker_stop) pthread_cond_wait(&L->changed, &L->mtx);
+        if (!L->is_running) break;
+        pthread_mutex_unlock(&L->mtx);
+        run_game(L);
+        mem_table_end();
+        pthread_mutex_lock(&L->mtx);
     }
-
+    pthread_mutex_unlock(&L->mtx);
+    profiler_thread_end();
     return NULL;
 }
 
@@ -878,13 +1475,23 @@ int lobby_name_exists(const char* name) {
 }
 
 /**
- * Free the global lobby array and destroy lobby mutexes.
+ * Stop the bot table workers, then free the global lobby array and destroy
+ * lobby mutexes.
  */
 void lobbies_free(void) {
     if (!g_lobbies) return;
 
     for (int i = 0; i < g_lobby_count; ++i) {
-        pthread_mutex_destroy(&g_lobbies[i].mtx);
+        Lobby* L = &g_lobbies[i];
+        pthread_mutex_lock(&L->mtx);
+        int joinable = L->worker_on;
+        L->worker_stop = 1;
+        pthread_cond_broadcast(&L->changed);
+        pthread_mutex_unlock(&L->mtx);
+        // A bot game still running ends within a few turn clocks once its sockets are closed.
+        if (joinable) pthread_join(L->worker, NULL);
+        pthread_mutex_destroy(&L->mtx);
+        pthread_cond_destroy(&L->changed);
     }
 
     free(g_lobbies);
@@ -0,0 +1,101 @@
+/*
+ * gamefeed.c
+ *
+ * Purpose:
+ *   Finished-game stream shared by the results export and the history archive
+ *   (see gamefeed.h).
+ *
+ * Responsibilities:
+ *   - Hand game threads a ring slot to fill in place.
+ *   - On one writer thread, pass every game to results_add() and history_append(),
+ *     and let the export flush and rotate between passes.
+ *
+ * Table of contents:
+ *   - Writer thread: feed_consume(), feed_idle()
+ *   - Recording: gamefeed_claim(), gamefeed_publish()
+ *   - Lifecycle: gamefeed_open(), gamefeed_close()
+ */
+
+#define _GNU_SOURCE
+#include "gamefeed.h"
+#include "history.h"
+#include "mpsc.h"
+
+#include <stdio.h>
+
+#define GAMEFEED_RING_SLOTS  4096
+#define GAMEFEED_IDLE_NS     10000000L   /* writer sleep when the ring is empty (10 ms) */
+
+static void feed_consume(const void* rec);
+static void feed_idle(int drained);
+
+static MpscWriter g_writer = { .idle_ns = GAMEFEED_IDLE_NS, .consume = feed_consume, .idle = feed_idle };
+
+/* --- Writer thread --- */
+
+/**
+ * Pass one finished game to every open consumer.
+ *
+ * @param rec GameResult.
+ */
+static void feed_consume(const void* rec) {
+    const GameResult* r = (const GameResult*)rec;
+    results_add(r);
+    history_append(r);
+}
+
+/**
+ * Let the results export write aged batches and rotate idle files.
+ *
+ * @param drained Unused.
+ */
+static void feed_idle(int drained) {
+    (void)drained;
+    results_tick();
+}
+
+/* --- Recording --- */
+
+/**
+ * Claim the slot of one finished game.
+ *
+ * @param ticket Output: ticket for gamefeed_publish().
+ * @return Slot, or NULL when the feed is off or full.
+ */
+GameResult* gamefeed_claim(size_t* ticket) {
+    if (!atomic_load_explicit(&g_writer.on, memory_order_relaxed)) return NULL;
+    return (GameResult*)mpsc_claim(&g_writer.ring, ticket); // full: dropped (counted by the ring)
+}
+
+/**
+ * Pass a filled slot to the writer thread.
+ *
+ * @param ticket Ticket returned by gamefeed_claim().
+ */
+void gamefeed_publish(size_t ticket) {
+    mpsc_publish(&g_writer.ring, ticket);
+}
+
+/* --- Lifecycle --- */
+
+/**
+ * Start the writer thread if the results export or the history archive is open.
+ *
+ * @return 0 on success or when nothing is open; -1 on error.
+ */
+int gamefeed_open(void) {
+    if (!results_is_open() && !history_is_open()) return 0;
+    return mpsc_writer_start(&g_writer, GAMEFEED_RING_SLOTS, sizeof(GameResult));
+}
+
+/**
+ * Hand the queued games to the consumers and stop the writer thread.
+ *
+ * The ring itself is not freed: a game thread may still be inside
+ * gamefeed_claim() while the server shuts down.
+ */
+void gamefeed_close(void) {
+    if (!mpsc_writer_stop(&g_writer)) return;
+    size_t dropped = atomic_load(&g_writer.ring.dropped);
+    if (dropped) printf("[GAMEFEED] %zu finished games dropped (ring full)\n", dropped);
+}
@@ -0,0 +1,452 @@
+/*
+ * history.c
+ *
+ * Purpose:
+ *   Indexed game-history archive (see history.h for the file format and indexes).
+ *
+ * Responsibilities:
+ *   - Append finished games from the game feed (gamefeed.h) to the memory-mapped
+ *     archive, linking each record to the previous game of both players.
+ *   - Keep the name and game-id indexes (open addressing) and answer queries
+ *     from client threads under a read lock.
+ *   - Rebuild the indexes from the archive when the server starts.
+ *
+ * Table of contents:
+ *   - Archive: record_at(), archive_map(), archive_grow()
+ *   - Indexes: name_hash(), name_slot(), names_grow(), id_slot(), ids_grow(), index_add()
+ *   - Game feed consumer: history_append()
+ *   - Queries: history_player_games(), history_find_game()
+ *   - Lifecycle: history_open(), history_close(), history_is_open()
+ */
+
+#define _GNU_SOURCE
+#include "history.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HISTORY_INDEX_MIN   4096        /* initial slots of each index (power of two) */
+
+typedef struct {
+    char     magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t count;   /* committed records */
+} HistoryHeader;
+
+/* Name index slot: the player's latest record; the name itself is read from that record. */
+typedef struct {
+    uint32_t hash;
+    uint32_t rec;     /* record number + 1; 0 = empty slot */
+} NameSlot;
+
+/* Game-id index slot. */
+typedef struct {
+    uint64_t id;
+    uint32_t rec;     /* record number + 1; 0 = empty slot */
+} IdSlot;
+
+char g_history_path[256] = "";
+
+static int g_history_on = 0;   /* set before the game feed starts, cleared after it stopped */
+
+/* Archive mapping and indexes: changed by the game feed writer thread under the
+ * write lock (it reads them without the lock, being the only writer); queries
+ * hold the read lock. */
+static pthread_rwlock_t g_lock = PTHREAD_RWLOCK_INITIALIZER;
+static int       g_fd = -1;
+static uint8_t*  g_map = NULL;
+static size_t    g_map_bytes;
+static uint64_t  g_cap;          /* records the file has room for */
+static NameSlot* g_names = NULL;
+static size_t    g_names_mask, g_names_used;
+static IdSlot*   g_ids = NULL;
+static size_t    g_ids_mask;
+
+/* Game feed writer thread only. */
+static unsigned long long g_appended, g_lost;
+
+/* --- Archive --- */
+
+static HistoryHeader* header(void) {
+    return (HistoryHeader*)g_map;
+}
+
+/**
+ * @param i Record number.
+ * @return Record @p i in the mapping.
+ */
+static HistoryRecord* record_at(uint64_t i) {
+    return (HistoryRecord*)(g_map + HISTORY_HEADER_BYTES + i * sizeof(HistoryRecord));
+}
+
+/**
+ * Map the whole archive file.
+ *
+ * @param bytes File size.
+ * @return 0 on success; -1 on error.
+ */
+static int archive_map(size_t bytes) {
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, g_fd, 0);
+    if (p == MAP_FAILED) {
+        perror("history: mmap");
+        return -1;
+    }
+    g_map = (uint8_t*)p;
+    g_map_bytes = bytes;
+    g_cap = (bytes - HISTORY_HEADER_BYTES) / sizeof(HistoryRecord);
+    return 0;
+}
+
+/**
+ * Extend the file by HISTORY_GROW_RECORDS records and remap it (write lock held
+ * while the mapping moves).
+ *
+ * @return 0 on success; -1 on error (the archive stays as it was).
+ */
+static int archive_grow(void) {
+    size_t bytes = g_map_bytes + (size_t)HISTORY_GROW_RECORDS * sizeof(HistoryRecord);
+    if (ftruncate(g_fd, (off_t)bytes) != 0) {
+        perror("history: ftruncate");
+        return -1;
+    }
+    pthread_rwlock_wrlock(&g_lock);
+    void* p = mremap(g_map, g_map_bytes, bytes, MREMAP_MAYMOVE);
+    if (p != MAP_FAILED) {
+        g_map = (uint8_t*)p;
+        g_map_bytes = bytes;
+        g_cap = (bytes - HISTORY_HEADER_BYTES) / sizeof(HistoryRecord);
+    }
+    pthread_rwlock_unlock(&g_lock);
+    if (p == MAP_FAILED) {
+        perror("history: mremap");
+        return -1;
+    }
+    return 0;
+}
+
+/* --- Indexes --- */
+
+/**
+ * FNV-1a hash of a player name.
+ */
+static uint32_t name_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < MAX_NAME_LEN && name[i]; ++i) h = (h ^ (uint8_t)name[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+/**
+ * @return Seat of @p name in record @p r; -1 if the player is not in it.
+ */
+static int record_seat(const HistoryRecord* r, const char* name) {
+    for (int s = 0; s < LOBBY_SIZE; ++s)
+        if (strncmp(r->name[s], name, MAX_NAME_LEN) == 0) return s;
+    return -1;
+}
+
+/**
+ * Find the name index slot of a player.
+ *
+ * @param name Player name.
+ * @param h    name_hash(name).
+ * @return The player's slot, or the empty slot where it would go.
+ */
+static NameSlot* name_slot(const char* name, uint32_t h) {
+    for (size_t i = h & g_names_mask;; i = (i + 1) & g_names_mask) {
+        NameSlot* s = &g_names[i];
+        if (!s->rec) return s;
+        if (s->hash == h && record_seat(record_at(s->rec - 1), name) >= 0) return s;
+    }
+}
+
+/**
+ * Find the id index slot of a game.
+ *
+ * @param id Game id.
+ * @return The game's slot, or the empty slot where it would go.
+ */
+static IdSlot* id_slot(uint64_t id) {
+    uint64_t h = id * 0x9E3779B97F4A7C15ull;
+    for (size_t i = (size_t)(h >> 32) & g_ids_mask;; i = (i + 1) & g_ids_mask) {
+        IdSlot* s = &g_ids[i];
+        if (!s->rec || s->id == id) return s;
+    }
+}
+
+/**
+ * Double the name index (slots keep their hash, so no name is compared).
+ *
+ * @return 0 on success; -1 on allocation failure.
+ */
+static int names_grow(void) {
+    size_t slots = (g_names_mask + 1) * 2;
+    NameSlot* t = (NameSlot*)calloc(slots, sizeof(NameSlot));
+    if (!t) return -1;
+    for (size_t i = 0; i <= g_names_mask; ++i) {
+        const NameSlot* s = &g_names[i];
+        if (!s->rec) continue;
+        size_t j = s->hash & (slots - 1);
+        while (t[j].rec) j = (j + 1) & (slots - 1);
+        t[j] = *s;
+    }
+    pthread_rwlock_wrlock(&g_lock);
+    free(g_names);
+    g_names = t;
+    g_names_mask = slots - 1;
+    pthread_rwlock_unlock(&g_lock);
+    return 0;
+}
+
+/**
+ * Double the id index.
+ *
+ * @return 0 on success; -1 on allocation failure.
+ */
+static int ids_grow(void) {
+    IdSlot* old = g_ids;
+    size_t old_mask = g_ids_mask;
+    IdSlot* t = (IdSlot*)calloc((old_mask + 1) * 2, sizeof(IdSlot));
+    if (!t) return -1;
+    pthread_rwlock_wrlock(&g_lock);
+    g_ids = t;
+    g_ids_mask = (old_mask + 1) * 2 - 1;
+    for (size_t i = 0; i <= old_mask; ++i)
+        if (old[i].rec) *id_slot(old[i].id) = old[i];
+    pthread_rwlock_unlock(&g_lock);
+    free(old);
+    return 0;
+}
+
+/**
+ * Index record @p n: it becomes the latest game of both its players. Caller
+ * holds the write lock (or is opening the archive).
+ *
+ * @param n Record number.
+ */
+static void index_add(uint64_t n) {
+    const HistoryRecord* r = record_at(n);
+    for (int s = 0; s < LOBBY_SIZE; ++s) {
+        uint32_t h = name_hash(r->name[s]);
+        NameSlot* slot = name_slot(r->name[s], h);
+        if (!slot->rec) {
+            slot->hash = h;
+            g_names_used++;
+        }
+        slot->rec = (uint32_t)(n + 1);
+    }
+    IdSlot* id = id_slot(r->game_id);
+    id->id = r->game_id;
+    id->rec = (uint32_t)(n + 1);
+}
+
+/* --- Game feed consumer --- */
+
+/**
+ * Append one game to the archive and index it.
+ *
+ * The record is written past the committed count, where no query looks, and
+ * published together with the index update under the write lock.
+ *
+ * @param g Finished game.
+ */
+void history_append(const GameResult* g) {
+    if (!g_history_on) return;
+    uint64_t n = header()->count;
+    if (n >= UINT32_MAX - 1 || (n == g_cap && archive_grow() != 0) ||
+        ((n + 1) * 2 > g_ids_mask + 1 && ids_grow() != 0) ||
+        ((g_names_used + LOBBY_SIZE) * 2 > g_names_mask + 1 && names_grow() != 0)) {
+        g_lost++;
+        return;
+    }
+
+    HistoryRecord* r = record_at(n);
+    memset(r, 0, sizeof(*r));
+    r->game_id     = g->game_id;
+    r->end_ms      = g->end_ms;
+    r->duration_ms = g->duration_ms;
+    r->lobby       = g->lobby;
+    r->turns       = g->turns;
+    r->profile     = g->profile;
+    r->end_reason  = g->end_reason;
+    r->winner      = g->winner;
+    for (int s = 0; s < LOBBY_SIZE; ++s) {
+        r->value[s] = g->value[s];
+        r->hand_size[s] = g->hand_size[s] > RESULTS_MAX_CARDS ? RESULTS_MAX_CARDS : g->hand_size[s];
+        memcpy(r->hand[s], g->hand[s], r->hand_size[s]);
+        memcpy(r->name[s], g->name[s], MAX_NAME_LEN);
+        r->name[s][MAX_NAME_LEN - 1] = '\0';
+        r->prev[s] = name_slot(r->name[s], name_hash(r->name[s]))->rec;
+    }
+
+    pthread_rwlock_wrlock(&g_lock);
+    index_add(n);
+    header()->count = n + 1;
+    pthread_rwlock_unlock(&g_lock);
+    g_appended++;
+}
+
+/* --- Queries --- */
+
+/**
+ * Copy a player's latest games, newest first, by following the record links.
+ *
+ * @param name Player name.
+ * @param max  Maximum number of games.
+ * @param out  Output entries.
+ * @return Number of games copied.
+ */
+int history_player_games(const char* name, int max, HistoryEntry* out) {
+    if (!name || !*name || max <= 0) return 0;
+    if (max > HISTORY_MAX_PAGE) max = HISTORY_MAX_PAGE;
+    int n = 0;
+    pthread_rwlock_rdlock(&g_lock);
+    if (g_map && g_names) {
+        uint32_t rec = name_slot(name, name_hash(name))->rec;
+        while (rec && n < max) {
+            const HistoryRecord* r = record_at(rec - 1);
+            int seat = record_seat(r, name);
+            if (seat < 0) break;   // cannot happen with a consistent archive
+            HistoryEntry* e = &out[n++];
+            e->game_id   = r->game_id;
+            e->end_ms    = r->end_ms;
+            e->my_value  = r->value[seat];
+            e->opp_value = r->value[1 - seat];
+            e->result    = r->winner == 2 ? 'P' : r->winner == seat ? 'W' : 'L';
+            memcpy(e->opponent, r->name[1 - seat], MAX_NAME_LEN);
+            rec = r->prev[seat];
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+    return n;
+}
+
+/**
+ * Look a game up by id.
+ *
+ * @param game_id Game id.
+ * @param out     Output record.
+ * @return 0 if found; -1 otherwise.
+ */
+int history_find_game(uint64_t game_id, HistoryRecord* out) {
+    int rc = -1;
+    pthread_rwlock_rdlock(&g_lock);
+    if (g_map && g_ids) {
+        const IdSlot* s = id_slot(game_id);
+        if (s->rec) {
+            memcpy(out, record_at(s->rec - 1), sizeof(*out));
+            rc = 0;
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+    return rc;
+}
+
+/* --- Lifecycle --- */
+
+/**
+ * Size of an index for @p entries entries (power of two, at most half full).
+ */
+static size_t index_slots(uint64_t entries) {
+    size_t slots = HISTORY_INDEX_MIN;
+    while ((uint64_t)slots < entries * 2) slots *= 2;
+    return slots;
+}
+
+/**
+ * Open (or create) the archive and rebuild the indexes.
+ *
+ * @param path Archive file path.
+ * @return 0 on success; -1 on error.
+ */
+int history_open(const char* path) {
+    if (!path || !*path) return -1;
+    g_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (g_fd < 0) {
+        perror("history");
+        return -1;
+    }
+    struct stat st;
+    int fresh = fstat(g_fd, &st) == 0 && st.st_size == 0;
+    size_t bytes = fresh ? HISTORY_HEADER_BYTES + (size_t)HISTORY_GROW_RECORDS * sizeof(HistoryRecord)
+                         : (size_t)st.st_size;
+    if ((fresh && ftruncate(g_fd, (off_t)bytes) != 0) || bytes < HISTORY_HEADER_BYTES || archive_map(bytes) != 0) {
+        fprintf(stderr, "history: cannot map %s\n", path);
+        close(g_fd);
+        g_fd = -1;
+        return -1;
+    }
+
+    HistoryHeader* h = header();
+    if (fresh) {
+        memcpy(h->magic, HISTORY_MAGIC, sizeof(h->magic));
+        h->record_size = (uint32_t)sizeof(HistoryRecord);
+        h->count = 0;
+    }
+    if (memcmp(h->magic, HISTORY_MAGIC, sizeof(h->magic)) != 0 ||
+        h->record_size != sizeof(HistoryRecord) || h->count > g_cap) {
+        fprintf(stderr, "history: %s is not a game archive of this version\n", path);
+        munmap(g_map, g_map_bytes);
+        g_map = NULL;
+        close(g_fd);
+        g_fd = -1;
+        return -1;
+    }
+
+    // Rebuild the indexes: one pass in archive order leaves every name at its latest game.
+    size_t name_slots = index_slots(h->count * LOBBY_SIZE), id_slots = index_slots(h->count);
+    g_names = (NameSlot*)calloc(name_slots, sizeof(NameSlot));
+    g_ids = (IdSlot*)calloc(id_slots, sizeof(IdSlot));
+    if (!g_names || !g_ids) {
+        history_close();
+        return -1;
+    }
+    g_names_mask = name_slots - 1;
+    g_ids_mask = id_slots - 1;
+    g_names_used = 0;
+    for (uint64_t i = 0; i < h->count; ++i) index_add(i);
+
+    g_history_on = 1;
+    printf("[HISTORY] Archive %s: %llu games, %zu players\n",
+           path, (unsigned long long)h->count, g_names_used);
+    return 0;
+}
+
+/**
+ * Unmap the archive (the game feed is stopped). Queries after this return nothing.
+ */
+void history_close(void) {
+    if (g_history_on) {
+        g_history_on = 0;
+        printf("[HISTORY] %llu games archived", g_appended);
+        if (g_lost) printf(", %llu lost (archive or index could not grow)", g_lost);
+        printf("\n");
+    }
+
+    pthread_rwlock_wrlock(&g_lock);
+    if (g_map) {
+        msync(g_map, g_map_bytes, MS_SYNC);
+        munmap(g_map, g_map_bytes);
+        g_map = NULL;
+    }
+    free(g_names);
+    free(g_ids);
+    g_names = NULL;
+    g_ids = NULL;
+    pthread_rwlock_unlock(&g_lock);
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+}
+
+/**
+ * @return 1 if the archive is open; 0 otherwise.
+ */
+int history_is_open(void) {
+    return g_history_on;
+}
@@ -6,7 +6,8 @@
  *
  * Responsibilities:
  *   - Parse CLI options and config.txt.
- *   - Initialize lobbies and start the server loop.
+ *   - Raise RLIMIT_NOFILE, initialize lobbies and start the server loop.
+ *   - Hot standby: follow a primary until takeover ("-standby"), stream tables as a primary.
  *
  * Table of contents:
  *   - CLI parsing: parse_cli_net(), parse_port_strict(), is_ip_valid()
@@ -15,7 +16,16 @@
  */
 
 #include "server.h"
+#include "capture.h"
 #include "game.h"
+#include "gamefeed.h"
+#include "history.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "replica.h"
+#include "protocol.h"
+#include "results.h"
+#include "trace.h"
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stdio.h>
@@ -29,12 +39,13 @@
  */
 static void print_help(const char* prog) {
     printf("Usage:\n");
-    printf("  %s [-i IP] [-p PORT]\n", prog);
+    printf("  %s [-i IP] [-p PORT] [-standby]\n", prog);
     printf("  %s -help\n", prog);
     printf("\n");
     printf("Options:\n");
     printf("  -i IP     Bind IP address (example: 0.0.0.0 or localhost)\n");
     printf("  -p PORT   Bind port (1..65535)\n");
+    printf("  -standby  Run as hot standby of the primary on REPLICA_SOCKET\n");
     printf("  -help     Show this help and exit\n");
     printf("\n");
     printf("Notes:\n");
@@ -42,6 +53,7 @@ static void print_help(const char* prog) {
     printf("  - To override via CLI, you must provide both -i and -p.\n");
     printf("  - If CLI IP/PORT are invalid, config.txt is used.\n");
     printf("  - If config.txt IP/PORT are invalid, defaults are used.\n");
+    printf("  - A standby serves nothing until the primary dies, then takes over its port.\n");
 }
 
 /**
@@ -125,6 +137,7 @@ static int parse_cli_net(int argc, char** argv, CliNet* out) {
     for (int i = 1; i < argc; ++i) {
         const char* a = argv[i];
 
+        if (strcmp(a, "-standby") == 0) continue;   // handled in main()
         if (strcmp(a, "-i") == 0) {
             out->requested = 1;
             if (i + 1 >= argc) return 0;
@@ -235,6 +248,9 @@ int main(int argc, char** argv) {
     int default_port = g_server_port;
 
     load_config("config.txt");
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-standby") == 0) g_replica_role = REPLICA_STANDBY;
+    }
 
     CliNet cli = {0};
     if (parse_cli_net(argc, argv, &cli) < 0) {
@@ -300,11 +316,53 @@ int main(int argc, char** argv) {
         }
     }
 
+    // Before fault_start(): the fault link table is sized from the raised limit.
+    fd_limit_raise();
     if (lobbies_init() != 0) {
         fprintf(stderr, "Failed to init lobbies\n");
         return 1;
     }
+    if (fault_start() != 0) {
+        fprintf(stderr, "Cannot start the fault sender; fault injection disabled.\n");
+        g_fault.enabled = 0;
+    }
+    if (g_capture_path[0] && capture_open(g_capture_path) != 0) {
+        fprintf(stderr, "Cannot open capture file %s; capture disabled.\n", g_capture_path);
+    }
+    if (g_trace_path[0] && trace_open(g_trace_path) != 0) {
+        fprintf(stderr, "Cannot open trace file %s; tracing disabled.\n", g_trace_path);
+    }
+    if (g_results_dir[0] && results_open(g_results_dir) != 0) {
+        fprintf(stderr, "Cannot export results to %s; export disabled.\n", g_results_dir);
+    }
+    if (g_history_path[0] && history_open(g_history_path) != 0) {
+        fprintf(stderr, "Cannot open history archive %s; history disabled.\n", g_history_path);
+    }
+    if (gamefeed_open() != 0) {
+        fprintf(stderr, "Cannot start the game feed; results export and history disabled.\n");
+    }
+    if (g_replica_role == REPLICA_STANDBY && replica_follow() != 0) {
+        fprintf(stderr, "Standby failed\n");
+        lobbies_free();
+        return 1;
+    }
+    if (g_replica_role == REPLICA_PRIMARY) (void)replica_start();
+    if (g_profile_hz > 0 && profiler_start(g_profile_hz) != 0) {
+        fprintf(stderr, "Cannot start the profiler; profiling disabled.\n");
+    }
     int ret = run_server(g_server_ip, g_server_port);
+    if (g_profile_hz > 0) {
+        profiler_stop();
+        int stacks = profiler_dump(g_profile_path);
+        if (stacks >= 0) printf("[PROF] %d stacks written to %s\n", stacks, g_profile_path);
+    }
+    replica_stop();
+    fault_stop();
+    gamefeed_close();
+    results_close();
+    history_close();
+    trace_close();
+    capture_close();
     lobbies_free();
     return ret;
 }
@@ -0,0 +1,390 @@
+/*
+ * metrics.c
+ *
+ * Purpose:
+ *   Memory accounting and connection admission control (see metrics.h).
+ *
+ * Responsibilities:
+ *   - Compute per-connection and per-table costs from the thread stack size.
+ *   - Count admitted connections and running games with atomics (no locks).
+ *   - Derive the admission limit from MAX_CLIENTS, MEM_BUDGET_MB and RLIMIT_NOFILE.
+ *   - Raise RLIMIT_NOFILE at startup; count accept failures and fd-shed connections.
+ *   - Create worker threads with the accounted stack size.
+ *   - Report counters and the process RSS; gate monitoring requests by MONITOR_TOKEN.
+ *
+ * Table of contents:
+ *   - Configuration and counters
+ *   - Costs: mem_set_costs(), mem_connection_cost(), mem_table_cost(), mem_max_connections()
+ *   - Accounting: mem_admit_connection(), mem_release_connection(), mem_table_*()
+ *   - Threads: mem_thread_create(), mem_thread_create_joinable()
+ *   - File descriptors: fd_limit_raise(), fd_limit(), fd_admit_extra(), fd_release_extra(),
+ *     fd_note_accept_error(), fd_note_shed(), count_open_fds()
+ *   - Reporting: read_rss_bytes(), mem_stats_snapshot(), mem_stats_format()
+ *   - Monitoring access: monitor_token_ok()
+ */
+
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "game.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/* --- Configuration and counters --- */
+int g_max_clients     = 1024;
+int g_thread_stack_kb = 128;
+int g_mem_budget_mb   = 0;
+char g_monitor_token[64] = "";
+int g_max_open_files  = 0;
+
+static size_t             g_fixed_bytes = 0;
+static size_t             g_conn_arg_bytes = 0;
+static atomic_int         g_conns = 0;
+static atomic_int         g_peak_conns = 0;
+static atomic_int         g_tables = 0;
+static atomic_ullong      g_rejected = 0;
+static int                g_fd_limit = 0;
+static atomic_ullong      g_accept_errors = 0;
+static atomic_ullong      g_fd_shed = 0;
+static atomic_int         g_extra_fds = 0;
+
+/**
+ * Stack size actually requested for worker threads (THREAD_STACK_KB, at least PTHREAD_STACK_MIN).
+ */
+static size_t thread_stack_bytes(void) {
+    size_t s = (size_t)(g_thread_stack_kb > 0 ? g_thread_stack_kb : 0) * 1024u;
+    if (s < (size_t)PTHREAD_STACK_MIN) s = (size_t)PTHREAD_STACK_MIN;
+    return s;
+}
+
+/**
+ * Stack plus the guard page glibc maps below it.
+ */
+static size_t thread_reserved_bytes(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    return thread_stack_bytes() + (size_t)(page > 0 ? page : 4096);
+}
+
+/* --- Costs --- */
+/**
+ * Record the server's allocation sizes (called once at startup).
+ *
+ * @param fixed_bytes    Memory allocated once (registries, lobby array).
+ * @param conn_arg_bytes Per-connection heap bytes (thread arguments, input queue).
+ */
+void mem_set_costs(size_t fixed_bytes, size_t conn_arg_bytes) {
+    g_fixed_bytes = fixed_bytes;
+    g_conn_arg_bytes = conn_arg_bytes;
+}
+
+/**
+ * Accounted cost of one connection (client thread stack + guard + heap bytes).
+ *
+ * @return Bytes.
+ */
+size_t mem_connection_cost(void) {
+    return thread_reserved_bytes() + g_conn_arg_bytes;
+}
+
+/**
+ * Accounted cost of one running game (game thread stack + guard page; the
+ * table's turn buffers are part of the preallocated lobby array).
+ *
+ * @return Bytes.
+ */
+size_t mem_table_cost(void) {
+    return thread_reserved_bytes();
+}
+
+/**
+ * Current admission limit: MAX_CLIENTS, lowered by MEM_BUDGET_MB when set and
+ * by the fd limit (less the extra fds already charged).
+ *
+ * @return Maximum number of concurrent connections.
+ */
+int mem_max_connections(void) {
+    int max = g_max_clients;
+    if (g_fd_limit > 0) {
+        int by_fd = (g_fd_limit - FD_RESERVED - atomic_load(&g_extra_fds)) / FD_PER_CONN;
+        if (by_fd < 0) by_fd = 0;
+        if (by_fd < max) max = by_fd;
+    }
+    if (g_mem_budget_mb > 0) {
+        unsigned long long budget = (unsigned long long)g_mem_budget_mb * 1024ull * 1024ull;
+        unsigned long long per = mem_connection_cost() + mem_table_cost() / LOBBY_SIZE;
+        unsigned long long avail = budget > g_fixed_bytes ? budget - g_fixed_bytes : 0;
+        unsigned long long n = avail / per;
+        if (n < (unsigned long long)max) max = (int)n;
+    }
+    return max;
+}
+
+/* --- Accounting --- */
+/**
+ * Try to admit one more connection.
+ *
+ * @return 0 if admitted (call mem_release_connection() when it closes); -1 if over the limit.
+ */
+int mem_admit_connection(void) {
+    int max = mem_max_connections();
+    int cur = atomic_load(&g_conns);
+    do {
+        if (cur >= max) {
+            atomic_fetch_add(&g_rejected, 1);
+            return -1;
+        }
+    } while (!atomic_compare_exchange_weak(&g_conns, &cur, cur + 1));
+
+    int peak = atomic_load(&g_peak_conns);
+    while (cur + 1 > peak && !atomic_compare_exchange_weak(&g_peak_conns, &peak, cur + 1)) { }
+    return 0;
+}
+
+/**
+ * Release a connection previously admitted with mem_admit_connection().
+ */
+void mem_release_connection(void) {
+    atomic_fetch_sub(&g_conns, 1);
+}
+
+/**
+ * Account a game thread starting.
+ */
+void mem_table_start(void) {
+    atomic_fetch_add(&g_tables, 1);
+}
+
+/**
+ * Account a game thread finishing.
+ */
+void mem_table_end(void) {
+    atomic_fetch_sub(&g_tables, 1);
+}
+
+/* --- Threads --- */
+/**
+ * Create a detached worker thread with the accounted stack size (THREAD_STACK_KB).
+ *
+ * @param fn  Thread entry point.
+ * @param arg Thread argument.
+ * @return 0 on success; error number from pthread_create() otherwise.
+ */
+int mem_thread_create(void* (*fn)(void*), void* arg) {
+    pthread_attr_t attr;
+    pthread_t th;
+    int rc = pthread_attr_init(&attr);
+    if (rc != 0) return rc;
+    (void)pthread_attr_setstacksize(&attr, thread_stack_bytes());
+    (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    rc = pthread_create(&th, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+/**
+ * Create a joinable worker thread with the accounted stack size (THREAD_STACK_KB).
+ *
+ * @param th  Receives the thread handle (for pthread_join()).
+ * @param fn  Thread entry point.
+ * @param arg Thread argument.
+ * @return 0 on success; error number from pthread_create() otherwise.
+ */
+int mem_thread_create_joinable(pthread_t* th, void* (*fn)(void*), void* arg) {
+    pthread_attr_t attr;
+    int rc = pthread_attr_init(&attr);
+    if (rc != 0) return rc;
+    (void)pthread_attr_setstacksize(&attr, thread_stack_bytes());
+    rc = pthread_create(th, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+/* --- File descriptors --- */
+/**
+ * Raise RLIMIT_NOFILE towards MAX_OPEN_FILES (or the hard limit).
+ *
+ * Raising the hard limit needs CAP_SYS_RESOURCE; without it the soft limit
+ * stops at the hard limit.
+ *
+ * @return Soft limit in effect afterwards.
+ */
+int fd_limit_raise(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return g_fd_limit = 0;
+
+    rlim_t target = g_max_open_files > 0 ? (rlim_t)g_max_open_files : rl.rlim_max;
+    if (target != rl.rlim_cur) {
+        struct rlimit want = rl;
+        want.rlim_cur = target;
+        if (want.rlim_max != RLIM_INFINITY && target > want.rlim_max) want.rlim_max = target;
+        if (setrlimit(RLIMIT_NOFILE, &want) != 0 && target > rl.rlim_max) {
+            want.rlim_cur = rl.rlim_max;
+            want.rlim_max = rl.rlim_max;
+            (void)setrlimit(RLIMIT_NOFILE, &want);
+        }
+        (void)getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    // fd numbers are ints; an "unlimited" soft limit is bounded by fs.nr_open anyway.
+    g_fd_limit = (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > INT_MAX) ? INT_MAX : (int)rl.rlim_cur;
+    return g_fd_limit;
+}
+
+/**
+ * @return Soft RLIMIT_NOFILE recorded by fd_limit_raise() (0 before it ran).
+ */
+int fd_limit(void) {
+    return g_fd_limit;
+}
+
+/**
+ * Charge @p n fds opened by an admitted connection beyond FD_PER_CONN.
+ *
+ * They must fit next to the admitted connections' own fds and FD_RESERVED.
+ *
+ * @param n Number of fds.
+ * @return 0 if charged; -1 if the fd limit would be exceeded.
+ */
+int fd_admit_extra(int n) {
+    int cur = atomic_load(&g_extra_fds);
+    do {
+        if (g_fd_limit > 0 &&
+            (long long)atomic_load(&g_conns) * FD_PER_CONN + cur + n > (long long)g_fd_limit - FD_RESERVED) {
+            return -1;
+        }
+    } while (!atomic_compare_exchange_weak(&g_extra_fds, &cur, cur + n));
+    return 0;
+}
+
+/**
+ * Release fds charged with fd_admit_extra().
+ *
+ * @param n Number of fds.
+ */
+void fd_release_extra(int n) {
+    atomic_fetch_sub(&g_extra_fds, n);
+}
+
+/**
+ * Count an accept() failure the server survived.
+ */
+void fd_note_accept_error(void) {
+    atomic_fetch_add_explicit(&g_accept_errors, 1, memory_order_relaxed);
+}
+
+/**
+ * Count a connection turned away with C45BUSY because fds ran out.
+ */
+void fd_note_shed(void) {
+    atomic_fetch_add_explicit(&g_fd_shed, 1, memory_order_relaxed);
+}
+
+/**
+ * Count open file descriptors (monitoring only: walks /proc/self/fd).
+ *
+ * @return Number of open fds, or -1 if unavailable (e.g. no fd left to open the directory).
+ */
+static int count_open_fds(void) {
+    DIR* d = opendir("/proc/self/fd");
+    if (!d) return -1;
+    int n = 0;
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] != '.') n++;
+    }
+    closedir(d);
+    return n > 0 ? n - 1 : 0; // minus the directory's own fd
+}
+
+/* --- Reporting --- */
+/**
+ * Read the resident set size of this process from /proc/self/statm.
+ *
+ * @return RSS in bytes, or 0 if unavailable.
+ */
+static unsigned long long read_rss_bytes(void) {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long long size = 0, resident = 0;
+    int ok = (fscanf(f, "%llu %llu", &size, &resident) == 2);
+    fclose(f);
+    long page = sysconf(_SC_PAGESIZE);
+    return ok ? resident * (unsigned long long)(page > 0 ? page : 4096) : 0;
+}
+
+/**
+ * Take a snapshot of the memory accounting counters (and current RSS).
+ *
+ * @param out Output snapshot.
+ */
+void mem_stats_snapshot(MemStats* out) {
+    out->conns = atomic_load(&g_conns);
+    out->peak_conns = atomic_load(&g_peak_conns);
+    out->tables = atomic_load(&g_tables);
+    out->max_conns = mem_max_connections();
+    out->conn_bytes = mem_connection_cost();
+    out->table_bytes = mem_table_cost();
+    out->fixed_bytes = g_fixed_bytes;
+    out->accounted_bytes = (unsigned long long)g_fixed_bytes +
+                           (unsigned long long)out->conns * out->conn_bytes +
+                           (unsigned long long)out->tables * out->table_bytes;
+    out->budget_bytes = (unsigned long long)(g_mem_budget_mb > 0 ? g_mem_budget_mb : 0) * 1024ull * 1024ull;
+    out->rejected = atomic_load(&g_rejected);
+    out->rss_bytes = read_rss_bytes();
+    struct rlimit rl;
+    out->fd_limit = g_fd_limit;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < INT_MAX) {
+        out->fd_limit = (int)rl.rlim_cur; // may have been changed from outside (prlimit)
+    }
+    out->fd_open = count_open_fds();
+    out->accept_errors = atomic_load_explicit(&g_accept_errors, memory_order_relaxed);
+    out->fd_shed = atomic_load_explicit(&g_fd_shed, memory_order_relaxed);
+    out->extra_fds = atomic_load(&g_extra_fds);
+}
+
+/**
+ * Format a snapshot as space-separated key=value pairs (no newline).
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int mem_stats_format(char* out, size_t cap) {
+    MemStats s;
+    mem_stats_snapshot(&s);
+    return snprintf(out, cap,
+                    "conns=%d peak_conns=%d max_conns=%d tables=%d "
+                    "conn_bytes=%zu table_bytes=%zu fixed_bytes=%zu "
+                    "accounted_bytes=%llu budget_bytes=%llu rejected=%llu rss_bytes=%llu "
+                    "fd_limit=%d fd_open=%d fd_headroom=%d accept_errors=%llu fd_shed=%llu extra_fds=%d",
+                    s.conns, s.peak_conns, s.max_conns, s.tables,
+                    s.conn_bytes, s.table_bytes, s.fixed_bytes,
+                    s.accounted_bytes, s.budget_bytes, s.rejected, s.rss_bytes,
+                    s.fd_limit, s.fd_open, s.fd_open >= 0 ? s.fd_limit - s.fd_open : -1,
+                    s.accept_errors, s.fd_shed, s.extra_fds);
+}
+
+/* --- Monitoring access --- */
+
+/**
+ * Check the secret of a monitoring request against MONITOR_TOKEN.
+ *
+ * Compares every byte regardless of mismatches, so the reply time does not
+ * reveal how much of the token was right.
+ *
+ * @param token Token sent by the client.
+ * @return 1 if MONITOR_TOKEN is set and the token matches; 0 otherwise.
+ */
+int monitor_token_ok(const char* token) {
+    if (g_monitor_token[0] == '\0' || !token) return 0;
+    size_t n = strlen(g_monitor_token);
+    if (strlen(token) != n) return 0;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < n; ++i) diff |= (unsigned char)(token[i] ^ g_monitor_token[i]);
+    return diff == 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * mpsc.c
+ *
+ * Purpose:
+ *   Bounded lock-free MPSC ring (per-slot sequence numbers, D. Vyukov's scheme).
+ *
+ * Table of contents:
+ *   - Slot layout: cell_seq(), cell_payload()
+ *   - Lifecycle: mpsc_init(), mpsc_free()
+ *   - Producer side: mpsc_claim(), mpsc_publish()
+ *   - Consumer side: mpsc_peek(), mpsc_release()
+ *   - Background writer: writer_main(), mpsc_writer_start(), mpsc_writer_stop()
+ */
+
+#include "mpsc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Each slot starts with its sequence number; the payload follows, aligned to 16 bytes.
+#define MPSC_HDR 16
+
+/**
+ * Sequence number of the slot for a given ticket.
+ */
+static atomic_size_t* cell_seq(MpscRing* r, size_t ticket) {
+    return (atomic_size_t*)(void*)(r->cells + (ticket & r->mask) * r->stride);
+}
+
+/**
+ * Payload of the slot for a given ticket.
+ */
+static void* cell_payload(MpscRing* r, size_t ticket) {
+    return r->cells + (ticket & r->mask) * r->stride + MPSC_HDR;
+}
+
+/**
+ * Initialize a ring.
+ *
+ * @param r         Ring to initialize.
+ * @param capacity  Number of slots (rounded up to a power of two).
+ * @param elem_size Payload size of one slot in bytes.
+ * @return 0 on success; -1 on allocation failure.
+ */
+int mpsc_init(MpscRing* r, size_t capacity, size_t elem_size) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    r->stride = MPSC_HDR + ((elem_size + 15u) & ~(size_t)15u);
+    r->mask = cap - 1;
+    r->cells = (unsigned char*)aligned_alloc(64, ((cap * r->stride) + 63u) & ~(size_t)63u);
+    if (!r->cells) return -1;
+
+    for (size_t i = 0; i < cap; ++i) atomic_init(cell_seq(r, i), i);
+    atomic_init(&r->head, 0);
+    atomic_init(&r->dropped, 0);
+    r->tail = 0;
+    return 0;
+}
+
+/**
+ * Release ring memory.
+ *
+ * @param r Ring.
+ */
+void mpsc_free(MpscRing* r) {
+    free(r->cells);
+    r->cells = NULL;
+}
+
+/**
+ * Claim a free slot (producer side).
+ *
+ * @param r          Ring.
+ * @param out_ticket Output: ticket to pass to mpsc_publish().
+ * @return Slot payload, or NULL if the ring is full.
+ */
+void* mpsc_claim(MpscRing* r, size_t* out_ticket) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for (;;) {
+        size_t seq = atomic_load_explicit(cell_seq(r, pos), memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *out_ticket = pos;
+                return cell_payload(r, pos);
+            }
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Make a claimed slot visible to the consumer.
+ *
+ * @param r      Ring.
+ * @param ticket Ticket returned by mpsc_claim().
+ */
+void mpsc_publish(MpscRing* r, size_t ticket) {
+    atomic_store_explicit(cell_seq(r, ticket), ticket + 1, memory_order_release);
+}
+
+/**
+ * Return the oldest published slot (consumer side).
+ *
+ * @param r Ring.
+ * @return Slot payload, or NULL if nothing is ready.
+ */
+void* mpsc_peek(MpscRing* r) {
+    size_t seq = atomic_load_explicit(cell_seq(r, r->tail), memory_order_acquire);
+    if (seq != r->tail + 1) return NULL;
+    return cell_payload(r, r->tail);
+}
+
+/**
+ * Return the slot obtained by mpsc_peek() to the producers.
+ *
+ * @param r Ring.
+ */
+void mpsc_release(MpscRing* r) {
+    atomic_store_explicit(cell_seq(r, r->tail), r->tail + r->mask + 1, memory_order_release);
+    r->tail++;
+}
+
+/* --- Background writer --- */
+
+/**
+ * Writer thread: drain the ring until stopped, then drain it once more.
+ *
+ * @param arg MpscWriter.
+ * @return NULL.
+ */
+static void* writer_main(void* arg) {
+    MpscWriter* w = (MpscWriter*)arg;
+    for (;;) {
+        int stopping = atomic_load(&w->stop);
+        int drained = 0;
+        void* rec;
+        while ((rec = mpsc_peek(&w->ring)) != NULL) {
+            w->consume(rec);
+            mpsc_release(&w->ring);
+            drained = 1;
+        }
+        if (stopping) break;
+        if (w->idle) w->idle(drained);
+        if (!drained) {
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = w->idle_ns };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Initialize the ring and start the writer thread.
+ *
+ * @param w         Writer.
+ * @param capacity  Ring slots.
+ * @param elem_size Record size in bytes.
+ * @return 0 on success; -1 on error.
+ */
+int mpsc_writer_start(MpscWriter* w, size_t capacity, size_t elem_size) {
+    if (mpsc_init(&w->ring, capacity, elem_size) != 0) return -1;
+    atomic_store(&w->stop, 0);
+    if (pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+        mpsc_free(&w->ring);
+        return -1;
+    }
+    atomic_store(&w->on, 1);
+    return 0;
+}
+
+/**
+ * Stop taking records, drain the ring and join the writer thread.
+ *
+ * @param w Writer.
+ * @return 1 if the writer was running; 0 otherwise.
+ */
+int mpsc_writer_stop(MpscWriter* w) {
+    if (!atomic_exchange(&w->on, 0)) return 0;
+    atomic_store(&w->stop, 1);
+    pthread_join(w->thread, NULL);
+    return 1;
+}
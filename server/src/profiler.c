@@ -0,0 +1,537 @@
+/*
+ * profiler.c
+ *
+ * Purpose:
+ *   In-process sampling profiler (see profiler.h).
+ *
+ * Responsibilities:
+ *   - Arm a per-thread CPU-time timer delivering SIGPROF to registered threads.
+ *   - In the signal handler: unwind the frame-pointer chain within the thread's
+ *     stack bounds and count the stack in a lock-free open-addressing table
+ *     (async-signal-safe: atomics and plain stores only).
+ *   - On demand: name the frames (ELF symbol table of the binary, dladdr() for
+ *     shared objects), merge equal stacks and write collapsed-stack text.
+ *
+ * Table of contents:
+ *   - Sampling: now_ns(), unwind(), table_add(), on_sigprof()
+ *   - Threads: profiler_thread_begin(), profiler_thread_end()
+ *   - Lifecycle: profiler_start(), profiler_stop()
+ *   - Symbols: load_symbols(), sym_find(), frame_name()
+ *   - Output: format_stack(), profiler_dump(), profiler_stats_format()
+ */
+
+#define _GNU_SOURCE
+#include "profiler.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define PROFILE_PROBES     64     /* linear probes before a new stack is dropped */
+#define PROFILE_LINE_MAX   4096   /* one collapsed stack line */
+
+/* One distinct stack. `key` is claimed first; pcs are valid once `ready` is set. */
+typedef struct {
+    _Atomic uint64_t key;    /* stack hash, 0 = free */
+    atomic_uint      count;
+    atomic_int       ready;
+    int              role;
+    int              depth;
+    uintptr_t        pcs[PROFILE_MAX_DEPTH];   /* leaf first */
+} ProfileSlot;
+
+/* A function of the server binary (addresses relative to the load base). */
+typedef struct {
+    uintptr_t   lo, hi;
+    const char* name;
+} ProfileSym;
+
+int  g_profile_hz = 0;
+char g_profile_path[256] = "blackjack.folded";
+
+static atomic_int          g_prof_on = 0;
+static int                 g_prof_ran = 0;
+static int                 g_handler_installed = 0;
+static int                 g_hz = 0;
+static struct timespec     g_cpu0;
+static ProfileSlot         g_slots[PROFILE_SLOTS];
+static atomic_uint         g_stacks = 0;
+static atomic_ullong       g_samples = 0;
+static atomic_ullong       g_dropped = 0;
+static atomic_ullong       g_handler_ns = 0;
+
+static _Thread_local timer_t   t_timer;
+static _Thread_local int       t_armed = 0;
+static _Thread_local int       t_role = 0;
+static _Thread_local uintptr_t t_stack_lo = 0, t_stack_hi = 0;
+
+/* Dump side (under g_dump_mtx). */
+static pthread_mutex_t g_dump_mtx = PTHREAD_MUTEX_INITIALIZER;
+static int             g_syms_loaded = 0;
+static char*           g_exe_image = NULL;   /* owns the symbol names */
+static ProfileSym*     g_syms = NULL;
+static size_t          g_nsyms = 0;
+static uintptr_t       g_exe_base = 0;
+
+static const char* const g_role_names[] = { "main", "client", "game" };
+
+/* --- Sampling --- */
+
+/**
+ * Monotonic nanoseconds (vDSO; async-signal-safe).
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Walk the frame-pointer chain of the interrupted context.
+ *
+ * Frames are followed only while they stay inside the thread's stack and move
+ * towards its base, so a corrupt or missing frame pointer ends the walk instead
+ * of faulting.
+ *
+ * @param uc  Interrupted context.
+ * @param pcs Output program counters, leaf first (return addresses after the first).
+ * @return Number of frames.
+ */
+static int unwind(const ucontext_t* uc, uintptr_t* pcs) {
+    uintptr_t pc, fp;
+#if defined(__x86_64__)
+    pc = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+    fp = (uintptr_t)uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    pc = (uintptr_t)uc->uc_mcontext.pc;
+    fp = (uintptr_t)uc->uc_mcontext.regs[29];
+#else
+    (void)uc;
+    return 0;
+#endif
+    int n = 0;
+    pcs[n++] = pc;
+    while (n < PROFILE_MAX_DEPTH &&
+           fp >= t_stack_lo && fp + 2 * sizeof(uintptr_t) <= t_stack_hi &&
+           (fp & (sizeof(uintptr_t) - 1)) == 0) {
+        const uintptr_t* frame = (const uintptr_t*)fp;
+        uintptr_t next = frame[0];
+        uintptr_t ret = frame[1];
+        if (ret == 0) break;
+        pcs[n++] = ret;
+        if (next <= fp) break;
+        fp = next;
+    }
+    return n;
+}
+
+/**
+ * Count one sample of a stack (lock-free; async-signal-safe).
+ *
+ * @param role  Thread role.
+ * @param pcs   Frames, leaf first.
+ * @param depth Number of frames.
+ */
+static void table_add(int role, const uintptr_t* pcs, int depth) {
+    uint64_t h = 1469598103934665603ull ^ (uint64_t)role;
+    for (int i = 0; i < depth; ++i) {
+        h ^= (uint64_t)pcs[i];
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 31;
+    if (h == 0) h = 1;
+
+    for (int probe = 0; probe < PROFILE_PROBES; ++probe) {
+        ProfileSlot* s = &g_slots[(h + (uint64_t)probe) & (PROFILE_SLOTS - 1)];
+        uint64_t k = atomic_load_explicit(&s->key, memory_order_acquire);
+        if (k == 0) {
+            uint64_t expected = 0;
+            if (atomic_compare_exchange_strong_explicit(&s->key, &expected, h,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                s->role = role;
+                s->depth = depth;
+                for (int i = 0; i < depth; ++i) s->pcs[i] = pcs[i];
+                atomic_fetch_add_explicit(&s->count, 1, memory_order_relaxed);
+                atomic_store_explicit(&s->ready, 1, memory_order_release);
+                atomic_fetch_add_explicit(&g_stacks, 1, memory_order_relaxed);
+                return;
+            }
+            k = expected;
+        }
+        if (k == h) {
+            atomic_fetch_add_explicit(&s->count, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+}
+
+/**
+ * SIGPROF handler: record the interrupted stack of the current thread.
+ */
+static void on_sigprof(int sig, siginfo_t* si, void* ctx) {
+    (void)sig;
+    (void)si;
+    if (!t_armed || !atomic_load_explicit(&g_prof_on, memory_order_relaxed)) return;
+    int saved_errno = errno;
+    uint64_t t0 = now_ns();
+
+    uintptr_t pcs[PROFILE_MAX_DEPTH];
+    int depth = unwind((const ucontext_t*)ctx, pcs);
+    if (depth > 0) table_add(t_role, pcs, depth);
+    atomic_fetch_add_explicit(&g_samples, 1, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&g_handler_ns, now_ns() - t0, memory_order_relaxed);
+    errno = saved_errno;
+}
+
+/* --- Threads --- */
+
+/**
+ * Start sampling the calling thread (no-op when the profiler is off).
+ *
+ * @param role ProfileThread.
+ */
+void profiler_thread_begin(int role) {
+    if (t_armed || !atomic_load_explicit(&g_prof_on, memory_order_relaxed)) return;
+    t_role = role;
+
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void* addr = NULL;
+        size_t size = 0;
+        if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+            t_stack_lo = (uintptr_t)addr;
+            t_stack_hi = (uintptr_t)addr + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = tid;
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &t_timer) != 0) return;
+
+    // Most sessions and games use less CPU than one period: a random first expiry
+    // samples them with a probability proportional to the CPU time they do use.
+    long period_ns = 1000000000L / g_hz;
+    uint64_t r = (now_ns() ^ ((uint64_t)tid << 32)) * 0x9e3779b97f4a7c15ull;
+    long first_ns = 1 + (long)((r >> 33) % (uint64_t)period_ns);
+    struct itimerspec its;
+    its.it_interval.tv_sec = period_ns / 1000000000L;
+    its.it_interval.tv_nsec = period_ns % 1000000000L;
+    its.it_value.tv_sec = first_ns / 1000000000L;
+    its.it_value.tv_nsec = first_ns % 1000000000L;
+    if (timer_settime(t_timer, 0, &its, NULL) != 0) {
+        timer_delete(t_timer);
+        return;
+    }
+    t_armed = 1;
+}
+
+/**
+ * Stop sampling the calling thread.
+ */
+void profiler_thread_end(void) {
+    if (!t_armed) return;
+    t_armed = 0;
+    timer_delete(t_timer);
+}
+
+/* --- Lifecycle --- */
+
+/**
+ * Install the SIGPROF handler and start sampling the calling thread.
+ *
+ * May be called again after profiler_stop(); samples keep accumulating.
+ *
+ * @param hz Sampling frequency per thread (1..1000).
+ * @return 0 on success; -1 on error.
+ */
+int profiler_start(int hz) {
+    if (hz < 1 || hz > 1000) return -1;
+    if (!g_handler_installed) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = on_sigprof;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGPROF, &sa, NULL) != 0) {
+            perror("profiler");
+            return -1;
+        }
+        g_handler_installed = 1;
+    }
+    if (!g_prof_ran) clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &g_cpu0);
+    g_hz = hz;
+    g_prof_ran = 1;
+    atomic_store(&g_prof_on, 1);
+    profiler_thread_begin(PROFILE_THREAD_MAIN);
+    printf("[PROF] Sampling server threads at %d Hz (CPU time)\n", hz);
+    return 0;
+}
+
+/**
+ * Stop sampling (the handler stays installed and ignores late signals).
+ */
+void profiler_stop(void) {
+    atomic_store(&g_prof_on, 0);
+    profiler_thread_end();
+}
+
+/* --- Symbols --- */
+
+/**
+ * Compare symbols by start address (qsort).
+ */
+static int sym_cmp(const void* a, const void* b) {
+    const ProfileSym* x = (const ProfileSym*)a;
+    const ProfileSym* y = (const ProfileSym*)b;
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+/**
+ * Load the function symbols of the running binary (/proc/self/exe), once.
+ *
+ * Uses .symtab (static functions included) and falls back to .dynsym for a
+ * stripped binary. Without symbols, frames are named through dladdr() only.
+ */
+static void load_symbols(void) {
+    if (g_syms_loaded) return;
+    g_syms_loaded = 1;
+
+    FILE* f = fopen("/proc/self/exe", "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < (long)sizeof(Elf64_Ehdr) || !(g_exe_image = (char*)malloc((size_t)size))) {
+        fclose(f);
+        return;
+    }
+    size_t got = fread(g_exe_image, 1, (size_t)size, f);
+    fclose(f);
+
+    const Elf64_Ehdr* eh = (const Elf64_Ehdr*)g_exe_image;
+    if (got != (size_t)size || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_shoff == 0 ||
+        eh->e_shoff + (size_t)eh->e_shnum * sizeof(Elf64_Shdr) > (size_t)size) {
+        return;
+    }
+    const Elf64_Shdr* sh = (const Elf64_Shdr*)(g_exe_image + eh->e_shoff);
+    const Elf64_Shdr* symtab = NULL;
+    for (int i = 0; i < eh->e_shnum; ++i) {
+        if (sh[i].sh_type == SHT_SYMTAB) symtab = &sh[i];
+        if (sh[i].sh_type == SHT_DYNSYM && !symtab) symtab = &sh[i];
+    }
+    if (!symtab || symtab->sh_link >= eh->e_shnum) return;
+    const Elf64_Shdr* strtab = &sh[symtab->sh_link];
+    if (symtab->sh_offset + symtab->sh_size > (size_t)size ||
+        strtab->sh_offset + strtab->sh_size > (size_t)size) {
+        return;
+    }
+
+    const Elf64_Sym* syms = (const Elf64_Sym*)(g_exe_image + symtab->sh_offset);
+    size_t count = symtab->sh_size / sizeof(Elf64_Sym);
+    g_syms = (ProfileSym*)calloc(count ? count : 1, sizeof(ProfileSym));
+    if (!g_syms) return;
+    for (size_t i = 0; i < count; ++i) {
+        if (ELF64_ST_TYPE(syms[i].st_info) != STT_FUNC || syms[i].st_value == 0) continue;
+        if (syms[i].st_name >= strtab->sh_size) continue;
+        ProfileSym* s = &g_syms[g_nsyms++];
+        s->lo = (uintptr_t)syms[i].st_value;
+        s->hi = s->lo + (syms[i].st_size ? (uintptr_t)syms[i].st_size : 1);
+        s->name = g_exe_image + strtab->sh_offset + syms[i].st_name;
+    }
+    qsort(g_syms, g_nsyms, sizeof(ProfileSym), sym_cmp);
+
+    // Position-independent executables are loaded at a random base.
+    Dl_info info;
+    if (eh->e_type == ET_DYN && dladdr((void*)g_slots, &info) && info.dli_fbase) {
+        g_exe_base = (uintptr_t)info.dli_fbase;
+    }
+}
+
+/**
+ * Find the server function containing @p pc.
+ *
+ * @param pc Runtime address.
+ * @return Symbol; NULL if @p pc is outside the binary's functions.
+ */
+static const ProfileSym* sym_find(uintptr_t pc) {
+    if (!g_nsyms || pc < g_exe_base) return NULL;
+    uintptr_t a = pc - g_exe_base;
+    size_t lo = 0, hi = g_nsyms;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (g_syms[mid].lo <= a) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return NULL;
+    const ProfileSym* s = &g_syms[lo - 1];
+    return a < s->hi ? s : NULL;
+}
+
+/**
+ * Name one frame.
+ *
+ * @param pc  Program counter (callers pass return address - 1).
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ */
+static void frame_name(uintptr_t pc, char* out, size_t cap) {
+    const ProfileSym* s = sym_find(pc);
+    if (s) {
+        snprintf(out, cap, "%s", s->name);
+        return;
+    }
+    Dl_info info;
+    if (dladdr((void*)pc, &info) && info.dli_fname) {
+        if (info.dli_sname) {
+            snprintf(out, cap, "%s", info.dli_sname);
+        } else {
+            const char* base = strrchr(info.dli_fname, '/');
+            snprintf(out, cap, "%s+0x%lx", base ? base + 1 : info.dli_fname,
+                     (unsigned long)(pc - (uintptr_t)info.dli_fbase));
+        }
+        return;
+    }
+    snprintf(out, cap, "0x%lx", (unsigned long)pc);
+}
+
+/* --- Output --- */
+
+/**
+ * Format a slot as "<thread>;<root>;...;<leaf>" (without the count).
+ *
+ * @param s   Slot.
+ * @param out Output buffer (PROFILE_LINE_MAX bytes).
+ */
+static void format_stack(const ProfileSlot* s, char* out) {
+    size_t len = (size_t)snprintf(out, PROFILE_LINE_MAX, "%s",
+                                  s->role >= 0 && s->role <= PROFILE_THREAD_GAME ? g_role_names[s->role] : "thread");
+    for (int i = s->depth - 1; i >= 0 && len < PROFILE_LINE_MAX - 1; --i) {
+        char name[256];
+        frame_name(i == 0 ? s->pcs[i] : s->pcs[i] - 1, name, sizeof(name));
+        len += (size_t)snprintf(out + len, PROFILE_LINE_MAX - len, ";%s", name);
+    }
+}
+
+/**
+ * Compare two stack lines (qsort on char* entries).
+ */
+static int line_cmp(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Write the aggregated stacks in collapsed-stack format.
+ *
+ * Stacks that differ only in their addresses within the same functions are
+ * merged into one line.
+ *
+ * @param path Output path.
+ * @return Number of lines written; -1 on error or when the profiler never ran.
+ */
+int profiler_dump(const char* path) {
+    if (!g_prof_ran || !path || !*path) return -1;
+
+    pthread_mutex_lock(&g_dump_mtx);
+    load_symbols();
+
+    // Snapshot: "<stack>\t<count>" strings, sorted so that equal stacks are adjacent.
+    size_t n = 0;
+    char** lines = (char**)calloc(PROFILE_SLOTS, sizeof(char*));
+    char* buf = (char*)malloc(PROFILE_LINE_MAX);
+    int ret = -1;
+    if (!lines || !buf) goto out;
+    for (size_t i = 0; i < PROFILE_SLOTS; ++i) {
+        const ProfileSlot* s = &g_slots[i];
+        if (!atomic_load_explicit(&s->ready, memory_order_acquire)) continue;
+        format_stack(s, buf);
+        size_t len = strlen(buf);
+        char* line = (char*)malloc(len + 16);
+        if (!line) continue;
+        snprintf(line, len + 16, "%s\t%u", buf, atomic_load_explicit(&s->count, memory_order_relaxed));
+        lines[n++] = line;
+    }
+    qsort(lines, n, sizeof(char*), line_cmp);
+
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        perror("profiler dump");
+        goto out;
+    }
+    ret = 0;
+    for (size_t i = 0; i < n;) {
+        char* tab = strrchr(lines[i], '\t');
+        size_t key_len = (size_t)(tab - lines[i]);
+        unsigned long long total = strtoull(tab + 1, NULL, 10);
+        size_t j = i + 1;
+        for (; j < n; ++j) {
+            char* t2 = strrchr(lines[j], '\t');
+            if ((size_t)(t2 - lines[j]) != key_len || memcmp(lines[i], lines[j], key_len) != 0) break;
+            total += strtoull(t2 + 1, NULL, 10);
+        }
+        fprintf(f, "%.*s %llu\n", (int)key_len, lines[i], total);
+        ret++;
+        i = j;
+    }
+    if (fclose(f) != 0 || rename(tmp, path) != 0) {
+        perror("profiler dump");
+        ret = -1;
+    }
+
+out:
+    if (lines) {
+        for (size_t i = 0; i < n; ++i) free(lines[i]);
+        free(lines);
+    }
+    free(buf);
+    pthread_mutex_unlock(&g_dump_mtx);
+    return ret;
+}
+
+/**
+ * Format profiler counters for C45METRICS.
+ *
+ * prof_overhead_pct is the time spent in the signal handler relative to the
+ * process CPU time since the profiler started.
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int profiler_stats_format(char* out, size_t cap) {
+    double pct = 0.0;
+    if (g_prof_ran) {
+        struct timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        double cpu_ns = (double)(ts.tv_sec - g_cpu0.tv_sec) * 1e9 + (double)(ts.tv_nsec - g_cpu0.tv_nsec);
+        if (cpu_ns > 0) pct = 100.0 * (double)atomic_load(&g_handler_ns) / cpu_ns;
+    }
+    return snprintf(out, cap, "prof_hz=%d prof_samples=%llu prof_stacks=%u prof_dropped=%llu prof_overhead_pct=%.3f",
+                    atomic_load(&g_prof_on) ? g_hz : 0,
+                    (unsigned long long)atomic_load(&g_samples), atomic_load(&g_stacks),
+                    (unsigned long long)atomic_load(&g_dropped), pct);
+}
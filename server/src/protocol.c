@@ -4,23 +4,45 @@
  * Purpose:
  *   Implementation of low-level line I/O and protocol helpers used by the server:
  *   - Safe "write all" for TCP sockets.
- *   - Line-oriented reads (blocking and timed).
- *   - Lobby snapshot serialization.
+ *   - Line-oriented reads (blocking, timed and peek) through a per-connection input queue.
+ *   - Lobby snapshot serialization (cached per lobby version, "not modified" replies).
+ *   - Game-history replies (C45HIST, C45GAME) from the history archive.
+ *   - Optional fault injection (fragmented/delayed writes, stalled reads, drops),
+ *     kept per connection; delayed writes are sent by a fault sender thread.
  *
  * Table of contents:
+ *   - Syscall accounting: io_stats_snapshot(), io_poll(), io_sleep_us()
+ *   - Fault injection: fault_roll(), fault_drop(), fault_before_read(), fault links
+ *     (fault_conn_begin(), fault_queue_write(), fault_sender_main()), fault_start(), fault_stop()
  *   - write_all()
- *   - read_line(), read_line_timeout()
  *   - is_c45_prefix()
- *   - send_lobbies_snapshot()
+ *   - Lobby snapshot: send_lobbies_snapshot(), send_lobbies_snapshot_since(), lobby_request_version()
+ *   - Extended lobby listing: send_lobby_stats()
+ *   - Game history: send_history(), send_game_record()
+ *   - Input queue: input_queue_reset(), has_queued_line(), read_line(), read_line_timeout(),
+ *     read_line_timeout_ms(), peek_line(), take_keepalive_line()
  */
 
+#define _GNU_SOURCE
 #include "protocol.h"
+#include "capture.h"
+#include "framing.h"
 #include "game.h"
+#include "history.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 #include <poll.h>
 
@@ -28,18 +50,74 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+FaultConfig g_fault = {0};
+
+/* --- Syscall accounting --- */
+
+// Relaxed counters: one uncontended atomic add next to a syscall is noise.
+static atomic_ullong g_io_recv = 0;
+static atomic_ullong g_io_send = 0;
+static atomic_ullong g_io_poll = 0;
+static atomic_ullong g_io_sleep = 0;
+
+#define IO_COUNT(c) atomic_fetch_add_explicit(&(c), 1, memory_order_relaxed)
+
 /**
- * Write an entire NUL-terminated string to a socket.
+ * Copy the current I/O syscall counters.
  *
- * @param fd Connected socket file descriptor.
- * @param s  NUL-terminated string to send.
+ * @param out Output counters.
+ */
+void io_stats_snapshot(IoStats* out) {
+    out->recv  = atomic_load_explicit(&g_io_recv, memory_order_relaxed);
+    out->send  = atomic_load_explicit(&g_io_send, memory_order_relaxed);
+    out->poll  = atomic_load_explicit(&g_io_poll, memory_order_relaxed);
+    out->sleep = atomic_load_explicit(&g_io_sleep, memory_order_relaxed);
+}
+
+/**
+ * Counted poll().
+ *
+ * @param fds        Poll set.
+ * @param nfds       Number of entries in @p fds.
+ * @param timeout_ms Timeout in milliseconds (-1 = infinite).
+ * @return Same as poll().
+ */
+int io_poll(struct pollfd* fds, nfds_t nfds, int timeout_ms) {
+    IO_COUNT(g_io_poll);
+    return poll(fds, nfds, timeout_ms);
+}
+
+/**
+ * Counted sleep.
+ *
+ * @param us Duration in microseconds.
+ */
+void io_sleep_us(unsigned us) {
+    IO_COUNT(g_io_sleep);
+    usleep(us);
+}
+
+/**
+ * Monotonic time in milliseconds (vDSO, no syscall).
+ */
+static long long io_mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000ll + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Send all @p n bytes (blocking).
  *
+ * @param fd Connected socket file descriptor.
+ * @param s  Bytes to send.
+ * @param n  Number of bytes.
  * @return 0 on success; -1 on error.
  */
-int write_all(int fd, const char* s) {
-    size_t n = strlen(s);
+static int send_all(int fd, const char* s, size_t n) {
     size_t off = 0;
     while (off < n) {
+        IO_COUNT(g_io_send);
         ssize_t w = send(fd, s + off, n - off, MSG_NOSIGNAL);
         if (w < 0) {
             if (errno == EINTR) continue;
@@ -50,36 +128,397 @@ int write_all(int fd, const char* s) {
     return 0;
 }
 
+/* --- Fault injection --- */
+/*
+ * Each connection gets its own fault link while fault injection runs.
+ * Delayed and fragmented writes are queued on the link and a single sender
+ * thread sends them when due, so write_all() never sleeps: the game thread
+ * broadcasts to both players and must keep its turn clock. Every link has its
+ * own timeline. A write is due after latency + jitter, but never before the
+ * previous write on the same link, so a connection's lines stay in order.
+ *
+ * While packets are queued the link holds a dup() of the socket. A connection
+ * the server closes still delivers what is in flight; then the dup is closed
+ * and the peer sees the FIN. A reused fd number gets a fresh link
+ * (fault_conn_begin()). Read stalls are kept on the link too; a stalled
+ * reader never waits past its own deadline.
+ *
+ * The link table is indexed by fd and sized from RLIMIT_NOFILE when the
+ * sender starts, so it only exists when FAULT_ENABLE is set.
+ */
+typedef struct FaultLink {
+    int       out_fd;          /* dup() of the socket while packets are queued; -1 otherwise */
+    unsigned  pending;         /* packets queued or being sent */
+    int       detached;        /* fd number reused by a new connection: free once drained */
+    int       nodelay;         /* TCP_NODELAY set for fragments */
+    long long ready_ms;        /* due time of the link's last queued packet */
+    long long stall_until_ms;  /* no input before this (CLOCK_MONOTONIC; 0 = not stalled) */
+} FaultLink;
+
+typedef struct FaultPacket {
+    struct FaultPacket* next;
+    FaultLink*          link;
+    long long           due_ms;    /* CLOCK_MONOTONIC */
+    size_t              len;
+    char                data[];
+} FaultPacket;
+
+static pthread_mutex_t g_fault_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_fault_cv = PTHREAD_COND_INITIALIZER;
+static FaultLink**     g_fault_links = NULL;  /* by fd; pages are only touched when used */
+static int             g_fault_nfd = 0;       /* entries in g_fault_links */
+static FaultPacket*    g_fault_head = NULL;   /* every queued packet, ordered by due_ms */
+static atomic_int      g_fault_on = 0;
+static int             g_fault_stop = 0;
+static pthread_t       g_fault_thread;
+
+// Per-thread PRNG state for fault decisions (rand() is shared with deck shuffling).
+static _Thread_local unsigned t_fault_seed = 0;
+
 /**
- * Read a single line from a socket into a buffer (byte-by-byte).
+ * Next pseudo-random value from the per-thread fault PRNG.
  *
- * @param fd      Connected socket file descriptor.
- * @param buf     Destination buffer.
- * @param buf_sz  Size of @p buf in bytes.
+ * @return Random value in 0..RAND_MAX.
+ */
+static unsigned fault_rand(void) {
+    if (t_fault_seed == 0) {
+        t_fault_seed = (unsigned)time(NULL) ^ (unsigned)(uintptr_t)&t_fault_seed;
+        if (t_fault_seed == 0) t_fault_seed = 1;
+    }
+    return (unsigned)rand_r(&t_fault_seed);
+}
+
+/**
+ * Decide whether a fault with the given probability should fire now.
  *
- * @return >=0 Length of data stored in @p buf (including '\n' if present).
- * @return  0  Peer closed the connection.
- * @return -1  Error.
+ * @param permille Probability in 1/1000 units (0 disables the fault).
+ * @return 1 if the fault fires; 0 otherwise.
  */
-int read_line(int fd, char* buf, size_t buf_sz) {
-    if (buf_sz == 0) return -1;
-    size_t pos = 0;
-    while (pos < buf_sz - 1) {
-        char c;
-        ssize_t r = recv(fd, &c, 1, 0);
-        if (r == 0) { /* peer closed */
-            buf[pos] = '\0';
-            return 0;
+static int fault_roll(int permille) {
+    if (permille <= 0) return 0;
+    return (int)(fault_rand() % 1000u) < permille;
+}
+
+/**
+ * Simulate an abrupt connection loss.
+ *
+ * shutdown() makes both the peer and every server thread using this socket
+ * observe a disconnect, so the regular reconnect paths are exercised.
+ *
+ * @param fd Connected socket file descriptor.
+ */
+static void fault_drop(int fd) {
+    printf("[FAULT] Dropping connection (fd=%d)\n", fd);
+    (void)shutdown(fd, SHUT_RDWR);
+}
+
+/**
+ * Look up (allocating on first use) the current link of a file descriptor.
+ * Caller holds g_fault_mtx.
+ *
+ * @param fd Socket file descriptor.
+ * @return Link, or NULL if @p fd is outside the table or allocation failed.
+ */
+static FaultLink* fault_link(int fd) {
+    if (fd < 0 || fd >= g_fault_nfd) return NULL;
+    FaultLink* l = g_fault_links[fd];
+    if (!l) {
+        l = calloc(1, sizeof(*l));
+        if (!l) return NULL;
+        l->out_fd = -1;
+        g_fault_links[fd] = l;
+    }
+    return l;
+}
+
+/**
+ * Apply read-side faults before a socket read.
+ *
+ * @param fd       Connected socket file descriptor.
+ * @param stall_ms Output: remaining stall in milliseconds (when 1 is returned).
+ * @return 0 to read; 1 while the connection is stalled (nothing may be read);
+ *         -1 if the connection was dropped.
+ */
+static int fault_before_read(int fd, long long* stall_ms) {
+    if (!atomic_load_explicit(&g_fault_on, memory_order_acquire)) return 0;
+    long long now = io_mono_ms();
+    int rc = 0;
+    pthread_mutex_lock(&g_fault_mtx);
+    FaultLink* l = fault_link(fd);
+    if (l && l->stall_until_ms > now) {
+        *stall_ms = l->stall_until_ms - now;
+        rc = 1;
+    } else {
+        if (l) l->stall_until_ms = 0;
+        if (fault_roll(g_fault.drop_permille)) {
+            rc = -1;
+        } else if (l && g_fault.stall_ms > 0 && fault_roll(g_fault.stall_permille)) {
+            l->stall_until_ms = now + g_fault.stall_ms;
+            *stall_ms = g_fault.stall_ms;
+            rc = 1;
         }
-        if (r < 0) {
-            if (errno == EINTR) continue;
+    }
+    pthread_mutex_unlock(&g_fault_mtx);
+    if (rc < 0) fault_drop(fd);
+    return rc;
+}
+
+/**
+ * Wait out a fault-injected stall, at most @p max_ms.
+ *
+ * Only a hangup or error ends the wait early; the stall is then lifted so the
+ * next read sees the disconnect.
+ *
+ * @param fd     Socket file descriptor.
+ * @param max_ms Longest wait in milliseconds.
+ */
+static void fault_stall_wait(int fd, long long max_ms) {
+    if (max_ms <= 0) return;
+    struct pollfd p = { .fd = fd, .events = 0 };
+    if (io_poll(&p, 1, max_ms > INT_MAX ? INT_MAX : (int)max_ms) <= 0) return;
+    pthread_mutex_lock(&g_fault_mtx);
+    FaultLink* l = fault_link(fd);
+    if (l) l->stall_until_ms = 0;
+    pthread_mutex_unlock(&g_fault_mtx);
+}
+
+/**
+ * Release the socket of a link that has nothing left to send (and the link
+ * itself if its fd number already belongs to a new connection).
+ * Caller holds g_fault_mtx.
+ *
+ * @param l Link with no pending packets.
+ */
+static void fault_link_idle(FaultLink* l) {
+    if (l->out_fd >= 0) close(l->out_fd);
+    l->out_fd = -1;
+    if (l->detached) free(l);
+}
+
+/**
+ * Drop every queued packet of a link whose socket failed.
+ * Caller holds g_fault_mtx.
+ *
+ * @param l Link.
+ */
+static void fault_link_discard(FaultLink* l) {
+    FaultPacket** pp = &g_fault_head;
+    while (*pp) {
+        FaultPacket* p = *pp;
+        if (p->link == l) {
+            *pp = p->next;
+            free(p);
+            l->pending--;
+        } else {
+            pp = &p->next;
+        }
+    }
+}
+
+/**
+ * Give @p fd a fresh fault link: a new connection got this fd number.
+ * Packets still queued for the old connection are sent on its own socket.
+ *
+ * @param fd Socket file descriptor.
+ */
+void fault_conn_begin(int fd) {
+    if (!atomic_load_explicit(&g_fault_on, memory_order_acquire)) return;
+    pthread_mutex_lock(&g_fault_mtx);
+    FaultLink* l = (fd >= 0 && fd < g_fault_nfd) ? g_fault_links[fd] : NULL;
+    if (l && l->pending > 0) {
+        l->detached = 1;
+        g_fault_links[fd] = NULL;
+    } else if (l) {
+        l->nodelay = 0;
+        l->ready_ms = 0;
+        l->stall_until_ms = 0;
+    }
+    pthread_mutex_unlock(&g_fault_mtx);
+}
+
+/**
+ * Insert a packet after every packet due no later than it (a link's packets
+ * keep their order). Caller holds g_fault_mtx.
+ *
+ * @param p Packet.
+ */
+static void fault_insert(FaultPacket* p) {
+    FaultPacket** pp = &g_fault_head;
+    while (*pp && (*pp)->due_ms <= p->due_ms) pp = &(*pp)->next;
+    p->next = *pp;
+    *pp = p;
+}
+
+/**
+ * Queue one write on the link of @p fd: delayed by latency + jitter (never
+ * before the link's previous write) and cut into fragments FAULT_FRAGMENT_GAP_MS apart.
+ *
+ * @param fd Connected socket file descriptor.
+ * @param s  Bytes to send.
+ * @param n  Number of bytes.
+ * @return 0 if queued; 1 if the write needs no fault and the link is idle
+ *         (send it directly); -1 on error.
+ */
+static int fault_queue_write(int fd, const char* s, size_t n) {
+    size_t chunk = n;
+    if (g_fault.fragment_bytes > 0 && (size_t)g_fault.fragment_bytes < n) chunk = (size_t)g_fault.fragment_bytes;
+    long long delay = g_fault.latency_ms > 0 ? g_fault.latency_ms : 0;
+    if (g_fault.jitter_ms > 0) delay += (long long)(fault_rand() % (unsigned)(g_fault.jitter_ms + 1));
+
+    pthread_mutex_lock(&g_fault_mtx);
+    FaultLink* l = g_fault_stop ? NULL : fault_link(fd);
+    if (!l || (delay == 0 && chunk == n && l->pending == 0)) {
+        pthread_mutex_unlock(&g_fault_mtx);
+        return 1;
+    }
+    if (l->out_fd < 0 && (l->out_fd = dup(fd)) < 0) {
+        pthread_mutex_unlock(&g_fault_mtx);
+        return -1;
+    }
+    if (chunk < n && !l->nodelay) {
+        // Disable Nagle, otherwise the kernel would merge the fragments again.
+        int one = 1;
+        (void)setsockopt(l->out_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        l->nodelay = 1;
+    }
+    long long due = io_mono_ms() + delay;
+    if (due < l->ready_ms) due = l->ready_ms;
+    for (size_t off = 0; off < n; off += chunk) {
+        size_t len = n - off < chunk ? n - off : chunk;
+        FaultPacket* p = malloc(sizeof(*p) + len);
+        if (!p) break;  // the rest is lost, as on a broken link
+        p->link = l;
+        p->due_ms = due;
+        p->len = len;
+        memcpy(p->data, s + off, len);
+        fault_insert(p);
+        l->pending++;
+        l->ready_ms = due;
+        due += g_fault.fragment_gap_ms > 0 ? g_fault.fragment_gap_ms : 0;
+    }
+    int rc = 0;
+    if (l->pending == 0) {
+        fault_link_idle(l);
+        rc = -1;
+    }
+    pthread_cond_signal(&g_fault_cv);
+    pthread_mutex_unlock(&g_fault_mtx);
+    return rc;
+}
+
+/**
+ * Sender thread: send each packet when it is due. Once stopping, everything
+ * still queued is sent immediately.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* fault_sender_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_fault_mtx);
+    for (;;) {
+        FaultPacket* p = g_fault_head;
+        if (!p) {
+            if (g_fault_stop) break;
+            pthread_cond_wait(&g_fault_cv, &g_fault_mtx);
+            continue;
+        }
+        long long wait = p->due_ms - io_mono_ms();
+        if (wait > 0 && !g_fault_stop) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += (time_t)(wait / 1000);
+            until.tv_nsec += (long)(wait % 1000) * 1000000L;
+            if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+            (void)pthread_cond_timedwait(&g_fault_cv, &g_fault_mtx, &until);
+            continue;
+        }
+        g_fault_head = p->next;
+        FaultLink* l = p->link;
+        int out_fd = l->out_fd;  // only this thread closes it while packets are pending
+        pthread_mutex_unlock(&g_fault_mtx);
+        int rc = send_all(out_fd, p->data, p->len);
+        free(p);
+        pthread_mutex_lock(&g_fault_mtx);
+        if (rc != 0) fault_link_discard(l);
+        if (--l->pending == 0) fault_link_idle(l);
+    }
+    pthread_mutex_unlock(&g_fault_mtx);
+    return NULL;
+}
+
+/**
+ * Start the fault sender thread (no-op unless FAULT_ENABLE is set).
+ *
+ * The link table covers every fd below the current RLIMIT_NOFILE soft limit,
+ * so main() raises MAX_OPEN_FILES first; sockets above it (a limit raised
+ * later) are served without faults.
+ *
+ * @return 0 on success or when fault injection is off; -1 on error.
+ */
+int fault_start(void) {
+    if (!g_fault.enabled || atomic_load(&g_fault_on)) return 0;
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return -1;
+    int nfd = (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > INT_MAX) ? INT_MAX : (int)rl.rlim_cur;
+    g_fault_links = calloc((size_t)nfd, sizeof(*g_fault_links));
+    if (!g_fault_links) return -1;
+    g_fault_nfd = nfd;
+    g_fault_stop = 0;
+    if (pthread_create(&g_fault_thread, NULL, fault_sender_main, NULL) != 0) {
+        free(g_fault_links);
+        g_fault_links = NULL;
+        g_fault_nfd = 0;
+        return -1;
+    }
+    atomic_store_explicit(&g_fault_on, 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Send everything still queued and stop the fault sender thread.
+ *
+ * The link table is not freed: a client thread may still be inside
+ * write_all() while the server shuts down (it then sends directly).
+ */
+void fault_stop(void) {
+    if (!atomic_load(&g_fault_on)) return;
+    pthread_mutex_lock(&g_fault_mtx);
+    g_fault_stop = 1;
+    pthread_cond_signal(&g_fault_cv);
+    pthread_mutex_unlock(&g_fault_mtx);
+    pthread_join(g_fault_thread, NULL);
+}
+
+/**
+ * Write an entire NUL-terminated string to a socket.
+ *
+ * With fault injection running, the write is queued on the connection's fault
+ * link instead of being delayed here (see fault_queue_write()).
+ *
+ * @param fd Connected socket file descriptor.
+ * @param s  NUL-terminated string to send.
+ *
+ * @return 0 on success; -1 on error.
+ */
+int write_all(int fd, const char* s) {
+    size_t n = strlen(s);
+
+    if (atomic_load_explicit(&g_fault_on, memory_order_acquire)) {
+        if (fault_roll(g_fault.drop_permille)) {
+            fault_drop(fd);
             return -1;
         }
-        buf[pos++] = c;
-        if (c == '\n') break;
+        int q = fault_queue_write(fd, s, n);
+        if (q < 0) return -1;
+        if (q == 0) {
+            capture_line(fd, CAPTURE_OUT, s, n);
+            return 0;
+        }
     }
-    buf[pos] = '\0';
-    return (int)pos;
+    if (send_all(fd, s, n) != 0) return -1;
+    capture_line(fd, CAPTURE_OUT, s, n);
+    return 0;
 }
 
 /**
@@ -92,30 +531,50 @@ int is_c45_prefix(const char* s) {
     return s && strncmp(s, "C45", 3) == 0;
 }
 
+/* --- Lobby snapshot --- */
+// Last serialized snapshot, shared by all client threads; rebuilt only when the
+// lobby version moved on. Sized from LOBBY_COUNT_MAX: header, one digit pair per
+// lobby, the version, a space and one profile letter per lobby, newline and NUL.
+#define SNAP_LINE_MAX (sizeof("C45L 99 ") - 1 + 2 * LOBBY_COUNT_MAX + sizeof(" 999999999") - 1 \
+                       + 1 + LOBBY_COUNT_MAX + sizeof("\n"))
+_Static_assert(LOBBY_COUNT_MAX <= 99, "snapshot header assumes a two-digit lobby count");
+static pthread_mutex_t g_snap_mtx = PTHREAD_MUTEX_INITIALIZER;
+static char     g_snap_line[SNAP_LINE_MAX];
+static size_t   g_snap_len = 0;
+static unsigned g_snap_version = 0;
+
 /**
- * Send the lobby list snapshot to a client.
+ * Serialize the current lobby list into the shared cache.
  *
- * @param fd Connected socket file descriptor.
- * @return 0 on success; -1 on error.
+ * Compact snapshot (single line) to keep the protocol usable under extreme
+ * fragmentation/delay (e.g., 1 byte per packet, high RTT).
+ *
+ * Format:
+ *   C45L <n> <pairs> <version>[ <profiles>]\n
+ * where <pairs> is 2*n digits, each pair is:
+ *   players (0..2) + status (0/1)
+ * and <profiles> (n letters, S = standard, B = blitz) is only sent when some
+ * lobby runs a non-standard timing profile.
+ *
+ * Example for 3 lobbies:
+ *   C45L 3 001020 17\n
+ *   C45L 3 001020 17 SSB\n
+ *
+ * The version is read before the lobbies are, so the line is never older than
+ * the version it carries. Caller holds g_snap_mtx.
+ *
+ * @param version Lobby version read before building.
+ * @return 0 on success; -1 if the line does not fit.
  */
-int send_lobbies_snapshot(int fd) {
-    // Compact snapshot (single line) to keep the protocol usable under extreme
-    // fragmentation/delay (e.g., 1 byte per packet, high RTT).
-    //
-    // Format:
-    //   C45L <n> <pairs>\n
-    // where <pairs> is 2*n digits, each pair is:
-    //   players (0..2) + status (0/1)
-    //
-    // Example for 3 lobbies:
-    //   C45L 3 001020\n
-    char out[512];
-    int n = g_lobby_count;
+static int snapshot_build_locked(unsigned version) {
+    char* out = g_snap_line;
+    size_t cap = sizeof(g_snap_line);
+    int n = lobby_public_count();   // bot lobbies are not listed
     if (n < 0) n = 0;
-    if (n > 200) n = 200; // bound the line length; the Java client also limits lobby count
+    if (n > LOBBY_COUNT_MAX) n = LOBBY_COUNT_MAX; // load_config enforces this; the Java client also limits lobby count
 
-    int pos = snprintf(out, sizeof(out), "C45L %d ", n);
-    if (pos < 0 || (size_t)pos >= sizeof(out)) return -1;
+    int pos = snprintf(out, cap, "C45L %d ", n);
+    if (pos < 0 || (size_t)pos >= cap) return -1;
 
     for (int i = 0; i < n; ++i) {
         int players, status;
@@ -128,23 +587,520 @@ int send_lobbies_snapshot(int fd) {
         if (players > 9) players = 9;
         status = status ? 1 : 0;
 
-        if ((size_t)(pos + 2) >= sizeof(out)) return -1;
+        if ((size_t)(pos + 2) >= cap) return -1;
         out[pos++] = (char)('0' + players);
         out[pos++] = (char)('0' + status);
     }
 
-    if ((size_t)(pos + 2) >= sizeof(out)) return -1;
+    int tail = snprintf(out + pos, cap - (size_t)pos, " %u", version);
+    if (tail < 0 || (size_t)(pos + tail) >= cap) return -1;
+    pos += tail;
+
+    // Timing profiles ("S"tandard/"B"litz per lobby), only when some lobby is not standard.
+    int timed = 0;
+    for (int i = 0; i < n; ++i) timed |= g_lobbies[i].profile != LOBBY_PROFILE_STANDARD;
+    if (timed) {
+        if ((size_t)(pos + 1 + n) >= cap) return -1;
+        out[pos++] = ' ';
+        for (int i = 0; i < n; ++i) out[pos++] = g_lobbies[i].profile == LOBBY_PROFILE_BLITZ ? 'B' : 'S';
+    }
+
+    tail = snprintf(out + pos, cap - (size_t)pos, "\n");
+    if (tail < 0 || (size_t)(pos + tail) >= cap) return -1;
+    g_snap_len = (size_t)(pos + tail);
+    g_snap_version = version;
+    return 0;
+}
+
+/**
+ * Send the lobby snapshot unless the client already has the current version.
+ *
+ * @param fd           Connected socket file descriptor.
+ * @param have_version Version the client holds (from "C45B <version>"); 0 = none.
+ * @return 0 on success; -1 on error.
+ */
+int send_lobbies_snapshot_since(int fd, unsigned have_version) {
+    unsigned version = lobby_version();
+    if (have_version != 0 && have_version == version) {
+        char out[32];
+        snprintf(out, sizeof(out), "C45LU %u\n", version);
+        if (write_all(fd, out) < 0) return -1;
+        printf("[PROTO] -> Lobby snapshot not modified (fd=%d)\n", fd);
+        return 0;
+    }
+
+    char out[sizeof(g_snap_line)];
+    pthread_mutex_lock(&g_snap_mtx);
+    if (g_snap_len == 0 || g_snap_version != version) {
+        if (snapshot_build_locked(version) < 0) {
+            g_snap_len = 0;
+            pthread_mutex_unlock(&g_snap_mtx);
+            return -1;
+        }
+    }
+    memcpy(out, g_snap_line, g_snap_len);
+    out[g_snap_len] = '\0';
+    pthread_mutex_unlock(&g_snap_mtx);
+
+    if (write_all(fd, out) < 0) return -1;
+    printf("[PROTO] -> Send lobby snapshot to client (fd=%d)\n", fd);
+    return 0;
+}
+
+/**
+ * Send the current lobby snapshot unconditionally.
+ *
+ * @param fd Connected socket file descriptor.
+ * @return 0 on success; -1 on error.
+ */
+int send_lobbies_snapshot(int fd) {
+    return send_lobbies_snapshot_since(fd, 0);
+}
+
+/**
+ * Extract the client's cached lobby version from a refresh request.
+ *
+ * @param line "C45B\n" or "C45B <version>\n".
+ * @return Version, or 0 if absent/invalid.
+ */
+unsigned lobby_request_version(const char* line) {
+    unsigned v = 0;
+    if (!line || sscanf(line, "C45B %u", &v) != 1) return 0;
+    return v;
+}
+
+/* --- Extended lobby listing --- */
+
+/**
+ * Send the opt-in extended lobby listing ("C45LX").
+ *
+ * Format:
+ *   C45LX <n> <entry> <entry> ...\n
+ * with one entry per lobby:
+ *   <players><status>:<games>:<game_ms_avg>:<turn_ms_avg>:<disconnects>:<reconnects>:<clock_ms>:<reconnect_ms>
+ * where the last two fields are the table's timing profile (turn clock, reconnect window).
+ * or, for an unauthenticated connection (before the handshake), only:
+ *   <games>
+ *
+ * Counters are read lock-free (lobby_stats_snapshot()); the line is flushed in
+ * pieces when many lobbies do not fit one buffer.
+ *
+ * @param fd   Connected socket file descriptor.
+ * @param full 1 for the full entries; 0 for per-lobby game counts only.
+ * @return 0 on success; -1 on error.
+ */
+int send_lobby_stats(int fd, int full) {
+    char out[1024];
+    int n = lobby_public_count();   // bot lobbies are not listed
+    if (n < 0) n = 0;
+    if (n > LOBBY_COUNT_MAX) n = LOBBY_COUNT_MAX; // same bound as the compact snapshot
+
+    size_t pos = (size_t)snprintf(out, sizeof(out), "C45LX %d", n);
+    for (int i = 0; i < n; ++i) {
+        pthread_mutex_lock(&g_lobbies[i].mtx);
+        int players = g_lobbies[i].player_count;
+        int status  = g_lobbies[i].is_running ? 1 : 0;
+        pthread_mutex_unlock(&g_lobbies[i].mtx);
+        if (players < 0) players = 0;
+        if (players > 9) players = 9;
+
+        LobbyStatsView v;
+        lobby_stats_snapshot(i, &v);
+        char entry[128];
+        int len = full ? snprintf(entry, sizeof(entry), " %d%d:%llu:%u:%u:%llu:%llu:%d:%d",
+                                  players, status, v.games, v.game_ms_avg, v.turn_ms_avg,
+                                  v.disconnects, v.reconnects, g_lobbies[i].turn_ms, g_lobbies[i].reconnect_ms)
+                       : snprintf(entry, sizeof(entry), " %llu", v.games);
+        if (len < 0 || (size_t)len >= sizeof(entry)) return -1;
+        if (pos + (size_t)len + 2 > sizeof(out)) {
+            out[pos] = '\0';
+            if (write_all(fd, out) < 0) return -1;
+            pos = 0;
+        }
+        memcpy(out + pos, entry, (size_t)len);
+        pos += (size_t)len;
+    }
+    out[pos++] = '\n';
+    out[pos] = '\0';
+    if (write_all(fd, out) < 0) return -1;
+    printf("[PROTO] -> Send extended lobby listing (fd=%d)\n", fd);
+    return 0;
+}
+
+/* --- Game history --- */
+
+/**
+ * Send a player's latest games, newest first:
+ *   C45HIST <n> <entry> <entry> ...\n
+ * with one entry per game:
+ *   <game_id>:<end_ms>:<W|L|P>:<my_value>:<opp_value>:<opponent>
+ * (values -1 = bust). "C45HIST 0" when the player has no games or the archive is off.
+ *
+ * @param fd   Connected socket file descriptor.
+ * @param name Player name.
+ * @param max  Games wanted (1..HISTORY_MAX_PAGE; out of range = 10).
+ * @return 0 on success; -1 on error.
+ */
+int send_history(int fd, const char* name, int max) {
+    HistoryEntry games[HISTORY_MAX_PAGE];
+    if (max < 1 || max > HISTORY_MAX_PAGE) max = 10;
+    int n = history_player_games(name, max, games);
+
+    char out[1024];
+    size_t pos = (size_t)snprintf(out, sizeof(out), "C45HIST %d", n);
+    for (int i = 0; i < n; ++i) {
+        char entry[128];
+        int len = snprintf(entry, sizeof(entry), " %llu:%llu:%c:%d:%d:%.*s",
+                           (unsigned long long)games[i].game_id, (unsigned long long)games[i].end_ms,
+                           games[i].result, games[i].my_value, games[i].opp_value,
+                           MAX_NAME_LEN - 1, games[i].opponent);
+        if (len < 0 || (size_t)len >= sizeof(entry)) return -1;
+        if (pos + (size_t)len + 2 > sizeof(out)) {
+            out[pos] = '\0';
+            if (write_all(fd, out) < 0) return -1;
+            pos = 0;
+        }
+        memcpy(out + pos, entry, (size_t)len);
+        pos += (size_t)len;
+    }
     out[pos++] = '\n';
     out[pos] = '\0';
+    if (write_all(fd, out) < 0) return -1;
+    printf("[PROTO] -> Send history of %s: %d games (fd=%d)\n", name, n, fd);
+    return 0;
+}
+
+/**
+ * Append a hand ("AS,TD,5H"; "-" when empty) to @p out.
+ *
+ * @return Bytes written.
+ */
+static int format_hand(char* out, size_t sz, const uint8_t* cards, int n) {
+    if (n <= 0) return snprintf(out, sz, "-");
+    int pos = 0;
+    for (int c = 0; c < n && (size_t)pos + 4 < sz; ++c) {
+        Card card = { .rank = cards[c] & 0x0F, .suit = (Suit)((cards[c] >> 4) & 3) };
+        char s[4];
+        card_to_str(card, s);
+        pos += snprintf(out + pos, sz - (size_t)pos, "%s%s", c ? "," : "", s);
+    }
+    return pos;
+}
 
+/**
+ * Send one archived game:
+ *   C45GAME <id> <end_ms> <lobby> <profile> <reason> <turns> <duration_ms> <winner> <name1> <value1> <hand1> <name2> <value2> <hand2>\n
+ * where profile is standard/blitz/bot, reason is normal/forfeit/violation/abandoned/lost,
+ * winner is the winning name or PUSH, hands are comma-separated cards.
+ * "C45GAME <id> NONE" when the game is not in the archive (or the archive is off),
+ * and for a @p viewer who did not play it, so other players' game ids are not
+ * told apart from unknown ones.
+ *
+ * @param fd      Connected socket file descriptor.
+ * @param game_id Game id.
+ * @param viewer  Session's player name (only their own games); NULL = any game (monitor token checked).
+ * @return 0 on success; -1 on error.
+ */
+int send_game_record(int fd, unsigned long long game_id, const char* viewer) {
+    static const char* const profiles[3] = { "standard", "blitz", "bot" };
+    static const char* const reasons[5] = { "normal", "forfeit", "violation", "abandoned", "lost" };
+    HistoryRecord r;
+    char out[512];
+    if (history_find_game(game_id, &r) != 0 ||
+        (viewer && strncmp(r.name[0], viewer, MAX_NAME_LEN) != 0 &&
+                   strncmp(r.name[1], viewer, MAX_NAME_LEN) != 0)) {
+        snprintf(out, sizeof(out), "C45GAME %llu NONE\n", game_id);
+        return write_all(fd, out) < 0 ? -1 : 0;
+    }
+
+    char hands[LOBBY_SIZE][64];
+    for (int s = 0; s < LOBBY_SIZE; ++s)
+        format_hand(hands[s], sizeof(hands[s]), r.hand[s], r.hand_size[s]);
+    int len = snprintf(out, sizeof(out), "C45GAME %llu %llu %u %s %s %u %u %.*s %.*s %d %s %.*s %d %s\n",
+                       game_id, (unsigned long long)r.end_ms, r.lobby, profiles[r.profile % 3],
+                       reasons[r.end_reason % 5], r.turns, r.duration_ms,
+                       MAX_NAME_LEN - 1, r.winner < LOBBY_SIZE ? r.name[r.winner] : "PUSH",
+                       MAX_NAME_LEN - 1, r.name[0], r.value[0], hands[0],
+                       MAX_NAME_LEN - 1, r.name[1], r.value[1], hands[1]);
+    if (len < 0 || (size_t)len >= sizeof(out)) return -1;
     if (write_all(fd, out) < 0) return -1;
-    printf("[PROTO] -> Send lobby snapshot to client (fd=%d)\n", fd);
+    printf("[PROTO] -> Send game %llu (fd=%d)\n", game_id, fd);
     return 0;
 }
 
+/* --- Per-connection input queue --- */
+/*
+ * Every socket gets a small input queue that survives state changes: the
+ * client thread (handshake, lobby, waiting, post-game) and the game thread
+ * (turns) read through it, so bytes received in one state are never lost or
+ * misparsed in the next. One recv() fills the queue with as much as is
+ * available; lines are then handed out without further syscalls.
+ *
+ * At most one thread reads a given fd at a time (ownership passes with the
+ * lobby's is_running flag), so a queue is not locked. Queues are indexed by fd
+ * and allocated lazily in chunks; a chunk is never freed, a reused fd number
+ * starts with input_queue_reset().
+ *
+ * Newlines are indexed once per received chunk (frame_newlines()), so a
+ * pipelined burst is split without rescanning and a partial line is not
+ * searched again when the rest of it arrives.
+ */
+#define INPUT_CHUNK     64
+#define INPUT_MAX_FD    (1 << 20)   /* Linux default fs.nr_open */
+#define INPUT_NL_MAX    32          /* indexed line ends per queue */
+
+typedef struct {
+    size_t   off;                   /* start of unread data in data[] */
+    size_t   len;                   /* unread bytes */
+    size_t   scanned;               /* unread bytes already searched for '\n' */
+    unsigned nl_head;               /* first entry of the nl[] ring */
+    unsigned nl_count;              /* indexed newlines not yet consumed */
+    uint16_t nl[INPUT_NL_MAX];      /* data[] index of each indexed '\n' */
+    char     data[INPUT_QUEUE_BYTES];
+} InputQueue;
+
+_Static_assert(INPUT_QUEUE_BYTES <= 65536, "InputQueue.nl[] holds 16-bit offsets");
+
+static pthread_mutex_t g_inq_mtx = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(InputQueue*) g_inq[INPUT_MAX_FD / INPUT_CHUNK];
+
+/**
+ * Look up (allocating on first use) the input queue of a file descriptor.
+ *
+ * @param fd Socket file descriptor.
+ * @return Queue, or NULL if @p fd is out of range or allocation failed.
+ */
+static InputQueue* input_queue(int fd) {
+    if (fd < 0 || fd >= INPUT_MAX_FD) return NULL;
+    _Atomic(InputQueue*)* slot = &g_inq[fd / INPUT_CHUNK];
+    InputQueue* chunk = atomic_load_explicit(slot, memory_order_acquire);
+    if (!chunk) {
+        pthread_mutex_lock(&g_inq_mtx);
+        chunk = atomic_load_explicit(slot, memory_order_relaxed);
+        if (!chunk) {
+            chunk = calloc(INPUT_CHUNK, sizeof(InputQueue));
+            if (chunk) atomic_store_explicit(slot, chunk, memory_order_release);
+        }
+        pthread_mutex_unlock(&g_inq_mtx);
+        if (!chunk) return NULL;
+    }
+    return &chunk[fd % INPUT_CHUNK];
+}
+
+/**
+ * Index the newlines of the not yet scanned queued bytes (as many as fit in nl[]).
+ *
+ * @param q Input queue.
+ */
+static void queue_index(InputQueue* q) {
+    if (q->scanned >= q->len || q->nl_count >= INPUT_NL_MAX) return;
+    uint32_t pos[INPUT_NL_MAX];
+    size_t room = INPUT_NL_MAX - q->nl_count;
+    size_t from = q->off + q->scanned;
+    size_t k = frame_newlines(q->data + from, q->len - q->scanned, pos, room);
+    for (size_t i = 0; i < k; ++i) {
+        q->nl[(q->nl_head + q->nl_count++) % INPUT_NL_MAX] = (uint16_t)(from + pos[i]);
+    }
+    // With a full index, resume after the last stored newline next time.
+    q->scanned = (k == room) ? q->scanned + pos[k - 1] + 1 : q->len;
+}
+
+/**
+ * Length of the next line in the queue.
+ *
+ * Lines longer than @p max are handed out in @p max sized pieces.
+ *
+ * @param q   Input queue.
+ * @param max Maximum line length the caller can store.
+ * @return Length including '\n'; 0 if no complete line is queued.
+ */
+static size_t queued_line_len(InputQueue* q, size_t max) {
+    if (max > sizeof(q->data) - 1) max = sizeof(q->data) - 1;
+    queue_index(q);
+    if (q->nl_count > 0) {
+        size_t n = (size_t)q->nl[q->nl_head] - q->off + 1;
+        return n > max ? max : n;
+    }
+    return q->len >= max ? max : 0;
+}
+
+/**
+ * Copy the next @p n queued bytes out as a NUL-terminated line.
+ *
+ * @param fd      Socket file descriptor (for capture).
+ * @param q       Input queue.
+ * @param n       Line length (from queued_line_len()).
+ * @param buf     Destination buffer (at least @p n + 1 bytes).
+ * @param consume 1 to remove the line from the queue; 0 to peek.
+ * @return @p n.
+ */
+static int queue_take(int fd, InputQueue* q, size_t n, char* buf, int consume) {
+    memcpy(buf, q->data + q->off, n);
+    buf[n] = '\0';
+    if (consume) {
+        q->off += n;
+        q->len -= n;
+        q->scanned -= n;  // n never exceeds the scanned prefix
+        if (q->nl_count > 0 && q->nl[q->nl_head] < q->off) {
+            q->nl_head = (q->nl_head + 1) % INPUT_NL_MAX;
+            q->nl_count--;
+        }
+        if (q->len == 0) q->off = q->nl_head = 0;
+        capture_line(fd, CAPTURE_IN, buf, n);
+    }
+    return (int)n;
+}
+
+/**
+ * Append whatever the socket has to the queue with a single recv().
+ *
+ * A fault-injected stall reads as "no data yet": -1 with errno EAGAIN and the
+ * remaining stall in @p stall_ms, so each caller waits it out against its own
+ * deadline (fault_stall_wait()).
+ *
+ * @param fd       Socket file descriptor.
+ * @param q        Input queue.
+ * @param flags    recv() flags (MSG_DONTWAIT for non-blocking fills).
+ * @param stall_ms Output: remaining stall in milliseconds; 0 if not stalled.
+ * @return Bytes added; 0 if the peer closed (or fault injection dropped
+ *         the connection); -1 on error (errno set).
+ */
+static ssize_t queue_fill(int fd, InputQueue* q, int flags, long long* stall_ms) {
+    *stall_ms = 0;
+    int f = fault_before_read(fd, stall_ms);
+    if (f < 0) return 0;
+    if (f > 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (q->off > 0) {
+        memmove(q->data, q->data + q->off, q->len);
+        for (unsigned i = 0; i < q->nl_count; ++i) {
+            q->nl[(q->nl_head + i) % INPUT_NL_MAX] -= (uint16_t)q->off;
+        }
+        q->off = 0;
+    }
+    IO_COUNT(g_io_recv);
+    ssize_t r = recv(fd, q->data + q->len, sizeof(q->data) - q->len, flags);
+    if (r > 0) q->len += (size_t)r;
+    return r;
+}
+
+/**
+ * Discard anything queued for @p fd (a new connection got this fd number).
+ *
+ * @param fd Socket file descriptor.
+ */
+void input_queue_reset(int fd) {
+    InputQueue* q = input_queue(fd);
+    if (q) {
+        q->off = q->len = q->scanned = 0;
+        q->nl_head = q->nl_count = 0;
+    }
+}
+
+/**
+ * Check whether a complete line is already queued for @p fd.
+ *
+ * poll() does not see queued input, so callers that wait on the socket
+ * must check this first.
+ *
+ * @param fd Socket file descriptor.
+ * @return 1 if read_line()/peek_line() would return without a syscall; 0 otherwise.
+ */
+int has_queued_line(int fd) {
+    InputQueue* q = input_queue(fd);
+    return q && queued_line_len(q, READ_BUF - 1) > 0;
+}
+
+/**
+ * Read a single line from a socket into a buffer (through the input queue).
+ *
+ * @param fd      Connected socket file descriptor.
+ * @param buf     Destination buffer.
+ * @param buf_sz  Size of @p buf in bytes.
+ *
+ * @return >=0 Length of data stored in @p buf (including '\n' if present).
+ * @return  0  Peer closed the connection.
+ * @return -1  Error.
+ */
+int read_line(int fd, char* buf, size_t buf_sz) {
+    if (buf_sz == 0) return -1;
+    buf[0] = '\0';
+    InputQueue* q = input_queue(fd);
+    if (!q) return -1;
+    for (;;) {
+        size_t n = queued_line_len(q, buf_sz - 1);
+        if (n > 0) return queue_take(fd, q, n, buf, 1);
+        long long stall_ms;
+        ssize_t r = queue_fill(fd, q, 0, &stall_ms);
+        if (r == 0) return 0; /* peer closed */
+        if (r < 0) {
+            if (stall_ms > 0) {
+                fault_stall_wait(fd, stall_ms);
+                continue;
+            }
+            if (errno == EINTR) continue;
+            return -1;
+        }
+    }
+}
+
+/**
+ * Read one line, waiting until a deadline; shared by read_line_timeout() and
+ * read_line_timeout_ms(). A fault-injected stall never holds the caller past
+ * the deadline.
+ *
+ * @param fd         Connected socket file descriptor.
+ * @param buf        Destination buffer.
+ * @param sz         Size of @p buf in bytes.
+ * @param timeout_ms Wait in milliseconds (0 = no wait).
+ * @param partial_ms Once bytes arrive, the deadline moves to now + this; 0 keeps it fixed.
+ *
+ * @return Same as read_line_timeout().
+ */
+static int read_line_until(int fd, char* buf, size_t sz, int timeout_ms, int partial_ms) {
+    if (sz == 0) return -1;
+    buf[0] = '\0';
+    InputQueue* q = input_queue(fd);
+    if (!q) return -1;
+    long long deadline = io_mono_ms() + timeout_ms;
+    for (;;) {
+        size_t n = queued_line_len(q, sz - 1);
+        if (n > 0) return queue_take(fd, q, n, buf, 1);
+        long long left = deadline - io_mono_ms();
+        if (left < 0) left = 0;
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        int pr = io_poll(&p, 1, left > INT_MAX ? INT_MAX : (int)left);
+        if (pr == 0) return -2;       // deadline reached
+        if (pr < 0) {
+            if (errno == EINTR) continue;   // e.g. SIGPROF from the sampling profiler
+            return -1;
+        }
+        long long stall_ms;
+        ssize_t r = queue_fill(fd, q, 0, &stall_ms);
+        if (r > 0) {
+            if (partial_ms > 0) deadline = io_mono_ms() + partial_ms;
+            continue;
+        }
+        if (r == 0) return 0;
+        if (stall_ms > 0) {
+            left = deadline - io_mono_ms();
+            if (left <= 0) return -2;
+            fault_stall_wait(fd, stall_ms < left ? stall_ms : left);
+            continue;
+        }
+        if (errno == EINTR) continue;
+        return -1;
+    }
+}
+
 /**
  * Read a single line with a poll()-based timeout.
  *
+ * Once part of a line has arrived, the rest gets 30 seconds. A fault-injected
+ * stall never holds the caller past its timeout.
+ *
  * @param fd            Connected socket file descriptor.
  * @param buf           Destination buffer.
  * @param sz            Size of @p buf in bytes.
@@ -156,19 +1112,128 @@ int send_lobbies_snapshot(int fd) {
  * @return -1  Error.
  */
 int read_line_timeout(int fd, char* buf, size_t sz, int t) {
-    size_t pos = 0;
-    while (pos < sz - 1) {
-        struct pollfd p = { .fd = fd, .events = POLLIN };
-        int pr = poll(&p, 1, t * 1000);
-        if (pr == 0) return -2;       // timeout
-        if (pr < 0) return -1;
-        char c;
-        ssize_t r = recv(fd, &c, 1, 0);
-        if (r <= 0) return r;
-        buf[pos++] = c;
-        if (c == '\n') break;
-        t = 30;
-    }
-    buf[pos] = '\0';
-    return (int)pos;
+    return read_line_until(fd, buf, sz, t * 1000, 30000);
+}
+
+/**
+ * Read a single line, waiting at most @p timeout_ms in total (turn clocks and
+ * reconnect windows that must fire within milliseconds of their deadline).
+ *
+ * Unlike read_line_timeout(), a partial line does not extend the wait: its bytes
+ * stay queued for the next call and -2 is returned at the deadline, so a slow
+ * sender cannot hold a turn past its clock.
+ *
+ * @param fd         Connected socket file descriptor.
+ * @param buf        Destination buffer.
+ * @param sz         Size of @p buf in bytes.
+ * @param timeout_ms Timeout in milliseconds (0 = no wait).
+ *
+ * @return >=0 Length of data stored in @p buf (including '\n' if present).
+ * @return  0  Peer closed the connection.
+ * @return -2  Timeout expired.
+ * @return -1  Error.
+ */
+int read_line_timeout_ms(int fd, char* buf, size_t sz, int timeout_ms) {
+    return read_line_until(fd, buf, sz, timeout_ms, 0);
+}
+
+/**
+ * Return the next line without consuming it and without blocking.
+ *
+ * If no complete line is queued, one non-blocking recv() tops up the queue.
+ * A following read_line() returns the same line without a syscall.
+ *
+ * @param fd  Connected socket file descriptor.
+ * @param buf Destination buffer.
+ * @param sz  Size of @p buf in bytes.
+ *
+ * @return >0 Length of the line in @p buf (still queued).
+ * @return  0 Peer closed the connection.
+ * @return -2 No complete line available yet.
+ * @return -1 Error.
+ */
+int peek_line(int fd, char* buf, size_t sz) {
+    if (sz == 0) return -1;
+    buf[0] = '\0';
+    InputQueue* q = input_queue(fd);
+    if (!q) return -1;
+    size_t n = queued_line_len(q, sz - 1);
+    if (n > 0) return queue_take(fd, q, n, buf, 0);
+    long long stall_ms;
+    ssize_t r = queue_fill(fd, q, MSG_DONTWAIT, &stall_ms);
+    if (r == 0) return 0;
+    if (r < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? -2 : -1;
+    n = queued_line_len(q, sz - 1);
+    return n > 0 ? queue_take(fd, q, n, buf, 0) : -2;
+}
+
+/**
+ * Find the first C45PI/C45PO queued behind the head line.
+ *
+ * @param q Input queue.
+ * @param n Output: length of the keep-alive line including '\n'.
+ * @return Offset of the line in q->data, or 0 if none is queued.
+ */
+static size_t queued_keepalive(const InputQueue* q, size_t* n) {
+    const char* end = q->data + q->off + q->len;
+    const char* line = memchr(q->data + q->off, '\n', q->len);
+    while (line && ++line < end) {
+        const char* nl = memchr(line, '\n', (size_t)(end - line));
+        if (!nl) break;
+        if ((size_t)(nl - line) >= 5 &&
+            (memcmp(line, "C45PI", 5) == 0 || memcmp(line, "C45PO", 5) == 0) &&
+            (line[5] == '\n' || line[5] == '\r' || line[5] == ' ' || line[5] == '\t')) {
+            *n = (size_t)(nl - line) + 1;
+            return (size_t)(line - q->data);
+        }
+        line = nl;
+    }
+    return 0;
+}
+
+/**
+ * Take a keep-alive line (C45PI/C45PO) from behind the head line.
+ *
+ * A line parked for a later state (a HIT/STAND waiting for the player's turn)
+ * stays at the head of the queue, but pings sent after it must still be
+ * answered. If none is queued, one non-blocking recv() tops up the queue.
+ *
+ * @param fd  Connected socket file descriptor.
+ * @param buf Destination buffer.
+ * @param sz  Size of @p buf in bytes.
+ *
+ * @return >0 Length of the keep-alive line in @p buf (removed from the queue).
+ * @return  0 Peer closed the connection.
+ * @return -2 No keep-alive line queued.
+ * @return -3 No keep-alive line queued and the queue is full: nothing more is
+ *            read until the head line is consumed (do not wait for POLLIN).
+ * @return -1 Error.
+ */
+int take_keepalive_line(int fd, char* buf, size_t sz) {
+    if (sz == 0) return -1;
+    buf[0] = '\0';
+    InputQueue* q = input_queue(fd);
+    if (!q) return -1;
+    size_t n = 0;
+    size_t at = queued_keepalive(q, &n);
+    if (at == 0) {
+        if (q->len == sizeof(q->data)) return -3;
+        long long stall_ms;
+        ssize_t r = queue_fill(fd, q, MSG_DONTWAIT, &stall_ms);
+        if (r == 0) return 0;
+        if (r < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? -2 : -1;
+        at = queued_keepalive(q, &n);
+        if (at == 0) return q->len == sizeof(q->data) ? -3 : -2;
+    }
+    size_t keep = n < sz - 1 ? n : sz - 1;
+    memcpy(buf, q->data + at, keep);
+    buf[keep] = '\0';
+    capture_line(fd, CAPTURE_IN, buf, keep);
+    size_t tail = q->off + q->len - (at + n);
+    memmove(q->data + at, q->data + at + n, tail);
+    q->len -= n;
+    // Indexed newlines behind the removed line moved: index the queue again.
+    q->scanned = 0;
+    q->nl_head = q->nl_count = 0;
+    return (int)keep;
 }
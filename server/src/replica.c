@@ -0,0 +1,593 @@
+/*
+ * replica.c
+ *
+ * Purpose:
+ *   Hot standby: table state streaming from a primary and takeover by a standby
+ *   (see replica.h for the stream format and failover rules).
+ *
+ * Responsibilities:
+ *   - Primary: flag changed tables, batch their images every REPLICA_BATCH_MS
+ *     from a background thread, bound the standby's lag.
+ *   - Standby: apply the stream to the local lobby array, detect the primary's
+ *     death, restore running games and hand over to run_server().
+ *   - Counters for C45METRICS.
+ *
+ * Table of contents:
+ *   - Configuration: replica_parse_role(), role_name()
+ *   - Game path: replica_mark()
+ *   - Primary: table_image(), build_batch(), replica_thread(), replica_start(), replica_stop()
+ *   - Standby: apply_table(), follow_stream(), restore_tables(), replica_follow(), replica_bind_retries()
+ *   - Reporting: replica_stats_format()
+ */
+
+#define _GNU_SOURCE
+#include "replica.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPLICA_RETRY_MS        200    /* standby: reconnect interval while the primary is absent */
+#define REPLICA_BIND_RETRIES    50     /* after a takeover: 50 x 100 ms for the old listen socket */
+
+int  g_replica_role = REPLICA_OFF;
+char g_replica_socket[108] = "blackjack.replica";
+int  g_replica_batch_ms = 20;
+int  g_replica_max_lag_ms = 1000;
+
+static atomic_int    g_repl_on = 0;        /* primary thread running: replica_mark() records */
+static atomic_int    g_repl_stop = 0;
+static atomic_int    g_took_over = 0;
+static pthread_t     g_repl_thread;
+static int           g_listen_fd = -1;
+static unsigned char* g_batch = NULL;      /* header + one image per lobby, allocated once */
+static unsigned char* g_mirror = NULL;     /* standby: running flag per lobby */
+
+static atomic_int    g_standby_attached = 0;
+static atomic_ullong g_batches = 0;
+static atomic_ullong g_tables = 0;
+static atomic_ullong g_bytes = 0;
+static atomic_ullong g_drops = 0;
+static atomic_uint   g_lag_ms = 0;         /* primary: last batch build-to-flush time; standby: last batch age */
+
+/**
+ * Wall-clock milliseconds (comparable between the primary and a local standby).
+ */
+static unsigned long long wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000ull;
+}
+
+/**
+ * Monotonic milliseconds (the clock of Lobby.turn_deadline_ms).
+ */
+static unsigned long long mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ull + (unsigned long long)ts.tv_nsec / 1000000ull;
+}
+
+/**
+ * Sleep for @p ms milliseconds (not counted in IoStats: this is not the game path).
+ */
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/* --- Configuration --- */
+
+/**
+ * Parse a REPLICA_ROLE value.
+ *
+ * @param s "off", "primary" or "standby".
+ * @return ReplicaRole value; -1 if unknown.
+ */
+int replica_parse_role(const char* s) {
+    if (!s) return -1;
+    if (strcmp(s, "off") == 0) return REPLICA_OFF;
+    if (strcmp(s, "primary") == 0) return REPLICA_PRIMARY;
+    if (strcmp(s, "standby") == 0) return REPLICA_STANDBY;
+    return -1;
+}
+
+/**
+ * @return Printable name of the current role.
+ */
+static const char* role_name(void) {
+    switch (g_replica_role) {
+        case REPLICA_PRIMARY: return "primary";
+        case REPLICA_STANDBY: return "standby";
+        default: return "off";
+    }
+}
+
+/**
+ * Fill a sockaddr_un with g_replica_socket.
+ *
+ * @return 0 on success; -1 if the path does not fit.
+ */
+static int replica_addr(struct sockaddr_un* a) {
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    if (strlen(g_replica_socket) >= sizeof(a->sun_path)) return -1;
+    memcpy(a->sun_path, g_replica_socket, strlen(g_replica_socket));
+    return 0;
+}
+
+/**
+ * Connect to the replica socket.
+ *
+ * @return Connected fd; -1 with errno set on failure.
+ */
+static int replica_connect(void) {
+    struct sockaddr_un a;
+    if (replica_addr(&a) != 0) { errno = ENAMETOOLONG; return -1; }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+/* --- Game path --- */
+
+/**
+ * Flag a table as changed since the last batch.
+ *
+ * @param L Lobby.
+ */
+void replica_mark(Lobby* L) {
+    if (!atomic_load_explicit(&g_repl_on, memory_order_relaxed)) return;
+    atomic_store_explicit(&L->repl_dirty, 1, memory_order_relaxed);
+}
+
+/* --- Primary --- */
+
+/**
+ * Copy one table into a stream image (under the lobby mutex).
+ *
+ * @param li Zero-based lobby index.
+ * @param t  Output image.
+ */
+static void table_image(int li, ReplicaTable* t) {
+    Lobby* L = &g_lobbies[li];
+    memset(t, 0, sizeof(*t));
+    t->lobby = li;
+    pthread_mutex_lock(&L->mtx);
+    t->running = L->is_running;
+    t->player_count = L->player_count;
+    t->turn = L->turn;
+    t->turn_left_ms = -1;
+    if (L->turn_deadline_ms) {
+        unsigned long long now = mono_ms();
+        unsigned long long left = L->turn_deadline_ms > now ? L->turn_deadline_ms - now : 0;
+        t->turn_left_ms = left > INT32_MAX ? INT32_MAX : (int32_t)left;
+    }
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        const Player* pl = &L->players[p];
+        ReplicaSeat* s = &t->seats[p];
+        memcpy(s->name, pl->name, MAX_NAME_LEN);
+        s->hand_size = pl->hand_size;
+        s->stood = pl->stood;
+        s->busted = pl->busted;
+        memcpy(s->hand, pl->hand, sizeof(s->hand));
+    }
+    t->deck = L->deck;
+    t->proof = L->proof;
+    pthread_mutex_unlock(&L->mtx);
+}
+
+/**
+ * Build the next batch from the flagged tables.
+ *
+ * @param seq Batch number.
+ * @return Batch size in bytes; 0 if no table changed.
+ */
+static size_t build_batch(uint64_t seq) {
+    ReplicaBatch* h = (ReplicaBatch*)g_batch;
+    ReplicaTable* t = (ReplicaTable*)(g_batch + sizeof(*h));
+    uint32_t n = 0;
+    for (int li = 0; li < g_lobby_count; ++li) {
+        atomic_int* d = &g_lobbies[li].repl_dirty;
+        if (!atomic_load_explicit(d, memory_order_relaxed)) continue;
+        atomic_store_explicit(d, 0, memory_order_relaxed);
+        table_image(li, &t[n++]);
+    }
+    if (n == 0) return 0;
+    h->magic = REPLICA_MAGIC;
+    h->count = n;
+    h->seq = seq;
+    h->sent_ms = wall_ms();
+    return sizeof(*h) + (size_t)n * sizeof(ReplicaTable);
+}
+
+/**
+ * Drop the current standby connection.
+ */
+static void standby_drop(int* sb, const char* why) {
+    if (*sb < 0) return;
+    close(*sb);
+    *sb = -1;
+    atomic_store(&g_standby_attached, 0);
+    printf("[REPLICA] Standby detached (%s)\n", why);
+}
+
+/**
+ * Replication thread: accept the standby, send one batch per interval.
+ *
+ * A batch that cannot be written at once stays pending (further changes are
+ * coalesced in the dirty flags meanwhile); if it is still pending after
+ * REPLICA_MAX_LAG_MS, the standby is dropped and resynchronizes on reconnect.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* replica_thread(void* arg) {
+    (void)arg;
+    int sb = -1;
+    uint64_t seq = 0;
+    size_t pend_off = 0, pend_len = 0;
+    unsigned long long pend_since = 0;
+
+    while (!atomic_load(&g_repl_stop)) {
+        struct pollfd pf[2] = {
+            { .fd = g_listen_fd, .events = POLLIN },
+            { .fd = sb, .events = POLLIN }
+        };
+        int pr = poll(pf, sb >= 0 ? 2 : 1, g_replica_batch_ms);
+
+        if (pr > 0 && (pf[0].revents & POLLIN)) {
+            int c = accept4(g_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (c >= 0) {
+                standby_drop(&sb, "replaced");   // newest standby wins
+                sb = c;
+                seq = 0;
+                pend_len = 0;
+                for (int li = 0; li < g_lobby_count; ++li) {
+                    atomic_store_explicit(&g_lobbies[li].repl_dirty, 1, memory_order_relaxed);
+                }
+                atomic_store(&g_standby_attached, 1);
+                printf("[REPLICA] Standby attached; sending %d tables\n", g_lobby_count);
+            }
+        }
+        if (sb < 0) continue;
+
+        // The standby never sends; readable means it closed.
+        if (pr > 0 && (pf[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            char tmp[64];
+            ssize_t r = recv(sb, tmp, sizeof(tmp), MSG_DONTWAIT);
+            if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) {
+                standby_drop(&sb, "closed");
+                continue;
+            }
+        }
+
+        if (pend_len == 0) {
+            size_t n = build_batch(++seq);
+            if (n == 0) { --seq; continue; }
+            pend_off = 0;
+            pend_len = n;
+            pend_since = wall_ms();
+        }
+
+        ssize_t w = send(sb, g_batch + pend_off, pend_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (w > 0) {
+            pend_off += (size_t)w;
+            pend_len -= (size_t)w;
+            atomic_fetch_add_explicit(&g_bytes, (unsigned long long)w, memory_order_relaxed);
+        } else if (w < 0 && errno != EAGAIN && errno != EINTR) {
+            standby_drop(&sb, "write error");
+            continue;
+        }
+
+        unsigned long long now = wall_ms();
+        if (pend_len == 0) {
+            const ReplicaBatch* h = (const ReplicaBatch*)g_batch;
+            atomic_fetch_add_explicit(&g_batches, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&g_tables, h->count, memory_order_relaxed);
+            atomic_store_explicit(&g_lag_ms, (unsigned)(now - pend_since), memory_order_relaxed);
+        } else if (now - pend_since > (unsigned long long)g_replica_max_lag_ms) {
+            atomic_fetch_add_explicit(&g_drops, 1, memory_order_relaxed);
+            standby_drop(&sb, "lagging");
+            pend_len = 0;
+        }
+    }
+
+    if (sb >= 0) close(sb);
+    return NULL;
+}
+
+/**
+ * Start the replication thread (primary role).
+ *
+ * Refuses to start if another primary already answers on the socket path.
+ *
+ * @return 0 on success; -1 on error.
+ */
+int replica_start(void) {
+    struct sockaddr_un a;
+    if (replica_addr(&a) != 0) {
+        fprintf(stderr, "[REPLICA] Socket path too long: %s\n", g_replica_socket);
+        return -1;
+    }
+    int other = replica_connect();
+    if (other >= 0) {
+        close(other);
+        fprintf(stderr, "[REPLICA] Another primary is serving %s; replication disabled\n", g_replica_socket);
+        return -1;
+    }
+
+    g_batch = (unsigned char*)malloc(sizeof(ReplicaBatch) + (size_t)g_lobby_count * sizeof(ReplicaTable));
+    if (!g_batch) return -1;
+
+    g_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (g_listen_fd < 0) { perror("replica socket"); goto fail; }
+    (void)unlink(g_replica_socket);   // stale file of a dead primary
+    if (bind(g_listen_fd, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(g_listen_fd, 1) != 0) {
+        perror("replica bind");
+        goto fail;
+    }
+
+    atomic_store(&g_repl_stop, 0);
+    atomic_store(&g_repl_on, 1);
+    if (pthread_create(&g_repl_thread, NULL, replica_thread, NULL) != 0) {
+        atomic_store(&g_repl_on, 0);
+        goto fail;
+    }
+    printf("[REPLICA] Primary: streaming tables on %s (batch %d ms, max lag %d ms)\n",
+           g_replica_socket, g_replica_batch_ms, g_replica_max_lag_ms);
+    return 0;
+
+fail:
+    if (g_listen_fd >= 0) close(g_listen_fd);
+    g_listen_fd = -1;
+    free(g_batch);
+    g_batch = NULL;
+    return -1;
+}
+
+/**
+ * Stop the replication thread and remove the socket file.
+ *
+ * A standby that is still attached sees the socket go away and takes over.
+ */
+void replica_stop(void) {
+    if (!atomic_exchange(&g_repl_on, 0)) return;
+    atomic_store(&g_repl_stop, 1);
+    pthread_join(g_repl_thread, NULL);
+    close(g_listen_fd);
+    g_listen_fd = -1;
+    (void)unlink(g_replica_socket);
+    free(g_batch);
+    g_batch = NULL;
+}
+
+/* --- Standby --- */
+
+/**
+ * Read exactly @p n bytes.
+ *
+ * @return 0 on success; -1 on EOF or error.
+ */
+static int read_full(int fd, void* buf, size_t n) {
+    unsigned char* p = (unsigned char*)buf;
+    while (n > 0) {
+        ssize_t r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+/**
+ * Apply one table image to the local lobby array.
+ *
+ * The remaining turn time becomes a local deadline, less the batch's age.
+ *
+ * @param t      Image.
+ * @param age_ms Time since the primary built the batch.
+ * @return 0 on success; -1 if the image is malformed.
+ */
+static int apply_table(const ReplicaTable* t, unsigned age_ms) {
+    if (t->lobby < 0 || t->lobby >= g_lobby_count) return -1;
+    if (t->player_count < 0 || t->player_count > LOBBY_SIZE) return -1;
+    if (t->turn < 0 || t->turn >= LOBBY_SIZE) return -1;
+    if (t->deck.top < 0 || t->deck.top > DECK_SIZE) return -1;
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        int hs = t->seats[p].hand_size;
+        if (hs < 0 || hs > (int)(sizeof(t->seats[p].hand) / sizeof(t->seats[p].hand[0]))) return -1;
+    }
+
+    Lobby* L = &g_lobbies[t->lobby];
+    pthread_mutex_lock(&L->mtx);
+    L->player_count = t->player_count;
+    L->turn = t->turn;
+    L->turn_deadline_ms = 0;
+    if (t->turn_left_ms >= 0) {
+        unsigned long long left = (unsigned)t->turn_left_ms > age_ms ? (unsigned)t->turn_left_ms - age_ms : 0;
+        L->turn_deadline_ms = mono_ms() + left;
+    }
+    L->deck = t->deck;
+    L->proof = t->proof;
+    L->proof.commit[sizeof(L->proof.commit) - 1] = '\0';
+    L->proof.seed[sizeof(L->proof.seed) - 1] = '\0';
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        Player* pl = &L->players[p];
+        const ReplicaSeat* s = &t->seats[p];
+        memcpy(pl->name, s->name, MAX_NAME_LEN);
+        pl->name[MAX_NAME_LEN - 1] = '\0';
+        pl->hand_size = s->hand_size;
+        pl->stood = s->stood;
+        pl->busted = s->busted;
+        memcpy(pl->hand, s->hand, sizeof(pl->hand));
+    }
+    pthread_mutex_unlock(&L->mtx);
+    g_mirror[t->lobby] = t->running ? 1 : 0;
+    return 0;
+}
+
+/**
+ * Apply batches from the primary until the stream ends.
+ *
+ * @param fd     Connected replica socket.
+ * @param synced Output: set to 1 once a batch has been applied.
+ */
+static void follow_stream(int fd, int* synced) {
+    ReplicaBatch h;
+    ReplicaTable t;
+    while (read_full(fd, &h, sizeof(h)) == 0) {
+        if (h.magic != REPLICA_MAGIC || h.count > (uint32_t)g_lobby_count) {
+            fprintf(stderr, "[REPLICA] Malformed batch; resynchronizing\n");
+            return;
+        }
+        unsigned long long now = wall_ms();
+        unsigned age_ms = now > h.sent_ms ? (unsigned)(now - h.sent_ms) : 0;
+        for (uint32_t i = 0; i < h.count; ++i) {
+            if (read_full(fd, &t, sizeof(t)) != 0) return;
+            if (apply_table(&t, age_ms) != 0) {
+                fprintf(stderr, "[REPLICA] Malformed table image; resynchronizing\n");
+                return;
+            }
+        }
+        now = wall_ms();
+        atomic_store_explicit(&g_lag_ms, now > h.sent_ms ? (unsigned)(now - h.sent_ms) : 0,
+                              memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_batches, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_tables, h.count, memory_order_relaxed);
+        *synced = 1;
+    }
+}
+
+/**
+ * Turn the mirrored running tables into resumable games.
+ *
+ * @return Number of games restored.
+ */
+static int restore_tables(void) {
+    int restored = 0;
+    for (int li = 0; li < g_lobby_count; ++li) {
+        Lobby* L = &g_lobbies[li];
+        int resume = 0;
+        pthread_mutex_lock(&L->mtx);
+        if (g_mirror[li] && L->player_count == LOBBY_SIZE) {
+            for (int p = 0; p < LOBBY_SIZE; ++p) {
+                L->players[p].connected = 1;
+                L->players[p].fd = -1;
+                L->players[p].replaced_fd = -1;
+            }
+            L->resume = 1;
+            resume = 1;
+        } else {
+            L->player_count = 0;
+            for (int p = 0; p < LOBBY_SIZE; ++p) {
+                Player* pl = &L->players[p];
+                pl->name[0] = '\0';
+                pl->hand_size = 0;
+                pl->connected = 0;
+                pl->fd = -1;
+                pl->stood = 0;
+                pl->busted = 0;
+            }
+        }
+        pthread_mutex_unlock(&L->mtx);
+        if (resume) {
+            start_game_if_ready(li);
+            restored++;
+        }
+    }
+    lobby_version_bump();
+    return restored;
+}
+
+/**
+ * Run as a standby until the primary dies, then take over.
+ *
+ * @return 0 when the caller should start serving; -1 on fatal error.
+ */
+int replica_follow(void) {
+    g_mirror = (unsigned char*)calloc((size_t)g_lobby_count, 1);
+    if (!g_mirror) return -1;
+
+    int synced = 0;
+    int said_waiting = 0;
+    for (;;) {
+        int fd = replica_connect();
+        if (fd < 0) {
+            // Refused/missing after we were in sync: the primary is gone.
+            if (synced && (errno == ECONNREFUSED || errno == ENOENT)) break;
+            if (errno == ENAMETOOLONG) {
+                fprintf(stderr, "[REPLICA] Socket path too long: %s\n", g_replica_socket);
+                free(g_mirror);
+                g_mirror = NULL;
+                return -1;
+            }
+            if (!said_waiting) {
+                printf("[REPLICA] Standby: waiting for a primary on %s\n", g_replica_socket);
+                said_waiting = 1;
+            }
+            sleep_ms(REPLICA_RETRY_MS);
+            continue;
+        }
+        printf("[REPLICA] Standby: following primary on %s\n", g_replica_socket);
+        said_waiting = 0;
+        follow_stream(fd, &synced);
+        close(fd);
+        printf("[REPLICA] Standby: stream ended after %llu batches (last lag %u ms)\n",
+               (unsigned long long)atomic_load(&g_batches), atomic_load(&g_lag_ms));
+    }
+
+    g_replica_role = REPLICA_PRIMARY;
+    atomic_store(&g_took_over, 1);
+    atomic_store(&g_batches, 0);
+    atomic_store(&g_tables, 0);
+    atomic_store(&g_lag_ms, 0);
+    int n = restore_tables();
+    printf("[REPLICA] Primary is gone; taking over with %d running game(s)\n", n);
+    free(g_mirror);
+    g_mirror = NULL;
+    return 0;
+}
+
+/**
+ * @return Busy-port retries for run_server() (nonzero right after a takeover).
+ */
+int replica_bind_retries(void) {
+    return atomic_load(&g_took_over) ? REPLICA_BIND_RETRIES : 0;
+}
+
+/* --- Reporting --- */
+
+/**
+ * Format replication counters for C45METRICS.
+ *
+ * @param out Output buffer.
+ * @param cap Size of @p out.
+ * @return Number of characters written (snprintf semantics).
+ */
+int replica_stats_format(char* out, size_t cap) {
+    return snprintf(out, cap,
+                    "repl_role=%s repl_standby=%d repl_batches=%llu repl_tables=%llu "
+                    "repl_bytes=%llu repl_drops=%llu repl_lag_ms=%u",
+                    role_name(), atomic_load(&g_standby_attached),
+                    (unsigned long long)atomic_load(&g_batches),
+                    (unsigned long long)atomic_load(&g_tables),
+                    (unsigned long long)atomic_load(&g_bytes),
+                    (unsigned long long)atomic_load(&g_drops),
+                    atomic_load(&g_lag_ms));
+}
@@ -0,0 +1,286 @@
+/*
+ * results.c
+ *
+ * Purpose:
+ *   Columnar export of finished games for analytics (see results.h for the file format).
+ *
+ * Responsibilities:
+ *   - Group finished games from the game feed (gamefeed.h) into column arrays and
+ *     append them as batches when a batch is full or a second old.
+ *   - Rotate batch files by size or age; a file gets its final name only when closed.
+ *
+ * Table of contents:
+ *   - Batches: batch_add(), write_column(), write_var_column(), batch_write()
+ *   - Files: file_open(), file_close()
+ *   - Game feed consumer: results_add(), results_tick()
+ *   - Lifecycle: results_open(), results_close(), results_is_open()
+ */
+
+#define _GNU_SOURCE
+#include "results.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RESULTS_BATCH_ROWS  1024
+#define RESULTS_FLUSH_MS    1000        /* oldest pending row waits at most this long */
+
+/* Column arrays of the batch being assembled (game feed writer thread only). */
+typedef struct {
+    uint32_t rows;
+    uint64_t first_ms;   /* monotonic time the oldest row arrived */
+    uint64_t game_id[RESULTS_BATCH_ROWS];
+    uint64_t end_ms[RESULTS_BATCH_ROWS];
+    uint16_t lobby[RESULTS_BATCH_ROWS];
+    uint8_t  profile[RESULTS_BATCH_ROWS];
+    uint8_t  end_reason[RESULTS_BATCH_ROWS];
+    uint8_t  winner[RESULTS_BATCH_ROWS];
+    uint16_t turns[RESULTS_BATCH_ROWS];
+    uint32_t duration_ms[RESULTS_BATCH_ROWS];
+    uint32_t think_ms[LOBBY_SIZE][RESULTS_BATCH_ROWS];
+    int8_t   value[LOBBY_SIZE][RESULTS_BATCH_ROWS];
+    uint32_t name_off[LOBBY_SIZE][RESULTS_BATCH_ROWS + 1];
+    char     name[LOBBY_SIZE][RESULTS_BATCH_ROWS * MAX_NAME_LEN];
+    uint32_t hand_off[LOBBY_SIZE][RESULTS_BATCH_ROWS + 1];
+    uint8_t  hand[LOBBY_SIZE][RESULTS_BATCH_ROWS * RESULTS_MAX_CARDS];
+} ResultsBatch;
+
+char g_results_dir[256] = "";
+int  g_results_rotate_mb = 64;
+int  g_results_rotate_sec = 3600;
+
+static int g_results_on = 0;   /* set before the game feed starts, cleared after it stopped */
+
+/* Game feed writer thread only. */
+static ResultsBatch       g_batch;
+static FILE*              g_out = NULL;
+static char               g_out_path[300];
+static uint64_t           g_out_opened_ms;
+static unsigned long long g_out_bytes;
+static unsigned           g_file_seq;
+static unsigned long long g_games, g_batches, g_files;
+
+/**
+ * Monotonic time in milliseconds.
+ */
+static uint64_t results_mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+/* --- Batches --- */
+
+/**
+ * Append one result to the column arrays of the current batch.
+ *
+ * @param r Result (from the game feed).
+ */
+static void batch_add(const GameResult* r) {
+    ResultsBatch* b = &g_batch;
+    uint32_t i = b->rows;
+    if (i == 0) {
+        b->first_ms = results_mono_ms();
+        for (int s = 0; s < LOBBY_SIZE; ++s) b->name_off[s][0] = b->hand_off[s][0] = 0;
+    }
+    b->game_id[i]     = r->game_id;
+    b->end_ms[i]      = r->end_ms;
+    b->lobby[i]       = r->lobby;
+    b->profile[i]     = r->profile;
+    b->end_reason[i]  = r->end_reason;
+    b->winner[i]      = r->winner;
+    b->turns[i]       = r->turns;
+    b->duration_ms[i] = r->duration_ms;
+    for (int s = 0; s < LOBBY_SIZE; ++s) {
+        b->think_ms[s][i] = r->think_ms[s];
+        b->value[s][i] = r->value[s];
+
+        size_t n = strnlen(r->name[s], MAX_NAME_LEN);
+        memcpy(b->name[s] + b->name_off[s][i], r->name[s], n);
+        b->name_off[s][i + 1] = b->name_off[s][i] + (uint32_t)n;
+
+        size_t h = r->hand_size[s] > RESULTS_MAX_CARDS ? RESULTS_MAX_CARDS : r->hand_size[s];
+        memcpy(b->hand[s] + b->hand_off[s][i], r->hand[s], h);
+        b->hand_off[s][i + 1] = b->hand_off[s][i] + (uint32_t)h;
+    }
+    b->rows = i + 1;
+    g_games++;
+}
+
+/**
+ * Write one fixed-width column.
+ *
+ * @param id    ResultsColumn.
+ * @param width Bytes per value.
+ * @param data  rows * width bytes.
+ */
+static void write_column(int id, size_t width, const void* data) {
+    uint8_t hdr[4] = { (uint8_t)id, RESULTS_FIXED, (uint8_t)(width & 0xFF), (uint8_t)(width >> 8) };
+    uint32_t bytes = (uint32_t)(width * g_batch.rows);
+    fwrite(hdr, 1, sizeof(hdr), g_out);
+    fwrite(&bytes, sizeof(bytes), 1, g_out);
+    fwrite(data, 1, bytes, g_out);
+    g_out_bytes += sizeof(hdr) + sizeof(bytes) + bytes;
+}
+
+/**
+ * Write one variable-width column: offsets, then the concatenated values.
+ *
+ * @param id   ResultsColumn.
+ * @param off  rows + 1 offsets into @p data.
+ * @param data Concatenated values.
+ */
+static void write_var_column(int id, const uint32_t* off, const void* data) {
+    uint8_t hdr[4] = { (uint8_t)id, RESULTS_VAR, 0, 0 };
+    uint32_t rows = g_batch.rows;
+    uint32_t bytes = (uint32_t)((rows + 1) * sizeof(uint32_t)) + off[rows];
+    fwrite(hdr, 1, sizeof(hdr), g_out);
+    fwrite(&bytes, sizeof(bytes), 1, g_out);
+    fwrite(off, sizeof(uint32_t), rows + 1, g_out);
+    fwrite(data, 1, off[rows], g_out);
+    g_out_bytes += sizeof(hdr) + sizeof(bytes) + bytes;
+}
+
+/* --- Files --- */
+
+/**
+ * Open the next batch file ("<name>.part" until closed).
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int file_open(void) {
+    snprintf(g_out_path, sizeof(g_out_path), "%s/results-%lld-%u.bjr",
+             g_results_dir, (long long)time(NULL), g_file_seq++);
+    char part[sizeof(g_out_path) + 8];
+    snprintf(part, sizeof(part), "%s.part", g_out_path);
+    g_out = fopen(part, "wb");
+    if (!g_out) {
+        perror("results");
+        return -1;
+    }
+    setvbuf(g_out, NULL, _IOFBF, 1 << 16);
+    fwrite(RESULTS_MAGIC, 1, 8, g_out);
+    g_out_bytes = 8;
+    g_out_opened_ms = results_mono_ms();
+    return 0;
+}
+
+/**
+ * Close the current batch file and give it its final name.
+ */
+static void file_close(void) {
+    if (!g_out) return;
+    int failed = fclose(g_out) != 0;
+    g_out = NULL;
+    char part[sizeof(g_out_path) + 8];
+    snprintf(part, sizeof(part), "%s.part", g_out_path);
+    if (failed || rename(part, g_out_path) != 0) {
+        perror("results");
+        return;
+    }
+    g_files++;
+}
+
+/**
+ * Append the current batch to the batch file (opened on demand) and rotate
+ * the file when it reached RESULTS_ROTATE_MB or RESULTS_ROTATE_SEC.
+ */
+static void batch_write(void) {
+    ResultsBatch* b = &g_batch;
+    if (b->rows == 0) return;
+    if (!g_out && file_open() != 0) {
+        b->rows = 0;   // the directory is gone: drop the batch rather than stall the ring
+        return;
+    }
+
+    uint32_t hdr[2] = { b->rows, RESULTS_COL_COUNT };
+    fwrite(hdr, sizeof(hdr), 1, g_out);
+    g_out_bytes += sizeof(hdr);
+    write_column(RESULTS_COL_GAME_ID, sizeof(b->game_id[0]), b->game_id);
+    write_column(RESULTS_COL_END_MS, sizeof(b->end_ms[0]), b->end_ms);
+    write_column(RESULTS_COL_LOBBY, sizeof(b->lobby[0]), b->lobby);
+    write_column(RESULTS_COL_PROFILE, 1, b->profile);
+    write_column(RESULTS_COL_END_REASON, 1, b->end_reason);
+    write_column(RESULTS_COL_WINNER, 1, b->winner);
+    write_column(RESULTS_COL_TURNS, sizeof(b->turns[0]), b->turns);
+    write_column(RESULTS_COL_DURATION_MS, sizeof(b->duration_ms[0]), b->duration_ms);
+    write_column(RESULTS_COL_THINK_MS_1, sizeof(b->think_ms[0][0]), b->think_ms[0]);
+    write_column(RESULTS_COL_THINK_MS_2, sizeof(b->think_ms[1][0]), b->think_ms[1]);
+    write_column(RESULTS_COL_VALUE_1, 1, b->value[0]);
+    write_column(RESULTS_COL_VALUE_2, 1, b->value[1]);
+    write_var_column(RESULTS_COL_NAME_1, b->name_off[0], b->name[0]);
+    write_var_column(RESULTS_COL_NAME_2, b->name_off[1], b->name[1]);
+    write_var_column(RESULTS_COL_HAND_1, b->hand_off[0], b->hand[0]);
+    write_var_column(RESULTS_COL_HAND_2, b->hand_off[1], b->hand[1]);
+    b->rows = 0;
+    g_batches++;
+
+    if (g_out_bytes >= (unsigned long long)g_results_rotate_mb * 1024ull * 1024ull ||
+        results_mono_ms() - g_out_opened_ms >= (uint64_t)g_results_rotate_sec * 1000ull) {
+        file_close();
+    } else {
+        fflush(g_out);
+    }
+}
+
+/* --- Game feed consumer --- */
+
+/**
+ * Add one finished game to the current batch; write the batch once it is full.
+ *
+ * @param r Result.
+ */
+void results_add(const GameResult* r) {
+    if (!g_results_on) return;
+    batch_add(r);
+    if (g_batch.rows == RESULTS_BATCH_ROWS) batch_write();
+}
+
+/**
+ * Write a batch whose oldest row waited RESULTS_FLUSH_MS; close an idle file
+ * at its age limit, so it does not stay ".part" for hours.
+ */
+void results_tick(void) {
+    if (!g_results_on) return;
+    uint64_t now = results_mono_ms();
+    if (g_batch.rows > 0 && now - g_batch.first_ms >= RESULTS_FLUSH_MS) batch_write();
+    if (g_out && g_batch.rows == 0 && now - g_out_opened_ms >= (uint64_t)g_results_rotate_sec * 1000ull)
+        file_close();
+}
+
+/* --- Lifecycle --- */
+
+/**
+ * Start exporting into @p dir.
+ *
+ * @param dir Existing directory for the batch files.
+ * @return 0 on success; -1 on error.
+ */
+int results_open(const char* dir) {
+    if (!dir || !*dir) return -1;
+    if (dir != g_results_dir) snprintf(g_results_dir, sizeof(g_results_dir), "%s", dir);
+    g_results_on = 1;
+    printf("[RESULTS] Exporting game results to %s (rotate at %d MB or %d s)\n",
+           dir, g_results_rotate_mb, g_results_rotate_sec);
+    return 0;
+}
+
+/**
+ * Write the pending batch and close the current file (the game feed is stopped).
+ */
+void results_close(void) {
+    if (!g_results_on) return;
+    batch_write();
+    file_close();
+    g_results_on = 0;
+    printf("[RESULTS] %llu games in %llu batches, %llu files\n", g_games, g_batches, g_files);
+}
+
+/**
+ * @return 1 if the export is open; 0 otherwise.
+ */
+int results_is_open(void) {
+    return g_results_on;
+}
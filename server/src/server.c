@@ -7,30 +7,49 @@
  * Responsibilities:
  *   - Accept client connections and run one thread per client.
  *   - Perform handshake (name registration) and lobby selection.
+ *   - Multi-table sessions (C45MT): one connection seated at several lobbies,
+ *     relaying "C45@<lobby>"-tagged lines to each table over a socketpair.
+ *   - Bot lane sessions (C45BOT): token-checked, seated in bot lobbies only,
+ *     no keep-alive, requeued with C45J right after each result.
  *   - Start game threads when lobbies become full.
- *   - Support keep-alive (PING/PONG) and reconnect into a running game.
+ *   - Support keep-alive (client-originated PING, answered with PONG; parameters
+ *     advertised in the handshake C45OK) and reconnect into a running game.
  *   - Maintain a global "active name" registry to prevent duplicates and to
  *     coordinate "back to lobby" requests across threads.
+ *   - Mark session lifecycle points (accept, handshake, join) for tracing (trace.h).
+ *   - Register client threads with the sampling profiler; dump it on C45PROF.
  *
  * Table of contents:
  *   - Signal handling: on_sigint()
+ *   - Registries: registries_init(), registries_free(), client_fd_*()
  *   - Active name registry: active_name_*()
- *   - Parsing helpers: parse_name_only()
+ *   - Parsing helpers: parse_name_only(), parse_name_and_lobby()
+ *   - Combined join: lobby_healthier(), join_any_lobby(), join_requested_lobby()
+ *   - Multi-table sessions: mt_join(), mt_dispatch(), mt_session()
  *   - Client thread state machine: client_thread()
- *   - Server loop: run_server()
+ *   - Accept overload handling: fd_reserve_take(), accept_shed_one(), accept_error_kind()
+ *   - Server loop: reject_busy(), run_server()
  */
 
 #define _GNU_SOURCE
 #include "server.h"
+#include "capture.h"
+#include "framing.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "protocol.h"
+#include "replica.h"
+#include "shuffle.h"
+#include "trace.h"
 #include "game.h"
 
 #include <arpa/inet.h>
-#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <poll.h>
 #include <pthread.h>
 #include <signal.h>
@@ -43,21 +62,21 @@
 #include <time.h>
 #include <unistd.h>
 
-#define ACTIVE_MAX 256
-#define CLIENT_FD_MAX 1024
+// Registries are sized by MAX_CLIENTS (g_max_clients) in registries_init().
 // Reserving names among all active connections (until disconnect)
 static pthread_mutex_t g_names_mtx = PTHREAD_MUTEX_INITIALIZER;
-static char g_active_names[ACTIVE_MAX][MAX_NAME_LEN];
-static int  g_active_fds[ACTIVE_MAX];
-static int  g_active_back_req[ACTIVE_MAX];
-static uint64_t g_active_tokens[ACTIVE_MAX];
+static char (*g_active_names)[MAX_NAME_LEN] = NULL;
+static int*      g_active_fds = NULL;
+static int*      g_active_back_req = NULL;
+static uint64_t* g_active_tokens = NULL;
 static uint64_t g_token_seq = 1;
 static int  g_active_cnt = 0;
 
 // Connected client sockets (including those who haven't completed handshake yet).
 static pthread_mutex_t g_clients_mtx = PTHREAD_MUTEX_INITIALIZER;
-static int  g_client_fds[CLIENT_FD_MAX];
+static int* g_client_fds = NULL;
 static int  g_client_cnt = 0;
+static int  g_registry_cap = 0;
 
 /**
  * Fetch the Linux socket cookie for a file descriptor.
@@ -114,6 +133,46 @@ typedef struct ClientThreadArgs {
     uint64_t cookie;
 } ClientThreadArgs;
 
+/* --- Registries --- */
+/**
+ * Free the name and client-fd registries.
+ */
+static void registries_free(void) {
+    free(g_active_names);    g_active_names = NULL;
+    free(g_active_fds);      g_active_fds = NULL;
+    free(g_active_back_req); g_active_back_req = NULL;
+    free(g_active_tokens);   g_active_tokens = NULL;
+    free(g_client_fds);      g_client_fds = NULL;
+    g_registry_cap = 0;
+}
+
+/**
+ * Allocate the name and client-fd registries for @p g_max_clients connections
+ * and report the fixed memory costs to the accounting module.
+ *
+ * @return 0 on success; -1 on allocation failure.
+ */
+static int registries_init(void) {
+    size_t cap = (size_t)g_max_clients;
+    g_active_names    = calloc(cap, sizeof(*g_active_names));
+    g_active_fds      = calloc(cap, sizeof(*g_active_fds));
+    g_active_back_req = calloc(cap, sizeof(*g_active_back_req));
+    g_active_tokens   = calloc(cap, sizeof(*g_active_tokens));
+    g_client_fds      = calloc(cap, sizeof(*g_client_fds));
+    if (!g_active_names || !g_active_fds || !g_active_back_req ||
+        !g_active_tokens || !g_client_fds) {
+        registries_free();
+        return -1;
+    }
+    g_registry_cap = g_max_clients;
+
+    size_t slot = sizeof(*g_active_names) + sizeof(*g_active_fds) + sizeof(*g_active_back_req) +
+                  sizeof(*g_active_tokens) + sizeof(*g_client_fds);
+    size_t lobbies = (size_t)g_lobby_count * sizeof(Lobby);
+    mem_set_costs(cap * slot + lobbies, sizeof(ClientThreadArgs) + INPUT_QUEUE_BYTES);
+    return 0;
+}
+
 /**
  * Register a connected client socket file descriptor.
  *
@@ -124,7 +183,7 @@ typedef struct ClientThreadArgs {
  */
 static void client_fd_add(int fd) {
     pthread_mutex_lock(&g_clients_mtx);
-    if (g_client_cnt < CLIENT_FD_MAX) {
+    if (g_client_cnt < g_registry_cap) {
         // Prevent duplicates (should not happen, but keeps the registry robust).
         for (int i = 0; i < g_client_cnt; ++i) {
             if (g_client_fds[i] == fd) {
@@ -143,6 +202,7 @@ static void client_fd_add(int fd) {
  * @param fd Socket file descriptor to remove.
  */
 static void client_fd_remove(int fd) {
+    trace_session_end(fd);
     pthread_mutex_lock(&g_clients_mtx);
     for (int i = 0; i < g_client_cnt; ++i) {
         if (g_client_fds[i] == fd) {
@@ -164,13 +224,14 @@ static void client_fd_remove(int fd) {
  * @param reason Optional single-token reason (e.g. "SIGINT", "NETWORK_LOST").
  */
 static void server_notify_and_disconnect_all(const char* reason) {
-    int fds[CLIENT_FD_MAX];
+    int* fds = NULL;
     int cnt = 0;
 
     pthread_mutex_lock(&g_clients_mtx);
     cnt = g_client_cnt;
-    if (cnt > CLIENT_FD_MAX) cnt = CLIENT_FD_MAX;
-    for (int i = 0; i < cnt; ++i) fds[i] = g_client_fds[i];
+    if (cnt > 0) fds = malloc((size_t)cnt * sizeof(*fds));
+    if (fds) memcpy(fds, g_client_fds, (size_t)cnt * sizeof(*fds));
+    else cnt = 0;
     pthread_mutex_unlock(&g_clients_mtx);
 
     char msg[128];
@@ -183,6 +244,7 @@ static void server_notify_and_disconnect_all(const char* reason) {
         (void)send(fd, msg, len, MSG_NOSIGNAL | MSG_DONTWAIT);
         (void)shutdown(fd, SHUT_RDWR);
     }
+    free(fds);
 }
 
 /**
@@ -260,6 +322,37 @@ static int is_token(const char* line, const char* tok) {
     return (c == '\0' || c == '\n' || c == '\r' || c == ' ' || c == '\t');
 }
 
+/**
+ * Send a handshake acknowledgement that advertises the keepalive parameters:
+ * "<tok> <ping_interval_ms> <liveness_timeout_ms>\n" (e.g. "C45OK 10000 15000").
+ *
+ * Older clients match the token by prefix and ignore the arguments.
+ *
+ * @param fd  Client socket.
+ * @param tok "C45OK", "C45REC_OK" or "C45JOK <lobby>".
+ * @return 0 on success; -1 on write error.
+ */
+static int send_handshake_ack(int fd, const char* tok) {
+    char out[64];
+    snprintf(out, sizeof(out), "%s %d %d\n", tok,
+             g_keepalive_interval_sec * 1000, g_keepalive_timeout_sec * 1000);
+    return write_all(fd, out);
+}
+
+/**
+ * Send the handshake acknowledgement of a bot session: "<tok> 0 0\n" (the
+ * bot lane has no keep-alive: no pings expected, no liveness timeout).
+ *
+ * @param fd  Client socket.
+ * @param tok "C45OK" or "C45JOK <lobby>".
+ * @return 0 on success; -1 on write error.
+ */
+static int send_bot_ack(int fd, const char* tok) {
+    char out[64];
+    snprintf(out, sizeof(out), "%s 0 0\n", tok);
+    return write_all(fd, out);
+}
+
 /* --- Signal handling --- */
 /**
  * SIGINT handler: marks the server loop as stopped.
@@ -289,7 +382,7 @@ int active_name_has(const char* n) {
  * @return 0 on success; -1 if the registry is full.
  */
 int active_name_add(const char* n) {
-    if (g_active_cnt >= ACTIVE_MAX) return -1;
+    if (g_active_cnt >= g_registry_cap) return -1;
     strncpy(g_active_names[g_active_cnt++], n, MAX_NAME_LEN);
     g_active_names[g_active_cnt-1][MAX_NAME_LEN-1] = '\0';
     g_active_fds[g_active_cnt-1] = -1;
@@ -442,7 +535,8 @@ static int lobby_try_reconnect(int lobby_index, const char* name, int fd) {
  * Try to take over a lobby slot while the lobby is not running (waiting phase).
  *
  * This allows a client to reconnect after losing TCP connection while waiting for
- * an opponent. The reconnect overwrites the stored fd for the matching player.
+ * an opponent. The reconnect overwrites the stored fd for the matching player and
+ * marks the old fd as replaced, so the old session leaves instead of waiting for a game.
  *
  * @param lobby_index Zero-based lobby index.
  * @param name        Player name.
@@ -470,6 +564,9 @@ static int lobby_try_takeover_waiting(int lobby_index,
         if (pl->connected && strncmp(pl->name, name, MAX_NAME_LEN) == 0) {
             int old_fd = pl->fd;
             pl->fd = fd;
+            // Tell the old session it lost the seat (lobby_seat_taken_over_locked()).
+            pl->replaced_fd = old_fd;
+            pthread_cond_broadcast(&L->changed);
             pthread_mutex_unlock(&L->mtx);
             if (out_old_fd) *out_old_fd = old_fd;
             return 0;
@@ -499,15 +596,13 @@ static int lobby_remove_player_by_name_if_fd(const char* name, int expected_fd)
             Player* pl = &L->players[p];
             if (!pl->connected) continue;
             if (strncmp(pl->name, name, MAX_NAME_LEN) != 0) continue;
-            if (pl->fd != expected_fd) {
-                pthread_mutex_unlock(&L->mtx);
-                return -1;
-            }
+            if (pl->fd != expected_fd) continue;   // same name on another socket (or a multi-table seat)
             pl->connected = 0;
             pl->name[0] = '\0';
             pl->hand_size = 0;
             pl->fd = -1;
             L->player_count--;
+            lobby_version_bump();
             pthread_mutex_unlock(&L->mtx);
             return 0;
         }
@@ -519,62 +614,500 @@ static int lobby_remove_player_by_name_if_fd(const char* name, int expected_fd)
 /**
  * Parse a client name line in the format: "C45<name>\n".
  *
+ * Prefix, trimming and the whitespace check come from one frame_line() pass.
+ *
  * @param line        Full received line.
  * @param out_name    Output buffer for the extracted name.
  * @param out_name_sz Size of @p out_name in bytes.
  * @return 0 on success; negative value on parse/validation error.
  */
 static int parse_name_only(const char* line, char* out_name, int out_name_sz) {
-    if (!is_c45_prefix(line)) return -1;
-
-    const char* s = line + 3;
-    while (*s == ' ' || *s == '\t') s++;
+    size_t n = strlen(line);
+    FrameLine f;
+    frame_line(line, n, &f);
+    if (!f.c45) return -1;
+
+    size_t len = f.tok_end - f.tok_begin;
+    if (len == 0) return -2;
+    if (f.first_space < f.tok_end) return -4;
+    if ((int)len >= out_name_sz) return -3;
+
+    memcpy(out_name, line + f.tok_begin, len);
+    out_name[len] = '\0';
+    return 0;
+}
 
+/**
+ * Parse a combined handshake line in the format: "C45JN <name> <lobby>\n".
+ *
+ * @param line        Full received line.
+ * @param out_name    Output buffer for the extracted name.
+ * @param out_name_sz Size of @p out_name in bytes.
+ * @param out_lobby   Output: 1-based lobby number, or 0 for "any lobby".
+ * @return 0 on success; negative value on parse/validation error.
+ */
+static int parse_name_and_lobby(const char* line, char* out_name, int out_name_sz, int* out_lobby) {
     char tmp[READ_BUF];
-    strncpy(tmp, s, sizeof(tmp) - 1);
-    tmp[sizeof(tmp) - 1] = '\0';
+    int lobby = -1;
+    if (sscanf(line, "C45JN %255s %d", tmp, &lobby) != 2) return -1;
+    if (lobby < 0 || lobby > g_lobby_count) return -2;
+    if ((int)strlen(tmp) >= out_name_sz) return -3;
+
+    strcpy(out_name, tmp);
+    *out_lobby = lobby;
+    return 0;
+}
 
-    for (int i = (int)strlen(tmp) - 1; i >= 0 &&
-             (tmp[i] == '\r' || tmp[i] == '\n' || tmp[i] == ' ' || tmp[i] == '\t'); --i) {
-        tmp[i] = '\0';
+/* --- Combined join --- */
+/**
+ * Health order for empty tables: fewer disconnects per completed game first.
+ *
+ * @param a First lobby counters.
+ * @param b Second lobby counters.
+ * @return 1 if @p a is healthier than @p b.
+ */
+static int lobby_healthier(const LobbyStatsView* a, const LobbyStatsView* b) {
+    // a.disc / (a.games + 1) < b.disc / (b.games + 1), without division.
+    return a->disconnects * (b->games + 1) < b->disconnects * (a->games + 1);
+}
+
+/**
+ * Seat a player in any open lobby of its class, preferring one where an
+ * opponent already waits (the game then starts right away), then the
+ * healthiest empty table (per-lobby counters, lobby_healthier()).
+ *
+ * @param name Player name.
+ * @param bot  1 = bot lobbies only; 0 = public lobbies only.
+ * @return Zero-based lobby index; -1 if every lobby is full or running.
+ */
+static int join_any_lobby(const char* name, int bot) {
+    for (int pass = 0; pass < 2; ++pass) {
+        int best = -1;
+        LobbyStatsView best_stats;
+        for (int i = 0; i < g_lobby_count; ++i) {
+            if (g_lobbies[i].bot != bot) continue;
+            pthread_mutex_lock(&g_lobbies[i].mtx);
+            int count = g_lobbies[i].player_count;
+            int running = g_lobbies[i].is_running;
+            pthread_mutex_unlock(&g_lobbies[i].mtx);
+            if (running || count >= LOBBY_SIZE) continue;
+            if (pass == 0) {
+                if (count == 0) continue;
+                if (lobby_try_add_player(i, name) == 0) return i;
+                continue;
+            }
+            LobbyStatsView v;
+            lobby_stats_snapshot(i, &v);
+            if (best < 0 || lobby_healthier(&v, &best_stats)) {
+                best = i;
+                best_stats = v;
+            }
+        }
+        if (best >= 0 && lobby_try_add_player(best, name) == 0) return best;
     }
-    if (tmp[0] == '\0') return -2;
-    for (int i = 0; tmp[i]; ++i) {
-        if (isspace((unsigned char)tmp[i])) return -4;
+    // Lost a race for the chosen table: take any open seat left.
+    for (int i = 0; i < g_lobby_count; ++i) {
+        if (g_lobbies[i].bot != bot) continue;
+        pthread_mutex_lock(&g_lobbies[i].mtx);
+        int running = g_lobbies[i].is_running;
+        pthread_mutex_unlock(&g_lobbies[i].mtx);
+        if (!running && lobby_try_add_player(i, name) == 0) return i;
     }
-    if ((int)strlen(tmp) >= out_name_sz) return -3;
+    return -1;
+}
 
-    strcpy(out_name, tmp);
+/**
+ * Seat a player for a combined "C45JN" (or "C45BOT") handshake or a bot's "C45J".
+ *
+ * @param name  Player name (already reserved).
+ * @param lobby 1-based lobby number, or 0 for any lobby of the player's class.
+ * @param bot   1 = bot session (bot lobbies only); 0 = public lobbies only.
+ * @return Zero-based lobby index; -1 if no seat was free.
+ */
+static int join_requested_lobby(const char* name, int lobby, int bot) {
+    if (lobby == 0) return join_any_lobby(name, bot);
+    if (lobby < 1 || lobby > g_lobby_count || g_lobbies[lobby - 1].bot != bot) return -1;
+    return lobby_try_add_player(lobby - 1, name) == 0 ? lobby - 1 : -1;
+}
+
+/* --- Multi-table sessions --- */
+
+/*
+ * One connection ("C45MT <name>") seated at up to MT_MAX_TABLES lobbies. Each
+ * seat is a socketpair: the game thread uses the table end as the player's
+ * socket (so lobby_game_thread() is unchanged), and the session thread relays
+ * lines between the client and the tables, tagged "C45@<lobby> <line>".
+ * The pair's FD_PER_MT_SEAT fds are charged against the fd limit (fd_admit_extra()).
+ */
+
+#define MT_MAX_TABLES 8   /* seats per multi-table session */
+
+/* One seat of a multi-table session. */
+typedef struct {
+    int lobby;     /* 1-based lobby number; 0 = free */
+    int mux_fd;    /* session end of the socketpair */
+    int game_fd;   /* table end (Player.fd) */
+} MtSeat;
+
+/**
+ * Check whether a lobby still holds a seat's table end. Caller holds the lobby mutex.
+ *
+ * @param L  Lobby.
+ * @param fd Table end of the seat.
+ * @return 1 if a connected player uses @p fd; 0 otherwise.
+ */
+static int lobby_seat_holds_fd_locked(const Lobby* L, int fd) {
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        if (L->players[p].connected && L->players[p].fd == fd) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Check (and clear) the takeover mark of a waiting session whose seat is gone:
+ * a C45REC on another connection took it over (lobby_try_takeover_waiting()).
+ * Caller holds the lobby mutex.
+ *
+ * @param L    Lobby.
+ * @param name Player name.
+ * @param fd   Socket of the waiting session.
+ * @return 1 if the seat was taken over from @p fd; 0 otherwise.
+ */
+static int lobby_seat_taken_over_locked(Lobby* L, const char* name, int fd) {
+    for (int p = 0; p < LOBBY_SIZE; ++p) {
+        Player* pl = &L->players[p];
+        if (!pl->connected || pl->replaced_fd != fd) continue;
+        if (strncmp(pl->name, name, MAX_NAME_LEN) != 0) continue;
+        pl->replaced_fd = -1;
+        return 1;
+    }
     return 0;
 }
 
 /**
- * Busy-wait until a lobby changes its running state.
+ * Check whether a lobby still holds a seat's table end (waiting or playing).
+ *
+ * @param li Zero-based lobby index.
+ * @param fd Table end of the seat.
+ * @return 1 if a connected player uses @p fd; 0 otherwise.
+ */
+static int lobby_seat_holds_fd(int li, int fd) {
+    Lobby* L = &g_lobbies[li];
+    pthread_mutex_lock(&L->mtx);
+    int held = lobby_seat_holds_fd_locked(L, fd);
+    pthread_mutex_unlock(&L->mtx);
+    return held;
+}
+
+/**
+ * Wait until a lobby no longer holds a seat's table end.
+ *
+ * Woken by Lobby.changed (the game thread dropped the seat's socket, or the
+ * game ended and released its players); the 100 ms re-check only covers a
+ * missed wakeup.
+ *
+ * @param li Zero-based lobby index.
+ * @param fd Table end of the seat.
+ */
+static void lobby_wait_seat_released(int li, int fd) {
+    Lobby* L = &g_lobbies[li];
+    pthread_mutex_lock(&L->mtx);
+    while (lobby_seat_holds_fd_locked(L, fd)) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += 100 * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        (void)pthread_cond_timedwait(&L->changed, &L->mtx, &until);
+    }
+    pthread_mutex_unlock(&L->mtx);
+}
+
+/**
+ * Give up a seat of a lobby whose game has not started (atomic with the
+ * running check, so a game that just started keeps its player).
+ *
+ * @param li Zero-based lobby index.
+ * @param fd Table end of the seat.
+ * @return 0 if the seat was removed; -1 if the game is running or the seat is gone.
+ */
+static int lobby_cancel_seat_fd(int li, int fd) {
+    Lobby* L = &g_lobbies[li];
+    int ok = -1;
+    pthread_mutex_lock(&L->mtx);
+    if (!L->is_running) {
+        for (int p = 0; p < LOBBY_SIZE; ++p) {
+            Player* pl = &L->players[p];
+            if (!pl->connected || pl->fd != fd) continue;
+            pl->connected = 0;
+            pl->name[0] = '\0';
+            pl->hand_size = 0;
+            pl->fd = -1;
+            L->player_count--;
+            lobby_version_bump();
+            ok = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&L->mtx);
+    return ok;
+}
+
+/**
+ * Release a seat: hang up the session end, take the seat back if its game has
+ * not started, and close the table end once the lobby no longer uses it (the
+ * game thread lets go when it notices the hangup or when the game ends).
+ *
+ * @param s Seat.
+ */
+static void mt_seat_release(MtSeat* s) {
+    if (!s->lobby) return;
+    close(s->mux_fd);
+    (void)lobby_cancel_seat_fd(s->lobby - 1, s->game_fd);
+    lobby_wait_seat_released(s->lobby - 1, s->game_fd);
+    close(s->game_fd);
+    fd_release_extra(FD_PER_MT_SEAT);
+    s->lobby = 0;
+    s->mux_fd = s->game_fd = -1;
+}
+
+/**
+ * Relay complete lines from a table to the client, tagged with the lobby number.
+ *
+ * @param s   Seat.
+ * @param cfd Client socket.
+ * @return 0 when drained; 1 if the table end closed; -1 on a client write error.
+ */
+static int mt_forward_out(MtSeat* s, int cfd) {
+    char line[TABLE_LINE_BYTES];
+    char out[TABLE_LINE_BYTES + 16];
+    int r;
+    while ((r = peek_line(s->mux_fd, line, sizeof(line))) > 0) {
+        (void)read_line(s->mux_fd, line, sizeof(line));
+        size_t len = strlen(line);
+        snprintf(out, sizeof(out), "C45@%d %s%s", s->lobby, line, line[len - 1] == '\n' ? "" : "\n");
+        if (write_all(cfd, out) < 0) return -1;
+    }
+    return r == -2 ? 0 : 1;
+}
+
+/**
+ * Seat the session at a lobby: "C45J <lobby>" -> "C45@<lobby> C45OK" (or C45WRONG).
+ *
+ * @param seats Session seats.
+ * @param name  Player name.
+ * @param cfd   Client socket.
+ * @param lobby 1-based lobby number.
+ * @return 0 on success or refusal; -1 on a client write error.
+ */
+static int mt_join(MtSeat* seats, const char* name, int cfd, int lobby) {
+    char out[48];
+    snprintf(out, sizeof(out), "C45@%d C45WRONG\n", lobby);
+    if (lobby < 1 || lobby > g_lobby_count || g_lobbies[lobby - 1].bot) return write_all(cfd, "C45WRONG\n");
+
+    MtSeat* free_seat = NULL;
+    for (int i = 0; i < MT_MAX_TABLES; ++i) {
+        if (seats[i].lobby == lobby) return write_all(cfd, out);
+        if (!seats[i].lobby && !free_seat) free_seat = &seats[i];
+    }
+    int sv[2];
+    if (!free_seat || fd_admit_extra(FD_PER_MT_SEAT) != 0) return write_all(cfd, out);
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        fd_release_extra(FD_PER_MT_SEAT);
+        return write_all(cfd, out);
+    }
+    if (lobby_try_add_player(lobby - 1, name) != 0) {
+        close(sv[0]);
+        close(sv[1]);
+        fd_release_extra(FD_PER_MT_SEAT);
+        return write_all(cfd, out);
+    }
+    // Fresh per-fd state: these numbers may have belonged to closed TCP connections.
+    fault_conn_begin(sv[0]);
+    fault_conn_begin(sv[1]);
+    input_queue_reset(sv[0]);
+    input_queue_reset(sv[1]);
+    lobby_attach_fd(lobby - 1, name, sv[1]);
+    free_seat->lobby = lobby;
+    free_seat->mux_fd = sv[0];
+    free_seat->game_fd = sv[1];
+
+    snprintf(out, sizeof(out), "C45@%d C45OK\n", lobby);
+    if (write_all(cfd, out) < 0) return -1;
+    printf("[PROTO] -> C45@%d C45OK '%s' (multi-table, fd=%d)\n", lobby, name, cfd);
+    start_game_if_ready(lobby - 1);
+    return 0;
+}
+
+/**
+ * Handle one client line of a multi-table session.
+ *
+ * Session-level: C45PI/C45PO (keep-alive, also counted as liveness by every
+ * running table), C45B (lobby snapshot), C45LX, C45HIST [n], C45GAME <id>, C45J <lobby>.
+ * Table-level: "C45@<lobby> <line>" goes to that table's game thread, except
+ * C45B while the game has not started, which gives the seat up.
+ *
+ * @param seats Session seats.
+ * @param name  Player name.
+ * @param cfd   Client socket.
+ * @param line  Received line.
+ * @return 0 to continue; -1 to end the session.
+ */
+static int mt_dispatch(MtSeat* seats, const char* name, int cfd, const char* line) {
+    int lobby = 0, off = 0;
+    if (is_token(line, "C45PI") || is_token(line, "C45PO")) {
+        if (is_token(line, "C45PI") && write_all(cfd, "C45PO\n") < 0) return -1;
+        for (int i = 0; i < MT_MAX_TABLES; ++i) {
+            if (!seats[i].lobby) continue;
+            pthread_mutex_lock(&g_lobbies[seats[i].lobby - 1].mtx);
+            int running = g_lobbies[seats[i].lobby - 1].is_running;
+            pthread_mutex_unlock(&g_lobbies[seats[i].lobby - 1].mtx);
+            if (running) (void)write_all(seats[i].mux_fd, "C45PO\n");
+        }
+        return 0;
+    }
+    if (is_token(line, "C45B")) return send_lobbies_snapshot_since(cfd, lobby_request_version(line));
+    if (is_token(line, "C45LX")) return send_lobby_stats(cfd, 1);
+    if (is_token(line, "C45HIST")) return send_history(cfd, name, atoi(line + 7));
+    unsigned long long game_id;
+    if (sscanf(line, "C45GAME %llu", &game_id) == 1) return send_game_record(cfd, game_id, name);
+    if (sscanf(line, "C45J %d", &lobby) == 1) return mt_join(seats, name, cfd, lobby);
+
+    if (sscanf(line, "C45@%d %n", &lobby, &off) == 1 && off > 0 && line[off] != '\0') {
+        const char* msg = line + off;
+        for (int i = 0; i < MT_MAX_TABLES; ++i) {
+            MtSeat* s = &seats[i];
+            if (s->lobby != lobby) continue;
+            if (is_token(msg, "C45B") && lobby_cancel_seat_fd(lobby - 1, s->game_fd) == 0) {
+                // Not started yet: leave the table (as C45B while waiting in a plain session).
+                mt_seat_release(s);
+                return send_lobbies_snapshot(cfd);
+            }
+            char fwd[READ_BUF + 1];
+            size_t len = strlen(msg);
+            snprintf(fwd, sizeof(fwd), "%s%s", msg, len && msg[len - 1] == '\n' ? "" : "\n");
+            (void)write_all(s->mux_fd, fwd);   // a closed table shows up as EOF on the seat
+            return 0;
+        }
+        char out[48];
+        snprintf(out, sizeof(out), "C45@%d C45WRONG\n", lobby);
+        return write_all(cfd, out);
+    }
+    return write_all(cfd, "C45WRONG\n");
+}
+
+/**
+ * Run a multi-table session until the client disconnects.
+ *
+ * @param cfd  Client socket (handshake done, lobby snapshot sent).
+ * @param name Player name (reserved in the active name registry).
+ */
+static void mt_session(int cfd, const char* name) {
+    MtSeat seats[MT_MAX_TABLES];
+    for (int i = 0; i < MT_MAX_TABLES; ++i) {
+        seats[i].lobby = 0;
+        seats[i].mux_fd = seats[i].game_fd = -1;
+    }
+    char line[READ_BUF];
+
+    for (;;) {
+        struct pollfd p[1 + MT_MAX_TABLES];
+        int seat_of[1 + MT_MAX_TABLES];
+        int n = 0;
+        p[n].fd = cfd;
+        p[n].events = POLLIN;
+        seat_of[n++] = -1;
+        for (int i = 0; i < MT_MAX_TABLES; ++i) {
+            if (!seats[i].lobby) continue;
+            p[n].fd = seats[i].mux_fd;
+            p[n].events = POLLIN;
+            seat_of[n++] = i;
+        }
+        int pr = io_poll(p, (nfds_t)n, has_queued_line(cfd) ? 0 : 1000);
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        // Tables -> client; a seat whose game ended (or dropped it) is released.
+        for (int k = 1; k < n; ++k) {
+            MtSeat* s = &seats[seat_of[k]];
+            int fr = p[k].revents ? mt_forward_out(s, cfd) : 0;
+            if (fr < 0) goto done;
+            if (fr > 0 || !lobby_seat_holds_fd(s->lobby - 1, s->game_fd)) {
+                if (fr == 0 && mt_forward_out(s, cfd) < 0) goto done;
+                printf("[GAME] '%s' left lobby #%d (multi-table, fd=%d)\n", name, s->lobby, cfd);
+                mt_seat_release(s);
+            }
+        }
+
+        // Client -> session / tables.
+        if (p[0].revents || has_queued_line(cfd)) {
+            int r;
+            while ((r = peek_line(cfd, line, sizeof(line))) > 0) {
+                (void)read_line(cfd, line, sizeof(line));
+                if (mt_dispatch(seats, name, cfd, line) < 0) goto done;
+            }
+            if (r != -2) break;
+        }
+    }
+
+done:
+    printf("[NET] Multi-table session of '%s' ends (fd=%d)\n", name, cfd);
+    // Hang up every table first, then wait for each game thread to let go.
+    for (int i = 0; i < MT_MAX_TABLES; ++i) {
+        if (seats[i].lobby) {
+            close(seats[i].mux_fd);
+            seats[i].mux_fd = -1;
+        }
+    }
+    for (int i = 0; i < MT_MAX_TABLES; ++i) {
+        MtSeat* s = &seats[i];
+        if (!s->lobby) continue;
+        (void)lobby_cancel_seat_fd(s->lobby - 1, s->game_fd);
+        lobby_wait_seat_released(s->lobby - 1, s->game_fd);
+        close(s->game_fd);
+        fd_release_extra(FD_PER_MT_SEAT);
+        s->lobby = 0;
+    }
+}
+
+/**
+ * Wait until a lobby changes its running state.
+ *
+ * Woken by Lobby.changed (game start, and game end once the players are
+ * released); the 100 ms re-check only covers a missed wakeup.
  *
  * @param lobby_index    Zero-based lobby index.
  * @param target_running Desired boolean state (0 or 1).
  */
 static void wait_lobby_running_change(int lobby_index, int target_running) {
-    for (;;) {
-        pthread_mutex_lock(&g_lobbies[lobby_index].mtx);
-        int running = g_lobbies[lobby_index].is_running;
-        pthread_mutex_unlock(&g_lobbies[lobby_index].mtx);
-        if (!!running == !!target_running) return;
-        usleep(100000);
+    Lobby* L = &g_lobbies[lobby_index];
+    pthread_mutex_lock(&L->mtx);
+    while (!!L->is_running != !!target_running) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += 100 * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        (void)pthread_cond_timedwait(&L->changed, &L->mtx, &until);
     }
+    pthread_mutex_unlock(&L->mtx);
 }
 
 
 /**
- * Per-client thread entry point.
- *
- * This function runs the complete client state machine:
- * handshake -> lobby selection -> waiting/game -> post-game.
+ * Client session: the complete client state machine
+ * (handshake -> lobby selection -> waiting/game -> post-game).
  *
- * @param arg Socket fd passed as (void*)(intptr_t)fd.
+ * @param arg Heap-allocated ClientThreadArgs (freed here).
  * @return NULL.
  */
-static void* client_thread(void* arg) {
+static void* client_session(void* arg) {
     ClientThreadArgs* a = (ClientThreadArgs*)arg;
     int cfd = a ? a->app_fd : -1;
     int track_fd = a ? a->track_fd : -1;
@@ -584,6 +1117,9 @@ static void* client_thread(void* arg) {
     printf("[NET] Client start (fd=%d)\n", cfd);
 
     client_fd_add(cfd);
+    fault_conn_begin(cfd);
+    input_queue_reset(cfd);
+    capture_session_begin(cfd);
 
     /* timeouts */
     struct timeval tv; tv.tv_sec = 120; tv.tv_usec = 0;
@@ -593,6 +1129,7 @@ static void* client_thread(void* arg) {
     char line[READ_BUF];
     char name[MAX_NAME_LEN] = {0};
     int lobby_num = -1;
+    int is_bot = 0;   /* bot lane session (C45BOT) */
     uint64_t my_token = 0;
 
     /* --- Handshake --- */
@@ -623,6 +1160,93 @@ static void* client_thread(void* arg) {
         }
         if (is_token(line, "C45PO")) continue;
 
+        // Monitoring: write the sampling profile (collapsed stacks) to PROFILE_FILE.
+        // "C45PROF <token>": same MONITOR_TOKEN check as C45METRICS.
+        if (is_token(line, "C45PROF")) {
+            char tok[sizeof(g_monitor_token)] = "";
+            if (sscanf(line, "C45PROF %63s", tok) != 1 || !monitor_token_ok(tok)) {
+                printf("[PROTO] Profile dump refused from fd=%d -> C45WRONG PROF\n", cfd);
+                write_all(cfd, "C45WRONG PROF\n");
+                client_fd_remove(cfd);
+                close(cfd);
+                close_tracked_fd_if_same(track_fd, track_cookie);
+                return NULL;
+            }
+            char out[sizeof(g_profile_path) + 32];
+            int stacks = profiler_dump(g_profile_path);
+            if (stacks < 0) snprintf(out, sizeof(out), "C45PROF OFF\n");
+            else snprintf(out, sizeof(out), "C45PROF %d %s\n", stacks, g_profile_path);
+            (void)write_all(cfd, out);
+            continue;
+        }
+
+        // Monitoring probe: memory accounting counters, one line.
+        // "C45METRICS <token>": refused unless the token matches MONITOR_TOKEN.
+        if (is_token(line, "C45METRICS")) {
+            char tok[sizeof(g_monitor_token)] = "";
+            if (sscanf(line, "C45METRICS %63s", tok) != 1 || !monitor_token_ok(tok)) {
+                printf("[PROTO] Metrics refused from fd=%d -> C45WRONG METRICS\n", cfd);
+                write_all(cfd, "C45WRONG METRICS\n");
+                client_fd_remove(cfd);
+                close(cfd);
+                close_tracked_fd_if_same(track_fd, track_cookie);
+                return NULL;
+            }
+            char out[READ_BUF * 4];
+            int len = snprintf(out, sizeof(out), "C45METRICS ");
+            len += mem_stats_format(out + len, sizeof(out) - (size_t)len);
+            if (len < (int)sizeof(out) - 1) {
+                out[len++] = ' ';
+                len += lobby_stats_format(out + len, sizeof(out) - (size_t)len);
+            }
+            if (len < (int)sizeof(out) - 1) {
+                out[len++] = ' ';
+                len += replica_stats_format(out + len, sizeof(out) - (size_t)len);
+            }
+            if (len < (int)sizeof(out) - 1) {
+                out[len++] = ' ';
+                len += profiler_stats_format(out + len, sizeof(out) - (size_t)len);
+            }
+            if (len < (int)sizeof(out) - 1) {
+                out[len++] = '\n';
+                out[len] = '\0';
+                (void)write_all(cfd, out);
+            }
+            continue;
+        }
+
+        // Monitoring probe: per-lobby game counts (the full listing needs a handshake).
+        if (is_token(line, "C45LX")) {
+            if (send_lobby_stats(cfd, 0) < 0) {
+                client_fd_remove(cfd);
+                close(cfd);
+                close_tracked_fd_if_same(track_fd, track_cookie);
+                return NULL;
+            }
+            continue;
+        }
+
+        // Support lookup: "C45GAME <id> <token>", any archived game, same MONITOR_TOKEN check as C45METRICS.
+        if (is_token(line, "C45GAME")) {
+            unsigned long long game_id;
+            char tok[sizeof(g_monitor_token)] = "";
+            if (sscanf(line, "C45GAME %llu %63s", &game_id, tok) != 2 || !monitor_token_ok(tok)) {
+                printf("[PROTO] Game lookup refused from fd=%d -> C45WRONG GAME\n", cfd);
+                write_all(cfd, "C45WRONG GAME\n");
+                client_fd_remove(cfd);
+                close(cfd);
+                close_tracked_fd_if_same(track_fd, track_cookie);
+                return NULL;
+            }
+            if (send_game_record(cfd, game_id, NULL) < 0) {
+                client_fd_remove(cfd);
+                close(cfd);
+                close_tracked_fd_if_same(track_fd, track_cookie);
+                return NULL;
+            }
+            continue;
+        }
+
         break;
     }
 
@@ -669,7 +1293,7 @@ static void* client_thread(void* arg) {
                 pthread_mutex_unlock(&L->mtx);
 
                 if (!running || !found || cur_fd == -1) break;
-                usleep(wait_us_step);
+                io_sleep_us(wait_us_step);
             }
 
             if (reconnected) {
@@ -687,7 +1311,7 @@ static void* client_thread(void* arg) {
                 my_token = active_name_set_fd(name, cfd);
                 pthread_mutex_unlock(&g_names_mtx);
 
-                write_all(cfd, "C45REC_OK\n");
+                send_handshake_ack(cfd, "C45REC_OK");
                 printf("[NET] Reconnected '%s' to lobby #%d (fd=%d)\n", name, lobby_num, cfd);
                 goto game_wait;
             }
@@ -710,7 +1334,7 @@ static void* client_thread(void* arg) {
                     my_token = active_name_set_fd(name, cfd);
                     pthread_mutex_unlock(&g_names_mtx);
 
-                    write_all(cfd, "C45REC_OK\n");
+                    send_handshake_ack(cfd, "C45REC_OK");
                     printf("[NET] Reconnected '%s' to lobby #%d (fd=%d)\n", name, lobby_num, cfd);
                     goto game_wait;
                 }
@@ -737,7 +1361,7 @@ static void* client_thread(void* arg) {
             my_token = active_name_set_fd(name, cfd);
             pthread_mutex_unlock(&g_names_mtx);
 
-            write_all(cfd, "C45REC_OK\n");
+            send_handshake_ack(cfd, "C45REC_OK");
             printf("[NET] Reconnected '%s' to lobby #%d (waiting, fd=%d)\n", name, lobby_num, cfd);
             start_game_if_ready(li);
             goto wait_for_game_start;
@@ -766,7 +1390,7 @@ static void* client_thread(void* arg) {
                 my_token = active_name_set_fd(name, cfd);
                 pthread_mutex_unlock(&g_names_mtx);
 
-                    write_all(cfd, "C45REC_OK\n");
+                    send_handshake_ack(cfd, "C45REC_OK");
                     printf("[NET] Reconnected '%s' to lobby #%d (fd=%d)\n", name, lobby_num, cfd);
                     goto game_wait;
                 }
@@ -794,7 +1418,7 @@ static void* client_thread(void* arg) {
                 my_token = active_name_set_fd(name, cfd);
                 pthread_mutex_unlock(&g_names_mtx);
 
-                    write_all(cfd, "C45REC_OK\n");
+                    send_handshake_ack(cfd, "C45REC_OK");
                     printf("[NET] Reconnected '%s' to lobby #%d (waiting, fd=%d)\n", name, lobby_num, cfd);
                     start_game_if_ready(i);
                     goto wait_for_game_start;
@@ -823,7 +1447,7 @@ static void* client_thread(void* arg) {
                 my_token = active_name_set_fd(name, cfd);
                 pthread_mutex_unlock(&g_names_mtx);
 
-                    write_all(cfd, "C45REC_OK\n");
+                    send_handshake_ack(cfd, "C45REC_OK");
                     printf("[NET] Reconnected '%s' to lobby #%d (waiting, fd=%d)\n", name, lobby_num, cfd);
                     start_game_if_ready(li);
                     goto wait_for_game_start;
@@ -854,7 +1478,7 @@ static void* client_thread(void* arg) {
         my_token = active_name_set_fd(name, cfd);
         pthread_mutex_unlock(&g_names_mtx);
 
-        if (write_all(cfd, "C45OK\n") < 0) {
+        if (send_handshake_ack(cfd, "C45OK") < 0) {
             pthread_mutex_lock(&g_names_mtx);
             active_name_remove_if_token(name, my_token);
             pthread_mutex_unlock(&g_names_mtx);
@@ -874,11 +1498,57 @@ static void* client_thread(void* arg) {
             return NULL;
         }
 
+        trace_event(cfd, TRACE_SNAPSHOT_SENT, 0, NULL);
         printf("[NET] Reconnect fallback -> lobby list for '%s' (fd=%d)\n", name, cfd);
         goto lobby_select;
     }
 
-    if (parse_name_only(line, name, sizeof(name)) != 0) {
+    // Combined handshake "C45JN <name> <lobby>": name and seat in one round trip.
+    // Multi-table handshake "C45MT <name>": one connection, several tables.
+    // Bot handshake "C45BOT <name> <token> [lobby]": bot lane (BOT_LOBBIES), seated at once.
+    int join_lobby = -1;
+    int multi_table = 0;
+    if (strncmp(line, "C45BOT ", 7) == 0) {
+        char nm[MAX_NAME_LEN], tok[sizeof(g_bot_token)], tmp[MAX_NAME_LEN + 4];
+        int fields = sscanf(line, "C45BOT %63s %63s %d", nm, tok, &join_lobby);
+        if (fields < 3) join_lobby = 0;
+        snprintf(tmp, sizeof(tmp), "C45%s", nm);
+        if (fields < 2 || parse_name_only(tmp, name, sizeof(name)) != 0 || !bot_token_ok(tok) ||
+            join_lobby < 0 || join_lobby > g_lobby_count) {
+            printf("[PROTO] Bot handshake refused from fd=%d -> C45WRONG BOT\n", cfd);
+            write_all(cfd, "C45WRONG BOT\n");
+            client_fd_remove(cfd);
+            close(cfd);
+            close_tracked_fd_if_same(track_fd, track_cookie);
+            return NULL;
+        }
+        is_bot = 1;
+        // Immediate dispatch: a bot answers each line at once, so Nagle would hold the
+        // next small write (C45T, C45R) until the delayed ACK, up to 40 ms per line.
+        int one = 1;
+        (void)setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    } else if (strncmp(line, "C45MT ", 6) == 0) {
+        char tmp[READ_BUF + 3];
+        snprintf(tmp, sizeof(tmp), "C45%s", line + 6);
+        if (parse_name_only(tmp, name, sizeof(name)) != 0) {
+            printf("[PROTO] Bad multi-table handshake from fd=%d: \"%s\" -> C45WRONG\n", cfd, line);
+            write_all(cfd, "C45WRONG\n");
+            client_fd_remove(cfd);
+            close(cfd);
+            close_tracked_fd_if_same(track_fd, track_cookie);
+            return NULL;
+        }
+        multi_table = 1;
+    } else if (strncmp(line, "C45JN ", 6) == 0) {
+        if (parse_name_and_lobby(line, name, sizeof(name), &join_lobby) != 0) {
+            printf("[PROTO] Bad combined join from fd=%d: \"%s\" -> C45WRONG\n", cfd, line);
+            write_all(cfd, "C45WRONG\n");
+            client_fd_remove(cfd);
+            close(cfd);
+            close_tracked_fd_if_same(track_fd, track_cookie);
+            return NULL;
+        }
+    } else if (parse_name_only(line, name, sizeof(name)) != 0) {
         printf("[PROTO] Bad name in handshake from fd=%d: \"%s\" -> C45WRONG\n", cfd, line);
         write_all(cfd, "C45WRONG\n");
         client_fd_remove(cfd);
@@ -886,6 +1556,7 @@ static void* client_thread(void* arg) {
         return NULL;
     }
     printf("[PROTO] Handshake OK '%s' from fd=%d\n", name, cfd);
+    trace_event(cfd, TRACE_HANDSHAKE_OK, 0, name);
 
     if (lobby_name_exists(name)) {
         write_all(cfd, "C45WRONG NAME_TAKEN\n");
@@ -911,8 +1582,39 @@ static void* client_thread(void* arg) {
         return NULL;
     }
 
-    // Acknowledge handshake for the Java client (its first OK)
-    if (write_all(cfd, "C45OK\n") < 0) {
+    if (multi_table) {
+        if (send_handshake_ack(cfd, "C45MTOK") < 0 || send_lobbies_snapshot(cfd) < 0) goto disconnect;
+        trace_event(cfd, TRACE_SNAPSHOT_SENT, 0, NULL);
+        printf("[PROTO] -> C45MTOK '%s' (multi-table, fd=%d)\n", name, cfd);
+        mt_session(cfd, name);
+        goto disconnect;
+    }
+
+    if (join_lobby >= 0) {
+        int li = join_requested_lobby(name, join_lobby, is_bot);
+        if (li >= 0) {
+            lobby_num = li + 1;
+            lobby_attach_fd(li, name, cfd);
+            // One ack for name + seat: "C45JOK <lobby> <ping_interval_ms> <timeout_ms>".
+            char tok[32];
+            snprintf(tok, sizeof(tok), "C45JOK %d", lobby_num);
+            if ((is_bot ? send_bot_ack(cfd, tok) : send_handshake_ack(cfd, tok)) < 0) {
+                printf("[ERR] Cannot send C45JOK (fd=%d)\n", cfd);
+                lobby_remove_player_by_name_if_fd(name, cfd);
+                goto disconnect;
+            }
+            printf("[PROTO] -> C45JOK '%s' in Lobby #%d (fd=%d)\n", name, lobby_num, cfd);
+            trace_event(cfd, TRACE_JOIN_OK, lobby_num, NULL);
+            start_game_if_ready(li);
+            goto wait_for_game_start;
+        }
+        // No free seat: continue as a plain handshake (C45OK + lobby list).
+        printf("[LOBBY] No seat for combined join of '%s' (lobby %d) -> lobby list (fd=%d)\n",
+               name, join_lobby, cfd);
+    }
+
+    // Acknowledge handshake for the Java client (its first OK), with keepalive parameters
+    if ((is_bot ? send_bot_ack(cfd, "C45OK") : send_handshake_ack(cfd, "C45OK")) < 0) {
         pthread_mutex_lock(&g_names_mtx);
         active_name_remove_if_token(name, my_token);
         pthread_mutex_unlock(&g_names_mtx);
@@ -933,6 +1635,7 @@ static void* client_thread(void* arg) {
         close_tracked_fd_if_same(track_fd, track_cookie);
         return NULL;
     }
+    trace_event(cfd, TRACE_SNAPSHOT_SENT, 0, NULL);
 
 lobby_select:
     for (;;) {
@@ -953,15 +1656,41 @@ lobby_select:
             }
             if (is_token(line, "C45PO")) continue;
 
-            // Request snapshot refresh outside the game loop.
+            // Request snapshot refresh outside the game loop ("C45B <version>" = conditional).
             if (is_token(line, "C45B")) {
-                if (send_lobbies_snapshot(cfd) < 0) goto disconnect;
+                if (send_lobbies_snapshot_since(cfd, lobby_request_version(line)) < 0) goto disconnect;
+                continue;
+            }
+
+            // Opt-in extended listing (per-lobby counters); the compact snapshot is unchanged.
+            if (is_token(line, "C45LX")) {
+                if (send_lobby_stats(cfd, 1) < 0) goto disconnect;
+                continue;
+            }
+
+            // The player's latest games ("C45HIST [n]") and one of them by id (history archive).
+            if (is_token(line, "C45HIST")) {
+                if (send_history(cfd, name, atoi(line + 7)) < 0) goto disconnect;
+                continue;
+            }
+            unsigned long long game_id;
+            if (sscanf(line, "C45GAME %llu", &game_id) == 1) {
+                if (send_game_record(cfd, game_id, name) < 0) goto disconnect;
                 continue;
             }
 
-            // Join lobby.
+            // Join lobby ("C45J 0" = any bot lobby, bot sessions only).
+            if (is_bot && sscanf(line, "C45J %d", &lobby_num) == 1 && lobby_num >= 0) {
+                int li = join_requested_lobby(name, lobby_num, 1);
+                if (li < 0) {
+                    write_all(cfd, "C45WRONG\n");
+                    continue;
+                }
+                lobby_num = li + 1;
+                goto seated;
+            }
             if (sscanf(line, "C45J %d", &lobby_num) != 1 ||
-                lobby_num < 1 || lobby_num > g_lobby_count) {
+                lobby_num < 1 || lobby_num > g_lobby_count || g_lobbies[lobby_num - 1].bot) {
                 printf("[PROTO] Wrong lobby choice -> C45WRONG (fd=%d)\n", cfd);
                 write_all(cfd, "C45WRONG\n");
                 continue; // stay connected and allow choosing another lobby
@@ -979,6 +1708,7 @@ lobby_select:
             // stay connected and allow choosing another lobby
             continue;
         }
+seated:
         lobby_attach_fd(lobby_num - 1, name, cfd);
 
         // Join OK for the Java client (its subsequent OKs)
@@ -989,88 +1719,98 @@ lobby_select:
         }
 
         printf("[PROTO] -> C45OK '%s' in Lobby #%d (fd=%d)\n", name, lobby_num, cfd);
+        trace_event(cfd, TRACE_JOIN_OK, lobby_num, NULL);
         start_game_if_ready(lobby_num - 1);
 
 wait_for_game_start:
 	        printf("[WAIT] '%s' Waiting for player in lobby #%d (fd=%d)\n", name, lobby_num, cfd);
 
-		        // wait until the game actually starts (or client cancels/disconnects)
+		        // Wait until the game actually starts (or client cancels/disconnects).
+		        // Lines for a later state (e.g. a HIT pipelined behind the join) stay
+		        // queued for the game thread; pings sent behind them are still answered.
+		        // The game thread owns the input queue once is_running is set, so the
+		        // queue is only touched here under the lobby mutex, after the running check.
 		        {
+		        int parked = 0;
 		        for (;;) {
-		            pthread_mutex_lock(&g_lobbies[lobby_num - 1].mtx);
-		            int running = g_lobbies[lobby_num - 1].is_running;
-		            pthread_mutex_unlock(&g_lobbies[lobby_num - 1].mtx);
+		            int r = -2;
+		            int just_parked = 0;
+		            int taken = 0;
+		            Lobby* WL = &g_lobbies[lobby_num - 1];
+		            pthread_mutex_lock(&WL->mtx);
+		            int running = WL->is_running;
+		            // A fast game (bot lane) can start and end between two checks, or a C45REC
+		            // on another connection can take the seat over: either way the seat is gone.
+		            int held = running || lobby_seat_holds_fd_locked(WL, cfd);
+		            if (!held) taken = lobby_seat_taken_over_locked(WL, name, cfd);
+		            if (!running && held && !parked) {
+		                r = peek_line(cfd, line, sizeof(line));
+		                if (r > 0 && (is_token(line, "C45PI") || is_token(line, "C45PO") || is_token(line, "C45B"))) {
+		                    (void)read_line(cfd, line, sizeof(line)); // already queued: no syscall
+		                } else if (r > 0) {
+		                    // Anything else belongs to the game: leave it queued.
+		                    parked = just_parked = 1;
+		                }
+		            }
+		            if (!running && held && parked) r = take_keepalive_line(cfd, line, sizeof(line));
+		            pthread_mutex_unlock(&WL->mtx);
 		            if (running) break;
+		            if (taken) {
+		                printf("[WAIT] '%s' seat taken over by a reconnect, closing old session (fd=%d)\n", name, cfd);
+		                goto disconnect;
+		            }
+		            if (!held) {
+		                printf("[GAME] '%s' Game in lobby #%d already over (fd=%d)\n", name, lobby_num, cfd);
+		                goto game_over;
+		            }
+		            if (just_parked) printf("[WAIT] '%s' pipelined input kept for the game (fd=%d)\n", name, cfd);
+
+		            if (r == -2 || r == -3) {
+		                // -3: the queue is full behind the parked line, only a hangup can change anything.
+		                short ev = parked ? POLLRDHUP : 0;
+		                if (r == -2) ev |= POLLIN;
+		                struct pollfd pfd = { .fd = cfd, .events = ev };
+		                int pr = io_poll(&pfd, 1, 1000);
+		                if (pr == 0) continue;
+		                if (pr < 0) {
+		                    if (errno == EINTR) continue;
+		                    printf("[WAIT] poll failed while waiting (fd=%d)\n", cfd);
+		                    lobby_remove_player_by_name_if_fd(name, cfd);
+		                    goto disconnect;
+		                }
+		                if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL | POLLRDHUP)) {
+		                    printf("[WAIT] '%s' disconnected while waiting (fd=%d)\n", name, cfd);
+		                    lobby_remove_player_by_name_if_fd(name, cfd);
+		                    goto disconnect;
+		                }
+		                continue;
+		            }
+		            if (r <= 0) {
+		                printf("[WAIT] '%s' disconnected while waiting (fd=%d)\n", name, cfd);
+		                lobby_remove_player_by_name_if_fd(name, cfd);
+		                goto disconnect;
+		            }
 
-		            struct pollfd pfd = { .fd = cfd, .events = POLLIN | POLLHUP | POLLERR };
-		            int pr = poll(&pfd, 1, 1000);
-		            if (pr == 0) continue;
-                    if (pr < 0) {
-                        if (errno == EINTR) continue;
-                        printf("[WAIT] poll failed while waiting (fd=%d)\n", cfd);
-                        lobby_remove_player_by_name_if_fd(name, cfd);
-                        goto disconnect;
-                    }
-                    if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
-                        printf("[WAIT] '%s' disconnected while waiting (fd=%d)\n", name, cfd);
-                        lobby_remove_player_by_name_if_fd(name, cfd);
-                        goto disconnect;
-                    }
-	            if (!(pfd.revents & POLLIN)) continue;
-
-	            // Re-check running before consuming any input to avoid stealing game traffic.
-	            pthread_mutex_lock(&g_lobbies[lobby_num - 1].mtx);
-	            running = g_lobbies[lobby_num - 1].is_running;
-	            pthread_mutex_unlock(&g_lobbies[lobby_num - 1].mtx);
-	            if (running) break;
-
-	            char peekbuf[READ_BUF];
-	            ssize_t rr = recv(cfd, peekbuf, sizeof(peekbuf) - 1, MSG_PEEK | MSG_DONTWAIT);
-                    if (rr == 0) {
-                        printf("[WAIT] '%s' disconnected while waiting (fd=%d)\n", name, cfd);
-                        lobby_remove_player_by_name_if_fd(name, cfd);
-                        goto disconnect;
-                    }
-                    if (rr < 0) {
-                        if (errno == EINTR) continue;
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
-                        printf("[WAIT] recv peek failed while waiting (fd=%d)\n", cfd);
-                        lobby_remove_player_by_name_if_fd(name, cfd);
-                        goto disconnect;
-                    }
-	            peekbuf[rr] = '\0';
-	            if (!strchr(peekbuf, '\n')) continue; // wait for a complete line
-
-		            int r = read_line(cfd, line, sizeof(line));
-                    if (r <= 0) {
-                        printf("[WAIT] '%s' disconnected while waiting (fd=%d)\n", name, cfd);
-                        lobby_remove_player_by_name_if_fd(name, cfd);
-                        goto disconnect;
-                    }
+		            if (is_token(line, "C45PI")) {
+		                (void)write_all(cfd, "C45PO\n");
+		                continue;
+		            }
+		            if (is_token(line, "C45PO")) continue;
 
-			            if (is_token(line, "C45PI")) {
-			                (void)write_all(cfd, "C45PO\n");
-			                continue;
-			            }
-			            if (is_token(line, "C45PO")) continue;
-
-			            if (is_token(line, "C45B")) {
-			                        // Cancel waiting: remove from lobby and return to lobby selection
-			                        lobby_remove_player_by_name_if_fd(name, cfd);
-			                        if (send_lobbies_snapshot(cfd) < 0) goto disconnect;
-			                        goto next_round;
-			            }
-	                    // Any other line while waiting is a protocol error.
-			                    write_all(cfd, "C45WRONG\n");
-			                    lobby_remove_player_by_name_if_fd(name, cfd);
-			                    goto disconnect;
-	        }
-	        }
+		            // C45B: cancel waiting, remove from lobby and return to lobby selection.
+		            lobby_remove_player_by_name_if_fd(name, cfd);
+		            if (send_lobbies_snapshot_since(cfd, lobby_request_version(line)) < 0) goto disconnect;
+		            goto next_round;
+		        }
+		        }
         printf("[GAME] '%s' Game started in lobby #%d (fd=%d)\n", name, lobby_num, cfd);
 game_wait:
         wait_lobby_running_change(lobby_num - 1, 0); // wait game end
-        // Ensure the player has been removed from the lobby by the game thread
-        while (lobby_name_exists(name)) usleep(10000);
+        // The game thread frees the seats as it ends; a seat it still holds is waited for on Lobby.changed.
+        lobby_wait_seat_released(lobby_num - 1, cfd);
+game_over:
+        // Bots queue up again right away: the next line is their next "C45J".
+        if (is_bot) goto next_round;
 
 		        printf("[GAME] '%s' Game finished, waiting for back request (fd=%d)\n", name, cfd);
         if (active_name_take_back(name, cfd)) {
@@ -1096,7 +1836,7 @@ game_wait:
 	            goto disconnect;
 	        }
 
-        if (send_lobbies_snapshot(cfd) < 0) goto disconnect;
+        if (send_lobbies_snapshot_since(cfd, lobby_request_version(line)) < 0) goto disconnect;
 
 next_round:
         continue;
@@ -1112,6 +1852,93 @@ disconnect:
     return NULL;
 }
 
+/**
+ * Per-client thread entry point: runs the session and releases the
+ * connection's admission slot when it ends (on every exit path).
+ *
+ * @param arg Heap-allocated ClientThreadArgs.
+ * @return NULL.
+ */
+static void* client_thread(void* arg) {
+    profiler_thread_begin(PROFILE_THREAD_CLIENT);
+    (void)client_session(arg);
+    profiler_thread_end();
+    mem_release_connection();
+    return NULL;
+}
+
+/* --- Server loop --- */
+/**
+ * Refuse a connection that is over the admission limit: best-effort
+ * "C45BUSY" and close (the client thread is never started).
+ *
+ * @param fd Accepted socket file descriptor.
+ */
+static void reject_busy(int fd) {
+    static const char msg[] = "C45BUSY\n";
+    (void)send(fd, msg, sizeof(msg) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(fd);
+}
+
+/* --- Accept overload handling --- */
+
+#define ACCEPT_BACKOFF_MIN_MS  10
+#define ACCEPT_BACKOFF_MAX_MS  1000
+
+// Spare fd released when accept() fails with EMFILE/ENFILE, so the pending
+// connection can still be accepted, told C45BUSY and closed.
+static int g_reserve_fd = -1;
+
+/**
+ * (Re)open the reserve fd if it is not held.
+ */
+static void fd_reserve_take(void) {
+    if (g_reserve_fd < 0) g_reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * Out of fds: give up the reserve fd, accept one pending connection, answer
+ * C45BUSY and close it, then take the reserve back.
+ *
+ * Without this the pending connection stays in the backlog and poll() keeps
+ * reporting the listen socket readable, so the loop would spin.
+ *
+ * @param srv Listening socket.
+ */
+static void accept_shed_one(int srv) {
+    if (g_reserve_fd >= 0) {
+        close(g_reserve_fd);
+        g_reserve_fd = -1;
+    }
+    int fd = accept(srv, NULL, NULL);
+    if (fd >= 0) {
+        reject_busy(fd);
+        fd_note_shed();
+    }
+    fd_reserve_take();
+}
+
+/**
+ * Classify an accept() error.
+ *
+ * @param e errno from accept().
+ * @return 0 fatal (listen socket unusable); 1 retry at once (the pending
+ *         connection failed); 2 resource shortage (retry after a backoff).
+ */
+static int accept_error_kind(int e) {
+    switch (e) {
+        case EMFILE: case ENFILE: case ENOBUFS: case ENOMEM:
+            return 2;
+        case EINTR: case EAGAIN: case ECONNABORTED: case EPROTO: case EPERM:
+        // Linux reports pending network errors of the new socket through accept().
+        case ENETDOWN: case ENOPROTOOPT: case EHOSTDOWN: case ENONET:
+        case EHOSTUNREACH: case ENETUNREACH: case ETIMEDOUT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 /**
  * Start the TCP server accept loop and spawn a thread per client.
  *
@@ -1150,16 +1977,41 @@ int run_server(const char* bind_ip, int port) {
     }
 
 
-    if (bind(srv, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    // After a standby takeover the dead primary's listen socket may still be closing.
+    int bind_rc;
+    for (int tries = replica_bind_retries();
+         (bind_rc = bind(srv, (struct sockaddr*)&addr, sizeof(addr))) < 0 && errno == EADDRINUSE && tries > 0;
+         --tries) {
+        io_sleep_us(100000);
+    }
+    if (bind_rc < 0) {
         perror("bind"); close(srv); return 1;
     }
     if (listen(srv, 64) < 0) {
         perror("listen"); close(srv); return 1;
     }
+    int nofile = fd_limit();  // raised by main() before the fault sender starts
+    fd_reserve_take();
+    if (registries_init() != 0) {
+        fprintf(stderr, "Cannot allocate registries for %d clients\n", g_max_clients);
+        close(srv);
+        return 1;
+    }
+    printf("[NET] RLIMIT_NOFILE %d (MAX_OPEN_FILES %d), %d fds per connection, reserve fd %s\n",
+           nofile, g_max_open_files, FD_PER_CONN, g_reserve_fd >= 0 ? "held" : "unavailable");
+    if ((nofile - FD_RESERVED) / FD_PER_CONN < g_max_clients) {
+        printf("[NET] MAX_CLIENTS %d exceeds the fd limit; admitting at most %d connections\n",
+               g_max_clients, (nofile - FD_RESERVED) / FD_PER_CONN);
+    }
+    printf("[MEM] Per connection %zu B, per table %zu B, limit %d connections\n",
+           mem_connection_cost(), mem_table_cost(), mem_max_connections());
+    printf("[NET] Line framing: %s\n", frame_level_name(frame_level()));
+    if (shuffle_pool_start() != 0) printf("[GAME] Shuffle pool unavailable; shuffles are computed per game\n");
 
     int ret = 0;
     const char* stop_reason = NULL;
     time_t last_ip_check = 0;
+    unsigned accept_backoff_ms = 0;
 
     printf("Server listening on %s:%d\n", bind_ip, port);
     while (g_server_running) {
@@ -1177,7 +2029,7 @@ int run_server(const char* bind_ip, int port) {
         }
 
         struct pollfd spfd = { .fd = srv, .events = POLLIN | POLLERR | POLLHUP };
-        int spr = poll(&spfd, 1, 1000);
+        int spr = io_poll(&spfd, 1, 1000);
         if (spr == 0) continue;
         if (spr < 0) {
             if (errno == EINTR) continue;
@@ -1198,28 +2050,54 @@ int run_server(const char* bind_ip, int port) {
         socklen_t clen = sizeof(cli);
         int track_fd = accept(srv, (struct sockaddr*)&cli, &clen);
         if (track_fd < 0) {
-            if (errno == EINTR) continue;
-            perror("accept");
-            ret = 1;
-            stop_reason = "ACCEPT_ERROR";
-            break;
+            int e = errno;
+            int kind = accept_error_kind(e);
+            if (kind == 0) {
+                perror("accept");
+                ret = 1;
+                stop_reason = "ACCEPT_ERROR";
+                break;
+            }
+            if (kind == 1) continue;
+
+            // Resource shortage: shed the pending connection if fds ran out,
+            // then back off (doubling up to ACCEPT_BACKOFF_MAX_MS) instead of stopping.
+            fd_note_accept_error();
+            if (e == EMFILE || e == ENFILE) accept_shed_one(srv);
+            accept_backoff_ms = accept_backoff_ms ? accept_backoff_ms * 2 : ACCEPT_BACKOFF_MIN_MS;
+            if (accept_backoff_ms > ACCEPT_BACKOFF_MAX_MS) accept_backoff_ms = ACCEPT_BACKOFF_MAX_MS;
+            fprintf(stderr, "[NET] accept: %s -> backing off %u ms\n", strerror(e), accept_backoff_ms);
+            io_sleep_us(accept_backoff_ms * 1000u);
+            continue;
+        }
+        accept_backoff_ms = 0;
+
+        if (mem_admit_connection() != 0) {
+            printf("[MEM] Connection refused: limit of %d connections reached -> C45BUSY\n",
+                   mem_max_connections());
+            reject_busy(track_fd);
+            continue;
         }
 
         uint64_t cookie = socket_cookie(track_fd);
         int cfd = dup(track_fd);
         if (cfd < 0) {
+            int e = errno;
             perror("dup");
-            close(track_fd);
+            mem_release_connection();
+            reject_busy(track_fd);
+            if (e == EMFILE || e == ENFILE) fd_note_shed();
             continue;
         }
         if (cookie == 0) cookie = socket_cookie(cfd);
+        trace_session_begin(cfd);
 
         printf("[NET] Connecting %s:%d (fd=%d track=%d)\n",
                inet_ntoa(cli.sin_addr), ntohs(cli.sin_port), cfd, track_fd);
 
-        pthread_t th;
         ClientThreadArgs* args = (ClientThreadArgs*)malloc(sizeof(*args));
         if (!args) {
+            mem_release_connection();
             close(cfd);
             close_tracked_fd_if_same(track_fd, cookie);
             continue;
@@ -1228,13 +2106,26 @@ int run_server(const char* bind_ip, int port) {
         args->track_fd = track_fd;
         args->cookie = cookie;
 
-        pthread_create(&th, NULL, client_thread, args);
-        pthread_detach(th);
+        int rc = mem_thread_create(client_thread, args);
+        if (rc != 0) {
+            fprintf(stderr, "[MEM] Cannot start client thread: %s -> C45BUSY\n", strerror(rc));
+            free(args);
+            trace_session_end(cfd);
+            mem_release_connection();
+            close(track_fd);
+            reject_busy(cfd);
+        }
     }
 
     if (!stop_reason) stop_reason = "SIGINT";
     server_notify_and_disconnect_all(stop_reason);
     close(srv);
+    if (g_reserve_fd >= 0) {
+        close(g_reserve_fd);
+        g_reserve_fd = -1;
+    }
+    shuffle_pool_stop();
+    // Client threads are detached and may still touch the registries; keep them allocated.
     printf("Server stopped\n");
     return ret;
 }
@@ -0,0 +1,382 @@
+/*
+ * shuffle.c
+ *
+ * Purpose:
+ *   Provably fair shuffles with precomputed commitments (see shuffle.h for the
+ *   exact definition auditors recompute).
+ *
+ * Responsibilities:
+ *   - Draw seeds from the kernel CSPRNG (getrandom, /dev/urandom fallback).
+ *   - Derive the deck from a seed with a SHA-256 stream and unbiased Fisher-Yates.
+ *   - Keep a ready queue of tickets filled from a background thread, in batches.
+ *   - Verify a revealed seed against a commitment.
+ *
+ * Table of contents:
+ *   - Seeds: fill_random(), next_seed(), shuffle_fixed_seeds()
+ *   - Deck derivation: SeedStream, stream_word(), stream_below(), shuffle_from_seed()
+ *   - Commitments: card_byte(), shuffle_commit(), shuffle_make()
+ *   - Pool: shuffle_producer(), shuffle_pool_start(), shuffle_pool_stop(), shuffle_take()
+ *   - Audit: hex_decode(), shuffle_verify()
+ *   - Counters: shuffle_stats_snapshot()
+ */
+
+#define _GNU_SOURCE
+#include "shuffle.h"
+#include "sha256.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+static ShuffleTicket    g_ready[SHUFFLE_POOL_TICKETS];
+static ShuffleTicket    g_staging[SHUFFLE_BATCH];   /* producer only */
+static int              g_head = 0;                 /* next ticket to take */
+static int              g_count = 0;
+static int              g_pool_on = 0;
+static int              g_pool_stop = 0;
+static pthread_t        g_producer;
+static pthread_mutex_t  g_pool_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_pool_need = PTHREAD_COND_INITIALIZER;
+
+static atomic_int         g_fixed = 0;
+static unsigned long long g_fixed_base = 0;
+static atomic_ullong      g_fixed_next = 0;
+
+static atomic_ullong g_made = 0;
+static atomic_ullong g_taken = 0;
+static atomic_ullong g_misses = 0;
+static atomic_ullong g_refills = 0;
+static atomic_ullong g_make_ns = 0;
+
+/**
+ * Monotonic nanoseconds.
+ */
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+/* --- Seeds --- */
+
+/**
+ * Fill @p out with kernel randomness.
+ *
+ * @return 0 on success; -1 if neither getrandom() nor /dev/urandom worked.
+ */
+static int fill_random(uint8_t* out, size_t n) {
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = getrandom(out + got, n - got, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    if (got == n) return 0;
+
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    while (got < n) {
+        ssize_t r = read(fd, out + got, n - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    return got == n ? 0 : -1;
+}
+
+/**
+ * Produce the next seed (random, or derived from the fixed base in benchmarks).
+ *
+ * @param seed Output seed.
+ */
+static void next_seed(uint8_t seed[SHUFFLE_SEED_BYTES]) {
+    if (atomic_load_explicit(&g_fixed, memory_order_relaxed)) {
+        uint8_t in[16];
+        unsigned long long n = atomic_fetch_add(&g_fixed_next, 1);
+        memcpy(in, &g_fixed_base, 8);
+        memcpy(in + 8, &n, 8);
+        sha256(in, sizeof(in), seed);
+        return;
+    }
+    if (fill_random(seed, SHUFFLE_SEED_BYTES) == 0) return;
+
+    // No kernel randomness: the proof still holds, but the seed is guessable.
+    static atomic_int warned = 0;
+    if (!atomic_exchange(&warned, 1)) fprintf(stderr, "[SHUFFLE] No kernel randomness; using weak seeds\n");
+    unsigned long long mix[3] = { now_ns(), (unsigned long long)rand(), (unsigned long long)(size_t)seed };
+    sha256(mix, sizeof(mix), seed);
+}
+
+/**
+ * Benchmarks only: deterministic seeds.
+ *
+ * @param base Seed base.
+ */
+void shuffle_fixed_seeds(unsigned long long base) {
+    g_fixed_base = base;
+    atomic_store(&g_fixed_next, 0);
+    atomic_store(&g_fixed, 1);
+}
+
+/* --- Deck derivation --- */
+
+typedef struct {
+    const uint8_t* seed;
+    uint32_t counter;
+    uint8_t  block[SHA256_BYTES];
+    int      pos;                  /* next unread byte of block */
+} SeedStream;
+
+/**
+ * Next 4-byte big-endian word of the seed stream.
+ */
+static uint32_t stream_word(SeedStream* s) {
+    if (s->pos >= SHA256_BYTES) {
+        uint8_t in[SHUFFLE_SEED_BYTES + 4];
+        memcpy(in, s->seed, SHUFFLE_SEED_BYTES);
+        in[SHUFFLE_SEED_BYTES]     = (uint8_t)(s->counter >> 24);
+        in[SHUFFLE_SEED_BYTES + 1] = (uint8_t)(s->counter >> 16);
+        in[SHUFFLE_SEED_BYTES + 2] = (uint8_t)(s->counter >> 8);
+        in[SHUFFLE_SEED_BYTES + 3] = (uint8_t)s->counter;
+        sha256(in, sizeof(in), s->block);
+        s->counter++;
+        s->pos = 0;
+    }
+    const uint8_t* b = s->block + s->pos;
+    s->pos += 4;
+    return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | (uint32_t)b[3];
+}
+
+/**
+ * Uniform integer in 0..n-1 (rejection sampling, no modulo bias).
+ */
+static uint32_t stream_below(SeedStream* s, uint32_t n) {
+    const uint64_t span = 1ull << 32;
+    const uint64_t limit = span - span % n;
+    for (;;) {
+        uint32_t w = stream_word(s);
+        if ((uint64_t)w < limit) return w % n;
+    }
+}
+
+/**
+ * Derive the deck order from a seed.
+ *
+ * @param seed Seed.
+ * @param out  Output deck (top = 0).
+ */
+void shuffle_from_seed(const uint8_t seed[SHUFFLE_SEED_BYTES], Deck* out) {
+    SeedStream s = { .seed = seed, .counter = 0, .pos = SHA256_BYTES };
+    deck_init(out);
+    for (int i = DECK_SIZE - 1; i > 0; --i) {
+        int j = (int)stream_below(&s, (uint32_t)(i + 1));
+        Card tmp = out->cards[i];
+        out->cards[i] = out->cards[j];
+        out->cards[j] = tmp;
+    }
+    out->top = 0;
+}
+
+/* --- Commitments --- */
+
+/**
+ * @return Card as one byte: suit * 13 + rank - 1.
+ */
+static uint8_t card_byte(Card c) {
+    return (uint8_t)((int)c.suit * 13 + c.rank - 1);
+}
+
+/**
+ * Commitment of a seed and a deck order.
+ *
+ * @param seed Seed.
+ * @param d    Deck.
+ * @param out  SHA-256 digest.
+ */
+void shuffle_commit(const uint8_t seed[SHUFFLE_SEED_BYTES], const Deck* d, uint8_t out[32]) {
+    uint8_t order[DECK_SIZE];
+    for (int i = 0; i < DECK_SIZE; ++i) order[i] = card_byte(d->cards[i]);
+    Sha256 c;
+    sha256_init(&c);
+    sha256_update(&c, seed, SHUFFLE_SEED_BYTES);
+    sha256_update(&c, order, sizeof(order));
+    sha256_final(&c, out);
+}
+
+/**
+ * Compute one ticket: fresh seed, deck, commitment.
+ *
+ * @param out Output ticket.
+ */
+void shuffle_make(ShuffleTicket* out) {
+    unsigned long long t0 = now_ns();
+    uint8_t seed[SHUFFLE_SEED_BYTES];
+    uint8_t digest[SHA256_BYTES];
+    next_seed(seed);
+    shuffle_from_seed(seed, &out->deck);
+    shuffle_commit(seed, &out->deck, digest);
+    sha256_hex(seed, sizeof(seed), out->proof.seed);
+    sha256_hex(digest, sizeof(digest), out->proof.commit);
+    atomic_fetch_add_explicit(&g_made, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_make_ns, now_ns() - t0, memory_order_relaxed);
+}
+
+/* --- Pool --- */
+
+/**
+ * Background thread: refill the ready queue one batch at a time, computing the
+ * batch outside the lock.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* shuffle_producer(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_pool_mtx);
+    for (;;) {
+        while (!g_pool_stop && g_count > SHUFFLE_POOL_TICKETS - SHUFFLE_BATCH) {
+            pthread_cond_wait(&g_pool_need, &g_pool_mtx);
+        }
+        if (g_pool_stop) break;
+        pthread_mutex_unlock(&g_pool_mtx);
+
+        for (int i = 0; i < SHUFFLE_BATCH; ++i) shuffle_make(&g_staging[i]);
+
+        pthread_mutex_lock(&g_pool_mtx);
+        for (int i = 0; i < SHUFFLE_BATCH; ++i) {
+            g_ready[(g_head + g_count) % SHUFFLE_POOL_TICKETS] = g_staging[i];
+            g_count++;
+        }
+        atomic_fetch_add_explicit(&g_refills, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&g_pool_mtx);
+    return NULL;
+}
+
+/**
+ * Start the background thread that keeps the ready queue filled.
+ *
+ * @return 0 on success; -1 on error.
+ */
+int shuffle_pool_start(void) {
+    pthread_mutex_lock(&g_pool_mtx);
+    if (g_pool_on) {
+        pthread_mutex_unlock(&g_pool_mtx);
+        return 0;
+    }
+    g_pool_stop = 0;
+    if (pthread_create(&g_producer, NULL, shuffle_producer, NULL) != 0) {
+        pthread_mutex_unlock(&g_pool_mtx);
+        return -1;
+    }
+    g_pool_on = 1;
+    pthread_mutex_unlock(&g_pool_mtx);
+    return 0;
+}
+
+/**
+ * Stop the background thread.
+ */
+void shuffle_pool_stop(void) {
+    pthread_mutex_lock(&g_pool_mtx);
+    if (!g_pool_on) {
+        pthread_mutex_unlock(&g_pool_mtx);
+        return;
+    }
+    g_pool_stop = 1;
+    g_pool_on = 0;
+    pthread_cond_signal(&g_pool_need);
+    pthread_mutex_unlock(&g_pool_mtx);
+    pthread_join(g_producer, NULL);
+}
+
+/**
+ * Take the next ticket from the ready queue (or compute one inline if empty).
+ *
+ * @param out Output ticket.
+ */
+void shuffle_take(ShuffleTicket* out) {
+    atomic_fetch_add_explicit(&g_taken, 1, memory_order_relaxed);
+    pthread_mutex_lock(&g_pool_mtx);
+    if (g_count > 0) {
+        *out = g_ready[g_head];
+        g_head = (g_head + 1) % SHUFFLE_POOL_TICKETS;
+        g_count--;
+        // Wake the producer only when crossing the refill mark; below it the producer
+        // is already busy and rechecks the count after each batch.
+        if (g_count == SHUFFLE_POOL_TICKETS - SHUFFLE_BATCH) pthread_cond_signal(&g_pool_need);
+        pthread_mutex_unlock(&g_pool_mtx);
+        return;
+    }
+    pthread_mutex_unlock(&g_pool_mtx);
+    atomic_fetch_add_explicit(&g_misses, 1, memory_order_relaxed);
+    shuffle_make(out);
+}
+
+/* --- Audit --- */
+
+/**
+ * Decode exactly 2 * @p n lowercase/uppercase hex chars.
+ *
+ * @return 0 on success; -1 on bad length or characters.
+ */
+static int hex_decode(const char* s, uint8_t* out, size_t n) {
+    if (!s || strlen(s) != 2 * n) return -1;
+    for (size_t i = 0; i < 2 * n; ++i) {
+        char c = s[i];
+        int v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else return -1;
+        if (i % 2 == 0) out[i / 2] = (uint8_t)(v << 4);
+        else out[i / 2] |= (uint8_t)v;
+    }
+    return 0;
+}
+
+/**
+ * Check a revealed seed against a commitment.
+ *
+ * @param seed_hex   Seed (64 hex chars).
+ * @param commit_hex Commitment (64 hex chars).
+ * @param out        Optional output deck.
+ * @return 1 if it matches; 0 if not; -1 if malformed.
+ */
+int shuffle_verify(const char* seed_hex, const char* commit_hex, Deck* out) {
+    uint8_t seed[SHUFFLE_SEED_BYTES], want[SHA256_BYTES], got[SHA256_BYTES];
+    if (hex_decode(seed_hex, seed, sizeof(seed)) != 0) return -1;
+    if (hex_decode(commit_hex, want, sizeof(want)) != 0) return -1;
+    Deck d;
+    shuffle_from_seed(seed, &d);
+    shuffle_commit(seed, &d, got);
+    if (out) *out = d;
+    return memcmp(want, got, sizeof(got)) == 0 ? 1 : 0;
+}
+
+/* --- Counters --- */
+
+/**
+ * Copy the counters.
+ *
+ * @param out Output counters.
+ */
+void shuffle_stats_snapshot(ShuffleStats* out) {
+    out->made = atomic_load(&g_made);
+    out->taken = atomic_load(&g_taken);
+    out->misses = atomic_load(&g_misses);
+    out->refills = atomic_load(&g_refills);
+    out->make_ns = atomic_load(&g_make_ns);
+    pthread_mutex_lock(&g_pool_mtx);
+    out->ready = g_count;
+    pthread_mutex_unlock(&g_pool_mtx);
+}
@@ -0,0 +1,426 @@
+/*
+ * trace.c
+ *
+ * Purpose:
+ *   Session lifecycle tracing exported as Chrome trace JSON (see trace.h for the spans).
+ *
+ * Responsibilities:
+ *   - Sample accepted connections and map their sockets to trace session ids.
+ *   - Enqueue timestamped lifecycle events from I/O and game threads into an MPSC ring.
+ *   - Pair events into spans on a background writer thread, write them as JSON
+ *     and keep per-phase totals for the shutdown summary.
+ *
+ * Table of contents:
+ *   - Session ids: trace_session_begin(), trace_session_end(), session_of()
+ *   - Recording: trace_event()
+ *   - JSON output: write_span(), write_thread_name(), json_escape()
+ *   - Span assembly: slot_for(), finish_session(), apply_event()
+ *   - Writer thread: consume_event(), trace_idle()
+ *   - Lifecycle: trace_open(), trace_close()
+ */
+
+#define _GNU_SOURCE
+#include "trace.h"
+#include "mpsc.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_RING_SLOTS     8192
+#define TRACE_MAX_FD         65536
+#define TRACE_OPEN_SESSIONS  4096       /* sessions being assembled by the writer */
+#define TRACE_IDLE_NS        2000000L   /* writer sleep when the ring is empty (2 ms) */
+
+typedef struct {
+    uint64_t ts_ns;
+    uint32_t session;
+    uint8_t  kind;
+    int32_t  arg;
+    char     label[TRACE_LABEL_LEN];
+} TraceRecord;
+
+/* Span names; indexes into g_span_names and g_span_stats. */
+typedef enum {
+    SPAN_HANDSHAKE = 0,
+    SPAN_LOBBY_LIST,
+    SPAN_LOBBY_SELECT,
+    SPAN_WAIT_OPPONENT,
+    SPAN_DEAL,
+    SPAN_FIRST_CARD,
+    SPAN_TURN,
+    SPAN_SESSION,
+    SPAN_COUNT
+} TraceSpan;
+
+static const char* const g_span_names[SPAN_COUNT] = {
+    "handshake", "lobby_list", "lobby_select", "wait_opponent",
+    "deal", "time_to_first_card", "turn", "session"
+};
+
+/* Per-session state kept by the writer thread. */
+typedef struct {
+    uint32_t id;          /* 0 = free slot */
+    uint64_t t_accept;
+    uint64_t t_mark;      /* end of the previous phase */
+    uint64_t t_turn;      /* C45T sent (valid while turn_open) */
+    int      turn_open;
+    int      first_card;
+    int      games, turns;
+} TraceSession;
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum_ns;
+    unsigned long long max_ns;
+} SpanStats;
+
+static void consume_event(const void* rec);
+static void trace_idle(int drained);
+
+char g_trace_path[256] = "";
+int  g_trace_sample = 1;
+
+static MpscWriter       g_writer = { .idle_ns = TRACE_IDLE_NS, .consume = consume_event, .idle = trace_idle };
+static FILE*            g_out = NULL;
+static struct timespec  g_t0;
+static _Atomic uint32_t g_session_by_fd[TRACE_MAX_FD];
+static atomic_uint      g_session_seq = 0;
+static atomic_uint      g_accept_seq = 0;
+
+/* Writer thread only. */
+static TraceSession     g_open[TRACE_OPEN_SESSIONS];
+static SpanStats        g_span_stats[SPAN_COUNT];
+static int              g_first_event = 1;
+static unsigned long    g_evicted = 0;
+
+/**
+ * Monotonic nanoseconds since trace start.
+ */
+static uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - g_t0.tv_sec) * 1000000000ull +
+           (uint64_t)(ts.tv_nsec - g_t0.tv_nsec);
+}
+
+/**
+ * Push one event into the ring (dropped and counted if the ring is full).
+ */
+static void push_event(uint32_t session, int kind, int arg, const char* label) {
+    size_t ticket;
+    TraceRecord* rec = (TraceRecord*)mpsc_claim(&g_writer.ring, &ticket);
+    if (!rec) return;
+
+    rec->ts_ns = trace_now_ns();
+    rec->session = session;
+    rec->kind = (uint8_t)kind;
+    rec->arg = arg;
+    if (label) snprintf(rec->label, sizeof(rec->label), "%s", label);
+    else rec->label[0] = '\0';
+    mpsc_publish(&g_writer.ring, ticket);
+}
+
+/* --- Session ids --- */
+
+/**
+ * Start a session for a freshly accepted socket if the connection is sampled.
+ *
+ * @param fd Connected socket file descriptor.
+ */
+void trace_session_begin(int fd) {
+    if (!atomic_load_explicit(&g_writer.on, memory_order_relaxed)) return;
+    if (fd < 0 || fd >= TRACE_MAX_FD) return;
+
+    unsigned n = atomic_fetch_add_explicit(&g_accept_seq, 1, memory_order_relaxed);
+    int every = g_trace_sample > 0 ? g_trace_sample : 1;
+    if (n % (unsigned)every != 0) {
+        atomic_store_explicit(&g_session_by_fd[fd], 0, memory_order_relaxed);
+        return;
+    }
+    uint32_t id = atomic_fetch_add_explicit(&g_session_seq, 1, memory_order_relaxed) + 1;
+    atomic_store_explicit(&g_session_by_fd[fd], id, memory_order_relaxed);
+    push_event(id, TRACE_ACCEPT, 0, NULL);
+}
+
+/**
+ * Look up the trace session id for a socket (0 = not traced).
+ */
+static uint32_t session_of(int fd) {
+    if (fd < 0 || fd >= TRACE_MAX_FD) return 0;
+    return atomic_load_explicit(&g_session_by_fd[fd], memory_order_relaxed);
+}
+
+/**
+ * End the session on @p fd and forget the mapping (before the fd can be reused).
+ *
+ * @param fd Socket file descriptor.
+ */
+void trace_session_end(int fd) {
+    if (!atomic_load_explicit(&g_writer.on, memory_order_relaxed)) return;
+    if (fd < 0 || fd >= TRACE_MAX_FD) return;
+    uint32_t id = atomic_exchange_explicit(&g_session_by_fd[fd], 0, memory_order_relaxed);
+    if (id) push_event(id, TRACE_END, 0, NULL);
+}
+
+/* --- Recording --- */
+
+/**
+ * Record a lifecycle point of the session on @p fd (no-op when not traced).
+ *
+ * @param fd    Socket of the session.
+ * @param kind  TraceKind.
+ * @param arg   Kind-specific argument.
+ * @param label Optional text (NULL for none).
+ */
+void trace_event(int fd, int kind, int arg, const char* label) {
+    if (!atomic_load_explicit(&g_writer.on, memory_order_relaxed)) return;
+    uint32_t id = session_of(fd);
+    if (id) push_event(id, kind, arg, label);
+}
+
+/* --- JSON output --- */
+
+/**
+ * Copy @p in into @p out as the body of a JSON string.
+ *
+ * @param in  Text.
+ * @param out Output buffer (at least 6 * strlen(in) + 1 bytes for the worst case).
+ * @param cap Size of @p out.
+ */
+static void json_escape(const char* in, char* out, size_t cap) {
+    size_t o = 0;
+    for (; *in && o + 7 < cap; ++in) {
+        unsigned char c = (unsigned char)*in;
+        if (c == '"' || c == '\\') {
+            out[o++] = '\\';
+            out[o++] = (char)c;
+        } else if (c < 0x20) {
+            o += (size_t)snprintf(out + o, cap - o, "\\u%04x", c);
+        } else {
+            out[o++] = (char)c;
+        }
+    }
+    out[o] = '\0';
+}
+
+/**
+ * Write one complete ("X") event and account it in the phase totals.
+ *
+ * @param span  Span name index.
+ * @param tid   Session id.
+ * @param from  Start (ns since trace start).
+ * @param to    End (ns since trace start).
+ * @param args  JSON object members without braces (may be empty).
+ */
+static void write_span(int span, uint32_t tid, uint64_t from, uint64_t to, const char* args) {
+    uint64_t dur = to > from ? to - from : 0;
+    SpanStats* st = &g_span_stats[span];
+    st->count++;
+    st->sum_ns += dur;
+    if (dur > st->max_ns) st->max_ns = dur;
+
+    fprintf(g_out, "%s{\"name\":\"%s\",\"cat\":\"session\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                   "\"pid\":1,\"tid\":%u,\"args\":{%s}}",
+            g_first_event ? "\n" : ",\n", g_span_names[span],
+            (double)from / 1000.0, (double)dur / 1000.0, tid, args ? args : "");
+    g_first_event = 0;
+}
+
+/**
+ * Name the session's track after the player.
+ *
+ * @param tid  Session id.
+ * @param name Player name.
+ */
+static void write_thread_name(uint32_t tid, const char* name) {
+    char esc[TRACE_LABEL_LEN * 6 + 1];
+    json_escape(name, esc, sizeof(esc));
+    fprintf(g_out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                   "\"args\":{\"name\":\"#%u %s\"}}",
+            g_first_event ? "\n" : ",\n", tid, tid, esc);
+    g_first_event = 0;
+}
+
+/* --- Span assembly --- */
+
+/**
+ * Write the session span and free the slot.
+ *
+ * @param s          Session.
+ * @param end        End timestamp.
+ * @param incomplete Nonzero if the session did not end (eviction, shutdown).
+ */
+static void finish_session(TraceSession* s, uint64_t end, int incomplete) {
+    char args[96];
+    snprintf(args, sizeof(args), "\"games\":%d,\"turns\":%d%s",
+             s->games, s->turns, incomplete ? ",\"incomplete\":1" : "");
+    write_span(SPAN_SESSION, s->id, s->t_accept, end, args);
+    s->id = 0;
+}
+
+/**
+ * Find the writer-side state of a session.
+ *
+ * @param id     Session id.
+ * @param create Nonzero for TRACE_ACCEPT: claim the slot (evicting an older session).
+ * @return Session state; NULL if the session is unknown (e.g. its accept was dropped).
+ */
+static TraceSession* slot_for(uint32_t id, int create) {
+    TraceSession* s = &g_open[id % TRACE_OPEN_SESSIONS];
+    if (s->id == id) return s;
+    if (!create) return NULL;
+    if (s->id) {
+        // More than TRACE_OPEN_SESSIONS traced sessions alive: close out the oldest one here.
+        finish_session(s, s->t_mark, 1);
+        g_evicted++;
+    }
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    return s;
+}
+
+/**
+ * Advance a session's state with one event, writing the spans it completes.
+ *
+ * @param rec Event.
+ */
+static void apply_event(const TraceRecord* rec) {
+    TraceSession* s = slot_for(rec->session, rec->kind == TRACE_ACCEPT);
+    if (!s) return;
+
+    uint64_t ts = rec->ts_ns;
+    char args[64];
+    switch (rec->kind) {
+    case TRACE_ACCEPT:
+        s->t_accept = s->t_mark = ts;
+        break;
+    case TRACE_HANDSHAKE_OK:
+        write_span(SPAN_HANDSHAKE, s->id, s->t_mark, ts, "");
+        if (rec->label[0]) write_thread_name(s->id, rec->label);
+        s->t_mark = ts;
+        break;
+    case TRACE_SNAPSHOT_SENT:
+        write_span(SPAN_LOBBY_LIST, s->id, s->t_mark, ts, "");
+        s->t_mark = ts;
+        break;
+    case TRACE_JOIN_OK:
+        snprintf(args, sizeof(args), "\"lobby\":%d", (int)rec->arg);
+        write_span(SPAN_LOBBY_SELECT, s->id, s->t_mark, ts, args);
+        s->t_mark = ts;
+        break;
+    case TRACE_GAME_START:
+        snprintf(args, sizeof(args), "\"lobby\":%d", (int)rec->arg);
+        write_span(SPAN_WAIT_OPPONENT, s->id, s->t_mark, ts, args);
+        s->games++;
+        s->t_mark = ts;
+        break;
+    case TRACE_DEAL:
+        write_span(SPAN_DEAL, s->id, s->t_mark, ts, "");
+        if (!s->first_card) {
+            write_span(SPAN_FIRST_CARD, s->id, s->t_accept, ts, "");
+            s->first_card = 1;
+        }
+        s->t_mark = ts;
+        break;
+    case TRACE_TURN_REQUEST:
+        s->t_turn = ts;
+        s->turn_open = 1;
+        break;
+    case TRACE_TURN_RESPONSE:
+        if (!s->turn_open) break;
+        snprintf(args, sizeof(args), "\"action\":\"%s\"",
+                 rec->arg == 'H' ? "hit" : rec->arg == 'S' ? "stand" : "timeout");
+        write_span(SPAN_TURN, s->id, s->t_turn, ts, args);
+        s->turns++;
+        s->turn_open = 0;
+        s->t_mark = ts;
+        break;
+    case TRACE_END:
+        finish_session(s, ts, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+/* --- Writer thread --- */
+
+/**
+ * Writer thread: fold one queued event into the spans.
+ *
+ * @param rec TraceRecord.
+ */
+static void consume_event(const void* rec) {
+    apply_event((const TraceRecord*)rec);
+}
+
+/**
+ * Flush the file once the ring ran empty.
+ *
+ * @param drained Nonzero if the pass handled events.
+ */
+static void trace_idle(int drained) {
+    if (!drained) fflush(g_out);
+}
+
+/* --- Lifecycle --- */
+
+/**
+ * Start tracing into @p path and spawn the writer thread.
+ *
+ * @param path Output file path.
+ * @return 0 on success; -1 on error.
+ */
+int trace_open(const char* path) {
+    if (!path || !*path) return -1;
+    g_out = fopen(path, "w");
+    if (!g_out) {
+        perror("trace");
+        return -1;
+    }
+    setvbuf(g_out, NULL, _IOFBF, 1 << 16);
+    fputs("[", g_out);
+
+    clock_gettime(CLOCK_MONOTONIC, &g_t0);
+    if (mpsc_writer_start(&g_writer, TRACE_RING_SLOTS, sizeof(TraceRecord)) != 0) {
+        fclose(g_out);
+        g_out = NULL;
+        return -1;
+    }
+    printf("[TRACE] Tracing 1 of every %d sessions to %s\n",
+           g_trace_sample > 0 ? g_trace_sample : 1, path);
+    return 0;
+}
+
+/**
+ * Write pending spans, stop the writer thread, terminate the JSON array and
+ * print the per-phase summary.
+ *
+ * Sessions still connected get their session span marked "incomplete". The ring
+ * itself is not freed: detached client threads may still be inside trace_event().
+ */
+void trace_close(void) {
+    if (!mpsc_writer_stop(&g_writer)) return;
+
+    uint64_t now = trace_now_ns();
+    for (int i = 0; i < TRACE_OPEN_SESSIONS; ++i) {
+        if (g_open[i].id) finish_session(&g_open[i], now, 1);
+    }
+    fputs("\n]\n", g_out);
+    fclose(g_out);
+    g_out = NULL;
+
+    printf("[TRACE] %u sessions traced\n", atomic_load(&g_session_seq));
+    for (int i = 0; i < SPAN_COUNT; ++i) {
+        const SpanStats* st = &g_span_stats[i];
+        if (!st->count) continue;
+        printf("[TRACE]   %-18s n=%-6llu avg=%9.3f ms  max=%9.3f ms\n", g_span_names[i], st->count,
+               (double)st->sum_ns / (double)st->count / 1e6, (double)st->max_ns / 1e6);
+    }
+    size_t dropped = atomic_load(&g_writer.ring.dropped);
+    if (dropped) printf("[TRACE] %zu events dropped (ring full)\n", dropped);
+    if (g_evicted) printf("[TRACE] %lu sessions closed early (too many open)\n", g_evicted);
+}
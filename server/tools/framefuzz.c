@@ -0,0 +1,251 @@
+/*
+ * framefuzz.c
+ *
+ * Purpose:
+ *   Equivalence fuzzer for the vectorized line framing (framing.c): every SIMD
+ *   level must return exactly what the scalar reference returns.
+ *
+ * Responsibilities:
+ *   - Generate random buffers biased towards protocol bytes ("C45", newlines,
+ *     '\r', blanks, other whitespace, high bytes) at random lengths and
+ *     alignments, including lengths around the 16/32-byte block edges.
+ *   - Compare frame_newlines() (with random output capacities) and frame_line()
+ *     at every supported level against the scalar functions.
+ *   - Optionally (-b) print scan throughput per level.
+ *
+ * Table of contents:
+ *   - Options: FuzzOptions, parse_options()
+ *   - Input generation: rng_next(), gen_bytes()
+ *   - Checks: check_newlines(), check_line()
+ *   - Throughput: bench_levels()
+ *   - main()
+ */
+
+#define _GNU_SOURCE
+#include "framing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FF_MAX_LEN  700     /* longer than INPUT_QUEUE_BYTES / 2 and READ_BUF */
+#define FF_MAX_POS  64
+
+typedef struct {
+    long iterations;
+    unsigned long long seed;
+    int bench;
+} FuzzOptions;
+
+static FuzzOptions g_opt;
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-n ITERATIONS] [-s SEED] [-b]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -n ITERATIONS  Random cases per level (default 200000)\n");
+    printf("  -s SEED        Generator seed (default 1)\n");
+    printf("  -b             Also print scan throughput per level\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @param o    Output options.
+ * @return 0 on success; -1 on invalid options.
+ */
+static int parse_options(int argc, char** argv, FuzzOptions* o) {
+    o->iterations = 200000;
+    o->seed = 1;
+    o->bench = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (strcmp(a, "-b") == 0) { o->bench = 1; continue; }
+        if (i + 1 >= argc) return -1;
+        if (strcmp(a, "-n") == 0) o->iterations = atol(argv[++i]);
+        else if (strcmp(a, "-s") == 0) o->seed = strtoull(argv[++i], NULL, 10);
+        else return -1;
+    }
+    if (o->iterations < 1) return -1;
+    if (o->seed == 0) o->seed = 1;
+    return 0;
+}
+
+/* --- Input generation --- */
+
+static unsigned long long g_rng;
+
+/**
+ * xorshift64* step.
+ */
+static unsigned long long rng_next(void) {
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return g_rng * 2685821657736338717ull;
+}
+
+/**
+ * Fill @p out with @p n bytes that look like protocol traffic plus noise.
+ *
+ * @param out Destination.
+ * @param n   Number of bytes.
+ */
+static void gen_bytes(char* out, size_t n) {
+    static const char alphabet[] = "C45C45\n\n\r  \t\v\fHSBabcXYZ019_-";
+    for (size_t i = 0; i < n; ++i) {
+        unsigned r = (unsigned)(rng_next() >> 40);
+        if (r % 16 == 0) out[i] = (char)(unsigned char)(r >> 8);   // any byte, incl. >= 0x80
+        else out[i] = alphabet[(r >> 4) % (sizeof(alphabet) - 1)];
+        if (out[i] == '\0') out[i] = 'x';
+    }
+    // Often start like a real line.
+    if (n >= 3 && rng_next() % 2) memcpy(out, "C45", 3);
+}
+
+/**
+ * Pick a length, favouring the block edges (15..17, 31..33, ...).
+ */
+static size_t gen_len(size_t max) {
+    unsigned long long r = rng_next();
+    if (r % 4 == 0) {
+        size_t edge = (size_t)(16u * (1u + (r >> 8) % 8u));
+        size_t len = edge - 1u + (size_t)((r >> 16) % 3u);
+        return len > max ? max : len;
+    }
+    return (size_t)((r >> 8) % (max + 1));
+}
+
+/* --- Checks --- */
+
+/**
+ * Compare frame_newlines() with the scalar reference on one input.
+ *
+ * @return 0 if equal; -1 otherwise (details printed).
+ */
+static int check_newlines(const char* p, size_t n, size_t max) {
+    uint32_t a[FF_MAX_POS], b[FF_MAX_POS];
+    size_t ka = frame_newlines(p, n, a, max);
+    size_t kb = frame_newlines_scalar(p, n, b, max);
+    if (ka == kb && memcmp(a, b, ka * sizeof(a[0])) == 0) return 0;
+    fprintf(stderr, "framefuzz: %s newlines differ (len %zu, max %zu): %zu vs %zu positions\n",
+            frame_level_name(frame_level()), n, max, ka, kb);
+    return -1;
+}
+
+/**
+ * Compare frame_line() with the scalar reference on one input.
+ *
+ * @return 0 if equal; -1 otherwise (details printed).
+ */
+static int check_line(const char* p, size_t n) {
+    FrameLine a, b;
+    frame_line(p, n, &a);
+    frame_line_scalar(p, n, &b);
+    if (a.c45 == b.c45 && a.tok_begin == b.tok_begin && a.tok_end == b.tok_end &&
+        a.first_space == b.first_space) return 0;
+    fprintf(stderr, "framefuzz: %s line differs (len %zu): "
+                    "c45 %d/%d begin %zu/%zu end %zu/%zu space %zu/%zu\n",
+            frame_level_name(frame_level()), n, a.c45, b.c45, a.tok_begin, b.tok_begin,
+            a.tok_end, b.tok_end, a.first_space, b.first_space);
+    return -1;
+}
+
+/* --- Throughput --- */
+
+/**
+ * Monotonic time in seconds.
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Print newline-scan and line-parse throughput for every supported level.
+ *
+ * @param top Best supported level.
+ */
+static void bench_levels(FrameLevel top) {
+    // A pipelined burst: a typical mix of short commands and a handshake.
+    static const char burst[] = "C45PI\nC45H\nC45H\nC45S\nC45B 17\nC45alice_the_player\n";
+    static const char name[] = "C45   alice_the_player_with_a_long_name\r\n";
+    char chunk[1024];
+    size_t used = 0;
+    while (used + sizeof(burst) - 1 <= sizeof(chunk)) {
+        memcpy(chunk + used, burst, sizeof(burst) - 1);
+        used += sizeof(burst) - 1;
+    }
+    const long rounds = 200000;
+    volatile size_t sink = 0;
+    for (int l = FRAME_SCALAR; l <= (int)top; ++l) {
+        frame_set_level((FrameLevel)l);
+        uint32_t pos[FF_MAX_POS];
+        double t0 = now_sec();
+        for (long r = 0; r < rounds; ++r) sink += frame_newlines(chunk, used, pos, FF_MAX_POS);
+        double t1 = now_sec();
+        FrameLine f;
+        for (long r = 0; r < rounds; ++r) {
+            frame_line(name, sizeof(name) - 1, &f);
+            sink += f.tok_end;
+        }
+        double t2 = now_sec();
+        printf("  %-6s newlines %7.0f MB/s   name line %6.1f ns\n",
+               frame_level_name((FrameLevel)l),
+               (double)used * (double)rounds / (t1 - t0) / 1e6,
+               (t2 - t1) / (double)rounds * 1e9);
+    }
+    (void)sink;
+}
+
+/**
+ * Fuzzer entry point.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @return 0 if every level matched the reference; 1 on a mismatch; 2 on bad options.
+ */
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 2;
+    }
+
+    FrameLevel top = frame_level();
+    // Slack on both sides so inputs start at every alignment.
+    static char buf[FF_MAX_LEN + 64];
+    long failures = 0;
+
+    for (int l = FRAME_SCALAR; l <= (int)top; ++l) {
+        if (frame_set_level((FrameLevel)l) != 0) continue;
+        g_rng = g_opt.seed;
+        for (long it = 0; it < g_opt.iterations && failures < 10; ++it) {
+            size_t align = (size_t)(rng_next() % 32u);
+            size_t n = gen_len(FF_MAX_LEN);
+            char* p = buf + align;
+            gen_bytes(p, n);
+            size_t max = (size_t)(rng_next() % (FF_MAX_POS + 1));
+            if (check_newlines(p, n, max) != 0) failures++;
+
+            size_t ln = gen_len(300);
+            gen_bytes(p, ln);
+            if (check_line(p, ln) != 0) failures++;
+        }
+        printf("framefuzz: %-6s %ld cases %s\n", frame_level_name((FrameLevel)l),
+               g_opt.iterations, failures ? "MISMATCH" : "OK");
+    }
+
+    if (g_opt.bench) bench_levels(top);
+    printf("RESULT level=%s mismatches=%ld\n", frame_level_name(top), failures);
+    return failures ? 1 : 0;
+}
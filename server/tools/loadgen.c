@@ -0,0 +1,611 @@
+/*
+ * loadgen.c
+ *
+ * Purpose:
+ *   Synthetic load generator for the Blackjack server.
+ *
+ * Responsibilities:
+ *   - Drive pairs of scripted players through complete games
+ *     (handshake -> join -> turns -> result -> back to lobby list).
+ *   - Measure games/s, action -> response latency and protocol throughput.
+ *   - Resume sessions through C45REC when a connection is dropped (e.g. by the
+ *     server's fault injection mode) and report reconnect success.
+ *   - Bot lane mode (-b TOKEN): sessions open with "C45BOT" and queue for the
+ *     next game with "C45J" right after each result.
+ *
+ * Table of contents:
+ *   - Options: LoadOptions, parse_options()
+ *   - Connection helpers: lg_connect(), lg_send(), lg_read_line()
+ *   - Player state machine: lg_join(), handle_line(), player_thread()
+ *   - Report: print_report()
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LG_LINE_MAX   512
+#define LG_LAT_MAX    (1 << 16)
+
+typedef struct {
+    const char* host;
+    int port;
+    int pairs;
+    int duration_sec;
+    int first_lobby;
+    int think_ms;
+    unsigned seed;
+    const char* bot_token;   /* NULL = regular players */
+} LoadOptions;
+
+typedef struct {
+    int    id;
+    char   name[32];
+    int    lobby;
+    int    fd;
+    char   in[4096];
+    size_t inlen;
+
+    int    named;          /* handshake was accepted at least once */
+    int    reconnecting;   /* C45REC sent, waiting for the answer */
+    int    expect_join_ok; /* C45J sent, waiting for C45OK/C45WRONG */
+    int    cards[12];
+    int    ncards;
+    double pending_ms;     /* send time of the last HIT/STAND (0 = none) */
+    double game_start_ms;
+    unsigned seed;
+
+    uint64_t results;
+    uint64_t actions;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t rec_attempts;
+    uint64_t rec_ok;
+    uint64_t drops;
+    uint64_t errors;
+    double*  lat;
+    size_t   lat_n;
+    uint64_t lat_seen;
+} LgPlayer;
+
+static LoadOptions g_opt;
+static atomic_int  g_stop = 0;
+static double      g_deadline_ms = 0;
+
+/**
+ * Monotonic clock in milliseconds.
+ *
+ * @return Current time in ms.
+ */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/**
+ * Sleep for a number of milliseconds.
+ *
+ * @param ms Duration in milliseconds.
+ */
+static void sleep_ms(int ms) {
+    if (ms <= 0) return;
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) { }
+}
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-h HOST] [-p PORT] [-c PAIRS] [-d SECONDS] [-l FIRST_LOBBY] [-t THINK_MS] [-s SEED] [-b TOKEN]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -h HOST   Server host (default 127.0.0.1)\n");
+    printf("  -p PORT   Server port (default 10000)\n");
+    printf("  -c PAIRS  Number of player pairs; pair i plays in lobby FIRST_LOBBY+i (default 1)\n");
+    printf("  -d SEC    Test duration in seconds (default 10)\n");
+    printf("  -l N      First lobby number to use (default 1)\n");
+    printf("  -t MS     Max random think time before each action (default 0)\n");
+    printf("  -s SEED   PRNG seed for think times (default: time)\n");
+    printf("  -b TOKEN  Play as bots (server BOT_TOKEN); FIRST_LOBBY must be a bot lobby\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @param o    Output options (defaults are filled in first).
+ * @return 0 on success; -1 on invalid arguments.
+ */
+static int parse_options(int argc, char** argv, LoadOptions* o) {
+    o->host = "127.0.0.1";
+    o->port = 10000;
+    o->pairs = 1;
+    o->duration_sec = 10;
+    o->first_lobby = 1;
+    o->think_ms = 0;
+    o->seed = (unsigned)time(NULL);
+    o->bot_token = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (i + 1 >= argc) return -1;
+        const char* v = argv[++i];
+        if (strcmp(a, "-h") == 0) o->host = v;
+        else if (strcmp(a, "-p") == 0) o->port = atoi(v);
+        else if (strcmp(a, "-c") == 0) o->pairs = atoi(v);
+        else if (strcmp(a, "-d") == 0) o->duration_sec = atoi(v);
+        else if (strcmp(a, "-l") == 0) o->first_lobby = atoi(v);
+        else if (strcmp(a, "-t") == 0) o->think_ms = atoi(v);
+        else if (strcmp(a, "-s") == 0) o->seed = (unsigned)strtoul(v, NULL, 10);
+        else if (strcmp(a, "-b") == 0) o->bot_token = v;
+        else return -1;
+    }
+    if (o->port < 1 || o->port > 65535) return -1;
+    if (o->pairs < 1 || o->duration_sec < 1 || o->first_lobby < 1 || o->think_ms < 0) return -1;
+    return 0;
+}
+
+/* --- Connection helpers --- */
+
+/**
+ * Open a TCP connection to the server.
+ *
+ * @return Connected socket fd, or -1 on error.
+ */
+static int lg_connect(void) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", g_opt.port);
+    struct addrinfo hints = {0}, *res = NULL;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(g_opt.host, port, &hints, &res) != 0 || !res) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, 0);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/**
+ * Send a protocol line on the player's connection.
+ *
+ * @param p Player.
+ * @param s NUL-terminated line (including '\n').
+ * @return 0 on success; -1 on error.
+ */
+static int lg_send(LgPlayer* p, const char* s) {
+    size_t n = strlen(s), off = 0;
+    while (off < n) {
+        ssize_t w = send(p->fd, s + off, n - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        off += (size_t)w;
+    }
+    p->bytes_out += n;
+    return 0;
+}
+
+/**
+ * Read one line from the player's connection (buffered).
+ *
+ * @param p          Player.
+ * @param out        Destination buffer.
+ * @param out_sz     Size of @p out.
+ * @param timeout_ms Max wait for more data.
+ * @return >0 line length; 0 peer closed; -1 error; -2 timeout.
+ */
+static int lg_read_line(LgPlayer* p, char* out, size_t out_sz, int timeout_ms) {
+    for (;;) {
+        char* nl = memchr(p->in, '\n', p->inlen);
+        if (nl) {
+            size_t len = (size_t)(nl - p->in) + 1;
+            size_t cp = len < out_sz - 1 ? len : out_sz - 1;
+            memcpy(out, p->in, cp);
+            out[cp] = '\0';
+            memmove(p->in, p->in + len, p->inlen - len);
+            p->inlen -= len;
+            return (int)cp;
+        }
+        if (p->inlen >= sizeof(p->in)) return -1;
+
+        struct pollfd pfd = { .fd = p->fd, .events = POLLIN };
+        int pr = poll(&pfd, 1, timeout_ms);
+        if (pr == 0) return -2;
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        ssize_t r = recv(p->fd, p->in + p->inlen, sizeof(p->in) - p->inlen, 0);
+        if (r == 0) return 0;
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p->inlen += (size_t)r;
+        p->bytes_in += (uint64_t)r;
+    }
+}
+
+/**
+ * Close the player's connection (session state is kept for C45REC).
+ *
+ * @param p Player.
+ */
+static void lg_close(LgPlayer* p) {
+    if (p->fd >= 0) close(p->fd);
+    p->fd = -1;
+    p->inlen = 0;
+    p->pending_ms = 0;
+    p->expect_join_ok = 0;
+}
+
+/**
+ * Connect (or reconnect) the player's session.
+ *
+ * A player that already completed a handshake resumes with C45REC so the
+ * server can attach it back to a running game (bots open a new session: the
+ * bot lane has no reconnect window).
+ *
+ * @param p Player.
+ * @return 0 on success; -1 on error.
+ */
+static int lg_open_session(LgPlayer* p) {
+    p->fd = lg_connect();
+    if (p->fd < 0) return -1;
+
+    char line[128];
+    if (p->named && !g_opt.bot_token) {
+        snprintf(line, sizeof(line), "C45REC %s %d\n", p->name, p->lobby);
+        p->rec_attempts++;
+        p->reconnecting = 1;
+    } else if (g_opt.bot_token) {
+        snprintf(line, sizeof(line), "C45BOT %s %s %d\n", p->name, g_opt.bot_token, p->lobby);
+        p->expect_join_ok = 1;
+    } else {
+        snprintf(line, sizeof(line), "C45%s\n", p->name);
+    }
+    if (lg_send(p, line) < 0) {
+        lg_close(p);
+        return -1;
+    }
+    return 0;
+}
+
+/* --- Player state machine --- */
+
+/**
+ * Compute the Blackjack value of the player's hand.
+ *
+ * @param p Player.
+ * @return Hand value.
+ */
+static int lg_hand_value(const LgPlayer* p) {
+    int sum = 0, aces = 0;
+    for (int i = 0; i < p->ncards; ++i) {
+        int r = p->cards[i];
+        if (r == 1) { aces++; sum += 11; }
+        else if (r >= 10) sum += 10;
+        else sum += r;
+    }
+    while (sum > 21 && aces > 0) { sum -= 10; aces--; }
+    return sum;
+}
+
+/**
+ * Add a card (e.g. "TD") to the player's hand.
+ *
+ * @param p    Player.
+ * @param card Two-character card string.
+ */
+static void lg_add_card(LgPlayer* p, const char* card) {
+    static const char R[] = "A23456789TJQK";
+    const char* r = strchr(R, card[0]);
+    if (!r || card[0] == '\0' || p->ncards >= 12) return;
+    p->cards[p->ncards++] = (int)(r - R) + 1;
+}
+
+/**
+ * Record one action -> response latency sample.
+ *
+ * @param p  Player.
+ * @param ms Latency in milliseconds.
+ */
+static void lg_add_latency(LgPlayer* p, double ms) {
+    if (!p->lat) p->lat = malloc(LG_LAT_MAX * sizeof(double));
+    if (!p->lat) return;
+    p->lat_seen++;
+    if (p->lat_n < LG_LAT_MAX) {
+        p->lat[p->lat_n++] = ms;
+    } else {
+        // Reservoir sampling keeps the distribution representative for long runs.
+        size_t j = (size_t)((uint64_t)rand_r(&p->seed) % p->lat_seen);
+        if (j < LG_LAT_MAX) p->lat[j] = ms;
+    }
+}
+
+/**
+ * Ask for the player's lobby ("C45J <lobby>").
+ *
+ * @param p Player.
+ * @return 0 on success; -1 on error.
+ */
+static int lg_join(LgPlayer* p) {
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "C45J %d\n", p->lobby);
+    p->expect_join_ok = 1;
+    return lg_send(p, cmd);
+}
+
+/**
+ * Handle one server line.
+ *
+ * @param p    Player.
+ * @param line Received line (NUL-terminated, may include '\n').
+ * @return 0 to continue; -1 to close the connection.
+ */
+static int handle_line(LgPlayer* p, const char* line) {
+    if (strncmp(line, "C45PI", 5) == 0) return lg_send(p, "C45PO\n");
+    if (strncmp(line, "C45PO", 5) == 0) return 0;
+
+    if (p->pending_ms > 0) {
+        lg_add_latency(p, now_ms() - p->pending_ms);
+        p->pending_ms = 0;
+    }
+
+    if (strncmp(line, "C45REC_OK", 9) == 0) {
+        if (p->reconnecting) p->rec_ok++;
+        p->reconnecting = 0;
+        return 0;
+    }
+    if (strncmp(line, "C45JOK", 6) == 0) {
+        p->named = 1;
+        p->expect_join_ok = 0;
+        return 0;
+    }
+    if (strncmp(line, "C45OK", 5) == 0) {
+        if (p->reconnecting) p->rec_ok++;
+        p->reconnecting = 0;
+        p->named = 1;
+        p->expect_join_ok = 0;
+        return 0;
+    }
+    if (strncmp(line, "C45WRONG", 8) == 0) {
+        if (strstr(line, "NAME_TAKEN")) {
+            // A stale session still holds the name; start over later.
+            p->named = 0;
+            sleep_ms(100);
+            return -1;
+        }
+        if (p->expect_join_ok && g_opt.bot_token && p->named) {
+            // Bot lane: the table is still being released; queue again.
+            sleep_ms(1);
+            return lg_join(p);
+        }
+        if (p->expect_join_ok && !g_opt.bot_token) {
+            // Lobby still full (previous game being cleaned up): refresh and retry.
+            p->expect_join_ok = 0;
+            sleep_ms(20);
+            return lg_send(p, "C45B\n");
+        }
+        p->errors++;
+        p->named = 0;
+        return -1;
+    }
+    if (strncmp(line, "C45L ", 5) == 0) {
+        int n = 0;
+        // Bot lobbies are not listed in the snapshot.
+        if (!g_opt.bot_token && sscanf(line, "C45L %d", &n) == 1 && p->lobby > n) {
+            fprintf(stderr, "loadgen: lobby #%d does not exist (server has %d)\n", p->lobby, n);
+            atomic_store(&g_stop, 1);
+            return -1;
+        }
+        return lg_join(p);
+    }
+    if (strncmp(line, "C45D ", 5) == 0) {
+        char c1[8] = {0}, c2[8] = {0};
+        if (sscanf(line, "C45D %7s %7s", c1, c2) != 2) return -1;
+        if (p->game_start_ms == 0) p->game_start_ms = now_ms();
+        p->ncards = 0;
+        lg_add_card(p, c1);
+        lg_add_card(p, c2);
+        return 0;
+    }
+    if (strncmp(line, "C45C ", 5) == 0) {
+        char c[8] = {0};
+        if (sscanf(line, "C45C %7s", c) == 1) lg_add_card(p, c);
+        return 0;
+    }
+    if (strncmp(line, "C45T ", 5) == 0) {
+        char who[64] = {0};
+        if (sscanf(line, "C45T %63s", who) != 1) return -1;
+        if (strcmp(who, p->name) != 0) return 0;
+        if (g_opt.think_ms > 0) sleep_ms((int)((unsigned)rand_r(&p->seed) % (unsigned)(g_opt.think_ms + 1)));
+        p->actions++;
+        p->pending_ms = now_ms();
+        return lg_send(p, lg_hand_value(p) < 17 ? "C45H\n" : "C45S\n");
+    }
+    if (strncmp(line, "C45R ", 5) == 0) {
+        p->results++;
+        p->game_start_ms = 0;
+        p->ncards = 0;
+        return g_opt.bot_token ? lg_join(p) : lg_send(p, "C45B\n");
+    }
+    if (strncmp(line, "C45DOWN", 7) == 0) {
+        atomic_store(&g_stop, 1);
+        return -1;
+    }
+    // C45B <name> <value>, C45TO, C45OD, C45OB: informational only.
+    return 0;
+}
+
+/**
+ * Player thread: keep playing games until the deadline.
+ *
+ * @param arg LgPlayer*.
+ * @return NULL.
+ */
+static void* player_thread(void* arg) {
+    LgPlayer* p = (LgPlayer*)arg;
+    char line[LG_LINE_MAX];
+    int backoff_ms = 10;
+
+    while (!atomic_load(&g_stop) && now_ms() < g_deadline_ms) {
+        if (p->fd < 0) {
+            if (lg_open_session(p) < 0) {
+                sleep_ms(backoff_ms);
+                if (backoff_ms < 500) backoff_ms *= 2;
+                continue;
+            }
+            backoff_ms = 10;
+        }
+
+        int r = lg_read_line(p, line, sizeof(line), 200);
+        if (r == -2) continue;
+        if (r <= 0) {
+            p->drops++;
+            lg_close(p);
+            continue;
+        }
+        if (handle_line(p, line) < 0) lg_close(p);
+    }
+    lg_close(p);
+    return NULL;
+}
+
+/* --- Report --- */
+
+/**
+ * qsort comparator for doubles.
+ */
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Aggregate per-player counters and print the final report.
+ *
+ * The last line ("RESULT ...") is meant for scripts.
+ *
+ * @param players Player array.
+ * @param n       Number of players.
+ * @param elapsed Measured test duration in seconds.
+ */
+static void print_report(LgPlayer* players, int n, double elapsed) {
+    uint64_t results = 0, actions = 0, bin = 0, bout = 0, ra = 0, rok = 0, drops = 0, errors = 0;
+    size_t lat_total = 0;
+    for (int i = 0; i < n; ++i) {
+        results += players[i].results;
+        actions += players[i].actions;
+        bin += players[i].bytes_in;
+        bout += players[i].bytes_out;
+        ra += players[i].rec_attempts;
+        rok += players[i].rec_ok;
+        drops += players[i].drops;
+        errors += players[i].errors;
+        lat_total += players[i].lat_n;
+    }
+
+    double* lat = lat_total ? malloc(lat_total * sizeof(double)) : NULL;
+    size_t k = 0;
+    for (int i = 0; lat && i < n; ++i) {
+        memcpy(lat + k, players[i].lat, players[i].lat_n * sizeof(double));
+        k += players[i].lat_n;
+    }
+    double p50 = 0, p99 = 0, pmax = 0;
+    if (lat && k > 0) {
+        qsort(lat, k, sizeof(double), cmp_double);
+        p50 = lat[k / 2];
+        p99 = lat[(size_t)((double)(k - 1) * 0.99)];
+        pmax = lat[k - 1];
+    }
+    free(lat);
+
+    double games = (double)results / 2.0;
+    double gps = elapsed > 0 ? games / elapsed : 0;
+    printf("loadgen: %d pairs, %.1fs\n", n / 2, elapsed);
+    printf("  games         %.0f (%.2f games/s)\n", games, gps);
+    printf("  actions       %llu\n", (unsigned long long)actions);
+    printf("  latency ms    p50=%.3f p99=%.3f max=%.3f (samples=%zu)\n", p50, p99, pmax, k);
+    printf("  throughput    in=%.1f KiB/s out=%.1f KiB/s\n",
+           elapsed > 0 ? (double)bin / 1024.0 / elapsed : 0,
+           elapsed > 0 ? (double)bout / 1024.0 / elapsed : 0);
+    printf("  drops         %llu\n", (unsigned long long)drops);
+    printf("  reconnects    %llu/%llu ok (%.1f%%)\n",
+           (unsigned long long)rok, (unsigned long long)ra,
+           ra ? 100.0 * (double)rok / (double)ra : 100.0);
+    printf("  errors        %llu\n", (unsigned long long)errors);
+    printf("RESULT games_per_sec=%.3f p50_ms=%.3f p99_ms=%.3f reconnect_ok=%llu reconnect_attempts=%llu\n",
+           gps, p50, p99, (unsigned long long)rok, (unsigned long long)ra);
+}
+
+/**
+ * Load generator entry point.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @return 0 on success; 1 on invalid arguments.
+ */
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int n = g_opt.pairs * 2;
+    LgPlayer* players = calloc((size_t)n, sizeof(LgPlayer));
+    pthread_t* th = calloc((size_t)n, sizeof(pthread_t));
+    if (!players || !th) return 1;
+
+    unsigned pid = (unsigned)getpid();
+    for (int i = 0; i < n; ++i) {
+        LgPlayer* p = &players[i];
+        p->id = i;
+        p->fd = -1;
+        p->lobby = g_opt.first_lobby + i / 2;
+        p->seed = g_opt.seed + (unsigned)i * 7919u;
+        snprintf(p->name, sizeof(p->name), "lg%u_%d%c", pid % 10000u, i / 2, (i % 2) ? 'b' : 'a');
+    }
+
+    double start = now_ms();
+    g_deadline_ms = start + g_opt.duration_sec * 1000.0;
+    for (int i = 0; i < n; ++i) pthread_create(&th[i], NULL, player_thread, &players[i]);
+    for (int i = 0; i < n; ++i) pthread_join(th[i], NULL);
+    double elapsed = (now_ms() - start) / 1000.0;
+
+    print_report(players, n, elapsed);
+    for (int i = 0; i < n; ++i) free(players[i].lat);
+    free(players);
+    free(th);
+    return 0;
+}
@@ -0,0 +1,476 @@
+/*
+ * membench.c
+ *
+ * Purpose:
+ *   Memory benchmark: resident bytes per idle connection and per active game,
+ *   compared with the server's own accounting (metrics.h).
+ *
+ * Responsibilities:
+ *   - Run the real server (linked in, loopback, 99 lobbies) on a background thread.
+ *   - Open idle connections from a forked client process (so client sockets and
+ *     buffers are not charged to the server's RSS) in steps up to each target
+ *     level; every connection completes the handshake and sits at the lobby list.
+ *   - Measure the server process RSS delta per idle connection at each level.
+ *   - Pair idle connections into lobbies and measure the RSS delta per running game.
+ *   - Report how far each level got and why it stopped (admission limit,
+ *     RLIMIT_NOFILE, thread limits), plus an RSS projection for the target.
+ *
+ * The server keeps two fds per connection (see run_server()), so MAX_CLIENTS is
+ * capped at half of RLIMIT_NOFILE; beyond that the server answers C45BUSY.
+ *
+ * Table of contents:
+ *   - Options: BenchOptions, parse_options()
+ *   - Client process: Cmd/Reply, open_idle(), join_games(), client_main()
+ *   - Server: server_thread(), start_server()
+ *   - Measurement: settle(), stop_reason()
+ *   - Report: main()
+ */
+
+#define _GNU_SOURCE
+#include "game.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MB_MAX_LEVELS  8
+#define MB_LOBBIES     99
+#define MB_FD_RESERVE  64      /* fds kept free for the listen socket, stdio, logs */
+#define MB_WAIT_MS     10000   /* max wait for server-side counters to catch up */
+
+typedef struct {
+    int port;
+    int levels[MB_MAX_LEVELS];
+    int level_count;
+    int games;
+    int verbose;
+} BenchOptions;
+
+static BenchOptions g_opt;
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-p PORT] [-l LEVELS] [-g GAMES] [-v]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -p PORT    Loopback port for the embedded server (default 12080)\n");
+    printf("  -l LEVELS  Comma-separated idle connection counts (default 10000,100000)\n");
+    printf("  -g GAMES   Games to start after the last level (default 50, max %d)\n", MB_LOBBIES);
+    printf("  -v         Show server log output\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @param o    Output options (defaults are filled in first).
+ * @return 0 on success; -1 on invalid arguments.
+ */
+static int parse_options(int argc, char** argv, BenchOptions* o) {
+    o->port = 12080;
+    o->levels[0] = 10000;
+    o->levels[1] = 100000;
+    o->level_count = 2;
+    o->games = 50;
+    o->verbose = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (strcmp(a, "-v") == 0) { o->verbose = 1; continue; }
+        if (i + 1 >= argc) return -1;
+        const char* v = argv[++i];
+        if (strcmp(a, "-p") == 0) o->port = atoi(v);
+        else if (strcmp(a, "-g") == 0) o->games = atoi(v);
+        else if (strcmp(a, "-l") == 0) {
+            o->level_count = 0;
+            char buf[128];
+            snprintf(buf, sizeof(buf), "%s", v);
+            for (char* tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+                if (o->level_count >= MB_MAX_LEVELS) return -1;
+                int n = atoi(tok);
+                if (n < 1 || (o->level_count > 0 && n <= o->levels[o->level_count - 1])) return -1;
+                o->levels[o->level_count++] = n;
+            }
+            if (o->level_count == 0) return -1;
+        } else return -1;
+    }
+    if (o->port < 1 || o->port > 65535 || o->games < 0 || o->games > MB_LOBBIES) return -1;
+    return 0;
+}
+
+/* --- Client process --- */
+
+typedef enum { CMD_OPEN, CMD_JOIN, CMD_QUIT } CmdOp;
+
+typedef struct {
+    CmdOp op;
+    int   arg;     /* OPEN: total connections wanted; JOIN: games */
+} Cmd;
+
+typedef struct {
+    int count;     /* OPEN: connections open; JOIN: games joined */
+    int busy;      /* server answered C45BUSY */
+    int err;       /* errno of the failure that stopped the step (0 = none) */
+} Reply;
+
+static int* g_conns = NULL;
+static int  g_conn_cnt = 0;
+
+/**
+ * Send a whole protocol line (client side, blocking).
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int send_line(int fd, const char* s) {
+    size_t n = strlen(s), off = 0;
+    while (off < n) {
+        ssize_t w = send(fd, s + off, n - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+/**
+ * Read from @p fd until a line starting with one of the prefixes arrives.
+ *
+ * Lines that arrive after the match in the same read are discarded; the
+ * benchmark never needs them.
+ *
+ * @param fd      Connected socket (with SO_RCVTIMEO set).
+ * @param want    Prefix that means success.
+ * @param refuse  Prefix that means refusal (may be NULL).
+ * @return 1 on @p want; 0 on @p refuse; -1 on error/timeout (errno set).
+ */
+static int wait_prefix(int fd, const char* want, const char* refuse) {
+    char buf[1024];
+    size_t len = 0;
+    for (;;) {
+        ssize_t r = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (r == 0) { errno = ECONNRESET; return -1; }
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        len += (size_t)r;
+        buf[len] = '\0';
+
+        char* line = buf;
+        char* nl;
+        while ((nl = strchr(line, '\n')) != NULL) {
+            if (strncmp(line, want, strlen(want)) == 0) return 1;
+            if (refuse && strncmp(line, refuse, strlen(refuse)) == 0) return 0;
+            line = nl + 1;
+        }
+        len = strlen(line);
+        memmove(buf, line, len + 1);
+        if (len >= sizeof(buf) - 1) { errno = EMSGSIZE; return -1; }
+    }
+}
+
+/**
+ * Open handshaked idle connections until @p total are open (or something stops us).
+ *
+ * @param total Target number of open connections.
+ * @param out   Output reply.
+ */
+static void open_idle(int total, Reply* out) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)g_opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval tv = { .tv_sec = 5, .tv_usec = 0 };
+
+    memset(out, 0, sizeof(*out));
+    while (g_conn_cnt < total) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) { out->err = errno; break; }
+        (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        int attempt = 0;
+        while (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            int e = errno;
+            close(fd);
+            fd = -1;
+            // The server may still be starting up (first connection only).
+            if (g_conn_cnt > 0 || e != ECONNREFUSED || ++attempt > 200) { errno = e; break; }
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000000L };
+            nanosleep(&ts, NULL);
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0) break;
+            (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+        if (fd < 0) { out->err = errno; break; }
+
+        char hello[32];
+        snprintf(hello, sizeof(hello), "C45mb%d\n", g_conn_cnt);
+        int rc = send_line(fd, hello) < 0 ? -1 : wait_prefix(fd, "C45L ", "C45BUSY");
+        if (rc <= 0) {
+            if (rc == 0) out->busy = 1;
+            else out->err = errno;
+            close(fd);
+            break;
+        }
+        g_conns[g_conn_cnt++] = fd;
+    }
+    out->count = g_conn_cnt;
+}
+
+/**
+ * Join the first 2 * @p games idle connections pairwise into lobbies 1..games.
+ *
+ * @param games Number of games to start.
+ * @param out   Output reply.
+ */
+static void join_games(int games, Reply* out) {
+    memset(out, 0, sizeof(*out));
+    for (int g = 0; g < games && 2 * g + 1 < g_conn_cnt; ++g) {
+        char cmd[32];
+        snprintf(cmd, sizeof(cmd), "C45J %d\n", g + 1);
+        for (int k = 0; k < 2; ++k) {
+            int fd = g_conns[2 * g + k];
+            if (send_line(fd, cmd) < 0 || wait_prefix(fd, "C45OK", "C45WRONG") <= 0) {
+                out->err = errno ? errno : EPROTO;
+                return;
+            }
+        }
+        out->count = g + 1;
+    }
+}
+
+/**
+ * Client process main loop: execute commands from the parent until CMD_QUIT.
+ *
+ * @param cmd_fd   Read end of the command pipe.
+ * @param reply_fd Write end of the reply pipe.
+ * @param max_conn Capacity of the connection table.
+ * @return Process exit code.
+ */
+static int client_main(int cmd_fd, int reply_fd, int max_conn) {
+    g_conns = calloc((size_t)max_conn, sizeof(*g_conns));
+    if (!g_conns) return 2;
+
+    Cmd c;
+    while (read(cmd_fd, &c, sizeof(c)) == (ssize_t)sizeof(c)) {
+        Reply r;
+        memset(&r, 0, sizeof(r));
+        if (c.op == CMD_QUIT) break;
+        if (c.op == CMD_OPEN) open_idle(c.arg < max_conn ? c.arg : max_conn, &r);
+        else if (c.op == CMD_JOIN) join_games(c.arg, &r);
+        if (write(reply_fd, &r, sizeof(r)) != (ssize_t)sizeof(r)) break;
+    }
+    for (int i = 0; i < g_conn_cnt; ++i) close(g_conns[i]);
+    return 0;
+}
+
+/* --- Server --- */
+
+/**
+ * Server thread: run the accept loop on loopback.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* server_thread(void* arg) {
+    (void)arg;
+    (void)run_server("127.0.0.1", g_opt.port);
+    return NULL;
+}
+
+/**
+ * Initialize the lobbies and start the server thread.
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int start_server(void) {
+    g_lobby_count = MB_LOBBIES;
+    if (lobbies_init() != 0) return -1;
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, server_thread, NULL) != 0) return -1;
+    pthread_detach(th);
+    return 0;
+}
+
+/* --- Measurement --- */
+
+/**
+ * Sleep for @p ms milliseconds.
+ */
+static void sleep_ms(long ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Wait until the server accounts @p conns connections and @p tables games,
+ * then give the threads a moment to reach their idle wait and sample.
+ *
+ * @param conns  Expected admitted connections.
+ * @param tables Expected running games.
+ * @param out    Output snapshot.
+ * @return 0 on success; -1 on timeout (the snapshot is filled in anyway).
+ */
+static int settle(int conns, int tables, MemStats* out) {
+    int rc = -1;
+    for (int waited = 0; waited < MB_WAIT_MS; waited += 10) {
+        mem_stats_snapshot(out);
+        if (out->conns == conns && out->tables == tables) { rc = 0; break; }
+        sleep_ms(10);
+    }
+    sleep_ms(300);
+    mem_stats_snapshot(out);
+    return rc;
+}
+
+/**
+ * Describe why opening connections stopped short of the target.
+ */
+static const char* stop_reason(const Reply* r, int target, int fd_cap) {
+    if (r->count >= target) return "reached";
+    if (r->busy) return r->count >= fd_cap ? "C45BUSY (RLIMIT_NOFILE cap)" : "C45BUSY (thread limit)";
+    if (r->err) return strerror(r->err);
+    return "stopped";
+}
+
+/**
+ * Benchmark entry point.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @return 0 on success; 2 on setup errors.
+ */
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    (void)getrlimit(RLIMIT_NOFILE, &rl);
+    int target = g_opt.levels[g_opt.level_count - 1];
+    long nofile = rl.rlim_cur == RLIM_INFINITY ? 1L << 20 : (long)rl.rlim_cur;
+    int fd_cap = (int)((nofile - MB_FD_RESERVE) / 2);
+
+    // The server logs every protocol step to stdout; keep the report separate.
+    FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report) return 2;
+    fflush(stdout);
+
+    // Fork the client process before any thread exists.
+    int cmd_pipe[2], reply_pipe[2];
+    if (pipe(cmd_pipe) != 0 || pipe(reply_pipe) != 0) return 2;
+    pid_t child = fork();
+    if (child < 0) return 2;
+    if (child == 0) {
+        close(cmd_pipe[1]);
+        close(reply_pipe[0]);
+        _exit(client_main(cmd_pipe[0], reply_pipe[1], target));
+    }
+    close(cmd_pipe[0]);
+    close(reply_pipe[1]);
+
+    if (!g_opt.verbose && !freopen("/dev/null", "w", stdout)) return 2;
+    if (g_opt.verbose) setvbuf(stdout, NULL, _IOLBF, 0);
+
+    g_max_clients = target < fd_cap ? target : fd_cap;
+    if (start_server() != 0) {
+        fprintf(stderr, "membench: cannot start the server\n");
+        return 2;
+    }
+
+    MemStats base;
+    (void)settle(0, 0, &base);
+    fprintf(report, "membench: RLIMIT_NOFILE %ld, MAX_CLIENTS %d, thread stack %d KB\n",
+            nofile, g_max_clients, g_thread_stack_kb);
+    fprintf(report, "  accounted: %zu B per connection, %zu B per game, %zu B fixed\n",
+            base.conn_bytes, base.table_bytes, base.fixed_bytes);
+    fprintf(report, "  baseline RSS %.1f MB\n", (double)base.rss_bytes / (1024.0 * 1024.0));
+    fprintf(report, "  %-8s %9s %10s %14s %14s   %s\n",
+            "target", "reached", "RSS MB", "B/idle conn", "accounted B", "stopped by");
+    fflush(report);
+
+    MemStats idle = base;
+    Reply r = {0};
+    double per_conn = 0.0;
+    for (int i = 0; i < g_opt.level_count; ++i) {
+        Cmd c = { CMD_OPEN, g_opt.levels[i] };
+        if (write(cmd_pipe[1], &c, sizeof(c)) != (ssize_t)sizeof(c) ||
+            read(reply_pipe[0], &r, sizeof(r)) != (ssize_t)sizeof(r)) {
+            fprintf(stderr, "membench: client process failed\n");
+            return 2;
+        }
+        (void)settle(r.count, 0, &idle);
+        if (r.count > 0) {
+            per_conn = (double)(idle.rss_bytes - base.rss_bytes) / (double)r.count;
+        }
+        fprintf(report, "  %-8d %9d %10.1f %14.0f %14zu   %s\n",
+                g_opt.levels[i], r.count, (double)idle.rss_bytes / (1024.0 * 1024.0),
+                per_conn, idle.conn_bytes, stop_reason(&r, g_opt.levels[i], fd_cap));
+        fflush(report);
+    }
+    int reached = r.count;
+
+    double per_game = 0.0;
+    int games = g_opt.games < reached / 2 ? g_opt.games : reached / 2;
+    if (games > 0) {
+        Cmd c = { CMD_JOIN, games };
+        if (write(cmd_pipe[1], &c, sizeof(c)) != (ssize_t)sizeof(c) ||
+            read(reply_pipe[0], &r, sizeof(r)) != (ssize_t)sizeof(r)) {
+            fprintf(stderr, "membench: client process failed\n");
+            return 2;
+        }
+        games = r.count;
+        MemStats active;
+        if (settle(reached, games, &active) != 0) {
+            fprintf(stderr, "membench: only %d of %d games running\n", active.tables, games);
+        }
+        if (games > 0) per_game = ((double)active.rss_bytes - (double)idle.rss_bytes) / (double)games;
+        fprintf(report, "  %d active games: %.0f B RSS per game (accounted %zu B)\n",
+                games, per_game, active.table_bytes);
+    }
+
+    if (reached < target) {
+        double projected = (double)base.rss_bytes + per_conn * (double)target;
+        fprintf(report, "  projected RSS at %d idle connections: %.1f MB (%.1f MB accounted)\n",
+                target, projected / (1024.0 * 1024.0),
+                ((double)base.fixed_bytes + (double)base.conn_bytes * target) / (1024.0 * 1024.0));
+    }
+    fprintf(report, "RESULT target=%d reached=%d bytes_per_idle_conn=%.0f bytes_per_game=%.0f "
+                    "accounted_conn=%zu accounted_game=%zu\n",
+            target, reached, per_conn, per_game, idle.conn_bytes, idle.table_bytes);
+    fflush(report);
+
+    Cmd q = { CMD_QUIT, 0 };
+    if (write(cmd_pipe[1], &q, sizeof(q)) == (ssize_t)sizeof(q)) (void)waitpid(child, NULL, 0);
+    else kill(child, SIGKILL);
+    // Game threads are now waiting for reconnects; do not wait for them.
+    _exit(0);
+}
@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# pgo.sh
+#
+# Purpose:
+#   Profile-guided optimized release build of blackjack_server.
+#
+# Steps:
+#   1. Build a plain -O3 binary and measure it with the load scenario.
+#   2. Build an instrumented binary (-fprofile-generate) and run the same
+#      scenario against it to collect a profile of the real hot paths.
+#   3. Rebuild with -fprofile-use and LTO, measure again and install the
+#      result as ./blackjack_server.
+#
+# The scenario is tools/loadgen on loopback against a server started in a
+# scratch directory with its own config.txt. Tunables (environment):
+#   PGO_PORT (12070), PGO_PAIRS (4), PGO_SECONDS (10), PGO_THINK_MS (0)
+#
+# Run from server/ (the Makefile's `pgo` target does that).
+
+set -eu
+
+MAKE=${MAKE:-make}
+PORT=${PGO_PORT:-12070}
+PAIRS=${PGO_PAIRS:-4}
+DURATION=${PGO_SECONDS:-10}
+THINK=${PGO_THINK_MS:-0}
+
+ROOT=$(pwd)
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/bj-pgo.XXXXXX")
+srv=
+trap 'if [ -n "$srv" ]; then kill $srv 2>/dev/null; fi; rm -rf "$WORK"' EXIT INT TERM
+
+LOADGEN="$ROOT/build/loadgen"
+[ -x "$LOADGEN" ] || "$MAKE" -s tools
+
+mkdir -p "$WORK/run"
+cat > "$WORK/run/config.txt" <<EOF
+LOBBY_COUNT $PAIRS
+IP 127.0.0.1
+PORT $PORT
+EOF
+
+# build <objdir> <opt flags> <ld flags>
+build() {
+    "$MAKE" -s OBJ_DIR="$1" TARGET="$1/blackjack_server" OPT="$2" LDFLAGS="-pthread $3" \
+        "$1/blackjack_server"
+}
+
+# run_scenario <binary>: prints the loadgen RESULT line
+run_scenario() {
+    (cd "$WORK/run" && exec "$1" > "$WORK/run/server.log" 2>&1) &
+    srv=$!
+    # loadgen retries its connections, so a short grace period is enough.
+    sleep 0.5
+    if ! kill -0 $srv 2>/dev/null; then
+        echo "pgo: server did not start:" >&2
+        cat "$WORK/run/server.log" >&2
+        exit 1
+    fi
+    "$LOADGEN" -p "$PORT" -c "$PAIRS" -d "$DURATION" -t "$THINK" -s 1 | grep '^RESULT'
+    # SIGINT lets main() return normally, which is when the profile is written.
+    kill -INT $srv
+    wait $srv || true
+    srv=
+}
+
+# field <RESULT line> <key>
+field() {
+    echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+echo "pgo: [1/3] baseline -O3 build"
+build "$WORK/base" "-O3" ""
+BEFORE=$(run_scenario "$WORK/base/blackjack_server")
+
+echo "pgo: [2/3] instrumented build + training run"
+build "$WORK/pgo" "-O3 -fprofile-generate -fprofile-update=atomic" "-fprofile-generate"
+run_scenario "$WORK/pgo/blackjack_server" > /dev/null
+if ! ls "$WORK"/pgo/*.gcda > /dev/null 2>&1; then
+    echo "pgo: training run produced no profile" >&2
+    exit 1
+fi
+
+echo "pgo: [3/3] -fprofile-use + LTO build"
+rm -f "$WORK"/pgo/*.o "$WORK/pgo/blackjack_server"
+build "$WORK/pgo" "-O3 -flto=auto -fprofile-use -fprofile-correction -Wno-missing-profile" \
+      "-O3 -flto=auto -fprofile-use"
+AFTER=$(run_scenario "$WORK/pgo/blackjack_server")
+
+cp "$WORK/pgo/blackjack_server" "$ROOT/blackjack_server"
+
+printf '\n%-12s %12s %12s\n' "" "games/s" "p99 ms"
+printf '%-12s %12s %12s\n' "-O3" "$(field "$BEFORE" games_per_sec)" "$(field "$BEFORE" p99_ms)"
+printf '%-12s %12s %12s\n' "PGO+LTO" "$(field "$AFTER" games_per_sec)" "$(field "$AFTER" p99_ms)"
+echo "pgo: installed $ROOT/blackjack_server"
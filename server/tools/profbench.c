@@ -0,0 +1,231 @@
+/*
+ * profbench.c
+ *
+ * Purpose:
+ *   Cost and sanity check of the built-in sampling profiler (profiler.c).
+ *
+ * Responsibilities:
+ *   - Run a CPU-bound server workload (committed shuffles: SHA-256 and
+ *     Fisher-Yates) on registered threads, alternating profiler off / on.
+ *   - Compare the workload's CPU time with and without sampling, and report the
+ *     handler time the profiler measures itself (prof_overhead_pct).
+ *   - Dump the profile and check that the hot functions were attributed
+ *     (sha256_block under shuffle_make, on the "game" thread role) and that
+ *     the sample count matches the CPU time spent.
+ *   - Exit non-zero if a check fails or the handler overhead exceeds 1%.
+ *
+ * Table of contents:
+ *   - Options: BenchOptions, parse_options()
+ *   - Workload: worker(), run_round()
+ *   - Checks: parse_metric(), check_dump()
+ *   - main()
+ */
+
+#define _GNU_SOURCE
+#include "profiler.h"
+#include "shuffle.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PB_ROUNDS          3
+#define PB_MAX_OVERHEAD    1.0   /* percent of CPU time in the handler */
+
+typedef struct {
+    int hz;               /* sampling frequency */
+    int threads;          /* worker threads */
+    int tickets;          /* tickets per worker per round */
+    const char* out;      /* dump path */
+} BenchOptions;
+
+static BenchOptions g_opt;
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-z HZ] [-t THREADS] [-n TICKETS] [-o FILE]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -z HZ       Sampling frequency per thread (default 99)\n");
+    printf("  -t THREADS  Worker threads (default 2)\n");
+    printf("  -n TICKETS  Shuffles per worker per round (default 40000)\n");
+    printf("  -o FILE     Collapsed-stack output (default build/profbench.folded)\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @return 0 on success; -1 on invalid options.
+ */
+static int parse_options(int argc, char** argv, BenchOptions* o) {
+    o->hz = 99;
+    o->threads = 2;
+    o->tickets = 40000;
+    o->out = "build/profbench.folded";
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (i + 1 >= argc) return -1;
+        if (strcmp(a, "-z") == 0) o->hz = atoi(argv[++i]);
+        else if (strcmp(a, "-t") == 0) o->threads = atoi(argv[++i]);
+        else if (strcmp(a, "-n") == 0) o->tickets = atoi(argv[++i]);
+        else if (strcmp(a, "-o") == 0) o->out = argv[++i];
+        else return -1;
+    }
+    if (o->hz < 1 || o->hz > 1000 || o->threads < 1 || o->threads > 64 || o->tickets < 1) return -1;
+    return 0;
+}
+
+/**
+ * Process CPU time in nanoseconds.
+ */
+static double cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* --- Workload --- */
+
+/**
+ * Worker: compute shuffles like a game thread would on a pool miss.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* worker(void* arg) {
+    (void)arg;
+    profiler_thread_begin(PROFILE_THREAD_GAME);
+    ShuffleTicket tk;
+    unsigned sink = 0;
+    for (int i = 0; i < g_opt.tickets; ++i) {
+        shuffle_make(&tk);
+        sink += (unsigned)tk.deck.cards[0].rank;
+    }
+    profiler_thread_end();
+    return (void*)(uintptr_t)sink;
+}
+
+/**
+ * Run one round of the workload on all workers.
+ *
+ * @return CPU time of the round (ns).
+ */
+static double run_round(void) {
+    pthread_t th[64];
+    double t0 = cpu_ns();
+    for (int i = 0; i < g_opt.threads; ++i) pthread_create(&th[i], NULL, worker, NULL);
+    for (int i = 0; i < g_opt.threads; ++i) pthread_join(th[i], NULL);
+    return cpu_ns() - t0;
+}
+
+/* --- Checks --- */
+
+/**
+ * Extract a numeric "key=value" field from a metrics line.
+ *
+ * @return Value; -1 if the key is missing.
+ */
+static double parse_metric(const char* line, const char* key) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "%s=", key);
+    const char* p = strstr(line, pat);
+    return p ? atof(p + strlen(pat)) : -1.0;
+}
+
+/**
+ * Check the dump: hot functions attributed to the right thread role.
+ *
+ * @param path   Dump path.
+ * @param stacks Lines reported by profiler_dump().
+ * @return 0 if the profile looks right; -1 otherwise.
+ */
+static int check_dump(const char* path, int stacks) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror("profbench");
+        return -1;
+    }
+    char line[4096];
+    unsigned long long total = 0, sha = 0, in_make = 0;
+    int lines = 0, bad = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char* sp = strrchr(line, ' ');
+        if (!sp || strncmp(line, "game;", 5) != 0) {
+            bad++;
+            continue;
+        }
+        unsigned long long n = strtoull(sp + 1, NULL, 10);
+        lines++;
+        total += n;
+        if (strstr(line, "sha256_block")) sha += n;
+        if (strstr(line, ";shuffle_make;")) in_make += n;
+    }
+    fclose(f);
+
+    printf("  dump: %d stacks, %llu samples; sha256_block %.1f%%, under shuffle_make %.1f%%\n",
+           lines, total, total ? 100.0 * (double)sha / (double)total : 0.0,
+           total ? 100.0 * (double)in_make / (double)total : 0.0);
+    if (lines != stacks || bad) {
+        printf("  FAIL: %d malformed lines (expected %d stacks)\n", bad, stacks);
+        return -1;
+    }
+    if (total == 0 || sha * 4 < total || in_make * 2 < total) {
+        printf("  FAIL: hot functions not attributed (expected sha256_block >= 25%%, shuffle_make >= 50%%)\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 2;
+    }
+    shuffle_fixed_seeds(1);   // no getrandom(): a pure CPU workload
+
+    printf("profbench: %d threads x %d shuffles per round, %d Hz\n", g_opt.threads, g_opt.tickets, g_opt.hz);
+    (void)run_round();   // warm-up
+
+    double best_off = 0.0, best_on = 0.0;
+    for (int r = 0; r < PB_ROUNDS; ++r) {
+        double off = run_round();
+        if (profiler_start(g_opt.hz) != 0) return 1;
+        double on = run_round();
+        profiler_stop();
+        if (r == 0 || off < best_off) best_off = off;
+        if (r == 0 || on < best_on) best_on = on;
+        printf("  round %d: off %.1f ms, on %.1f ms CPU\n", r + 1, off / 1e6, on / 1e6);
+    }
+
+    char stats[256];
+    profiler_stats_format(stats, sizeof(stats));
+    double samples = parse_metric(stats, "prof_samples");
+    double overhead = parse_metric(stats, "prof_overhead_pct");
+    double expected = (double)PB_ROUNDS * best_on / 1e9 * g_opt.hz;
+    printf("  %s\n", stats);
+    printf("  samples %.0f, expected about %.0f from CPU time\n", samples, expected);
+
+    int failed = 0;
+    int stacks = profiler_dump(g_opt.out);
+    if (stacks <= 0 || check_dump(g_opt.out, stacks) != 0) failed = 1;
+    if (samples < expected * 0.5 || samples > expected * 1.5) {
+        printf("  FAIL: sample count does not match CPU time\n");
+        failed = 1;
+    }
+    if (overhead > PB_MAX_OVERHEAD) {
+        printf("  FAIL: handler overhead %.3f%% > %.1f%%\n", overhead, PB_MAX_OVERHEAD);
+        failed = 1;
+    }
+
+    printf("RESULT cpu_off_ms=%.1f cpu_on_ms=%.1f delta_pct=%.2f handler_pct=%.3f stacks=%d checks=%s\n",
+           best_off / 1e6, best_on / 1e6, 100.0 * (best_on - best_off) / best_off, overhead, stacks,
+           failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,725 @@
+/*
+ * replay.c
+ *
+ * Purpose:
+ *   Trace-driven replay of a protocol capture (CAPTURE_FILE, see include/capture.h).
+ *
+ * Responsibilities:
+ *   - Load a capture file and split it into per-connection sessions.
+ *   - Re-open every session against a server with the original timing
+ *     (optionally time-scaled). Each client line is sent once its recorded
+ *     trigger (the server line it answered) arrives again, after the recorded
+ *     think time; unprompted lines keep their recorded spacing.
+ *   - Answer live keepalive pings instead of replaying the recorded C45PO lines.
+ *   - Compare request -> response latency and reply opcodes with the capture
+ *     and report the divergence.
+ *
+ * Table of contents:
+ *   - Options: ReplayOptions, parse_options()
+ *   - Capture loading: load_capture(), free_sessions()
+ *   - Session replay: rp_connect(), pump(), wait_trigger(), session_thread()
+ *   - Report: print_report()
+ */
+
+#define _GNU_SOURCE
+#include "capture.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RP_REPLY_WAIT_MS    2000   /* how long to wait for the reply after the last line */
+#define RP_TRIGGER_WAIT_MS  5000   /* give up on a session whose trigger never arrives */
+#define RP_RESYNC_LINES     16     /* look-ahead when the replayed game takes another course */
+#define RP_QUEUE            64
+#define RP_KEY_MAX          64
+
+typedef struct {
+    const char* host;
+    int port;
+    const char* file;
+    double speed;
+} ReplayOptions;
+
+typedef struct {
+    uint64_t ts_ns;
+    uint8_t  dir;
+    uint16_t len;
+    char*    data;
+} RpLine;
+
+typedef struct {
+    uint32_t id;
+    RpLine*  lines;
+    size_t   n, cap;
+
+    /* results */
+    int      connect_failed;
+    int      closed_early;
+    uint64_t sent;
+    uint64_t replies;
+    uint64_t mismatches;
+    uint64_t skipped;      /* client lines skipped to resync with the replayed game */
+    int      diverged;     /* a trigger never arrived; rest of the session dropped */
+    double*  orig_ms;      /* recorded request -> response latency, per request */
+    double*  replay_ms;    /* measured latency during replay (-1 = no reply) */
+    size_t   nreq;
+} RpSession;
+
+static ReplayOptions g_opt;
+static double        g_start_ms;
+
+/**
+ * Monotonic clock in milliseconds.
+ *
+ * @return Current time in ms.
+ */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s -f CAPTURE [-h HOST] [-p PORT] [-x SPEED]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -f FILE   Capture file written by the server (CAPTURE_FILE)\n");
+    printf("  -h HOST   Server host (default 127.0.0.1)\n");
+    printf("  -p PORT   Server port (default 10000)\n");
+    printf("  -x SPEED  Time scale; 2 replays twice as fast, 0.5 at half speed (default 1)\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @param o    Output options (defaults are filled in first).
+ * @return 0 on success; -1 on invalid arguments.
+ */
+static int parse_options(int argc, char** argv, ReplayOptions* o) {
+    o->host = "127.0.0.1";
+    o->port = 10000;
+    o->file = NULL;
+    o->speed = 1.0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (i + 1 >= argc) return -1;
+        const char* v = argv[++i];
+        if (strcmp(a, "-h") == 0) o->host = v;
+        else if (strcmp(a, "-p") == 0) o->port = atoi(v);
+        else if (strcmp(a, "-f") == 0) o->file = v;
+        else if (strcmp(a, "-x") == 0) o->speed = atof(v);
+        else return -1;
+    }
+    if (!o->file || o->port < 1 || o->port > 65535 || o->speed <= 0) return -1;
+    return 0;
+}
+
+/* --- Capture loading --- */
+
+/**
+ * Check whether a line is a keepalive message (C45PI / C45PO).
+ *
+ * @param s   Line bytes.
+ * @param len Line length.
+ * @return 1 if keepalive; 0 otherwise.
+ */
+static int is_keepalive(const char* s, size_t len) {
+    return len >= 5 && (strncmp(s, "C45PI", 5) == 0 || strncmp(s, "C45PO", 5) == 0);
+}
+
+/**
+ * Find the session with a given id, creating it if needed.
+ */
+static RpSession* session_get(RpSession** sessions, size_t* n, size_t* cap, uint32_t id) {
+    for (size_t i = 0; i < *n; ++i) {
+        if ((*sessions)[i].id == id) return &(*sessions)[i];
+    }
+    if (*n == *cap) {
+        size_t nc = *cap ? *cap * 2 : 64;
+        RpSession* ns = realloc(*sessions, nc * sizeof(RpSession));
+        if (!ns) return NULL;
+        *sessions = ns;
+        *cap = nc;
+    }
+    RpSession* s = &(*sessions)[(*n)++];
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    return s;
+}
+
+/**
+ * Free the sessions returned by load_capture() and their lines.
+ */
+static void free_sessions(RpSession* sessions, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < sessions[i].n; ++j) free(sessions[i].lines[j].data);
+        free(sessions[i].lines);
+        free(sessions[i].orig_ms);
+        free(sessions[i].replay_ms);
+    }
+    free(sessions);
+}
+
+/**
+ * Load a capture file and group its records by session.
+ *
+ * Records without a session (sockets accepted before capture started) are skipped.
+ * A capture containing a truncated record (CAPTURE_TRUNCATED) is rejected.
+ *
+ * @param path      Capture file path.
+ * @param out       Output: session array.
+ * @param out_count Output: number of sessions.
+ * @return Number of records loaded, or -1 on error.
+ */
+static long load_capture(const char* path, RpSession** out, size_t* out_count) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char magic[8];
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, CAPTURE_MAGIC, 8) != 0) {
+        fprintf(stderr, "replay: %s is not a capture file\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    RpSession* sessions = NULL;
+    size_t n = 0, cap = 0;
+    long records = 0;
+    for (;;) {
+        uint64_t ts;
+        uint32_t sid;
+        uint8_t dir, flags;
+        uint16_t len;
+        if (fread(&ts, sizeof(ts), 1, f) != 1) break;
+        if (fread(&sid, sizeof(sid), 1, f) != 1 || fread(&dir, 1, 1, f) != 1 ||
+            fread(&flags, 1, 1, f) != 1 || fread(&len, sizeof(len), 1, f) != 1) break;
+        if (flags & CAPTURE_TRUNCATED) {
+            // a cut line cannot be replayed faithfully: refuse the whole capture
+            fprintf(stderr, "replay: %s: record %ld (session %u) was truncated to %u bytes when captured\n",
+                    path, records + 1, (unsigned)sid, (unsigned)len);
+            fclose(f);
+            free_sessions(sessions, n);
+            return -1;
+        }
+        char* data = malloc((size_t)len + 1);
+        if (!data) break;
+        if (fread(data, 1, len, f) != len) {
+            free(data);
+            break;
+        }
+        data[len] = '\0';
+
+        if (sid == 0 || (sid & 0x80000000u)) {
+            free(data);
+            continue;
+        }
+        RpSession* s = session_get(&sessions, &n, &cap, sid);
+        if (!s) {
+            free(data);
+            break;
+        }
+        if (s->n == s->cap) {
+            size_t nc = s->cap ? s->cap * 2 : 32;
+            RpLine* nl = realloc(s->lines, nc * sizeof(RpLine));
+            if (!nl) {
+                free(data);
+                break;
+            }
+            s->lines = nl;
+            s->cap = nc;
+        }
+        s->lines[s->n++] = (RpLine){ .ts_ns = ts, .dir = dir, .len = len, .data = data };
+        records++;
+    }
+    fclose(f);
+    *out = sessions;
+    *out_count = n;
+    return records;
+}
+
+/* --- Session replay --- */
+
+/**
+ * Open a TCP connection to the server.
+ *
+ * @return Connected socket fd, or -1 on error.
+ */
+static int rp_connect(void) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", g_opt.port);
+    struct addrinfo hints = {0}, *res = NULL;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(g_opt.host, port, &hints, &res) != 0 || !res) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, 0);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/**
+ * Send a whole buffer.
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int rp_send(int fd, const char* s, size_t n) {
+    size_t off = 0;
+    while (off < n) {
+        ssize_t w = send(fd, s + off, n - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+/**
+ * Length of the opcode of a protocol line ("C45OK", "C45D", ...).
+ */
+static size_t opcode_len(const char* s, size_t len) {
+    size_t i = 0;
+    while (i < len && s[i] != ' ' && s[i] != '\n' && s[i] != '\r') i++;
+    return i;
+}
+
+/**
+ * Build the matching key of a server line: the opcode, plus the player name
+ * for turn notifications (both players receive "C45T <name>").
+ *
+ * @param s   Line bytes.
+ * @param len Line length.
+ * @param out Output buffer (RP_KEY_MAX bytes).
+ */
+static void line_key(const char* s, size_t len, char* out) {
+    size_t k = opcode_len(s, len);
+    if (k == 4 && strncmp(s, "C45T", 4) == 0 && k < len && s[k] == ' ') {
+        k++;
+        while (k < len && s[k] != ' ' && s[k] != '\n' && s[k] != '\r') k++;
+    }
+    if (k >= RP_KEY_MAX) k = RP_KEY_MAX - 1;
+    memcpy(out, s, k);
+    out[k] = '\0';
+}
+
+/**
+ * Recorded reply to the client line at index @p i (first non-keepalive server
+ * line before the next client line), or NULL.
+ */
+static const RpLine* recorded_reply(const RpSession* s, size_t i) {
+    for (size_t j = i + 1; j < s->n; ++j) {
+        const RpLine* l = &s->lines[j];
+        if (l->dir == CAPTURE_IN && !is_keepalive(l->data, l->len)) return NULL;
+        if (l->dir == CAPTURE_OUT && !is_keepalive(l->data, l->len)) return l;
+    }
+    return NULL;
+}
+
+/**
+ * Recorded trigger of the client line at index @p i: the last non-keepalive
+ * server line since the previous client line, or NULL if the client spoke
+ * on its own (handshake, keepalive, ...).
+ */
+static const RpLine* recorded_trigger(const RpSession* s, size_t i) {
+    if (is_keepalive(s->lines[i].data, s->lines[i].len)) return NULL;
+    for (size_t j = i; j-- > 0;) {
+        const RpLine* l = &s->lines[j];
+        if (is_keepalive(l->data, l->len)) continue;
+        return l->dir == CAPTURE_OUT ? l : NULL;
+    }
+    return NULL;
+}
+
+typedef struct {
+    int    fd;
+    char   in[8192];
+    size_t inlen;
+    int    closed;
+
+    /* server lines not yet consumed as triggers */
+    char   keys[RP_QUEUE][RP_KEY_MAX];
+    double at_ms[RP_QUEUE];
+    size_t qn;
+
+    /* outstanding request */
+    int    waiting;
+    double sent_ms;
+    size_t req;
+    const RpLine* expect;
+} RpConn;
+
+/**
+ * Find a received, unconsumed server line with the given key.
+ *
+ * @return Queue index, or -1.
+ */
+static int queue_find(const RpConn* c, const char* key) {
+    for (size_t i = 0; i < c->qn; ++i) {
+        if (strcmp(c->keys[i], key) == 0) return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * Consume queue entries up to and including @p idx.
+ */
+static void queue_consume(RpConn* c, size_t idx) {
+    size_t rest = c->qn - idx - 1;
+    memmove(c->keys, c->keys + idx + 1, rest * sizeof(c->keys[0]));
+    memmove(c->at_ms, c->at_ms + idx + 1, rest * sizeof(c->at_ms[0]));
+    c->qn = rest;
+}
+
+/**
+ * Handle one received server line: answer pings, measure the reply latency of
+ * the outstanding request and queue the line as a potential trigger.
+ */
+static void on_server_line(RpSession* s, RpConn* c, const char* line, size_t len) {
+    if (len >= 5 && strncmp(line, "C45PI", 5) == 0) {
+        (void)rp_send(c->fd, "C45PO\n", 6);
+        return;
+    }
+    if (is_keepalive(line, len)) return;
+
+    double now = now_ms();
+    s->replies++;
+    if (c->waiting) {
+        s->replay_ms[c->req] = now - c->sent_ms;
+        if (c->expect) {
+            size_t a = opcode_len(line, len);
+            size_t b = opcode_len(c->expect->data, c->expect->len);
+            if (a != b || memcmp(line, c->expect->data, a) != 0) s->mismatches++;
+        }
+        c->waiting = 0;
+    }
+
+    if (c->qn == RP_QUEUE) queue_consume(c, 0); // keep the most recent lines
+    line_key(line, len, c->keys[c->qn]);
+    c->at_ms[c->qn] = now;
+    c->qn++;
+}
+
+/**
+ * Read from the server until @p until_ms or until at least one line arrived.
+ *
+ * @param s        Session.
+ * @param c        Connection state.
+ * @param until_ms Absolute deadline (now_ms() clock).
+ * @return 1 if new lines were handled; 0 on deadline or close.
+ */
+static int pump(RpSession* s, RpConn* c, double until_ms) {
+    while (!c->closed) {
+        int got = 0;
+        char* nl;
+        while ((nl = memchr(c->in, '\n', c->inlen)) != NULL) {
+            size_t len = (size_t)(nl - c->in) + 1;
+            on_server_line(s, c, c->in, len);
+            memmove(c->in, c->in + len, c->inlen - len);
+            c->inlen -= len;
+            got = 1;
+        }
+        if (c->inlen >= sizeof(c->in)) c->inlen = 0; // garbage without newline: drop it
+        if (got) return 1;
+
+        double left = until_ms - now_ms();
+        if (left <= 0) return 0;
+        struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+        int pr = poll(&pfd, 1, (int)(left + 0.999));
+        if (pr == 0) return 0;
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            c->closed = 1;
+            return 0;
+        }
+        ssize_t r = recv(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen, 0);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            c->closed = 1;
+            return 0;
+        }
+        c->inlen += (size_t)r;
+    }
+    return 0;
+}
+
+/**
+ * Wait until the server sends the trigger of the client line at @p i.
+ *
+ * The cards are reshuffled on replay, so games can take a different course
+ * than in the capture (e.g. a bust ends a turn earlier). When a trigger of one
+ * of the next RP_RESYNC_LINES client lines shows up instead, the lines in
+ * between are skipped.
+ *
+ * @param s    Session.
+ * @param c    Connection state.
+ * @param i    Index of the client line.
+ * @param out_at Output: replay time the trigger arrived.
+ * @return Index of the client line to send next (>= i), or s->n on divergence.
+ */
+static size_t wait_trigger(RpSession* s, RpConn* c, size_t i, double* out_at) {
+    double give_up = now_ms() + RP_TRIGGER_WAIT_MS;
+    for (;;) {
+        size_t seen = 0;
+        for (size_t j = i; j < s->n && seen <= RP_RESYNC_LINES; ++j) {
+            const RpLine* l = &s->lines[j];
+            if (l->dir != CAPTURE_IN || is_keepalive(l->data, l->len)) continue;
+            seen++;
+            const RpLine* trig = recorded_trigger(s, j);
+            if (!trig) {
+                if (j == i) return i;
+                continue;
+            }
+            char key[RP_KEY_MAX];
+            line_key(trig->data, trig->len, key);
+            int q = queue_find(c, key);
+            if (q < 0) continue;
+            *out_at = c->at_ms[q];
+            queue_consume(c, (size_t)q);
+            for (size_t k = i; k < j; ++k) {
+                if (s->lines[k].dir == CAPTURE_IN && !is_keepalive(s->lines[k].data, s->lines[k].len)) s->skipped++;
+            }
+            return j;
+        }
+        if (c->closed || now_ms() >= give_up) {
+            s->diverged = 1;
+            return s->n;
+        }
+        (void)pump(s, c, give_up);
+    }
+}
+
+/**
+ * Replay one session: connect at its original start time and resend its
+ * client lines, each one after its recorded trigger plus the recorded think time.
+ *
+ * @param arg RpSession*.
+ * @return NULL.
+ */
+static void* session_thread(void* arg) {
+    RpSession* s = (RpSession*)arg;
+    if (s->n == 0) return NULL;
+
+    size_t nreq = 0;
+    for (size_t i = 0; i < s->n; ++i) {
+        if (s->lines[i].dir == CAPTURE_IN && !is_keepalive(s->lines[i].data, s->lines[i].len)) nreq++;
+    }
+    s->orig_ms = calloc(nreq ? nreq : 1, sizeof(double));
+    s->replay_ms = calloc(nreq ? nreq : 1, sizeof(double));
+    RpConn* c = calloc(1, sizeof(RpConn));
+    if (!s->orig_ms || !s->replay_ms || !c) {
+        free(c);
+        return NULL;
+    }
+
+    double t0 = g_start_ms + (double)s->lines[0].ts_ns / 1e6 / g_opt.speed;
+    double wait = t0 - now_ms();
+    if (wait > 0) {
+        long us = (long)(wait * 1000.0);
+        struct timespec ts = { .tv_sec = us / 1000000L, .tv_nsec = (us % 1000000L) * 1000L };
+        nanosleep(&ts, NULL);
+    }
+    c->fd = rp_connect();
+    if (c->fd < 0) {
+        s->connect_failed = 1;
+        free(c);
+        return NULL;
+    }
+
+    // Unprompted lines keep their recorded spacing relative to the previous client line.
+    double prev_sent = now_ms();
+    uint64_t prev_ts = s->lines[0].ts_ns;
+
+    for (size_t i = 0; i < s->n && !c->closed; ++i) {
+        if (s->lines[i].dir != CAPTURE_IN) continue;
+        if (s->lines[i].len >= 5 && strncmp(s->lines[i].data, "C45PO", 5) == 0) continue; // answered live
+
+        double at = 0;
+        i = wait_trigger(s, c, i, &at);
+        if (i >= s->n) break;
+        const RpLine* l = &s->lines[i];
+        const RpLine* trig = recorded_trigger(s, i);
+
+        double due = trig ? at + (double)(l->ts_ns - trig->ts_ns) / 1e6 / g_opt.speed
+                          : prev_sent + (double)(l->ts_ns - prev_ts) / 1e6 / g_opt.speed;
+        while (!c->closed && now_ms() < due) (void)pump(s, c, due);
+        if (c->closed) break;
+
+        if (c->waiting && !is_keepalive(l->data, l->len)) s->replay_ms[c->req] = -1; // no reply in time
+        if (rp_send(c->fd, l->data, l->len) < 0) {
+            c->closed = 1;
+            break;
+        }
+        s->sent++;
+        prev_sent = now_ms();
+        prev_ts = l->ts_ns;
+        if (is_keepalive(l->data, l->len)) continue;
+
+        const RpLine* rep = recorded_reply(s, i);
+        s->orig_ms[s->nreq] = rep ? (double)(rep->ts_ns - l->ts_ns) / 1e6 : -1;
+        s->replay_ms[s->nreq] = -1;
+        c->req = s->nreq++;
+        c->waiting = 1;
+        c->sent_ms = prev_sent;
+        c->expect = rep;
+    }
+    if (!c->closed) {
+        double end = now_ms() + RP_REPLY_WAIT_MS;
+        while (c->waiting && !c->closed && now_ms() < end) (void)pump(s, c, end);
+    } else if (s->sent < nreq) {
+        s->closed_early = 1;
+    }
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+/* --- Report --- */
+
+/**
+ * qsort comparator for doubles.
+ */
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Percentile of a sorted array.
+ */
+static double pct(const double* v, size_t n, double p) {
+    if (n == 0) return 0;
+    return v[(size_t)((double)(n - 1) * p)];
+}
+
+/**
+ * Aggregate per-session results and print the report.
+ *
+ * The last line ("RESULT ...") is meant for scripts.
+ *
+ * @param s       Sessions.
+ * @param n       Number of sessions.
+ * @param elapsed Replay duration in seconds.
+ */
+static void print_report(RpSession* s, size_t n, double elapsed) {
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) total += s[i].nreq;
+
+    double* orig = malloc((total ? total : 1) * sizeof(double));
+    double* rep = malloc((total ? total : 1) * sizeof(double));
+    double* diff = malloc((total ? total : 1) * sizeof(double));
+    if (!orig || !rep || !diff) {
+        free(orig);
+        free(rep);
+        free(diff);
+        return;
+    }
+
+    size_t k = 0, unanswered = 0;
+    uint64_t sent = 0, replies = 0, mism = 0;
+    uint64_t skipped = 0;
+    int failed = 0, early = 0, diverged = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sent += s[i].sent;
+        replies += s[i].replies;
+        mism += s[i].mismatches;
+        failed += s[i].connect_failed;
+        early += s[i].closed_early;
+        diverged += s[i].diverged;
+        skipped += s[i].skipped;
+        for (size_t j = 0; j < s[i].nreq; ++j) {
+            if (s[i].orig_ms[j] < 0) continue; // no recorded reply: nothing to compare
+            if (s[i].replay_ms[j] < 0) {
+                unanswered++;
+                continue;
+            }
+            orig[k] = s[i].orig_ms[j];
+            rep[k] = s[i].replay_ms[j];
+            diff[k] = s[i].replay_ms[j] - s[i].orig_ms[j];
+            k++;
+        }
+    }
+    qsort(orig, k, sizeof(double), cmp_double);
+    qsort(rep, k, sizeof(double), cmp_double);
+    qsort(diff, k, sizeof(double), cmp_double);
+
+    printf("replay: %zu sessions, %.1fs (speed x%.2f)\n", n, elapsed, g_opt.speed);
+    printf("  lines sent    %llu (replies %llu)\n", (unsigned long long)sent, (unsigned long long)replies);
+    printf("  recorded ms   p50=%.3f p99=%.3f\n", pct(orig, k, 0.5), pct(orig, k, 0.99));
+    printf("  replayed ms   p50=%.3f p99=%.3f\n", pct(rep, k, 0.5), pct(rep, k, 0.99));
+    printf("  divergence ms p50=%+.3f p99=%+.3f (samples=%zu)\n", pct(diff, k, 0.5), pct(diff, k, 0.99), k);
+    printf("  unanswered    %zu\n", unanswered);
+    printf("  opcode diffs  %llu\n", (unsigned long long)mism);
+    printf("  resync        skipped=%llu diverged=%d\n", (unsigned long long)skipped, diverged);
+    printf("  failed        connect=%d closed_early=%d\n", failed, early);
+    printf("RESULT sessions=%zu p50_div_ms=%.3f p99_div_ms=%.3f unanswered=%zu opcode_diffs=%llu\n",
+           n, pct(diff, k, 0.5), pct(diff, k, 0.99), unanswered, (unsigned long long)mism);
+    free(orig);
+    free(rep);
+    free(diff);
+}
+
+/**
+ * Replay entry point.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @return 0 on success; 1 on invalid arguments or unreadable capture.
+ */
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    RpSession* sessions = NULL;
+    size_t n = 0;
+    long records = load_capture(g_opt.file, &sessions, &n);
+    if (records < 0) return 1;
+    printf("replay: loaded %ld records in %zu sessions from %s\n", records, n, g_opt.file);
+
+    pthread_t* th = calloc(n ? n : 1, sizeof(pthread_t));
+    if (!th) return 1;
+    g_start_ms = now_ms();
+    for (size_t i = 0; i < n; ++i) pthread_create(&th[i], NULL, session_thread, &sessions[i]);
+    for (size_t i = 0; i < n; ++i) pthread_join(th[i], NULL);
+    double elapsed = (now_ms() - g_start_ms) / 1000.0;
+
+    print_report(sessions, n, elapsed);
+    free_sessions(sessions, n);
+    free(th);
+    return 0;
+}
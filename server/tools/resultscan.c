@@ -0,0 +1,297 @@
+/*
+ * resultscan.c
+ *
+ * Purpose:
+ *   Scan game result batch files (RESULTS_DIR, see include/results.h).
+ *
+ * Responsibilities:
+ *   - Load batch files and locate the columns of every batch by id.
+ *   - Summarize the games (end reasons, pushes, durations, turns, think time per
+ *     profile) reading only the fixed-width columns the summary needs.
+ *   - Optionally print the games as CSV, or only those of one player.
+ *
+ * Table of contents:
+ *   - Options: ScanOptions, parse_options()
+ *   - Columns: BatchView, load_batch(), batch_complete(), col_*()
+ *   - Output: print_row(), print_summary()
+ *   - main()
+ */
+
+#define _GNU_SOURCE
+#include "results.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    int csv;               /* print every game as CSV */
+    const char* player;    /* only games of this player (NULL = all) */
+    int first_file;        /* argv index of the first file */
+} ScanOptions;
+
+/* Column pointers of one batch (into the file buffer). */
+typedef struct {
+    uint32_t rows;
+    const uint8_t* fixed[RESULTS_COL_COUNT + 1];
+    const uint8_t* var[RESULTS_COL_COUNT + 1];   /* offsets (rows + 1 u32), then the data */
+} BatchView;
+
+typedef struct {
+    unsigned long long games, pushes, turns, duration_ms, think_ms;
+    unsigned long long reasons[5];
+} ProfileTotals;
+
+static const char* const g_reason_names[5] = { "normal", "forfeit", "violation", "abandoned", "lost" };
+static const char* const g_profile_names[3] = { "standard", "blitz", "bot" };
+
+static ScanOptions   g_opt;
+static ProfileTotals g_tot[3];
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-c] [-u NAME] FILE...\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -c       Print every game as CSV (header on the first line)\n");
+    printf("  -u NAME  Only games of player NAME\n");
+    printf("  FILE     Batch files written by the server (RESULTS_DIR/results-*.bjr)\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @return 0 on success; -1 on invalid options.
+ */
+static int parse_options(int argc, char** argv, ScanOptions* o) {
+    memset(o, 0, sizeof(*o));
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-c") == 0) o->csv = 1;
+        else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) o->player = argv[++i];
+        else return -1;
+    }
+    o->first_file = i;
+    return i < argc ? 0 : -1;
+}
+
+/**
+ * Monotonic clock in seconds.
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* --- Columns --- */
+
+/**
+ * Locate the columns of the batch at @p p.
+ *
+ * @param p   Batch start.
+ * @param end End of the file buffer.
+ * @param v   Output view.
+ * @return Pointer past the batch; NULL if the batch is truncated or malformed.
+ */
+static const uint8_t* load_batch(const uint8_t* p, const uint8_t* end, BatchView* v) {
+    uint32_t hdr[2];
+    if (end - p < (long)sizeof(hdr)) return NULL;
+    memcpy(hdr, p, sizeof(hdr));
+    p += sizeof(hdr);
+    memset(v, 0, sizeof(*v));
+    v->rows = hdr[0];
+    for (uint32_t c = 0; c < hdr[1]; ++c) {
+        uint32_t bytes;
+        if (end - p < 8) return NULL;
+        uint8_t id = p[0], kind = p[1];
+        unsigned width = (unsigned)p[2] | (unsigned)p[3] << 8;
+        memcpy(&bytes, p + 4, 4);
+        p += 8;
+        if ((uint64_t)(end - p) < bytes) return NULL;
+        if (id <= RESULTS_COL_COUNT) {   // unknown columns are skipped
+            if (kind == RESULTS_FIXED && (uint64_t)width * v->rows == bytes) v->fixed[id] = p;
+            else if (kind == RESULTS_VAR && bytes >= (v->rows + 1) * 4u) v->var[id] = p;
+        }
+        p += bytes;
+    }
+    return p;
+}
+
+/**
+ * @return 1 if every column this tool reads is present; 0 otherwise.
+ */
+static int batch_complete(const BatchView* v) {
+    for (int id = RESULTS_COL_GAME_ID; id <= RESULTS_COL_VALUE_2; ++id)
+        if (!v->fixed[id]) return 0;
+    for (int id = RESULTS_COL_NAME_1; id <= RESULTS_COL_HAND_2; ++id)
+        if (!v->var[id]) return 0;
+    return 1;
+}
+
+static uint64_t col_u64(const BatchView* v, int id, uint32_t i) {
+    uint64_t x; memcpy(&x, v->fixed[id] + (size_t)i * 8, 8); return x;
+}
+static uint32_t col_u32(const BatchView* v, int id, uint32_t i) {
+    uint32_t x; memcpy(&x, v->fixed[id] + (size_t)i * 4, 4); return x;
+}
+static uint16_t col_u16(const BatchView* v, int id, uint32_t i) {
+    uint16_t x; memcpy(&x, v->fixed[id] + (size_t)i * 2, 2); return x;
+}
+static uint8_t col_u8(const BatchView* v, int id, uint32_t i) {
+    return v->fixed[id][i];
+}
+
+/**
+ * Value @p i of a variable-width column.
+ *
+ * @param len Output: length in bytes.
+ * @return Pointer to the value.
+ */
+static const uint8_t* col_var(const BatchView* v, int id, uint32_t i, uint32_t* len) {
+    uint32_t a, b;
+    memcpy(&a, v->var[id] + (size_t)i * 4, 4);
+    memcpy(&b, v->var[id] + (size_t)(i + 1) * 4, 4);
+    *len = b - a;
+    return v->var[id] + (size_t)(v->rows + 1) * 4 + a;
+}
+
+/* --- Output --- */
+
+/**
+ * Print one game as a CSV row.
+ */
+static void print_row(const BatchView* v, uint32_t i) {
+    static const char ranks[] = "A23456789TJQK";
+    static const char suits[] = "CDHS";
+    printf("%llu,%llu,%u,%s,%s,%u,%u,%u",
+           (unsigned long long)col_u64(v, RESULTS_COL_GAME_ID, i),
+           (unsigned long long)col_u64(v, RESULTS_COL_END_MS, i),
+           col_u16(v, RESULTS_COL_LOBBY, i),
+           g_profile_names[col_u8(v, RESULTS_COL_PROFILE, i) % 3],
+           g_reason_names[col_u8(v, RESULTS_COL_END_REASON, i) % 5],
+           col_u8(v, RESULTS_COL_WINNER, i),
+           col_u16(v, RESULTS_COL_TURNS, i),
+           col_u32(v, RESULTS_COL_DURATION_MS, i));
+    for (int s = 0; s < LOBBY_SIZE; ++s) {
+        uint32_t n, h;
+        const uint8_t* name = col_var(v, RESULTS_COL_NAME_1 + s, i, &n);
+        const uint8_t* hand = col_var(v, RESULTS_COL_HAND_1 + s, i, &h);
+        printf(",%.*s,%d,%u,", (int)n, (const char*)name, (int8_t)col_u8(v, RESULTS_COL_VALUE_1 + s, i),
+               col_u32(v, RESULTS_COL_THINK_MS_1 + s, i));
+        for (uint32_t c = 0; c < h; ++c) {
+            int rank = hand[c] & 0x0F;
+            putchar(rank >= 1 && rank <= 13 ? ranks[rank - 1] : '?');
+            putchar(suits[(hand[c] >> 4) & 3]);
+        }
+    }
+    putchar('\n');
+}
+
+/**
+ * Check whether game @p i was played by @p name.
+ */
+static int row_has_player(const BatchView* v, uint32_t i, const char* name) {
+    size_t want = strlen(name);
+    for (int s = 0; s < LOBBY_SIZE; ++s) {
+        uint32_t n;
+        const uint8_t* p = col_var(v, RESULTS_COL_NAME_1 + s, i, &n);
+        if (n == want && memcmp(p, name, n) == 0) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Print the totals per profile.
+ *
+ * @param out     Output stream.
+ * @param batches Batches read.
+ * @param bytes   File bytes read.
+ * @param secs    Scan time.
+ */
+static void print_summary(FILE* out, unsigned long long batches, unsigned long long bytes, double secs) {
+    unsigned long long games = 0;
+    for (int p = 0; p < 3; ++p) games += g_tot[p].games;
+    fprintf(out, "resultscan: %llu games in %llu batches, %.1f MB scanned in %.3f s (%.0f games/s)\n",
+           games, batches, (double)bytes / 1e6, secs, secs > 0 ? (double)games / secs : 0.0);
+    for (int p = 0; p < 3; ++p) {
+        const ProfileTotals* t = &g_tot[p];
+        if (!t->games) continue;
+        fprintf(out, "  %-8s games=%llu push=%.1f%% avg_ms=%.0f avg_turns=%.2f think_ms_per_turn=%.0f",
+               g_profile_names[p], t->games, 100.0 * (double)t->pushes / (double)t->games,
+               (double)t->duration_ms / (double)t->games, (double)t->turns / (double)t->games,
+               t->turns ? (double)t->think_ms / (double)t->turns : 0.0);
+        for (int r = 0; r < 5; ++r) fprintf(out, " %s=%llu", g_reason_names[r], t->reasons[r]);
+        fprintf(out, "\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 2;
+    }
+    if (g_opt.csv) printf("game_id,end_ms,lobby,profile,end_reason,winner,turns,duration_ms,"
+                          "name_1,value_1,think_ms_1,hand_1,name_2,value_2,think_ms_2,hand_2\n");
+
+    double t0 = now_sec();
+    unsigned long long batches = 0, bytes = 0;
+    int failed = 0;
+    for (int f = g_opt.first_file; f < argc; ++f) {
+        FILE* in = fopen(argv[f], "rb");
+        if (!in) {
+            perror(argv[f]);
+            failed = 1;
+            continue;
+        }
+        fseek(in, 0, SEEK_END);
+        long size = ftell(in);
+        fseek(in, 0, SEEK_SET);
+        uint8_t* buf = size > 0 ? (uint8_t*)malloc((size_t)size) : NULL;
+        if (!buf || fread(buf, 1, (size_t)size, in) != (size_t)size || size < 8 ||
+            memcmp(buf, RESULTS_MAGIC, 8) != 0) {
+            fprintf(stderr, "%s: not a results file\n", argv[f]);
+            free(buf);
+            fclose(in);
+            failed = 1;
+            continue;
+        }
+        fclose(in);
+        bytes += (unsigned long long)size;
+
+        const uint8_t* p = buf + 8;
+        const uint8_t* end = buf + size;
+        while (p < end) {
+            BatchView v;
+            p = load_batch(p, end, &v);
+            if (!p || !batch_complete(&v)) {
+                fprintf(stderr, "%s: truncated or malformed batch\n", argv[f]);
+                failed = 1;
+                break;
+            }
+            batches++;
+            for (uint32_t i = 0; i < v.rows; ++i) {
+                if (g_opt.player && !row_has_player(&v, i, g_opt.player)) continue;
+                ProfileTotals* t = &g_tot[col_u8(&v, RESULTS_COL_PROFILE, i) % 3];
+                t->games++;
+                t->pushes += col_u8(&v, RESULTS_COL_WINNER, i) == 2;
+                t->turns += col_u16(&v, RESULTS_COL_TURNS, i);
+                t->duration_ms += col_u32(&v, RESULTS_COL_DURATION_MS, i);
+                t->think_ms += col_u32(&v, RESULTS_COL_THINK_MS_1, i) + col_u32(&v, RESULTS_COL_THINK_MS_2, i);
+                t->reasons[col_u8(&v, RESULTS_COL_END_REASON, i) % 5]++;
+                if (g_opt.csv) print_row(&v, i);
+            }
+        }
+        free(buf);
+    }
+    // With -c the summary goes to stderr, so stdout stays plain CSV.
+    print_summary(g_opt.csv ? stderr : stdout, batches, bytes, now_sec() - t0);
+    return failed;
+}
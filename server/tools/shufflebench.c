@@ -0,0 +1,358 @@
+/*
+ * shufflebench.c
+ *
+ * Purpose:
+ *   Per-game cost of provably fair shuffles (shuffle.c) and a correctness check
+ *   of the commitments; doubles as an auditor's verifier for one game.
+ *
+ * Responsibilities:
+ *   - Check SHA-256 against the FIPS 180-4 test vectors.
+ *   - Time the parts of one ticket: seed (getrandom), deck derivation,
+ *     commitment, and the whole ticket.
+ *   - Verify generated tickets with shuffle_verify(), and that a tampered
+ *     commitment is rejected.
+ *   - Chi-square test of card positions over many shuffles.
+ *   - Compare what a game thread pays per deal: taking a precomputed ticket from
+ *     the pool vs computing it inline (p50/p99), at a given game start rate.
+ *   - Audit mode (-v SEED COMMIT): print the deck for a revealed seed and
+ *     whether it matches the commitment.
+ *
+ * Table of contents:
+ *   - Options: BenchOptions, parse_options()
+ *   - Checks: check_sha256(), check_verify(), check_uniform()
+ *   - Timing: time_parts(), time_deals()
+ *   - Audit: audit()
+ *   - main()
+ */
+
+#define _GNU_SOURCE
+#include "game.h"
+#include "sha256.h"
+#include "shuffle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+
+typedef struct {
+    int tickets;          /* tickets timed / verified */
+    int deals;            /* deals in the pool vs inline comparison */
+    int interval_us;      /* time between deals (game start rate) */
+    const char* seed_hex; /* audit mode */
+    const char* commit_hex;
+} BenchOptions;
+
+static BenchOptions g_opt;
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-n TICKETS] [-g DEALS] [-r INTERVAL_US]\n", prog);
+    printf("  %s -v SEED_HEX COMMIT_HEX\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -n TICKETS      Tickets to time and verify (default 20000)\n");
+    printf("  -g DEALS        Deals for the pool vs inline comparison (default 4000)\n");
+    printf("  -r INTERVAL_US  Time between deals (default 250)\n");
+    printf("  -v SEED COMMIT  Audit one game: seed from C45R, commitment from C45D\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @return 0 on success; -1 on invalid options.
+ */
+static int parse_options(int argc, char** argv, BenchOptions* o) {
+    o->tickets = 20000;
+    o->deals = 4000;
+    o->interval_us = 250;
+    o->seed_hex = o->commit_hex = NULL;
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (strcmp(a, "-v") == 0) {
+            if (i + 2 >= argc) return -1;
+            o->seed_hex = argv[++i];
+            o->commit_hex = argv[++i];
+            continue;
+        }
+        if (i + 1 >= argc) return -1;
+        if (strcmp(a, "-n") == 0) o->tickets = atoi(argv[++i]);
+        else if (strcmp(a, "-g") == 0) o->deals = atoi(argv[++i]);
+        else if (strcmp(a, "-r") == 0) o->interval_us = atoi(argv[++i]);
+        else return -1;
+    }
+    if (o->tickets < 1 || o->deals < 1 || o->interval_us < 0) return -1;
+    return 0;
+}
+
+/**
+ * Monotonic nanoseconds.
+ */
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+/**
+ * qsort comparator for unsigned long long.
+ */
+static int cmp_ull(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* --- Checks --- */
+
+/**
+ * Compare SHA-256 with the FIPS 180-4 / NIST example digests.
+ *
+ * @return 0 if all match; -1 otherwise.
+ */
+static int check_sha256(void) {
+    static const struct { const char* msg; const char* hex; } v[] = {
+        { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    };
+    uint8_t d[SHA256_BYTES];
+    char hex[2 * SHA256_BYTES + 1];
+    int bad = 0;
+    for (size_t i = 0; i < sizeof(v) / sizeof(v[0]); ++i) {
+        sha256(v[i].msg, strlen(v[i].msg), d);
+        sha256_hex(d, sizeof(d), hex);
+        if (strcmp(hex, v[i].hex) != 0) bad++;
+    }
+
+    // One million 'a', fed in uneven pieces through the streaming API.
+    static char chunk[997];
+    memset(chunk, 'a', sizeof(chunk));
+    Sha256 c;
+    sha256_init(&c);
+    size_t left = 1000000;
+    while (left) {
+        size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+        sha256_update(&c, chunk, n);
+        left -= n;
+    }
+    sha256_final(&c, d);
+    sha256_hex(d, sizeof(d), hex);
+    if (strcmp(hex, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") != 0) bad++;
+
+    printf("  sha256 test vectors: %s\n", bad ? "MISMATCH" : "OK");
+    return bad ? -1 : 0;
+}
+
+/**
+ * Verify @p n fresh tickets and one tampered commitment.
+ *
+ * @return 0 if all checks pass; -1 otherwise.
+ */
+static int check_verify(int n) {
+    int bad = 0;
+    for (int i = 0; i < n; ++i) {
+        ShuffleTicket t;
+        Deck d;
+        shuffle_make(&t);
+        if (shuffle_verify(t.proof.seed, t.proof.commit, &d) != 1 ||
+            memcmp(d.cards, t.deck.cards, sizeof(d.cards)) != 0) bad++;
+        if (i == 0) {
+            t.proof.commit[0] = t.proof.commit[0] == '0' ? '1' : '0';
+            if (shuffle_verify(t.proof.seed, t.proof.commit, NULL) != 0) bad++;
+        }
+    }
+    printf("  verify %d tickets + 1 tampered: %s\n", n, bad ? "MISMATCH" : "OK");
+    return bad ? -1 : 0;
+}
+
+/**
+ * Chi-square of the position of every card over @p n shuffles (51 degrees of
+ * freedom per card; the mean over all cards should be close to 51).
+ *
+ * @return 0 if the mean statistic is plausible; -1 otherwise.
+ */
+static int check_uniform(int n) {
+    static unsigned pos[DECK_SIZE][DECK_SIZE];   /* [card][position] */
+    memset(pos, 0, sizeof(pos));
+    for (int i = 0; i < n; ++i) {
+        uint8_t seed[SHUFFLE_SEED_BYTES];
+        Deck d;
+        if (getrandom(seed, sizeof(seed), 0) != (ssize_t)sizeof(seed)) return -1;
+        shuffle_from_seed(seed, &d);
+        for (int p = 0; p < DECK_SIZE; ++p) {
+            int card = (int)d.cards[p].suit * 13 + d.cards[p].rank - 1;
+            pos[card][p]++;
+        }
+    }
+    double expect = (double)n / DECK_SIZE, sum = 0.0;
+    for (int c = 0; c < DECK_SIZE; ++c) {
+        double chi = 0.0;
+        for (int p = 0; p < DECK_SIZE; ++p) {
+            double dlt = (double)pos[c][p] - expect;
+            chi += dlt * dlt / expect;
+        }
+        sum += chi;
+    }
+    double mean = sum / DECK_SIZE;
+    // The mean of 52 chi-square(51) values has sd ~1.4; 60 is far outside chance.
+    int ok = mean > 42.0 && mean < 60.0;
+    printf("  card positions over %d shuffles: mean chi-square %.1f (df 51) %s\n",
+           n, mean, ok ? "OK" : "SUSPICIOUS");
+    return ok ? 0 : -1;
+}
+
+/* --- Timing --- */
+
+/**
+ * Time the parts of one ticket.
+ *
+ * @param n         Iterations.
+ * @param ticket_ns Output: mean ns per whole ticket.
+ */
+static void time_parts(int n, double* ticket_ns) {
+    uint8_t seed[SHUFFLE_SEED_BYTES], digest[SHA256_BYTES];
+    Deck d;
+    volatile unsigned sink = 0;
+
+    unsigned long long t0 = now_ns();
+    for (int i = 0; i < n; ++i) {
+        if (getrandom(seed, sizeof(seed), 0) < 0) break;
+        sink += seed[0];
+    }
+    unsigned long long t1 = now_ns();
+    for (int i = 0; i < n; ++i) {
+        seed[0] = (uint8_t)i;
+        shuffle_from_seed(seed, &d);
+        sink += (unsigned)d.cards[0].rank;
+    }
+    unsigned long long t2 = now_ns();
+    for (int i = 0; i < n; ++i) {
+        seed[0] = (uint8_t)i;
+        shuffle_commit(seed, &d, digest);
+        sink += digest[0];
+    }
+    unsigned long long t3 = now_ns();
+    for (int i = 0; i < n; ++i) {
+        ShuffleTicket t;
+        shuffle_make(&t);
+        sink += (unsigned)t.deck.cards[0].rank;
+    }
+    unsigned long long t4 = now_ns();
+    (void)sink;
+
+    *ticket_ns = (double)(t4 - t3) / n;
+    printf("  per ticket (%d): seed %.0f ns, deck %.0f ns, commitment %.0f ns, total %.0f ns\n",
+           n, (double)(t1 - t0) / n, (double)(t2 - t1) / n, (double)(t3 - t2) / n, *ticket_ns);
+}
+
+/**
+ * Latency of getting a shuffled deck at deal time: pool vs inline.
+ *
+ * @param deals       Number of deals.
+ * @param interval_us Time between deals.
+ * @param take_p99    Output: pool p99 ns.
+ * @param inline_p99  Output: inline p99 ns.
+ * @param misses      Output: pool misses during the run.
+ */
+static void time_deals(int deals, int interval_us, unsigned long long* take_p99,
+                       unsigned long long* inline_p99, unsigned long long* misses) {
+    unsigned long long* lat = (unsigned long long*)malloc((size_t)deals * sizeof(*lat));
+    if (!lat) return;
+    struct timespec gap = { .tv_sec = interval_us / 1000000, .tv_nsec = (long)(interval_us % 1000000) * 1000L };
+
+    for (int mode = 0; mode < 2; ++mode) {
+        ShuffleStats before, after;
+        if (mode == 0) {
+            shuffle_pool_start();
+            // Let the first batches fill the queue, as after server startup.
+            struct timespec fill = { .tv_sec = 0, .tv_nsec = 50000000L };
+            nanosleep(&fill, NULL);
+        }
+        shuffle_stats_snapshot(&before);
+        for (int i = 0; i < deals; ++i) {
+            ShuffleTicket t;
+            unsigned long long t0 = now_ns();
+            if (mode == 0) shuffle_take(&t);
+            else shuffle_make(&t);
+            lat[i] = now_ns() - t0;
+            if (interval_us > 0) nanosleep(&gap, NULL);
+        }
+        shuffle_stats_snapshot(&after);
+        if (mode == 0) shuffle_pool_stop();
+
+        qsort(lat, (size_t)deals, sizeof(*lat), cmp_ull);
+        unsigned long long p50 = lat[deals / 2], p99 = lat[(size_t)deals * 99 / 100], mx = lat[deals - 1];
+        if (mode == 0) {
+            *take_p99 = p99;
+            *misses = after.misses - before.misses;
+            printf("  deal from pool:   p50 %llu ns, p99 %llu ns, max %llu ns, misses %llu, refills %llu\n",
+                   p50, p99, mx, *misses, after.refills - before.refills);
+        } else {
+            *inline_p99 = p99;
+            printf("  deal inline:      p50 %llu ns, p99 %llu ns, max %llu ns\n", p50, p99, mx);
+        }
+    }
+    free(lat);
+}
+
+/* --- Audit --- */
+
+/**
+ * Print the deck for a revealed seed and check it against the commitment.
+ *
+ * @return Process exit code (0 = matches).
+ */
+static int audit(const char* seed_hex, const char* commit_hex) {
+    Deck d;
+    int r = shuffle_verify(seed_hex, commit_hex, &d);
+    if (r < 0) {
+        fprintf(stderr, "shufflebench: seed and commitment must be 64 hex chars each\n");
+        return 2;
+    }
+    printf("deck:");
+    for (int i = 0; i < DECK_SIZE; ++i) {
+        char cs[3];
+        card_to_str(d.cards[i], cs);
+        printf(" %s", cs);
+    }
+    printf("\ncommitment: %s\n", r == 1 ? "MATCHES" : "DOES NOT MATCH");
+    return r == 1 ? 0 : 1;
+}
+
+/**
+ * Benchmark entry point.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @return 0 if every check passed; 1 on a failed check; 2 on bad options.
+ */
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 2;
+    }
+    if (g_opt.seed_hex) return audit(g_opt.seed_hex, g_opt.commit_hex);
+
+    int failed = 0;
+    printf("shufflebench: pool %d tickets, batch %d\n", SHUFFLE_POOL_TICKETS, SHUFFLE_BATCH);
+    if (check_sha256() != 0) failed = 1;
+    if (check_verify(1000) != 0) failed = 1;
+    if (check_uniform(52000) != 0) failed = 1;
+
+    double ticket_ns = 0.0;
+    time_parts(g_opt.tickets, &ticket_ns);
+
+    unsigned long long take_p99 = 0, inline_p99 = 0, misses = 0;
+    time_deals(g_opt.deals, g_opt.interval_us, &take_p99, &inline_p99, &misses);
+
+    printf("RESULT ticket_ns=%.0f deal_pool_p99_ns=%llu deal_inline_p99_ns=%llu misses=%llu checks=%s\n",
+           ticket_ns, take_p99, inline_p99, misses, failed ? "FAIL" : "OK");
+    return failed;
+}
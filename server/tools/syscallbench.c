@@ -0,0 +1,631 @@
+/*
+ * syscallbench.c
+ *
+ * Purpose:
+ *   Syscall-budget regression benchmark: cost of one scripted game in server
+ *   syscalls and context switches, broken down by protocol phase.
+ *
+ * Responsibilities:
+ *   - Run the real server (linked in, loopback, one lobby) on a background thread.
+ *   - Drive two players through a fixed scenario from a single client thread:
+ *     handshake, join, N hits, stand, result, back to the lobby list.
+ *   - Attribute server socket/sleep syscalls (IoStats counters in protocol.c)
+ *     and server-side context switches to the phase the client is in.
+ *   - Count heap allocations made by server code (malloc/calloc/realloc are
+ *     wrapped at link time) and per-game name copies (game_loop_stats_snapshot()).
+ *   - Compare per-game averages with budgets and exit non-zero if one is exceeded.
+ *
+ * Context switches are counted with perf_event_open(PERF_COUNT_SW_CONTEXT_SWITCHES)
+ * inherited by all server threads; when perf events are unavailable the
+ * process-wide getrusage() minus the client thread's share is used instead.
+ * Syscall tracepoints usually need tracefs/root, so syscalls are counted by the
+ * server's own I/O wrappers.
+ *
+ * Table of contents:
+ *   - Options: BenchOptions, parse_options()
+ *   - Allocation counters: __wrap_malloc(), __wrap_calloc(), __wrap_realloc()
+ *   - Counters: Sample, sample_now(), phase_mark()
+ *   - Server: server_thread(), start_server()
+ *   - Client: BenchPlayer, bp_connect(), bp_send(), next_line(), play_game()
+ *   - Report: print_report()
+ */
+
+#define _GNU_SOURCE
+#include "game.h"
+#include "protocol.h"
+#include "server.h"
+#include "shuffle.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SB_WAIT_MS  10000   /* max wait for any expected server line */
+
+typedef enum {
+    PH_HANDSHAKE,
+    PH_JOIN,
+    PH_HIT,
+    PH_STAND,
+    PH_RESULT,
+    PH_BACK,
+    PH_COUNT
+} Phase;
+
+static const char* const PHASE_NAMES[PH_COUNT] = {
+    "handshake", "join", "hit", "stand", "result", "back"
+};
+
+/*
+ * Budgets per game (handshake: per connection pair), in server syscalls and
+ * server context switches. Keep some headroom for card randomness and the
+ * server's periodic bind-address check.
+ */
+typedef struct {
+    double syscalls;
+    double ctxsw;
+} Budget;
+
+static const Budget BUDGETS[PH_COUNT] = {
+    [PH_HANDSHAKE] = {  25, 20 },
+    [PH_JOIN]      = {  25, 12 },
+    [PH_HIT]       = {  50, 20 },
+    [PH_STAND]     = {   8,  5 },
+    [PH_RESULT]    = {   8,  6 },
+    [PH_BACK]      = {  15, 10 },
+};
+static const Budget BUDGET_GAME = { 100, 50 };
+
+/*
+ * Steady-state game phases (everything after the handshake) must not touch the
+ * heap, and a game copies each seated player's name exactly once.
+ */
+#define BUDGET_ALLOCS_PER_GAME       0.0
+#define BUDGET_NAME_COPIES_PER_GAME  ((double)LOBBY_SIZE)
+
+typedef struct {
+    int port;
+    int games;
+    int hits;
+    unsigned seed;
+    int verbose;
+    int no_budget;
+} BenchOptions;
+
+static BenchOptions g_opt;
+
+/**
+ * Print CLI usage help.
+ *
+ * @param prog Program name (argv[0]).
+ */
+static void print_help(const char* prog) {
+    printf("Usage:\n");
+    printf("  %s [-p PORT] [-g GAMES] [-n HITS] [-s SEED] [-v] [-r]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -p PORT   Loopback port for the embedded server (default 12050)\n");
+    printf("  -g GAMES  Number of games to play (default 20)\n");
+    printf("  -n HITS   Hits per player before standing (default 2)\n");
+    printf("  -s SEED   Deck shuffle seed (default 1)\n");
+    printf("  -v        Show server log output\n");
+    printf("  -r        Report only, do not enforce budgets\n");
+}
+
+/**
+ * Parse CLI options.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @param o    Output options (defaults are filled in first).
+ * @return 0 on success; -1 on invalid arguments.
+ */
+static int parse_options(int argc, char** argv, BenchOptions* o) {
+    o->port = 12050;
+    o->games = 20;
+    o->hits = 2;
+    o->seed = 1;
+    o->verbose = 0;
+    o->no_budget = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (strcmp(a, "-v") == 0) { o->verbose = 1; continue; }
+        if (strcmp(a, "-r") == 0) { o->no_budget = 1; continue; }
+        if (i + 1 >= argc) return -1;
+        const char* v = argv[++i];
+        if (strcmp(a, "-p") == 0) o->port = atoi(v);
+        else if (strcmp(a, "-g") == 0) o->games = atoi(v);
+        else if (strcmp(a, "-n") == 0) o->hits = atoi(v);
+        else if (strcmp(a, "-s") == 0) o->seed = (unsigned)strtoul(v, NULL, 10);
+        else return -1;
+    }
+    if (o->port < 1 || o->port > 65535 || o->games < 1 || o->hits < 0) return -1;
+    return 0;
+}
+
+/* --- Allocation counters --- */
+
+/*
+ * Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc: every call from
+ * the server objects (and this file) lands here. Allocations made inside libc
+ * itself are not seen, which is what we want: only our own code is measured.
+ */
+void* __real_malloc(size_t n);
+void* __real_calloc(size_t n, size_t sz);
+void* __real_realloc(void* p, size_t n);
+
+static atomic_ullong g_allocs = 0;
+
+/** Counting malloc(). */
+void* __wrap_malloc(size_t n) {
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    return __real_malloc(n);
+}
+
+/** Counting calloc(). */
+void* __wrap_calloc(size_t n, size_t sz) {
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    return __real_calloc(n, sz);
+}
+
+/** Counting realloc(). */
+void* __wrap_realloc(void* p, size_t n) {
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    return __real_realloc(p, n);
+}
+
+/* --- Counters --- */
+
+typedef struct {
+    IoStats io;
+    unsigned long long ctxsw;
+    unsigned long long allocs;
+} Sample;
+
+typedef struct {
+    unsigned long long recv, send, poll, sleep, ctxsw, allocs;
+} PhaseTotals;
+
+static int         g_perf_fd = -1;
+static PhaseTotals g_totals[PH_COUNT];
+static Phase       g_phase = PH_HANDSHAKE;
+static Sample      g_last;
+
+/**
+ * Open an inherited context-switch counter for the calling thread and every
+ * thread it creates afterwards.
+ *
+ * @return perf fd, or -1 if perf events are unavailable.
+ */
+static int perf_open_ctxsw(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_SOFTWARE;
+    a.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    a.inherit = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+/**
+ * Server-side context switches so far.
+ */
+static unsigned long long ctxsw_now(void) {
+    if (g_perf_fd >= 0) {
+        uint64_t v = 0;
+        if (read(g_perf_fd, &v, sizeof(v)) == (ssize_t)sizeof(v)) return v;
+    }
+    struct rusage all, self;
+    getrusage(RUSAGE_SELF, &all);
+    getrusage(RUSAGE_THREAD, &self);
+    return (unsigned long long)((all.ru_nvcsw + all.ru_nivcsw) - (self.ru_nvcsw + self.ru_nivcsw));
+}
+
+/**
+ * Take a counter sample.
+ */
+static void sample_now(Sample* s) {
+    io_stats_snapshot(&s->io);
+    s->ctxsw = ctxsw_now();
+    s->allocs = atomic_load_explicit(&g_allocs, memory_order_relaxed);
+}
+
+/**
+ * Charge everything since the previous mark to the current phase and enter @p next.
+ *
+ * @param next Phase the client is entering.
+ */
+static void phase_mark(Phase next) {
+    // PH_COUNT only closes the running phase.
+    Sample s;
+    sample_now(&s);
+    PhaseTotals* t = &g_totals[g_phase];
+    t->recv  += s.io.recv - g_last.io.recv;
+    t->send  += s.io.send - g_last.io.send;
+    t->poll  += s.io.poll - g_last.io.poll;
+    t->sleep += s.io.sleep - g_last.io.sleep;
+    t->ctxsw += s.ctxsw - g_last.ctxsw;
+    t->allocs += s.allocs - g_last.allocs;
+    g_last = s;
+    g_phase = next;
+}
+
+/* --- Server --- */
+
+static pthread_mutex_t g_ready_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_ready_cv = PTHREAD_COND_INITIALIZER;
+static int             g_ready = 0;
+
+/**
+ * Server thread: open the inherited perf counter, then run the accept loop
+ * (every server thread is created from here and is therefore counted).
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* server_thread(void* arg) {
+    (void)arg;
+    g_perf_fd = perf_open_ctxsw();
+
+    pthread_mutex_lock(&g_ready_mtx);
+    g_ready = 1;
+    pthread_cond_signal(&g_ready_cv);
+    pthread_mutex_unlock(&g_ready_mtx);
+
+    (void)run_server("127.0.0.1", g_opt.port);
+    return NULL;
+}
+
+/**
+ * Initialize one lobby with a fixed deck seed and start the server thread.
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int start_server(void) {
+    g_lobby_count = 1;
+    if (lobbies_init() != 0) return -1;
+    shuffle_fixed_seeds(g_opt.seed); // make decks reproducible
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, server_thread, NULL) != 0) return -1;
+    pthread_detach(th);
+
+    pthread_mutex_lock(&g_ready_mtx);
+    while (!g_ready) pthread_cond_wait(&g_ready_cv, &g_ready_mtx);
+    pthread_mutex_unlock(&g_ready_mtx);
+    return 0;
+}
+
+/* --- Client --- */
+
+typedef struct {
+    char   name[32];
+    int    fd;
+    char   in[4096];
+    size_t inlen;
+    int    hits;
+    int    done;      /* stood or busted in the current game */
+    int    got_result;
+} BenchPlayer;
+
+/**
+ * Connect to the embedded server, retrying while it starts listening.
+ *
+ * @return Connected socket fd, or -1 on error.
+ */
+static int bp_connect(void) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)g_opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int attempt = 0; attempt < 200; ++attempt) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            int one = 1;
+            (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        close(fd);
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000000L };
+        nanosleep(&ts, NULL);
+    }
+    return -1;
+}
+
+/**
+ * Send a protocol line.
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int bp_send(BenchPlayer* p, const char* s) {
+    size_t n = strlen(s), off = 0;
+    while (off < n) {
+        ssize_t w = send(p->fd, s + off, n - off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+/**
+ * Pop one buffered line of a player, if any.
+ *
+ * @return 1 if a line was stored in @p out; 0 otherwise.
+ */
+static int pop_line(BenchPlayer* p, char* out, size_t out_sz) {
+    char* nl = memchr(p->in, '\n', p->inlen);
+    if (!nl) return 0;
+    size_t len = (size_t)(nl - p->in) + 1;
+    size_t cp = len < out_sz - 1 ? len : out_sz - 1;
+    memcpy(out, p->in, cp);
+    out[cp] = '\0';
+    memmove(p->in, p->in + len, p->inlen - len);
+    p->inlen -= len;
+    return 1;
+}
+
+/**
+ * Wait for the next server line on either player's connection.
+ *
+ * Keepalive pings are answered here and never returned.
+ *
+ * @param pl     Both players.
+ * @param out    Destination buffer.
+ * @param out_sz Size of @p out.
+ * @return Index of the player that received the line; -1 on error/timeout.
+ */
+static int next_line(BenchPlayer pl[2], char* out, size_t out_sz) {
+    for (;;) {
+        for (int i = 0; i < 2; ++i) {
+            while (pop_line(&pl[i], out, out_sz)) {
+                if (strncmp(out, "C45PI", 5) == 0) {
+                    if (bp_send(&pl[i], "C45PO\n") < 0) return -1;
+                    continue;
+                }
+                return i;
+            }
+        }
+
+        struct pollfd pfd[2] = {
+            { .fd = pl[0].fd, .events = POLLIN },
+            { .fd = pl[1].fd, .events = POLLIN },
+        };
+        int pr = poll(pfd, 2, SB_WAIT_MS);
+        if (pr == 0) {
+            fprintf(stderr, "syscallbench: timeout waiting for the server\n");
+            return -1;
+        }
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (pl[i].inlen >= sizeof(pl[i].in)) return -1;
+            ssize_t r = recv(pl[i].fd, pl[i].in + pl[i].inlen, sizeof(pl[i].in) - pl[i].inlen, 0);
+            if (r <= 0) {
+                fprintf(stderr, "syscallbench: server closed %s's connection\n", pl[i].name);
+                return -1;
+            }
+            pl[i].inlen += (size_t)r;
+        }
+    }
+}
+
+/**
+ * Wait until player @p who receives a line starting with @p prefix.
+ *
+ * Lines for the other player, or other lines for @p who, are not expected
+ * in the phases this is used for and are ignored.
+ *
+ * @return 0 on success; -1 on error.
+ */
+static int expect_line(BenchPlayer pl[2], int who, const char* prefix) {
+    char line[READ_BUF];
+    for (;;) {
+        int i = next_line(pl, line, sizeof(line));
+        if (i < 0) return -1;
+        if (i == who && strncmp(line, prefix, strlen(prefix)) == 0) return 0;
+        if (strncmp(line, "C45WRONG", 8) == 0) {
+            fprintf(stderr, "syscallbench: unexpected %s", line);
+            return -1;
+        }
+    }
+}
+
+/**
+ * Play one game: join, turns (N hits then stand), result, back.
+ *
+ * @param pl Both players (already past the handshake, at the lobby list).
+ * @return 0 on success; -1 on error.
+ */
+static int play_game(BenchPlayer pl[2]) {
+    phase_mark(PH_JOIN);
+    for (int i = 0; i < 2; ++i) {
+        pl[i].hits = 0;
+        pl[i].done = 0;
+        pl[i].got_result = 0;
+        if (bp_send(&pl[i], "C45J 1\n") < 0) return -1;
+    }
+
+    char line[READ_BUF];
+    while (!(pl[0].got_result && pl[1].got_result)) {
+        int i = next_line(pl, line, sizeof(line));
+        if (i < 0) return -1;
+
+        if (strncmp(line, "C45OK", 5) == 0) {
+            continue; // join acknowledged
+        } else if (strncmp(line, "C45T ", 5) == 0) {
+            char who[MAX_NAME_LEN] = {0};
+            if (sscanf(line, "C45T %63s", who) != 1 || strcmp(who, pl[i].name) != 0) continue;
+            BenchPlayer* me = &pl[i];
+            BenchPlayer* other = &pl[1 - i];
+            if (me->hits < g_opt.hits) {
+                phase_mark(PH_HIT);
+                me->hits++;
+                if (bp_send(me, "C45H\n") < 0) return -1;
+            } else {
+                phase_mark(other->done ? PH_RESULT : PH_STAND);
+                me->done = 1;
+                if (bp_send(me, "C45S\n") < 0) return -1;
+            }
+        } else if (strncmp(line, "C45B ", 5) == 0) {
+            pl[i].done = 1; // busted
+        } else if (strncmp(line, "C45R ", 5) == 0) {
+            pl[i].got_result = 1;
+        } else if (strncmp(line, "C45WRONG", 8) == 0) {
+            fprintf(stderr, "syscallbench: unexpected %s", line);
+            return -1;
+        }
+    }
+
+    phase_mark(PH_BACK);
+    for (int i = 0; i < 2; ++i) {
+        if (bp_send(&pl[i], "C45B\n") < 0) return -1;
+        if (expect_line(pl, i, "C45L ") < 0) return -1;
+    }
+    return 0;
+}
+
+/* --- Report --- */
+
+/**
+ * Print the per-phase breakdown and check budgets.
+ *
+ * The last line ("RESULT ...") is meant for scripts.
+ *
+ * @param out   Report stream.
+ * @param games Number of games played.
+ * @return Number of exceeded budgets.
+ */
+static int print_report(FILE* out, int games) {
+    int failed = 0;
+    double game_sys = 0, game_cs = 0, game_allocs = 0;
+
+    fprintf(out, "syscallbench: %d games, %d hits per player, seed %u (ctx switches via %s)\n",
+            games, g_opt.hits, g_opt.seed, g_perf_fd >= 0 ? "perf_event" : "getrusage");
+    fprintf(out, "  %-10s %8s %8s %8s %8s %9s %9s %7s   %s\n",
+            "phase", "recv", "send", "poll", "sleep", "syscalls", "ctxsw", "allocs", "budget");
+    for (int ph = 0; ph < PH_COUNT; ++ph) {
+        const PhaseTotals* t = &g_totals[ph];
+        double div = ph == PH_HANDSHAKE ? 1.0 : (double)games;
+        double sys = (double)(t->recv + t->send + t->poll + t->sleep) / div;
+        double cs = (double)t->ctxsw / div;
+        double al = (double)t->allocs / div;
+        int over = sys > BUDGETS[ph].syscalls || cs > BUDGETS[ph].ctxsw;
+        if (ph != PH_HANDSHAKE) {
+            game_sys += sys;
+            game_cs += cs;
+            game_allocs += al;
+        }
+        if (over && !g_opt.no_budget) failed++;
+        fprintf(out, "  %-10s %8.1f %8.1f %8.1f %8.1f %9.1f %9.1f %7.1f   %.0f/%.0f%s\n",
+                PHASE_NAMES[ph],
+                (double)t->recv / div, (double)t->send / div,
+                (double)t->poll / div, (double)t->sleep / div,
+                sys, cs, al, BUDGETS[ph].syscalls, BUDGETS[ph].ctxsw,
+                over ? "  OVER BUDGET" : "");
+    }
+    int game_over = game_sys > BUDGET_GAME.syscalls || game_cs > BUDGET_GAME.ctxsw;
+    if (game_over && !g_opt.no_budget) failed++;
+    fprintf(out, "  %-10s %44.1f %9.1f %7.1f   %.0f/%.0f%s\n", "per game",
+            game_sys, game_cs, game_allocs, BUDGET_GAME.syscalls, BUDGET_GAME.ctxsw,
+            game_over ? "  OVER BUDGET" : "");
+
+    GameLoopStats gl;
+    game_loop_stats_snapshot(&gl);
+    double copies = gl.games ? (double)gl.name_copies / (double)gl.games : 0.0;
+    int alloc_over = game_allocs > BUDGET_ALLOCS_PER_GAME;
+    int copy_over = copies > BUDGET_NAME_COPIES_PER_GAME;
+    if ((alloc_over || copy_over) && !g_opt.no_budget) failed++;
+    fprintf(out, "  heap allocations per game %.1f (budget %.0f)%s, name copies per game %.1f (budget %.0f)%s\n",
+            game_allocs, BUDGET_ALLOCS_PER_GAME, alloc_over ? "  OVER BUDGET" : "",
+            copies, BUDGET_NAME_COPIES_PER_GAME, copy_over ? "  OVER BUDGET" : "");
+    fprintf(out, "  (handshake is per connection pair; other rows are averages per game)\n");
+    fprintf(out, "RESULT syscalls_per_game=%.1f ctxsw_per_game=%.1f allocs_per_game=%.1f "
+                 "name_copies_per_game=%.1f budget=%s\n",
+            game_sys, game_cs, game_allocs, copies, failed ? "FAIL" : "OK");
+    return failed;
+}
+
+/**
+ * Benchmark entry point.
+ *
+ * @param argc CLI argc.
+ * @param argv CLI argv.
+ * @return 0 within budget; 1 if a budget is exceeded; 2 on setup/protocol errors.
+ */
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv, &g_opt) != 0) {
+        print_help(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // The server logs every protocol step to stdout; keep the report separate.
+    FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report) return 2;
+    if (!g_opt.verbose && !freopen("/dev/null", "w", stdout)) return 2;
+    if (g_opt.verbose) setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (start_server() != 0) {
+        fprintf(stderr, "syscallbench: cannot start the server\n");
+        return 2;
+    }
+
+    BenchPlayer pl[2];
+    memset(pl, 0, sizeof(pl));
+    pl[0].fd = pl[1].fd = -1; // poll() skips negative fds until both are connected
+    unsigned pid = (unsigned)getpid() % 10000u;
+    snprintf(pl[0].name, sizeof(pl[0].name), "sb%u_a", pid);
+    snprintf(pl[1].name, sizeof(pl[1].name), "sb%u_b", pid);
+
+    sample_now(&g_last);
+    for (int i = 0; i < 2; ++i) {
+        char hello[64];
+        pl[i].fd = bp_connect();
+        if (pl[i].fd < 0) {
+            fprintf(stderr, "syscallbench: cannot connect to 127.0.0.1:%d\n", g_opt.port);
+            return 2;
+        }
+        snprintf(hello, sizeof(hello), "C45%.31s\n", pl[i].name);
+        if (bp_send(&pl[i], hello) < 0 ||
+            expect_line(pl, i, "C45OK") < 0 ||
+            expect_line(pl, i, "C45L ") < 0) return 2;
+    }
+
+    for (int g = 0; g < g_opt.games; ++g) {
+        if (play_game(pl) < 0) {
+            fprintf(stderr, "syscallbench: game %d failed\n", g + 1);
+            return 2;
+        }
+    }
+    phase_mark(PH_COUNT); // close the last phase
+
+    int failed = print_report(report, g_opt.games);
+    fflush(report);
+    // The server thread is still in its accept loop; exiting tears it down.
+    _exit(failed ? 1 : 0);
+}